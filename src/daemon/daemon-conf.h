@@ -69,6 +69,7 @@ typedef struct pa_daemon_conf {
         disable_shm,
         disable_remixing,
         disable_lfe_remixing,
+        shared_resamplers,
         load_default_script_file,
         disallow_exit,
         log_meta,
@@ -52,7 +52,8 @@
 #include <pulsecore/core-error.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
-#include <pulsecore/time-smoother.h>
+#include <pulsecore/tsched.h>
+#include <pulsecore/histogram.h>
 
 #include <modules/reserve-wrap.h>
 
@@ -66,21 +67,6 @@
 #define DEFAULT_TSCHED_BUFFER_USEC (2*PA_USEC_PER_SEC)             /* 2s    -- Overall buffer size */
 #define DEFAULT_TSCHED_WATERMARK_USEC (20*PA_USEC_PER_MSEC)        /* 20ms  -- Fill up when only this much is left in the buffer */
 
-#define TSCHED_WATERMARK_INC_STEP_USEC (10*PA_USEC_PER_MSEC)       /* 10ms  -- On underrun, increase watermark by this */
-#define TSCHED_WATERMARK_DEC_STEP_USEC (5*PA_USEC_PER_MSEC)        /* 5ms   -- When everything's great, decrease watermark by this */
-#define TSCHED_WATERMARK_VERIFY_AFTER_USEC (20*PA_USEC_PER_SEC)    /* 20s   -- How long after a drop out recheck if things are good now */
-#define TSCHED_WATERMARK_INC_THRESHOLD_USEC (0*PA_USEC_PER_MSEC)   /* 0ms   -- If the buffer level ever below this theshold, increase the watermark */
-#define TSCHED_WATERMARK_DEC_THRESHOLD_USEC (100*PA_USEC_PER_MSEC) /* 100ms -- If the buffer level didn't drop below this theshold in the verification time, decrease the watermark */
-
-/* Note that TSCHED_WATERMARK_INC_THRESHOLD_USEC == 0 means tht we
- * will increase the watermark only if we hit a real underrun. */
-
-#define TSCHED_MIN_SLEEP_USEC (10*PA_USEC_PER_MSEC)                /* 10ms  -- Sleep at least 10ms on each iteration */
-#define TSCHED_MIN_WAKEUP_USEC (4*PA_USEC_PER_MSEC)                /* 4ms   -- Wakeup at least this long before the buffer runs empty*/
-
-#define SMOOTHER_MIN_INTERVAL (2*PA_USEC_PER_MSEC)                 /* 2ms   -- min smoother update interval */
-#define SMOOTHER_MAX_INTERVAL (200*PA_USEC_PER_MSEC)               /* 200ms -- max smoother update inteval */
-
 #define VOLUME_ACCURACY (PA_VOLUME_NORM/100)  /* don't require volume adjustments to be perfectly correct. don't necessarily extend granularity in software unless the differences get greater than this level */
 
 struct userdata {
@@ -104,17 +90,9 @@ struct userdata {
     size_t
         frame_size,
         fragment_size,
-        hwbuf_size,
-        tsched_watermark,
-        hwbuf_unused,
-        min_sleep,
-        min_wakeup,
-        watermark_inc_step,
-        watermark_dec_step,
-        watermark_inc_threshold,
-        watermark_dec_threshold;
-
-    pa_usec_t watermark_dec_not_before;
+        hwbuf_size;
+
+    pa_tsched *tsched;
 
     pa_memchunk memchunk;
 
@@ -129,11 +107,7 @@ struct userdata {
 
     snd_mixer_selem_channel_id_t mixer_map[SND_MIXER_SCHN_LAST];
 
-    pa_smoother *smoother;
-    uint64_t write_count;
     uint64_t since_start;
-    pa_usec_t smoother_interval;
-    pa_usec_t last_smoother_update;
 
     pa_reserve_wrapper *reserve;
     pa_hook_slot *reserve_slot;
@@ -258,133 +232,6 @@ static int reserve_monitor_init(struct userdata *u, const char *dname) {
     return 0;
 }
 
-static void fix_min_sleep_wakeup(struct userdata *u) {
-    size_t max_use, max_use_2;
-
-    pa_assert(u);
-    pa_assert(u->use_tsched);
-
-    max_use = u->hwbuf_size - u->hwbuf_unused;
-    max_use_2 = pa_frame_align(max_use/2, &u->sink->sample_spec);
-
-    u->min_sleep = pa_usec_to_bytes(TSCHED_MIN_SLEEP_USEC, &u->sink->sample_spec);
-    u->min_sleep = PA_CLAMP(u->min_sleep, u->frame_size, max_use_2);
-
-    u->min_wakeup = pa_usec_to_bytes(TSCHED_MIN_WAKEUP_USEC, &u->sink->sample_spec);
-    u->min_wakeup = PA_CLAMP(u->min_wakeup, u->frame_size, max_use_2);
-}
-
-static void fix_tsched_watermark(struct userdata *u) {
-    size_t max_use;
-    pa_assert(u);
-    pa_assert(u->use_tsched);
-
-    max_use = u->hwbuf_size - u->hwbuf_unused;
-
-    if (u->tsched_watermark > max_use - u->min_sleep)
-        u->tsched_watermark = max_use - u->min_sleep;
-
-    if (u->tsched_watermark < u->min_wakeup)
-        u->tsched_watermark = u->min_wakeup;
-}
-
-static void increase_watermark(struct userdata *u) {
-    size_t old_watermark;
-    pa_usec_t old_min_latency, new_min_latency;
-
-    pa_assert(u);
-    pa_assert(u->use_tsched);
-
-    /* First, just try to increase the watermark */
-    old_watermark = u->tsched_watermark;
-    u->tsched_watermark = PA_MIN(u->tsched_watermark * 2, u->tsched_watermark + u->watermark_inc_step);
-    fix_tsched_watermark(u);
-
-    if (old_watermark != u->tsched_watermark) {
-        pa_log_info("Increasing wakeup watermark to %0.2f ms",
-                    (double) pa_bytes_to_usec(u->tsched_watermark, &u->sink->sample_spec) / PA_USEC_PER_MSEC);
-        return;
-    }
-
-    /* Hmm, we cannot increase the watermark any further, hence let's raise the latency */
-    old_min_latency = u->sink->thread_info.min_latency;
-    new_min_latency = PA_MIN(old_min_latency * 2, old_min_latency + TSCHED_WATERMARK_INC_STEP_USEC);
-    new_min_latency = PA_MIN(new_min_latency, u->sink->thread_info.max_latency);
-
-    if (old_min_latency != new_min_latency) {
-        pa_log_info("Increasing minimal latency to %0.2f ms",
-                    (double) new_min_latency / PA_USEC_PER_MSEC);
-
-        pa_sink_set_latency_range_within_thread(u->sink, new_min_latency, u->sink->thread_info.max_latency);
-    }
-
-    /* When we reach this we're officialy fucked! */
-}
-
-static void decrease_watermark(struct userdata *u) {
-    size_t old_watermark;
-    pa_usec_t now;
-
-    pa_assert(u);
-    pa_assert(u->use_tsched);
-
-    now = pa_rtclock_now();
-
-    if (u->watermark_dec_not_before <= 0)
-        goto restart;
-
-    if (u->watermark_dec_not_before > now)
-        return;
-
-    old_watermark = u->tsched_watermark;
-
-    if (u->tsched_watermark < u->watermark_dec_step)
-        u->tsched_watermark = u->tsched_watermark / 2;
-    else
-        u->tsched_watermark = PA_MAX(u->tsched_watermark / 2, u->tsched_watermark - u->watermark_dec_step);
-
-    fix_tsched_watermark(u);
-
-    if (old_watermark != u->tsched_watermark)
-        pa_log_info("Decreasing wakeup watermark to %0.2f ms",
-                    (double) pa_bytes_to_usec(u->tsched_watermark, &u->sink->sample_spec) / PA_USEC_PER_MSEC);
-
-    /* We don't change the latency range*/
-
-restart:
-    u->watermark_dec_not_before = now + TSCHED_WATERMARK_VERIFY_AFTER_USEC;
-}
-
-static void hw_sleep_time(struct userdata *u, pa_usec_t *sleep_usec, pa_usec_t*process_usec) {
-    pa_usec_t usec, wm;
-
-    pa_assert(sleep_usec);
-    pa_assert(process_usec);
-
-    pa_assert(u);
-    pa_assert(u->use_tsched);
-
-    usec = pa_sink_get_requested_latency_within_thread(u->sink);
-
-    if (usec == (pa_usec_t) -1)
-        usec = pa_bytes_to_usec(u->hwbuf_size, &u->sink->sample_spec);
-
-    wm = pa_bytes_to_usec(u->tsched_watermark, &u->sink->sample_spec);
-
-    if (wm > usec)
-        wm = usec/2;
-
-    *sleep_usec = usec - wm;
-    *process_usec = wm;
-
-#ifdef DEBUG_TIMING
-    pa_log_debug("Buffer time: %lu ms; Sleep time: %lu ms; Process time: %lu ms",
-                 (unsigned long) (usec / PA_USEC_PER_MSEC),
-                 (unsigned long) (*sleep_usec / PA_USEC_PER_MSEC),
-                 (unsigned long) (*process_usec / PA_USEC_PER_MSEC));
-#endif
-}
-
 static int try_recover(struct userdata *u, const char *call, int err) {
     pa_assert(u);
     pa_assert(call);
@@ -410,64 +257,6 @@ static int try_recover(struct userdata *u, const char *call, int err) {
     return 0;
 }
 
-static size_t check_left_to_play(struct userdata *u, size_t n_bytes, pa_bool_t on_timeout) {
-    size_t left_to_play;
-    pa_bool_t underrun = FALSE;
-
-    /* We use <= instead of < for this check here because an underrun
-     * only happens after the last sample was processed, not already when
-     * it is removed from the buffer. This is particularly important
-     * when block transfer is used. */
-
-    if (n_bytes <= u->hwbuf_size)
-        left_to_play = u->hwbuf_size - n_bytes;
-    else {
-
-        /* We got a dropout. What a mess! */
-        left_to_play = 0;
-        underrun = TRUE;
-
-#ifdef DEBUG_TIMING
-        PA_DEBUG_TRAP;
-#endif
-
-        if (!u->first && !u->after_rewind)
-            if (pa_log_ratelimit())
-                pa_log_info("Underrun!");
-    }
-
-#ifdef DEBUG_TIMING
-    pa_log_debug("%0.2f ms left to play; inc threshold = %0.2f ms; dec threshold = %0.2f ms",
-                 (double) pa_bytes_to_usec(left_to_play, &u->sink->sample_spec) / PA_USEC_PER_MSEC,
-                 (double) pa_bytes_to_usec(u->watermark_inc_threshold, &u->sink->sample_spec) / PA_USEC_PER_MSEC,
-                 (double) pa_bytes_to_usec(u->watermark_dec_threshold, &u->sink->sample_spec) / PA_USEC_PER_MSEC);
-#endif
-
-    if (u->use_tsched) {
-        pa_bool_t reset_not_before = TRUE;
-
-        if (!u->first && !u->after_rewind) {
-            if (underrun || left_to_play < u->watermark_inc_threshold)
-                increase_watermark(u);
-            else if (left_to_play > u->watermark_dec_threshold) {
-                reset_not_before = FALSE;
-
-                /* We decrease the watermark only if have actually
-                 * been woken up by a timeout. If something else woke
-                 * us up it's too easy to fulfill the deadlines... */
-
-                if (on_timeout)
-                    decrease_watermark(u);
-            }
-        }
-
-        if (reset_not_before)
-            u->watermark_dec_not_before = 0;
-    }
-
-    return left_to_play;
-}
-
 static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polled, pa_bool_t on_timeout) {
     pa_bool_t work_done = TRUE;
     pa_usec_t max_sleep_usec = 0, process_usec = 0;
@@ -478,7 +267,7 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
     pa_sink_assert_ref(u->sink);
 
     if (u->use_tsched)
-        hw_sleep_time(u, &max_sleep_usec, &process_usec);
+        pa_tsched_sleep_time(u->tsched, &max_sleep_usec, &process_usec);
 
     for (;;) {
         snd_pcm_sframes_t n;
@@ -503,7 +292,7 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
         pa_log_debug("avail: %lu", (unsigned long) n_bytes);
 #endif
 
-        left_to_play = check_left_to_play(u, n_bytes, on_timeout);
+        left_to_play = pa_tsched_check_left_to_play(u->tsched, n_bytes, on_timeout, !u->first && !u->after_rewind);
         on_timeout = FALSE;
 
         if (u->use_tsched)
@@ -522,7 +311,7 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
                 break;
             }
 
-        if (PA_UNLIKELY(n_bytes <= u->hwbuf_unused)) {
+        if (PA_UNLIKELY(n_bytes <= pa_tsched_get_unused(u->tsched))) {
 
             if (polled)
                 PA_ONCE_BEGIN {
@@ -549,7 +338,7 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
             break;
         }
 
-        n_bytes -= u->hwbuf_unused;
+        n_bytes -= pa_tsched_get_unused(u->tsched);
         polled = FALSE;
 
 #ifdef DEBUG_TIMING
@@ -563,10 +352,17 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
             const snd_pcm_channel_area_t *areas;
             snd_pcm_uframes_t offset, frames;
             snd_pcm_sframes_t sframes;
+            pa_bool_t profiling;
+            uint64_t t0, dt;
 
             frames = (snd_pcm_uframes_t) (n_bytes / u->frame_size);
 /*             pa_log_debug("%lu frames to write", (unsigned long) frames); */
 
+            /* The write probe accounts for mmap_begin() and
+             * mmap_commit(), but not for the rendering in between */
+            profiling = pa_atomic_load(&u->core->render_profiling) > 0;
+            t0 = pa_histogram_start(profiling);
+
             if (PA_UNLIKELY((err = pa_alsa_safe_mmap_begin(u->pcm_handle, &areas, &offset, &frames, u->hwbuf_size, &u->sink->sample_spec)) < 0)) {
 
                 if (!after_avail && err == -EAGAIN)
@@ -598,6 +394,8 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
 
             p = (uint8_t*) areas[0].addr + (offset * u->frame_size);
 
+            dt = profiling ? pa_histogram_now() - t0 : 0;
+
             chunk.memblock = pa_memblock_new_fixed(u->core->mempool, p, frames * u->frame_size, TRUE);
             chunk.length = pa_memblock_get_length(chunk.memblock);
             chunk.index = 0;
@@ -605,6 +403,8 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
             pa_sink_render_into_full(u->sink, &chunk);
             pa_memblock_unref_fixed(chunk.memblock);
 
+            t0 = pa_histogram_start(profiling);
+
             if (PA_UNLIKELY((sframes = snd_pcm_mmap_commit(u->pcm_handle, offset, frames)) < 0)) {
 
                 if ((r = try_recover(u, "snd_pcm_mmap_commit", (int) sframes)) == 0)
@@ -613,9 +413,12 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
                 return r;
             }
 
+            if (profiling)
+                pa_histogram_add(&u->sink->profile[PA_SINK_PROBE_WRITE], dt + pa_histogram_now() - t0);
+
             work_done = TRUE;
 
-            u->write_count += frames * u->frame_size;
+            pa_tsched_written(u->tsched, (size_t) frames * u->frame_size);
             u->since_start += frames * u->frame_size;
 
 #ifdef DEBUG_TIMING
@@ -649,7 +452,7 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
     pa_sink_assert_ref(u->sink);
 
     if (u->use_tsched)
-        hw_sleep_time(u, &max_sleep_usec, &process_usec);
+        pa_tsched_sleep_time(u->tsched, &max_sleep_usec, &process_usec);
 
     for (;;) {
         snd_pcm_sframes_t n;
@@ -666,7 +469,7 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
         }
 
         n_bytes = (size_t) n * u->frame_size;
-        left_to_play = check_left_to_play(u, n_bytes, on_timeout);
+        left_to_play = pa_tsched_check_left_to_play(u->tsched, n_bytes, on_timeout, !u->first && !u->after_rewind);
         on_timeout = FALSE;
 
         if (u->use_tsched)
@@ -681,7 +484,7 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
                 pa_bytes_to_usec(left_to_play, &u->sink->sample_spec) > process_usec+max_sleep_usec/2)
                 break;
 
-        if (PA_UNLIKELY(n_bytes <= u->hwbuf_unused)) {
+        if (PA_UNLIKELY(n_bytes <= pa_tsched_get_unused(u->tsched))) {
 
             if (polled)
                 PA_ONCE_BEGIN {
@@ -704,12 +507,13 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
             break;
         }
 
-        n_bytes -= u->hwbuf_unused;
+        n_bytes -= pa_tsched_get_unused(u->tsched);
         polled = FALSE;
 
         for (;;) {
             snd_pcm_sframes_t frames;
             void *p;
+            uint64_t t0;
 
 /*         pa_log_debug("%lu frames to write", (unsigned long) frames); */
 
@@ -724,7 +528,9 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
                 frames = (snd_pcm_sframes_t) (n_bytes/u->frame_size);
 
             p = pa_memblock_acquire(u->memchunk.memblock);
+            t0 = pa_histogram_start(pa_atomic_load(&u->core->render_profiling) > 0);
             frames = snd_pcm_writei(u->pcm_handle, (const uint8_t*) p + u->memchunk.index, (snd_pcm_uframes_t) frames);
+            pa_histogram_add_since(&u->sink->profile[PA_SINK_PROBE_WRITE], t0);
             pa_memblock_release(u->memchunk.memblock);
 
             if (PA_UNLIKELY(frames < 0)) {
@@ -754,7 +560,7 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
 
             work_done = TRUE;
 
-            u->write_count += frames * u->frame_size;
+            pa_tsched_written(u->tsched, (size_t) frames * u->frame_size);
             u->since_start += frames * u->frame_size;
 
 /*         pa_log_debug("wrote %lu frames", (unsigned long) frames); */
@@ -778,9 +584,8 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, pa_bool_t polle
 
 static void update_smoother(struct userdata *u) {
     snd_pcm_sframes_t delay = 0;
-    int64_t position;
     int err;
-    pa_usec_t now1 = 0, now2;
+    pa_usec_t now1 = 0;
     snd_pcm_status_t *status;
 
     snd_pcm_status_alloca(&status);
@@ -807,38 +612,15 @@ static void update_smoother(struct userdata *u) {
     if (now1 <= 0)
         now1 = pa_rtclock_now();
 
-    /* check if the time since the last update is bigger than the interval */
-    if (u->last_smoother_update > 0)
-        if (u->last_smoother_update + u->smoother_interval > now1)
-            return;
-
-    position = (int64_t) u->write_count - ((int64_t) delay * (int64_t) u->frame_size);
-
-    if (PA_UNLIKELY(position < 0))
-        position = 0;
-
-    now2 = pa_bytes_to_usec((uint64_t) position, &u->sink->sample_spec);
-
-    pa_smoother_put(u->smoother, now1, now2);
-
-    u->last_smoother_update = now1;
-    /* exponentially increase the update interval up to the MAX limit */
-    u->smoother_interval = PA_MIN (u->smoother_interval * 2, SMOOTHER_MAX_INTERVAL);
+    pa_tsched_update_smoother(u->tsched, now1, delay > 0 ? (size_t) delay * u->frame_size : 0);
 }
 
 static pa_usec_t sink_get_latency(struct userdata *u) {
     pa_usec_t r;
-    int64_t delay;
-    pa_usec_t now1, now2;
 
     pa_assert(u);
 
-    now1 = pa_rtclock_now();
-    now2 = pa_smoother_get(u->smoother, now1);
-
-    delay = (int64_t) pa_bytes_to_usec(u->write_count, &u->sink->sample_spec) - (int64_t) now2;
-
-    r = delay >= 0 ? (pa_usec_t) delay : 0;
+    r = pa_tsched_get_latency(u->tsched, pa_rtclock_now());
 
     if (u->memchunk.memblock)
         r += pa_bytes_to_usec(u->memchunk.length, &u->sink->sample_spec);
@@ -864,7 +646,7 @@ static int suspend(struct userdata *u) {
     pa_assert(u);
     pa_assert(u->pcm_handle);
 
-    pa_smoother_pause(u->smoother, pa_rtclock_now());
+    pa_tsched_pause(u->tsched, pa_rtclock_now());
 
     /* Let's suspend -- we don't call snd_pcm_drain() here since that might
      * take awfully long with our long buffer sizes today. */
@@ -888,40 +670,16 @@ static int update_sw_params(struct userdata *u) {
 
     pa_assert(u);
 
-    /* Use the full buffer if noone asked us for anything specific */
-    u->hwbuf_unused = 0;
-
-    if (u->use_tsched) {
-        pa_usec_t latency;
-
-        if ((latency = pa_sink_get_requested_latency_within_thread(u->sink)) != (pa_usec_t) -1) {
-            size_t b;
-
-            pa_log_debug("Latency set to %0.2fms", (double) latency / PA_USEC_PER_MSEC);
-
-            b = pa_usec_to_bytes(latency, &u->sink->sample_spec);
-
-            /* We need at least one sample in our buffer */
-
-            if (PA_UNLIKELY(b < u->frame_size))
-                b = u->frame_size;
-
-            u->hwbuf_unused = PA_LIKELY(b < u->hwbuf_size) ? (u->hwbuf_size - b) : 0;
-        }
-
-        fix_min_sleep_wakeup(u);
-        fix_tsched_watermark(u);
-    }
-
-    pa_log_debug("hwbuf_unused=%lu", (unsigned long) u->hwbuf_unused);
+    /* This also updates max_request */
+    pa_tsched_update_requested_latency(u->tsched);
 
     /* We need at last one frame in the used part of the buffer */
-    avail_min = (snd_pcm_uframes_t) u->hwbuf_unused / u->frame_size + 1;
+    avail_min = (snd_pcm_uframes_t) pa_tsched_get_unused(u->tsched) / u->frame_size + 1;
 
     if (u->use_tsched) {
         pa_usec_t sleep_usec, process_usec;
 
-        hw_sleep_time(u, &sleep_usec, &process_usec);
+        pa_tsched_sleep_time(u->tsched, &sleep_usec, &process_usec);
         avail_min += pa_usec_to_bytes(sleep_usec, &u->sink->sample_spec) / u->frame_size;
     }
 
@@ -932,8 +690,6 @@ static int update_sw_params(struct userdata *u) {
         return err;
     }
 
-    pa_sink_set_max_request_within_thread(u->sink, u->hwbuf_size - u->hwbuf_unused);
-
     return 0;
 }
 
@@ -993,10 +749,7 @@ static int unsuspend(struct userdata *u) {
     if (build_pollfd(u) < 0)
         goto fail;
 
-    u->write_count = 0;
-    pa_smoother_reset(u->smoother, pa_rtclock_now(), TRUE);
-    u->smoother_interval = SMOOTHER_MIN_INTERVAL;
-    u->last_smoother_update = 0;
+    pa_tsched_reset(u->tsched, pa_rtclock_now());
 
     u->first = TRUE;
     u->since_start = 0;
@@ -1259,7 +1012,7 @@ static void sink_update_requested_latency_cb(pa_sink *s) {
     if (!u->pcm_handle)
         return;
 
-    before = u->hwbuf_unused;
+    before = pa_tsched_get_unused(u->tsched);
     update_sw_params(u);
 
     /* Let's check whether we now use only a smaller part of the
@@ -1268,7 +1021,7 @@ static void sink_update_requested_latency_cb(pa_sink *s) {
     current fill level. Thus, let's do a full rewind once, to clear
     things up. */
 
-    if (u->hwbuf_unused > before) {
+    if (pa_tsched_get_unused(u->tsched) > before) {
         pa_log_debug("Requesting rewind due to latency change.");
         pa_sink_request_rewind(s, (size_t) -1);
     }
@@ -1289,10 +1042,10 @@ static int process_rewind(struct userdata *u) {
         return -1;
     }
 
-    unused_nbytes = u->tsched_watermark + (size_t) unused * u->frame_size;
+    unused_nbytes = (size_t) unused * u->frame_size;
 
     if (u->hwbuf_size > unused_nbytes)
-        limit_nbytes = u->hwbuf_size - unused_nbytes;
+        limit_nbytes = pa_tsched_rewind_limit(u->tsched, u->hwbuf_size - unused_nbytes);
     else
         limit_nbytes = 0;
 
@@ -1320,7 +1073,7 @@ static int process_rewind(struct userdata *u) {
         if (rewind_nbytes <= 0)
             pa_log_info("Tried rewind, but was apparently not possible.");
         else {
-            u->write_count -= rewind_nbytes;
+            pa_tsched_rewound(u->tsched, rewind_nbytes);
             pa_log_debug("Rewound %lu bytes.", (unsigned long) rewind_nbytes);
             pa_sink_process_rewind(u->sink, rewind_nbytes);
 
@@ -1380,15 +1133,13 @@ static void thread_func(void *userdata) {
                     pa_log_info("Starting playback.");
                     snd_pcm_start(u->pcm_handle);
 
-                    pa_smoother_resume(u->smoother, pa_rtclock_now(), TRUE);
+                    pa_tsched_start(u->tsched, pa_rtclock_now());
                 }
 
                 update_smoother(u);
             }
 
             if (u->use_tsched) {
-                pa_usec_t cusec;
-
                 if (u->since_start <= u->hwbuf_size) {
 
                     /* USB devices on ALSA seem to hit a buffer
@@ -1406,16 +1157,7 @@ static void thread_func(void *userdata) {
 
                 /* OK, the playback buffer is now full, let's
                  * calculate when to wake up next */
-/*                 pa_log_debug("Waking up in %0.2fms (sound card clock).", (double) sleep_usec / PA_USEC_PER_MSEC); */
-
-                /* Convert from the sound card time domain to the
-                 * system time domain */
-                cusec = pa_smoother_translate(u->smoother, pa_rtclock_now(), sleep_usec);
-
-/*                 pa_log_debug("Waking up in %0.2fms (system clock).", (double) cusec / PA_USEC_PER_MSEC); */
-
-                /* We don't trust the conversion, so we wake up whatever comes first */
-                pa_rtpoll_set_timer_relative(u->rtpoll, PA_MIN(sleep_usec, cusec));
+                pa_tsched_set_timer(u->tsched, u->rtpoll, sleep_usec);
             }
 
             u->first = FALSE;
@@ -1709,16 +1451,6 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
     u->rtpoll = pa_rtpoll_new();
     pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
 
-    u->smoother = pa_smoother_new(
-            DEFAULT_TSCHED_BUFFER_USEC*2,
-            DEFAULT_TSCHED_BUFFER_USEC*2,
-            TRUE,
-            TRUE,
-            5,
-            pa_rtclock_now(),
-            TRUE);
-    u->smoother_interval = SMOOTHER_MIN_INTERVAL;
-
     dev_id = pa_modargs_get_value(
             ma, "device_id",
             pa_modargs_get_value(ma, "device", DEFAULT_DEVICE));
@@ -1873,24 +1605,17 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
     pa_sink_set_max_request(u->sink, u->hwbuf_size);
     pa_sink_set_max_rewind(u->sink, u->hwbuf_size);
 
-    if (u->use_tsched) {
-        u->tsched_watermark = pa_usec_to_bytes_round_up(pa_bytes_to_usec_round_up(tsched_watermark, &requested_ss), &u->sink->sample_spec);
-
-        u->watermark_inc_step = pa_usec_to_bytes(TSCHED_WATERMARK_INC_STEP_USEC, &u->sink->sample_spec);
-        u->watermark_dec_step = pa_usec_to_bytes(TSCHED_WATERMARK_DEC_STEP_USEC, &u->sink->sample_spec);
-
-        u->watermark_inc_threshold = pa_usec_to_bytes_round_up(TSCHED_WATERMARK_INC_THRESHOLD_USEC, &u->sink->sample_spec);
-        u->watermark_dec_threshold = pa_usec_to_bytes_round_up(TSCHED_WATERMARK_DEC_THRESHOLD_USEC, &u->sink->sample_spec);
-
-        fix_min_sleep_wakeup(u);
-        fix_tsched_watermark(u);
+    u->tsched = pa_tsched_new(u->sink, u->hwbuf_size,
+                              pa_usec_to_bytes_round_up(pa_bytes_to_usec_round_up(tsched_watermark, &requested_ss), &u->sink->sample_spec),
+                              u->use_tsched);
 
+    if (u->use_tsched) {
         pa_sink_set_latency_range(u->sink,
                                   0,
                                   pa_bytes_to_usec(u->hwbuf_size, &ss));
 
         pa_log_info("Time scheduling watermark is %0.2fms",
-                    (double) pa_bytes_to_usec(u->tsched_watermark, &ss) / PA_USEC_PER_MSEC);
+                    (double) pa_bytes_to_usec(pa_tsched_get_watermark(u->tsched), &ss) / PA_USEC_PER_MSEC);
     } else
         pa_sink_set_fixed_latency(u->sink, pa_bytes_to_usec(u->hwbuf_size, &ss));
 
@@ -1986,8 +1711,8 @@ static void userdata_free(struct userdata *u) {
     if (u->mixer_handle)
         snd_mixer_close(u->mixer_handle);
 
-    if (u->smoother)
-        pa_smoother_free(u->smoother);
+    if (u->tsched)
+        pa_tsched_free(u->tsched);
 
     reserve_done(u);
     monitor_done(u);
@@ -0,0 +1,713 @@
+/*
+ *
+ *  Bluetooth low-complexity, subband codec (SBC) library
+ *
+ *  Copyright (C) 2004-2009  Marcel Holtmann <marcel@holtmann.org>
+ *  Copyright (C) 2004-2005  Henryk Ploetz <henryk@ploetzli.ch>
+ *  Copyright (C) 2005-2006  Brad Midgley <bmidgley@xmission.com>
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdint.h>
+#include <limits.h>
+#include "sbc.h"
+#include "sbc_math.h"
+#include "sbc_tables.h"
+
+#include "sbc_primitives_sse.h"
+
+/*
+ * SSE2 and AVX2 optimizations
+ */
+
+#ifdef SBC_BUILD_WITH_SSE_SUPPORT
+
+/* Distance between two blocks in sb_sample_f */
+#define SB_SAMPLE_BLOCK_BYTES (2 * 8 * sizeof(int32_t))
+
+#define SBC_SCALE_FACTOR(x) ((31 - SCALE_OUT_BITS) - __builtin_clz(x))
+
+/* The compiler only knows the XMM registers if it uses them itself */
+#ifdef __SSE__
+#define XMM_CLOBBERS_0_2 , "xmm0", "xmm1", "xmm2"
+#define XMM_CLOBBERS_0_3 XMM_CLOBBERS_0_2, "xmm3"
+#define XMM_CLOBBERS_0_4 XMM_CLOBBERS_0_3, "xmm4"
+#define XMM_CLOBBERS_0_7 XMM_CLOBBERS_0_4, "xmm5", "xmm6", "xmm7"
+#else
+#define XMM_CLOBBERS_0_2
+#define XMM_CLOBBERS_0_3
+#define XMM_CLOBBERS_0_4
+#define XMM_CLOBBERS_0_7
+#endif
+
+static inline void sbc_analyze_four_sse2(const int16_t *in, int32_t *out,
+					const FIXED_T *consts)
+{
+	static const SBC_ALIGNED int32_t round_c[4] = {
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+	};
+	asm volatile (
+		"movdqu      (%0), %%xmm0\n"
+		"pmaddwd     (%1), %%xmm0\n"
+		"paddd       (%2), %%xmm0\n"
+		"\n"
+		"movdqu    16(%0), %%xmm1\n"
+		"pmaddwd   16(%1), %%xmm1\n"
+		"paddd     %%xmm1, %%xmm0\n"
+		"\n"
+		"movdqu    32(%0), %%xmm1\n"
+		"pmaddwd   32(%1), %%xmm1\n"
+		"paddd     %%xmm1, %%xmm0\n"
+		"\n"
+		"movdqu    48(%0), %%xmm1\n"
+		"pmaddwd   48(%1), %%xmm1\n"
+		"paddd     %%xmm1, %%xmm0\n"
+		"\n"
+		"movdqu    64(%0), %%xmm1\n"
+		"pmaddwd   64(%1), %%xmm1\n"
+		"paddd     %%xmm1, %%xmm0\n"
+		"\n"
+		"psrad         %4, %%xmm0\n"
+		"packssdw  %%xmm0, %%xmm0\n"
+		"\n"
+		"pshufd     $0x00, %%xmm0, %%xmm1\n"
+		"pshufd     $0x55, %%xmm0, %%xmm2\n"
+		"pmaddwd   80(%1), %%xmm1\n"
+		"pmaddwd   96(%1), %%xmm2\n"
+		"paddd     %%xmm2, %%xmm1\n"
+		"\n"
+		"movdqu    %%xmm1, (%3)\n"
+		:
+		: "r" (in), "r" (consts), "r" (&round_c), "r" (out),
+			"i" (SBC_PROTO_FIXED4_SCALE)
+		: "memory" XMM_CLOBBERS_0_2);
+}
+
+static inline void sbc_analyze_eight_sse2(const int16_t *in, int32_t *out,
+							const FIXED_T *consts)
+{
+	static const SBC_ALIGNED int32_t round_c[4] = {
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+	};
+	asm volatile (
+		"movdqu      (%0), %%xmm0\n"
+		"movdqu    16(%0), %%xmm1\n"
+		"pmaddwd     (%1), %%xmm0\n"
+		"pmaddwd   16(%1), %%xmm1\n"
+		"paddd       (%2), %%xmm0\n"
+		"paddd       (%2), %%xmm1\n"
+		"\n"
+		"movdqu    32(%0), %%xmm2\n"
+		"movdqu    48(%0), %%xmm3\n"
+		"pmaddwd   32(%1), %%xmm2\n"
+		"pmaddwd   48(%1), %%xmm3\n"
+		"paddd     %%xmm2, %%xmm0\n"
+		"paddd     %%xmm3, %%xmm1\n"
+		"\n"
+		"movdqu    64(%0), %%xmm2\n"
+		"movdqu    80(%0), %%xmm3\n"
+		"pmaddwd   64(%1), %%xmm2\n"
+		"pmaddwd   80(%1), %%xmm3\n"
+		"paddd     %%xmm2, %%xmm0\n"
+		"paddd     %%xmm3, %%xmm1\n"
+		"\n"
+		"movdqu    96(%0), %%xmm2\n"
+		"movdqu   112(%0), %%xmm3\n"
+		"pmaddwd   96(%1), %%xmm2\n"
+		"pmaddwd  112(%1), %%xmm3\n"
+		"paddd     %%xmm2, %%xmm0\n"
+		"paddd     %%xmm3, %%xmm1\n"
+		"\n"
+		"movdqu   128(%0), %%xmm2\n"
+		"movdqu   144(%0), %%xmm3\n"
+		"pmaddwd  128(%1), %%xmm2\n"
+		"pmaddwd  144(%1), %%xmm3\n"
+		"paddd     %%xmm2, %%xmm0\n"
+		"paddd     %%xmm3, %%xmm1\n"
+		"\n"
+		"psrad         %4, %%xmm0\n"
+		"psrad         %4, %%xmm1\n"
+		"packssdw  %%xmm1, %%xmm0\n"
+		"\n"
+		"pshufd     $0x00, %%xmm0, %%xmm1\n"
+		"movdqa    %%xmm1, %%xmm2\n"
+		"pmaddwd  160(%1), %%xmm1\n"
+		"pmaddwd  176(%1), %%xmm2\n"
+		"\n"
+		"pshufd     $0x55, %%xmm0, %%xmm3\n"
+		"movdqa    %%xmm3, %%xmm4\n"
+		"pmaddwd  192(%1), %%xmm3\n"
+		"pmaddwd  208(%1), %%xmm4\n"
+		"paddd     %%xmm3, %%xmm1\n"
+		"paddd     %%xmm4, %%xmm2\n"
+		"\n"
+		"pshufd     $0xaa, %%xmm0, %%xmm3\n"
+		"movdqa    %%xmm3, %%xmm4\n"
+		"pmaddwd  224(%1), %%xmm3\n"
+		"pmaddwd  240(%1), %%xmm4\n"
+		"paddd     %%xmm3, %%xmm1\n"
+		"paddd     %%xmm4, %%xmm2\n"
+		"\n"
+		"pshufd     $0xff, %%xmm0, %%xmm3\n"
+		"movdqa    %%xmm3, %%xmm4\n"
+		"pmaddwd  256(%1), %%xmm3\n"
+		"pmaddwd  272(%1), %%xmm4\n"
+		"paddd     %%xmm3, %%xmm1\n"
+		"paddd     %%xmm4, %%xmm2\n"
+		"\n"
+		"movdqu    %%xmm1, (%3)\n"
+		"movdqu    %%xmm2, 16(%3)\n"
+		:
+		: "r" (in), "r" (consts), "r" (&round_c), "r" (out),
+			"i" (SBC_PROTO_FIXED8_SCALE)
+		: "memory" XMM_CLOBBERS_0_4);
+}
+
+static inline void sbc_analyze_4b_4s_sse2(int16_t *x, int32_t *out,
+						int out_stride)
+{
+	/* Analyze blocks */
+	sbc_analyze_four_sse2(x + 12, out, analysis_consts_fixed4_simd_odd);
+	out += out_stride;
+	sbc_analyze_four_sse2(x + 8, out, analysis_consts_fixed4_simd_even);
+	out += out_stride;
+	sbc_analyze_four_sse2(x + 4, out, analysis_consts_fixed4_simd_odd);
+	out += out_stride;
+	sbc_analyze_four_sse2(x + 0, out, analysis_consts_fixed4_simd_even);
+}
+
+static inline void sbc_analyze_4b_8s_sse2(int16_t *x, int32_t *out,
+						int out_stride)
+{
+	/* Analyze blocks */
+	sbc_analyze_eight_sse2(x + 24, out, analysis_consts_fixed8_simd_odd);
+	out += out_stride;
+	sbc_analyze_eight_sse2(x + 16, out, analysis_consts_fixed8_simd_even);
+	out += out_stride;
+	sbc_analyze_eight_sse2(x + 8, out, analysis_consts_fixed8_simd_odd);
+	out += out_stride;
+	sbc_analyze_eight_sse2(x + 0, out, analysis_consts_fixed8_simd_even);
+}
+
+/*
+ * ORs abs(v) - 1 (or 0 if v is 0) into acc, which is what the scale
+ * factor calculation needs: x is positive after the first step unless
+ * it was negative or zero, the second step turns negative values into
+ * their one's complement.
+ */
+#define SSE2_OR_ABS_MINUS_ONE(v, t0, t1, acc) \
+		"pxor    " t0 ", " t0 "\n" \
+		"movdqa  " v ", " t1 "\n" \
+		"pcmpgtd " t0 ", " t1 "\n" \
+		"paddd   " v ", " t1 "\n" \
+		"pcmpgtd " t1 ", " t0 "\n" \
+		"pxor    " t0 ", " t1 "\n" \
+		"por     " t1 ", " acc "\n"
+
+static void sbc_calc_scalefactors_sse2(
+	int32_t sb_sample_f[16][2][8],
+	uint32_t scale_factor[2][8],
+	int blocks, int channels, int subbands)
+{
+	static const SBC_ALIGNED int32_t consts[4] = {
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+	};
+	uint32_t SBC_ALIGNED x[4];
+	int ch, sb, i;
+	intptr_t blk;
+
+	for (ch = 0; ch < channels; ch++) {
+		for (sb = 0; sb < subbands; sb += 4) {
+			blk = (blocks - 1) * SB_SAMPLE_BLOCK_BYTES;
+			asm volatile (
+				"movdqa       (%3), %%xmm0\n"
+			"1:\n"
+				"movdqu   (%1, %0), %%xmm3\n"
+				SSE2_OR_ABS_MINUS_ONE("%%xmm3", "%%xmm2",
+						"%%xmm1", "%%xmm0")
+				"sub            %2, %0\n"
+				"jns            1b\n"
+				"\n"
+				"movdqa      %%xmm0, (%4)\n"
+			: "+r" (blk)
+			: "r" (&sb_sample_f[0][ch][sb]),
+				"i" (SB_SAMPLE_BLOCK_BYTES),
+				"r" (&consts), "r" (x)
+			: "cc", "memory" XMM_CLOBBERS_0_3);
+
+			for (i = 0; i < 4; i++)
+				scale_factor[ch][sb + i] = SBC_SCALE_FACTOR(x[i]);
+		}
+	}
+}
+
+/*
+ * Takes the ORed abs(sample) - 1 values of the left, right, mid and
+ * side signal of each subband, and decides which subbands are better
+ * coded as joint stereo.
+ */
+static int sbc_joint_decide(int32_t sb_sample_f[16][2][8],
+	uint32_t scale_factor[2][8], uint32_t acc[4][8],
+	int blocks, int subbands)
+{
+	int sb, blk, joint = 0;
+
+	for (sb = 0; sb < subbands; sb++) {
+		uint32_t x, y;
+
+		scale_factor[0][sb] = SBC_SCALE_FACTOR(acc[0][sb]);
+		scale_factor[1][sb] = SBC_SCALE_FACTOR(acc[1][sb]);
+
+		/* last subband does not use joint stereo */
+		if (sb == subbands - 1)
+			break;
+
+		x = SBC_SCALE_FACTOR(acc[2][sb]);
+		y = SBC_SCALE_FACTOR(acc[3][sb]);
+
+		if ((scale_factor[0][sb] + scale_factor[1][sb]) > x + y) {
+			joint |= 1 << (subbands - 1 - sb);
+			scale_factor[0][sb] = x;
+			scale_factor[1][sb] = y;
+			for (blk = 0; blk < blocks; blk++) {
+				int32_t tmp0 = sb_sample_f[blk][0][sb];
+				int32_t tmp1 = sb_sample_f[blk][1][sb];
+				sb_sample_f[blk][0][sb] =
+					ASR(tmp0, 1) + ASR(tmp1, 1);
+				sb_sample_f[blk][1][sb] =
+					ASR(tmp0, 1) - ASR(tmp1, 1);
+			}
+		}
+	}
+
+	return joint;
+}
+
+static int sbc_calc_scalefactors_j_sse2(
+	int32_t sb_sample_f[16][2][8],
+	uint32_t scale_factor[2][8],
+	int blocks, int subbands)
+{
+	static const SBC_ALIGNED int32_t consts[4] = {
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+	};
+	uint32_t SBC_ALIGNED acc[4][8];
+	int sb;
+	intptr_t blk;
+
+	/* Left, right, mid and side signal of four subbands at once */
+	for (sb = 0; sb < subbands; sb += 4) {
+		blk = (blocks - 1) * SB_SAMPLE_BLOCK_BYTES;
+		asm volatile (
+			"movdqa       (%3), %%xmm0\n"
+			"movdqa      %%xmm0, %%xmm1\n"
+			"movdqa      %%xmm0, %%xmm2\n"
+			"movdqa      %%xmm0, %%xmm3\n"
+		"1:\n"
+			"movdqu   (%1, %0), %%xmm4\n"
+			"movdqu 32(%1, %0), %%xmm5\n"
+			SSE2_OR_ABS_MINUS_ONE("%%xmm4", "%%xmm6",
+					"%%xmm7", "%%xmm0")
+			SSE2_OR_ABS_MINUS_ONE("%%xmm5", "%%xmm6",
+					"%%xmm7", "%%xmm1")
+			"psrad          $1, %%xmm4\n"
+			"psrad          $1, %%xmm5\n"
+			"movdqa      %%xmm4, %%xmm6\n"
+			"paddd       %%xmm5, %%xmm6\n"
+			"psubd       %%xmm5, %%xmm4\n"
+			SSE2_OR_ABS_MINUS_ONE("%%xmm6", "%%xmm5",
+					"%%xmm7", "%%xmm2")
+			SSE2_OR_ABS_MINUS_ONE("%%xmm4", "%%xmm5",
+					"%%xmm7", "%%xmm3")
+			"sub            %2, %0\n"
+			"jns            1b\n"
+			"\n"
+			"movdqu      %%xmm0, (%4)\n"
+			"movdqu      %%xmm1, 32(%4)\n"
+			"movdqu      %%xmm2, 64(%4)\n"
+			"movdqu      %%xmm3, 96(%4)\n"
+		: "+r" (blk)
+		: "r" (&sb_sample_f[0][0][sb]),
+			"i" (SB_SAMPLE_BLOCK_BYTES),
+			"r" (&consts), "r" (&acc[0][sb])
+		: "cc", "memory" XMM_CLOBBERS_0_7);
+	}
+
+	return sbc_joint_decide(sb_sample_f, scale_factor, acc,
+							blocks, subbands);
+}
+
+#ifdef SBC_BUILD_WITH_AVX2_SUPPORT
+
+/*
+ * The AVX2 versions do a whole block of the 8 subbands filter, or
+ * all 8 subbands of the scale factor calculation, at once
+ */
+
+static inline void sbc_analyze_four_avx2(const int16_t *in, int32_t *out,
+					const FIXED_T *consts)
+{
+	static const SBC_ALIGNED int32_t round_c[4] = {
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+	};
+	asm volatile (
+		"vmovdqu      (%0), %%ymm0\n"
+		"vpmaddwd     (%1), %%ymm0, %%ymm0\n"
+		"vmovdqu    32(%0), %%ymm1\n"
+		"vpmaddwd   32(%1), %%ymm1, %%ymm1\n"
+		"vpaddd     %%ymm1, %%ymm0, %%ymm0\n"
+		"vmovdqu    64(%0), %%xmm1\n"
+		"vpmaddwd   64(%1), %%xmm1, %%xmm1\n"
+		"vpaddd     %%ymm1, %%ymm0, %%ymm0\n"
+		"\n"
+		"vextracti128   $1, %%ymm0, %%xmm1\n"
+		"vpaddd     %%xmm1, %%xmm0, %%xmm0\n"
+		"vpaddd       (%2), %%xmm0, %%xmm0\n"
+		"vpsrad         %4, %%xmm0, %%xmm0\n"
+		"vpackssdw  %%xmm0, %%xmm0, %%xmm0\n"
+		"\n"
+		"vpshufd     $0x00, %%xmm0, %%xmm1\n"
+		"vpshufd     $0x55, %%xmm0, %%xmm2\n"
+		"vpmaddwd   80(%1), %%xmm1, %%xmm1\n"
+		"vpmaddwd   96(%1), %%xmm2, %%xmm2\n"
+		"vpaddd     %%xmm2, %%xmm1, %%xmm1\n"
+		"\n"
+		"vmovdqu    %%xmm1, (%3)\n"
+		:
+		: "r" (in), "r" (consts), "r" (&round_c), "r" (out),
+			"i" (SBC_PROTO_FIXED4_SCALE)
+		: "memory" XMM_CLOBBERS_0_2);
+}
+
+static inline void sbc_analyze_eight_avx2(const int16_t *in, int32_t *out,
+							const FIXED_T *consts)
+{
+	static const SBC_ALIGNED int32_t round_c[8] = {
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+	};
+	asm volatile (
+		"vmovdqu      (%0), %%ymm0\n"
+		"vpmaddwd     (%1), %%ymm0, %%ymm0\n"
+		"vpaddd       (%2), %%ymm0, %%ymm0\n"
+		"vmovdqu    32(%0), %%ymm1\n"
+		"vpmaddwd   32(%1), %%ymm1, %%ymm1\n"
+		"vpaddd     %%ymm1, %%ymm0, %%ymm0\n"
+		"vmovdqu    64(%0), %%ymm1\n"
+		"vpmaddwd   64(%1), %%ymm1, %%ymm1\n"
+		"vpaddd     %%ymm1, %%ymm0, %%ymm0\n"
+		"vmovdqu    96(%0), %%ymm1\n"
+		"vpmaddwd   96(%1), %%ymm1, %%ymm1\n"
+		"vpaddd     %%ymm1, %%ymm0, %%ymm0\n"
+		"vmovdqu   128(%0), %%ymm1\n"
+		"vpmaddwd  128(%1), %%ymm1, %%ymm1\n"
+		"vpaddd     %%ymm1, %%ymm0, %%ymm0\n"
+		"\n"
+		"vpsrad         %4, %%ymm0, %%ymm0\n"
+		"vextracti128   $1, %%ymm0, %%xmm1\n"
+		"vpackssdw  %%xmm1, %%xmm0, %%xmm0\n"
+		"\n"
+		"vpbroadcastd %%xmm0, %%ymm1\n"
+		"vpmaddwd  160(%1), %%ymm1, %%ymm1\n"
+		"\n"
+		"vpshufd     $0x55, %%xmm0, %%xmm2\n"
+		"vpbroadcastd %%xmm2, %%ymm2\n"
+		"vpmaddwd  192(%1), %%ymm2, %%ymm2\n"
+		"vpaddd     %%ymm2, %%ymm1, %%ymm1\n"
+		"\n"
+		"vpshufd     $0xaa, %%xmm0, %%xmm2\n"
+		"vpbroadcastd %%xmm2, %%ymm2\n"
+		"vpmaddwd  224(%1), %%ymm2, %%ymm2\n"
+		"vpaddd     %%ymm2, %%ymm1, %%ymm1\n"
+		"\n"
+		"vpshufd     $0xff, %%xmm0, %%xmm2\n"
+		"vpbroadcastd %%xmm2, %%ymm2\n"
+		"vpmaddwd  256(%1), %%ymm2, %%ymm2\n"
+		"vpaddd     %%ymm2, %%ymm1, %%ymm1\n"
+		"\n"
+		"vmovdqu    %%ymm1, (%3)\n"
+		:
+		: "r" (in), "r" (consts), "r" (&round_c), "r" (out),
+			"i" (SBC_PROTO_FIXED8_SCALE)
+		: "memory" XMM_CLOBBERS_0_2);
+}
+
+static inline void sbc_analyze_4b_4s_avx2(int16_t *x, int32_t *out,
+						int out_stride)
+{
+	/* Analyze blocks */
+	sbc_analyze_four_avx2(x + 12, out, analysis_consts_fixed4_simd_odd);
+	out += out_stride;
+	sbc_analyze_four_avx2(x + 8, out, analysis_consts_fixed4_simd_even);
+	out += out_stride;
+	sbc_analyze_four_avx2(x + 4, out, analysis_consts_fixed4_simd_odd);
+	out += out_stride;
+	sbc_analyze_four_avx2(x + 0, out, analysis_consts_fixed4_simd_even);
+
+	asm volatile ("vzeroupper\n");
+}
+
+static inline void sbc_analyze_4b_8s_avx2(int16_t *x, int32_t *out,
+						int out_stride)
+{
+	/* Analyze blocks */
+	sbc_analyze_eight_avx2(x + 24, out, analysis_consts_fixed8_simd_odd);
+	out += out_stride;
+	sbc_analyze_eight_avx2(x + 16, out, analysis_consts_fixed8_simd_even);
+	out += out_stride;
+	sbc_analyze_eight_avx2(x + 8, out, analysis_consts_fixed8_simd_odd);
+	out += out_stride;
+	sbc_analyze_eight_avx2(x + 0, out, analysis_consts_fixed8_simd_even);
+
+	asm volatile ("vzeroupper\n");
+}
+
+/* Same as SSE2_OR_ABS_MINUS_ONE, zero must hold 0 and (%5) -1 */
+#define AVX2_OR_ABS_MINUS_ONE(v, t, zero, acc) \
+		"vpabsd    " v ", " t "\n" \
+		"vpaddd     (%5), " t ", " t "\n" \
+		"vpmaxsd   " zero ", " t ", " t "\n" \
+		"vpor      " t ", " acc ", " acc "\n"
+
+static const SBC_ALIGNED int32_t avx2_scale_consts[2][8] = {
+	{
+		1 << SCALE_OUT_BITS, 1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS, 1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS, 1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS, 1 << SCALE_OUT_BITS,
+	}, {
+		-1, -1, -1, -1, -1, -1, -1, -1,
+	}
+};
+
+static void sbc_calc_scalefactors_avx2(
+	int32_t sb_sample_f[16][2][8],
+	uint32_t scale_factor[2][8],
+	int blocks, int channels, int subbands)
+{
+	uint32_t SBC_ALIGNED x[8];
+	int ch, i;
+	intptr_t blk;
+
+	if (subbands == 4) {
+		sbc_calc_scalefactors_sse2(sb_sample_f, scale_factor,
+						blocks, channels, subbands);
+		return;
+	}
+
+	for (ch = 0; ch < channels; ch++) {
+		blk = (blocks - 1) * SB_SAMPLE_BLOCK_BYTES;
+		asm volatile (
+			"vmovdqu      (%3), %%ymm0\n"
+			"vpxor      %%ymm2, %%ymm2, %%ymm2\n"
+		"1:\n"
+			"vmovdqu  (%1, %0), %%ymm3\n"
+			AVX2_OR_ABS_MINUS_ONE("%%ymm3", "%%ymm1",
+						"%%ymm2", "%%ymm0")
+			"sub            %2, %0\n"
+			"jns            1b\n"
+			"\n"
+			"vmovdqu    %%ymm0, (%4)\n"
+			"vzeroupper\n"
+		: "+r" (blk)
+		: "r" (&sb_sample_f[0][ch][0]),
+			"i" (SB_SAMPLE_BLOCK_BYTES),
+			"r" (avx2_scale_consts[0]), "r" (x),
+			"r" (avx2_scale_consts[1])
+		: "cc", "memory" XMM_CLOBBERS_0_3);
+
+		for (i = 0; i < 8; i++)
+			scale_factor[ch][i] = SBC_SCALE_FACTOR(x[i]);
+	}
+}
+
+static int sbc_calc_scalefactors_j_avx2(
+	int32_t sb_sample_f[16][2][8],
+	uint32_t scale_factor[2][8],
+	int blocks, int subbands)
+{
+	uint32_t SBC_ALIGNED acc[4][8];
+	intptr_t blk;
+
+	if (subbands == 4)
+		return sbc_calc_scalefactors_j_sse2(sb_sample_f, scale_factor,
+							blocks, subbands);
+
+	/* Left, right, mid and side signal of all subbands at once */
+	blk = (blocks - 1) * SB_SAMPLE_BLOCK_BYTES;
+	asm volatile (
+		"vmovdqu      (%3), %%ymm0\n"
+		"vmovdqa    %%ymm0, %%ymm1\n"
+		"vmovdqa    %%ymm0, %%ymm2\n"
+		"vmovdqa    %%ymm0, %%ymm3\n"
+		"vpxor      %%ymm7, %%ymm7, %%ymm7\n"
+	"1:\n"
+		"vmovdqu  (%1, %0), %%ymm4\n"
+		"vmovdqu 32(%1, %0), %%ymm5\n"
+		AVX2_OR_ABS_MINUS_ONE("%%ymm4", "%%ymm6", "%%ymm7", "%%ymm0")
+		AVX2_OR_ABS_MINUS_ONE("%%ymm5", "%%ymm6", "%%ymm7", "%%ymm1")
+		"vpsrad         $1, %%ymm4, %%ymm4\n"
+		"vpsrad         $1, %%ymm5, %%ymm5\n"
+		"vpaddd     %%ymm5, %%ymm4, %%ymm6\n"
+		AVX2_OR_ABS_MINUS_ONE("%%ymm6", "%%ymm6", "%%ymm7", "%%ymm2")
+		"vpsubd     %%ymm5, %%ymm4, %%ymm6\n"
+		AVX2_OR_ABS_MINUS_ONE("%%ymm6", "%%ymm6", "%%ymm7", "%%ymm3")
+		"sub            %2, %0\n"
+		"jns            1b\n"
+		"\n"
+		"vmovdqu    %%ymm0, (%4)\n"
+		"vmovdqu    %%ymm1, 32(%4)\n"
+		"vmovdqu    %%ymm2, 64(%4)\n"
+		"vmovdqu    %%ymm3, 96(%4)\n"
+		"vzeroupper\n"
+	: "+r" (blk)
+	: "r" (&sb_sample_f[0][0][0]),
+		"i" (SB_SAMPLE_BLOCK_BYTES),
+		"r" (avx2_scale_consts[0]), "r" (acc),
+		"r" (avx2_scale_consts[1])
+	: "cc", "memory" XMM_CLOBBERS_0_7);
+
+	return sbc_joint_decide(sb_sample_f, scale_factor, acc,
+							blocks, subbands);
+}
+
+#endif
+
+static int sbc_have_cpuid(void)
+{
+#ifdef __amd64__
+	return 1;
+#else
+	uint32_t a, b;
+
+	/* According to Intel manual, CPUID instruction is supported
+	 * if the value of ID bit (bit 21) in EFLAGS can be modified */
+	asm volatile (
+		"pushfl\n"
+		"pushfl\n"
+		"popl           %0\n"
+		"movl           %0, %1\n"
+		"xorl    $0x200000, %0\n"
+		"pushl          %0\n"
+		"popfl\n"
+		"pushfl\n"
+		"popl           %0\n"
+		"popfl\n"
+		: "=&r" (a), "=&r" (b)
+		:
+		: "cc");
+
+	return ((a ^ b) & 0x200000) != 0;
+#endif
+}
+
+static void sbc_cpuid(uint32_t leaf, uint32_t regs[4])
+{
+	/* ebx may be the PIC register on i386 */
+	asm volatile (
+#ifdef __i386__
+		"xchgl     %%ebx, %1\n"
+		"cpuid\n"
+		"xchgl     %%ebx, %1\n"
+		: "=a" (regs[0]), "=r" (regs[1]),
+#else
+		"cpuid\n"
+		: "=a" (regs[0]), "=b" (regs[1]),
+#endif
+			"=c" (regs[2]), "=d" (regs[3])
+		: "0" (leaf), "2" (0));
+}
+
+#ifdef SBC_BUILD_WITH_AVX2_SUPPORT
+static int check_avx2_support(uint32_t max_leaf, const uint32_t regs1[4])
+{
+	uint32_t regs[4], xcr0;
+
+	if (max_leaf < 7)
+		return 0;
+
+	/* AVX, and the OS saves the YMM registers (OSXSAVE) */
+	if (!(regs1[2] & (1 << 27)) || !(regs1[2] & (1 << 28)))
+		return 0;
+
+	asm volatile (
+		".byte 0x0f, 0x01, 0xd0\n" /* xgetbv */
+		: "=a" (xcr0), "=d" (regs[3])
+		: "c" (0));
+
+	if ((xcr0 & 6) != 6)
+		return 0;
+
+	sbc_cpuid(7, regs);
+	return regs[1] & (1 << 5);
+}
+#endif
+
+void sbc_init_primitives_sse(struct sbc_encoder_state *state)
+{
+	uint32_t regs[4], max_leaf;
+
+	if (!sbc_have_cpuid())
+		return;
+
+	sbc_cpuid(0, regs);
+	max_leaf = regs[0];
+
+	sbc_cpuid(1, regs);
+	if (!(regs[3] & (1 << 26)))
+		return;
+
+	state->sbc_analyze_4b_4s = sbc_analyze_4b_4s_sse2;
+	state->sbc_analyze_4b_8s = sbc_analyze_4b_8s_sse2;
+	state->sbc_calc_scalefactors = sbc_calc_scalefactors_sse2;
+	state->sbc_calc_scalefactors_j = sbc_calc_scalefactors_j_sse2;
+	state->implementation_info = "SSE2";
+
+#ifdef SBC_BUILD_WITH_AVX2_SUPPORT
+	if (check_avx2_support(max_leaf, regs)) {
+		state->sbc_analyze_4b_4s = sbc_analyze_4b_4s_avx2;
+		state->sbc_analyze_4b_8s = sbc_analyze_4b_8s_avx2;
+		state->sbc_calc_scalefactors = sbc_calc_scalefactors_avx2;
+		state->sbc_calc_scalefactors_j = sbc_calc_scalefactors_j_avx2;
+		state->implementation_info = "AVX2";
+	}
+#endif
+}
+
+#endif
@@ -47,6 +47,7 @@
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/core-error.h>
 #include <pulsecore/time-smoother.h>
+#include <pulsecore/drift.h>
 
 #include "module-combine-symdef.h"
 
@@ -100,6 +101,10 @@ struct output {
 
     pa_memblockq *memblockq;
 
+    /* Adjusts the rate of the sink input in the IO thread, towards
+     * the target latency the main thread determines */
+    pa_drift *drift;
+
     /* For communication of the stream latencies to the main thread */
     pa_usec_t total_latency;
 
@@ -154,6 +159,7 @@ enum {
 
 enum {
     SINK_INPUT_MESSAGE_POST = PA_SINK_INPUT_MESSAGE_MAX,
+    SINK_INPUT_MESSAGE_SET_TARGET_LATENCY
 };
 
 static void output_disable(struct output *o);
@@ -164,7 +170,6 @@ static int output_create_sink_input(struct output *o);
 static void adjust_rates(struct userdata *u) {
     struct output *o;
     pa_usec_t max_sink_latency = 0, min_total_latency = (pa_usec_t) -1, target_latency, avg_total_latency = 0;
-    uint32_t base_rate;
     uint32_t idx;
     unsigned n = 0;
 
@@ -211,26 +216,14 @@ static void adjust_rates(struct userdata *u) {
     pa_log_info("[%s] avg total latency is %0.2f msec.", u->sink->name, (double) avg_total_latency / PA_USEC_PER_MSEC);
     pa_log_info("[%s] target latency is %0.2f msec.", u->sink->name, (double) target_latency / PA_USEC_PER_MSEC);
 
-    base_rate = u->sink->sample_spec.rate;
-
+    /* The rates themselves are adjusted continuously in the IO
+     * threads of the outputs, we just tell them where to go */
     PA_IDXSET_FOREACH(o, u->outputs, idx) {
-        uint32_t r = base_rate;
 
         if (!o->sink_input || !PA_SINK_IS_OPENED(pa_sink_get_state(o->sink)))
             continue;
 
-        if (o->total_latency < target_latency)
-            r -= (uint32_t) ((((double) (target_latency - o->total_latency))/(double)u->adjust_time)*(double)r);
-        else if (o->total_latency > target_latency)
-            r += (uint32_t) ((((double) (o->total_latency - target_latency))/(double)u->adjust_time)*(double)r);
-
-        if (r < (uint32_t) (base_rate*0.9) || r > (uint32_t) (base_rate*1.1)) {
-            pa_log_warn("[%s] sample rates too different, not adjusting (%u vs. %u).", o->sink_input->sink->name, base_rate, r);
-            pa_sink_input_set_rate(o->sink_input, base_rate);
-        } else {
-            pa_log_info("[%s] new rate is %u Hz; ratio is %0.3f; latency is %0.0f usec.", o->sink_input->sink->name, r, (double) r / base_rate, (float) o->total_latency);
-            pa_sink_input_set_rate(o->sink_input, r);
-        }
+        pa_asyncmsgq_post(o->sink_input->sink->asyncmsgq, PA_MSGOBJECT(o->sink_input), SINK_INPUT_MESSAGE_SET_TARGET_LATENCY, NULL, (int64_t) target_latency, NULL, NULL);
     }
 
     pa_asyncmsgq_send(u->sink->asyncmsgq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_UPDATE_LATENCY, NULL, (int64_t) avg_total_latency, NULL);
@@ -421,6 +414,20 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
 
     pa_memblockq_drop(o->memblockq, chunk->length);
 
+    if (o->drift && i->thread_info.resampler) {
+        pa_usec_t latency;
+        double rate;
+
+        /* Same as what the main thread calculates in adjust_rates() */
+        latency =
+            pa_bytes_to_usec(pa_memblockq_get_length(o->memblockq), &i->sample_spec) +
+            pa_bytes_to_usec(pa_memblockq_get_length(i->thread_info.render_memblockq), &i->sink->sample_spec) +
+            pa_sink_get_latency_within_thread(i->sink);
+
+        rate = pa_drift_update(o->drift, pa_rtclock_now(), latency);
+        pa_resampler_set_rate_ratio(i->thread_info.resampler, rate / i->sample_spec.rate);
+    }
+
     return 0;
 }
 
@@ -503,6 +510,9 @@ static void sink_input_attach_cb(pa_sink_input *i) {
 
     pa_sink_input_request_rewind(i, 0, FALSE, TRUE, TRUE);
 
+    if (o->drift)
+        pa_drift_reset(o->drift);
+
     pa_atomic_store(&o->max_request, (int) pa_sink_input_get_max_request(i));
 
     c = pa_sink_get_requested_latency_within_thread(i->sink);
@@ -565,6 +575,13 @@ static int sink_input_process_msg(pa_msgobject *obj, int code, void *data, int64
                 pa_memblockq_flush_write(o->memblockq);
 
             return 0;
+
+        case SINK_INPUT_MESSAGE_SET_TARGET_LATENCY:
+
+            if (o->drift)
+                pa_drift_set_target(o->drift, (pa_usec_t) offset);
+
+            return 0;
     }
 
     return pa_sink_input_process_msg(obj, code, data, offset, chunk);
@@ -892,6 +909,9 @@ static struct output *output_new(struct userdata *u, pa_sink *sink) {
             0,
             NULL);
 
+    if (u->adjust_time > 0)
+        o->drift = pa_drift_new(u->sink->sample_spec.rate, u->adjust_time);
+
     pa_assert_se(pa_idxset_put(u->outputs, o, NULL) == 0);
     update_description(u);
 
@@ -926,6 +946,9 @@ static void output_free(struct output *o) {
     if (o->memblockq)
         pa_memblockq_free(o->memblockq);
 
+    if (o->drift)
+        pa_drift_free(o->drift);
+
     pa_xfree(o);
 }
 
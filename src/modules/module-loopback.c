@@ -35,6 +35,7 @@
 #include <pulsecore/namereg.h>
 #include <pulsecore/log.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/drift.h>
 
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
@@ -85,6 +86,9 @@ struct userdata {
     pa_bool_t in_pop;
     size_t min_memblockq_length;
 
+    /* Keeps the queue at two requests' worth, in output thread context */
+    pa_drift *drift;
+
     struct {
         int64_t send_counter;
         size_t source_output_buffer;
@@ -96,12 +100,14 @@ struct userdata {
 
         size_t min_memblockq_length;
         size_t max_request;
+        double rate;
     } latency_snapshot;
 };
 
 static const char* const valid_modargs[] = {
     "source",
     "sink",
+    "adjust_time",
     "latency_msec",
     "format",
     "rate",
@@ -145,8 +151,7 @@ static void teardown(struct userdata *u) {
 
 /* Called from main context */
 static void adjust_rates(struct userdata *u) {
-    size_t buffer, fs;
-    uint32_t old_rate, base_rate, new_rate;
+    size_t buffer;
     pa_usec_t buffer_latency;
 
     pa_assert(u);
@@ -176,18 +181,10 @@ static void adjust_rates(struct userdata *u) {
                 u->latency_snapshot.max_request*2,
                 u->latency_snapshot.min_memblockq_length);
 
-    fs = pa_frame_size(&u->sink_input->sample_spec);
-    old_rate = u->sink_input->sample_spec.rate;
-    base_rate = u->source_output->sample_spec.rate;
-
-    if (u->latency_snapshot.min_memblockq_length < u->latency_snapshot.max_request*2)
-        new_rate = base_rate - (((u->latency_snapshot.max_request*2 - u->latency_snapshot.min_memblockq_length) / fs) *PA_USEC_PER_SEC)/u->adjust_time;
-    else
-        new_rate = base_rate + (((u->latency_snapshot.min_memblockq_length - u->latency_snapshot.max_request*2) / fs) *PA_USEC_PER_SEC)/u->adjust_time;
-
-    pa_log_info("Old rate %lu Hz, new rate %lu Hz", (unsigned long) old_rate, (unsigned long) new_rate);
-
-    pa_sink_input_set_rate(u->sink_input, new_rate);
+    /* The rate is adjusted on every pop in the output thread */
+    pa_log_info("Base rate %lu Hz, current rate %0.3f Hz",
+                (unsigned long) u->sink_input->sample_spec.rate,
+                u->latency_snapshot.rate);
 
     pa_core_rttime_restart(u->core, u->time_event, pa_rtclock_now() + u->adjust_time);
 }
@@ -391,6 +388,15 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
 
     update_min_memblockq_length(u);
 
+    if (u->drift && i->thread_info.resampler) {
+        double rate;
+
+        pa_drift_set_target(u->drift, pa_bytes_to_usec(pa_sink_input_get_max_request(i)*2, &i->sample_spec));
+
+        rate = pa_drift_update(u->drift, pa_rtclock_now(), pa_bytes_to_usec(pa_memblockq_get_length(u->memblockq), &i->sample_spec));
+        pa_resampler_set_rate_ratio(i->thread_info.resampler, rate / i->sample_spec.rate);
+    }
+
     return 0;
 }
 
@@ -483,6 +489,8 @@ static int sink_input_process_msg_cb(pa_msgobject *obj, int code, void *data, in
             u->latency_snapshot.min_memblockq_length = u->min_memblockq_length;
             u->min_memblockq_length = (size_t) -1;
 
+            u->latency_snapshot.rate = u->drift ? pa_drift_get_rate(u->drift) : u->sink_input->sample_spec.rate;
+
             return 0;
         }
 
@@ -518,6 +526,9 @@ static void sink_input_attach_cb(pa_sink_input *i) {
     pa_memblockq_set_maxrewind(u->memblockq, pa_sink_input_get_max_rewind(i));
 
     u->min_memblockq_length = (size_t) -1;
+
+    if (u->drift)
+        pa_drift_reset(u->drift);
 }
 
 /* Called from output thread context */
@@ -664,6 +675,9 @@ int pa__init(pa_module *m) {
     else
         u->adjust_time = DEFAULT_ADJUST_TIME_USEC;
 
+    if (u->adjust_time > 0)
+        u->drift = pa_drift_new(ss.rate, u->adjust_time);
+
     pa_sink_input_new_data_init(&sink_input_data);
     sink_input_data.driver = __FILE__;
     sink_input_data.module = m;
@@ -780,5 +794,8 @@ void pa__done(pa_module*m) {
     if (u->time_event)
         u->core->mainloop->time_free(u->time_event);
 
+    if (u->drift)
+        pa_drift_free(u->drift);
+
     pa_xfree(u);
 }
@@ -48,6 +48,7 @@
 #include <pulsecore/thread.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/tsched.h>
 
 #include "module-null-sink-symdef.h"
 
@@ -61,7 +62,10 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "rate=<sample rate> "
         "channels=<number of channels> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "parallel_render=<convert the streams on several threads?> "
+        "render_threads=<number of threads for parallel_render, 0 for one less than CPUs> "
+        "tsched=<enable timer-based scheduling?>");
 
 #define DEFAULT_SINK_NAME "null"
 #define BLOCK_USEC (PA_USEC_PER_SEC * 2)
@@ -76,7 +80,12 @@ struct userdata {
     pa_rtpoll *rtpoll;
 
     pa_usec_t block_usec;
+
+    pa_tsched *tsched;
+    size_t hwbuf_size;
+
     pa_usec_t timestamp;
+    pa_bool_t first, after_rewind;
 };
 
 static const char* const valid_modargs[] = {
@@ -86,6 +95,9 @@ static const char* const valid_modargs[] = {
     "rate",
     "channels",
     "channel_map",
+    "parallel_render",
+    "render_threads",
+    "tsched",
     "description", /* supported for compatibility reasons, made redundant by sink_properties= */
     NULL
 };
@@ -102,8 +114,10 @@ static int sink_process_msg(
     switch (code) {
         case PA_SINK_MESSAGE_SET_STATE:
 
-            if (PA_PTR_TO_UINT(data) == PA_SINK_RUNNING)
+            if (PA_PTR_TO_UINT(data) == PA_SINK_RUNNING) {
                 u->timestamp = pa_rtclock_now();
+                u->first = TRUE;
+            }
 
             break;
 
@@ -127,6 +141,17 @@ static void sink_update_requested_latency_cb(pa_sink *s) {
     pa_sink_assert_ref(s);
     pa_assert_se(u = s->userdata);
 
+    if (u->tsched) {
+        /* If we now queue less than before make sure subsequent
+         * rewinds are relative to the new fill level */
+        if (pa_tsched_update_requested_latency(u->tsched)) {
+            pa_log_debug("Requesting rewind due to latency change.");
+            pa_sink_request_rewind(s, (size_t) -1);
+        }
+
+        return;
+    }
+
     u->block_usec = pa_sink_get_requested_latency_within_thread(s);
 
     if (u->block_usec == (pa_usec_t) -1)
@@ -159,11 +184,18 @@ static void process_rewind(struct userdata *u, pa_usec_t now) {
     if (in_buffer <= 0)
         goto do_nothing;
 
+    if (u->tsched)
+        in_buffer = pa_tsched_rewind_limit(u->tsched, in_buffer);
+
     if (rewind_nbytes > in_buffer)
         rewind_nbytes = in_buffer;
 
+    if (rewind_nbytes <= 0)
+        goto do_nothing;
+
     pa_sink_process_rewind(u->sink, rewind_nbytes);
     u->timestamp -= pa_bytes_to_usec(rewind_nbytes, &u->sink->sample_spec);
+    u->after_rewind = TRUE;
 
     pa_log_debug("Rewound %lu bytes.", (unsigned long) rewind_nbytes);
     return;
@@ -202,6 +234,47 @@ static void process_render(struct userdata *u, pa_usec_t now) {
 /*     pa_log_debug("Ate in sum %lu bytes (of %lu)", (unsigned long) ate, (unsigned long) nbytes); */
 }
 
+static void process_render_tsched(struct userdata *u, pa_usec_t now, pa_bool_t on_timeout) {
+    size_t n_bytes, left_to_play, fill_to;
+    pa_usec_t sleep_usec, process_usec;
+
+    pa_assert(u);
+
+    pa_tsched_sleep_time(u->tsched, &sleep_usec, &process_usec);
+
+    /* Our virtual buffer is whatever has been rendered beyond now. If
+     * we woke up too late that is an underrun, just like on real
+     * hardware. */
+    if (u->timestamp >= now)
+        n_bytes = u->hwbuf_size - PA_MIN(pa_usec_to_bytes(u->timestamp - now, &u->sink->sample_spec), u->hwbuf_size);
+    else
+        n_bytes = u->hwbuf_size + pa_usec_to_bytes(now - u->timestamp, &u->sink->sample_spec);
+
+    left_to_play = pa_tsched_check_left_to_play(u->tsched, n_bytes, on_timeout, !u->first && !u->after_rewind);
+
+    if (u->timestamp < now)
+        u->timestamp = now;
+
+    /* Same as for hardware sinks: don't fill up before at least half
+     * the sleep time is over, so that clients only have to keep
+     * around a single buffer length */
+    if (pa_bytes_to_usec(left_to_play, &u->sink->sample_spec) > process_usec + sleep_usec/2)
+        return;
+
+    fill_to = u->hwbuf_size - pa_tsched_get_unused(u->tsched);
+
+    while (left_to_play < fill_to) {
+        pa_memchunk chunk;
+
+        pa_sink_render(u->sink, fill_to - left_to_play, &chunk);
+        pa_memblock_unref(chunk.memblock);
+
+/*         pa_log_debug("Ate %lu bytes.", (unsigned long) chunk.length); */
+        u->timestamp += pa_bytes_to_usec(chunk.length, &u->sink->sample_spec);
+        left_to_play += chunk.length;
+    }
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
 
@@ -212,6 +285,7 @@ static void thread_func(void *userdata) {
     pa_thread_mq_install(&u->thread_mq);
 
     u->timestamp = pa_rtclock_now();
+    u->first = TRUE;
 
     for (;;) {
         int ret;
@@ -229,10 +303,23 @@ static void thread_func(void *userdata) {
                     pa_sink_process_rewind(u->sink, 0);
             }
 
-            if (u->timestamp <= now)
-                process_render(u, now);
+            if (u->tsched) {
+                pa_usec_t sleep_usec, process_usec;
 
-            pa_rtpoll_set_timer_absolute(u->rtpoll, u->timestamp);
+                process_render_tsched(u, now, pa_rtpoll_timer_elapsed(u->rtpoll));
+
+                /* Wake up when only the watermark is left to play */
+                pa_tsched_sleep_time(u->tsched, &sleep_usec, &process_usec);
+                pa_rtpoll_set_timer_absolute(u->rtpoll, u->timestamp > process_usec ? u->timestamp - process_usec : 0);
+
+                u->first = FALSE;
+                u->after_rewind = FALSE;
+            } else {
+                if (u->timestamp <= now)
+                    process_render(u, now);
+
+                pa_rtpoll_set_timer_absolute(u->rtpoll, u->timestamp);
+            }
         } else
             pa_rtpoll_set_timer_disabled(u->rtpoll);
 
@@ -260,7 +347,8 @@ int pa__init(pa_module*m) {
     pa_channel_map map;
     pa_modargs *ma = NULL;
     pa_sink_new_data data;
-    size_t nbytes;
+    pa_bool_t parallel_render = FALSE, use_tsched = FALSE;
+    uint32_t render_threads = 0;
 
     pa_assert(m);
 
@@ -276,6 +364,21 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "parallel_render", &parallel_render) < 0) {
+        pa_log("Failed to parse parallel_render argument.");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "render_threads", &render_threads) < 0 || render_threads > 256) {
+        pa_log("Invalid number of render threads.");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_boolean(ma, "tsched", &use_tsched) < 0) {
+        pa_log("Failed to parse tsched argument.");
+        goto fail;
+    }
+
     m->userdata = u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
@@ -285,6 +388,7 @@ int pa__init(pa_module*m) {
     pa_sink_new_data_init(&data);
     data.driver = __FILE__;
     data.module = m;
+    data.render_threads = render_threads;
     pa_sink_new_data_set_name(&data, pa_modargs_get_value(ma, "sink_name", DEFAULT_SINK_NAME));
     pa_sink_new_data_set_sample_spec(&data, &ss);
     pa_sink_new_data_set_channel_map(&data, &map);
@@ -297,7 +401,7 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
-    u->sink = pa_sink_new(m->core, &data, PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY);
+    u->sink = pa_sink_new(m->core, &data, PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY|(parallel_render ? PA_SINK_PARALLEL_RENDER : 0));
     pa_sink_new_data_done(&data);
 
     if (!u->sink) {
@@ -312,10 +416,21 @@ int pa__init(pa_module*m) {
     pa_sink_set_asyncmsgq(u->sink, u->thread_mq.inq);
     pa_sink_set_rtpoll(u->sink, u->rtpoll);
 
-    u->block_usec = BLOCK_USEC;
-    nbytes = pa_usec_to_bytes(u->block_usec, &u->sink->sample_spec);
-    pa_sink_set_max_rewind(u->sink, nbytes);
-    pa_sink_set_max_request(u->sink, nbytes);
+    if (use_tsched) {
+        u->hwbuf_size = pa_usec_to_bytes(BLOCK_USEC, &u->sink->sample_spec);
+        u->tsched = pa_tsched_new(u->sink, u->hwbuf_size, pa_usec_to_bytes(PA_TSCHED_DEFAULT_WATERMARK_USEC, &u->sink->sample_spec), TRUE);
+
+        pa_sink_set_max_rewind(u->sink, u->hwbuf_size);
+        pa_sink_set_max_request(u->sink, u->hwbuf_size);
+        pa_sink_set_latency_range(u->sink, 0, BLOCK_USEC);
+    } else {
+        size_t nbytes;
+
+        u->block_usec = BLOCK_USEC;
+        nbytes = pa_usec_to_bytes(u->block_usec, &u->sink->sample_spec);
+        pa_sink_set_max_rewind(u->sink, nbytes);
+        pa_sink_set_max_request(u->sink, nbytes);
+    }
 
     if (!(u->thread = pa_thread_new(thread_func, u))) {
         pa_log("Failed to create thread.");
@@ -367,6 +482,9 @@ void pa__done(pa_module*m) {
     if (u->sink)
         pa_sink_unref(u->sink);
 
+    if (u->tsched)
+        pa_tsched_free(u->tsched);
+
     if (u->rtpoll)
         pa_rtpoll_free(u->rtpoll);
 
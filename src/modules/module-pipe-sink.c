@@ -34,6 +34,7 @@
 #include <sys/ioctl.h>
 #include <poll.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/core-error.h>
@@ -45,6 +46,8 @@
 #include <pulsecore/thread.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/tsched.h>
 
 #include "module-pipe-sink-symdef.h"
 
@@ -59,7 +62,9 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "rate=<sample rate>"
         "channels=<number of channels> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "float_mixing=<mix in interleaved float32 and convert only when writing to the FIFO?> "
+        "tsched=<enable timer-based scheduling?>");
 
 #define DEFAULT_FILE_NAME "fifo_output"
 #define DEFAULT_SINK_NAME "fifo_output"
@@ -81,6 +86,19 @@ struct userdata {
     pa_rtpoll_item *rtpoll_item;
 
     int write_type;
+
+    /* The format written to the FIFO. This differs from the sink
+     * sample spec if the sink mixes in float32. */
+    pa_sample_spec device_spec;
+    pa_bool_t float_mixing;
+    pa_memblock *convert_buffer;
+
+    /* With timer-based scheduling we keep the FIFO filled up to the
+     * requested latency and use its fill level as our clock */
+    pa_tsched *tsched;
+    size_t hwbuf_size;
+    uint64_t written;
+    pa_bool_t first;
 };
 
 static const char* const valid_modargs[] = {
@@ -91,18 +109,46 @@ static const char* const valid_modargs[] = {
     "rate",
     "channels",
     "channel_map",
+    "float_mixing",
+    "tsched",
     NULL
 };
 
+static size_t device_to_sink_bytes(struct userdata *u, size_t nbytes) {
+    return nbytes / pa_frame_size(&u->device_spec) * pa_frame_size(&u->sink->sample_spec);
+}
+
 static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
     struct userdata *u = PA_SINK(o)->userdata;
 
     switch (code) {
 
+        case PA_SINK_MESSAGE_SET_STATE:
+
+            if (!u->tsched)
+                break;
+
+            /* We only write while running, the reader drains the
+             * FIFO in the meantime */
+            if (PA_PTR_TO_UINT(data) == PA_SINK_RUNNING) {
+                if (u->sink->thread_info.state != PA_SINK_RUNNING)
+                    u->first = TRUE;
+            } else if (u->sink->thread_info.state == PA_SINK_RUNNING)
+                pa_tsched_pause(u->tsched, pa_rtclock_now());
+
+            break;
+
         case PA_SINK_MESSAGE_GET_LATENCY: {
             size_t n = 0;
             int l;
 
+            if (u->tsched) {
+                *((pa_usec_t*) data) =
+                    pa_tsched_get_latency(u->tsched, pa_rtclock_now()) +
+                    pa_bytes_to_usec(u->memchunk.length, &u->device_spec);
+                return 0;
+            }
+
 #ifdef FIONREAD
             if (ioctl(u->fd, FIONREAD, &l) >= 0 && l > 0)
                 n = (size_t) l;
@@ -110,7 +156,7 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
 
             n += u->memchunk.length;
 
-            *((pa_usec_t*) data) = pa_bytes_to_usec(n, &u->sink->sample_spec);
+            *((pa_usec_t*) data) = pa_bytes_to_usec(n, &u->device_spec);
             return 0;
         }
     }
@@ -118,11 +164,29 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
     return pa_sink_process_msg(o, code, data, offset, chunk);
 }
 
-static int process_render(struct userdata *u) {
+static void sink_update_requested_latency_cb(pa_sink *s) {
+    struct userdata *u;
+
+    pa_sink_assert_ref(s);
+    pa_assert_se(u = s->userdata);
+
+    /* What went into the FIFO cannot be taken back, so there is no
+     * point in requesting a rewind if we now use less of it */
+    pa_tsched_update_requested_latency(u->tsched);
+}
+
+/* Returns the number of bytes written to the FIFO, 0 if it is full */
+static ssize_t process_render(struct userdata *u, size_t nbytes) {
     pa_assert(u);
 
-    if (u->memchunk.length <= 0)
-        pa_sink_render(u->sink, pa_pipe_buf(u->fd), &u->memchunk);
+    if (u->memchunk.length <= 0) {
+        pa_sink_render(u->sink, nbytes, &u->memchunk);
+
+        /* This is the only place where float mixing sinks leave the
+         * float32 domain */
+        if (u->float_mixing)
+            pa_memchunk_convert_from_float32ne(&u->memchunk, u->core->mempool, u->device_spec.format, &u->convert_buffer);
+    }
 
     pa_assert(u->memchunk.length > 0);
 
@@ -156,12 +220,104 @@ static int process_render(struct userdata *u) {
                 pa_memblock_unref(u->memchunk.memblock);
                 pa_memchunk_reset(&u->memchunk);
             }
+
+            if (u->tsched) {
+                uint64_t before;
+
+                /* Count whole frames only, partial writes are
+                 * accounted for once the rest of the frame follows */
+                before = u->written / pa_frame_size(&u->device_spec);
+                u->written += (uint64_t) l;
+                pa_tsched_written(u->tsched, (size_t) (u->written / pa_frame_size(&u->device_spec) - before) * pa_frame_size(&u->sink->sample_spec));
+            }
         }
 
-        return 0;
+        return l;
     }
 }
 
+static int fifo_queued(struct userdata *u, size_t *queued) {
+    int l = 0;
+
+    pa_assert(u);
+    pa_assert(queued);
+
+#ifdef FIONREAD
+    if (ioctl(u->fd, FIONREAD, &l) < 0) {
+        pa_log("FIONREAD failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+#endif
+
+    *queued = device_to_sink_bytes(u, l > 0 ? (size_t) l : 0);
+    return 0;
+}
+
+static int process_render_tsched(struct userdata *u, pa_bool_t on_timeout, pa_usec_t *sleep_usec) {
+    size_t queued, n_bytes, left_to_play, fill_to;
+    pa_usec_t max_sleep_usec, process_usec;
+    pa_bool_t work_done = FALSE;
+
+    pa_assert(u);
+    pa_assert(sleep_usec);
+
+    pa_tsched_sleep_time(u->tsched, &max_sleep_usec, &process_usec);
+
+    if (fifo_queued(u, &queued) < 0)
+        return -1;
+
+    /* Whatever the reader took out of the FIFO has been played. If it
+     * is entirely empty the reader ran dry, which is our underrun. */
+    if (queued > 0)
+        n_bytes = u->hwbuf_size - PA_MIN(queued, u->hwbuf_size);
+    else
+        n_bytes = u->hwbuf_size + pa_frame_size(&u->sink->sample_spec);
+
+    left_to_play = pa_tsched_check_left_to_play(u->tsched, n_bytes, on_timeout, !u->first);
+
+    /* Don't fill up before at least half the sleep time is over, see
+     * alsa-sink.c */
+    if (pa_bytes_to_usec(left_to_play, &u->sink->sample_spec) <= process_usec + max_sleep_usec/2) {
+
+        fill_to = u->hwbuf_size - pa_tsched_get_unused(u->tsched);
+
+        while (left_to_play < fill_to) {
+            ssize_t l;
+
+            if ((l = process_render(u, fill_to - left_to_play)) < 0)
+                return -1;
+
+            /* The FIFO is smaller than we thought */
+            if (l == 0)
+                break;
+
+            left_to_play += device_to_sink_bytes(u, (size_t) l);
+            work_done = TRUE;
+        }
+    }
+
+    if (work_done) {
+        pa_usec_t now = pa_rtclock_now();
+
+        if (u->first)
+            pa_tsched_start(u->tsched, now);
+
+        if (fifo_queued(u, &queued) < 0)
+            return -1;
+
+        pa_tsched_update_smoother(u->tsched, now, queued);
+    }
+
+    *sleep_usec = pa_bytes_to_usec(left_to_play, &u->sink->sample_spec);
+
+    if (*sleep_usec > process_usec)
+        *sleep_usec -= process_usec;
+    else
+        *sleep_usec = 0;
+
+    return 0;
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
 
@@ -183,16 +339,30 @@ static void thread_func(void *userdata) {
             if (u->sink->thread_info.rewind_requested)
                 pa_sink_process_rewind(u->sink, 0);
 
-            if (pollfd->revents) {
-                if (process_render(u) < 0)
+            if (u->tsched) {
+
+                if (u->sink->thread_info.state == PA_SINK_RUNNING) {
+                    pa_usec_t sleep_usec = 0;
+
+                    if (process_render_tsched(u, pa_rtpoll_timer_elapsed(u->rtpoll), &sleep_usec) < 0)
+                        goto fail;
+
+                    pa_tsched_set_timer(u->tsched, u->rtpoll, sleep_usec);
+                    u->first = FALSE;
+                } else
+                    pa_rtpoll_set_timer_disabled(u->rtpoll);
+
+            } else if (pollfd->revents) {
+                if (process_render(u, device_to_sink_bytes(u, pa_pipe_buf(u->fd))) < 0)
                     goto fail;
 
                 pollfd->revents = 0;
             }
-        }
+        } else if (u->tsched)
+            pa_rtpoll_set_timer_disabled(u->rtpoll);
 
         /* Hmm, nothing to do. Let's sleep */
-        pollfd->events = (short) (u->sink->thread_info.state == PA_SINK_RUNNING ? POLLOUT : 0);
+        pollfd->events = (short) (!u->tsched && u->sink->thread_info.state == PA_SINK_RUNNING ? POLLOUT : 0);
 
         if ((ret = pa_rtpoll_run(u->rtpoll, TRUE)) < 0)
             goto fail;
@@ -223,6 +393,7 @@ int pa__init(pa_module*m) {
     struct stat st;
     pa_sample_spec ss;
     pa_channel_map map;
+    pa_bool_t float_mixing = FALSE, use_tsched = FALSE;
     pa_modargs *ma;
     struct pollfd *pollfd;
     pa_sink_new_data data;
@@ -241,6 +412,22 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "float_mixing", &float_mixing) < 0) {
+        pa_log("Failed to parse float_mixing argument.");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_boolean(ma, "tsched", &use_tsched) < 0) {
+        pa_log("Failed to parse tsched argument.");
+        goto fail;
+    }
+
+#ifndef FIONREAD
+    /* Without knowing the fill level of the FIFO we can only wake up
+     * when it becomes writable */
+    use_tsched = FALSE;
+#endif
+
     u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
@@ -249,6 +436,15 @@ int pa__init(pa_module*m) {
     u->rtpoll = pa_rtpoll_new();
     pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
     u->write_type = 0;
+    u->device_spec = ss;
+    u->float_mixing = float_mixing && ss.format != PA_SAMPLE_FLOAT32NE;
+
+    /* Mix, apply volumes and resample straight into float32 and
+     * convert to the FIFO format only once per rendered block. The
+     * bus stays interleaved, and this is only available here, not in
+     * the other sinks. */
+    if (u->float_mixing)
+        ss.format = PA_SAMPLE_FLOAT32NE;
 
     u->filename = pa_runtime_path(pa_modargs_get_value(ma, "file", DEFAULT_FILE_NAME));
 
@@ -286,7 +482,7 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
-    u->sink = pa_sink_new(m->core, &data, PA_SINK_LATENCY);
+    u->sink = pa_sink_new(m->core, &data, PA_SINK_LATENCY|(use_tsched ? PA_SINK_DYNAMIC_LATENCY : 0));
     pa_sink_new_data_done(&data);
 
     if (!u->sink) {
@@ -299,8 +495,32 @@ int pa__init(pa_module*m) {
 
     pa_sink_set_asyncmsgq(u->sink, u->thread_mq.inq);
     pa_sink_set_rtpoll(u->sink, u->rtpoll);
-    pa_sink_set_max_request(u->sink, pa_pipe_buf(u->fd));
-    pa_sink_set_fixed_latency(u->sink, pa_bytes_to_usec(pa_pipe_buf(u->fd), &u->sink->sample_spec));
+
+    if (use_tsched) {
+        size_t fifo_size = pa_pipe_buf(u->fd);
+#ifdef F_GETPIPE_SZ
+        int r;
+
+        /* PIPE_BUF is only the atomic write size, the FIFO itself is
+         * usually much larger */
+        if ((r = fcntl(u->fd, F_GETPIPE_SZ)) > 0)
+            fifo_size = (size_t) r;
+#endif
+
+        u->hwbuf_size = device_to_sink_bytes(u, fifo_size);
+        u->tsched = pa_tsched_new(u->sink, u->hwbuf_size, pa_usec_to_bytes(PA_TSCHED_DEFAULT_WATERMARK_USEC, &u->sink->sample_spec), TRUE);
+        u->first = TRUE;
+
+        u->sink->update_requested_latency = sink_update_requested_latency_cb;
+        pa_sink_set_max_request(u->sink, u->hwbuf_size);
+        pa_sink_set_latency_range(u->sink, 0, pa_bytes_to_usec(u->hwbuf_size, &u->sink->sample_spec));
+
+        pa_log_info("Using timer-based scheduling, FIFO size is %0.2fms.",
+                    (double) pa_bytes_to_usec(u->hwbuf_size, &u->sink->sample_spec) / PA_USEC_PER_MSEC);
+    } else {
+        pa_sink_set_max_request(u->sink, device_to_sink_bytes(u, pa_pipe_buf(u->fd)));
+        pa_sink_set_fixed_latency(u->sink, pa_bytes_to_usec(pa_pipe_buf(u->fd), &u->device_spec));
+    }
 
     u->rtpoll_item = pa_rtpoll_item_new(u->rtpoll, PA_RTPOLL_NEVER, 1);
     pollfd = pa_rtpoll_item_get_pollfd(u->rtpoll_item, NULL);
@@ -360,9 +580,15 @@ void pa__done(pa_module*m) {
     if (u->memchunk.memblock)
        pa_memblock_unref(u->memchunk.memblock);
 
+    if (u->convert_buffer)
+        pa_memblock_unref(u->convert_buffer);
+
     if (u->rtpoll_item)
         pa_rtpoll_item_free(u->rtpoll_item);
 
+    if (u->tsched)
+        pa_tsched_free(u->tsched);
+
     if (u->rtpoll)
         pa_rtpoll_free(u->rtpoll);
 
@@ -46,6 +46,7 @@
 #include <pulsecore/pdispatch.h>
 #include <pulsecore/pstream.h>
 #include <pulsecore/pstream-util.h>
+#include <pulsecore/rtpoll-mainloop.h>
 #include <pulsecore/socket-client.h>
 #include <pulsecore/socket-util.h>
 #include <pulsecore/time-smoother.h>
@@ -56,6 +57,7 @@
 #include <pulsecore/proplist-util.h>
 #include <pulsecore/auth-cookie.h>
 #include <pulsecore/mcalign.h>
+#include <pulsecore/codec.h>
 
 #ifdef TUNNEL_SINK
 #include "module-tunnel-sink-symdef.h"
@@ -74,7 +76,9 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "channels=<number of channels> "
         "rate=<sample rate> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "thread_io=<talk to the server from the IO thread?> "
+        "codec=<pcm, lossless or adpcm>");
 #else
 PA_MODULE_DESCRIPTION("Tunnel module for sources");
 PA_MODULE_USAGE(
@@ -86,7 +90,9 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "channels=<number of channels> "
         "rate=<sample rate> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "thread_io=<talk to the server from the IO thread?> "
+        "codec=<pcm, lossless or adpcm>");
 #endif
 
 PA_MODULE_AUTHOR("Lennart Poettering");
@@ -109,6 +115,8 @@ static const char* const valid_modargs[] = {
     "source",
 #endif
     "channel_map",
+    "thread_io",
+    "codec",
     NULL,
 };
 
@@ -124,7 +132,8 @@ enum {
     SINK_MESSAGE_REQUEST = PA_SINK_MESSAGE_MAX,
     SINK_MESSAGE_REMOTE_SUSPEND,
     SINK_MESSAGE_UPDATE_LATENCY,
-    SINK_MESSAGE_POST
+    SINK_MESSAGE_POST,
+    SINK_MESSAGE_MAX
 };
 
 #define DEFAULT_TLENGTH_MSEC 150
@@ -135,13 +144,25 @@ enum {
 enum {
     SOURCE_MESSAGE_POST = PA_SOURCE_MESSAGE_MAX,
     SOURCE_MESSAGE_REMOTE_SUSPEND,
-    SOURCE_MESSAGE_UPDATE_LATENCY
+    SOURCE_MESSAGE_UPDATE_LATENCY,
+    SOURCE_MESSAGE_MAX
 };
 
 #define DEFAULT_FRAGSIZE_MSEC 25
 
 #endif
 
+/* Only used with thread_io=1, where the pstream lives in the IO thread */
+enum {
+#ifdef TUNNEL_SINK
+    TUNNEL_MESSAGE_CONNECT = SINK_MESSAGE_MAX,
+#else
+    TUNNEL_MESSAGE_CONNECT = SOURCE_MESSAGE_MAX,
+#endif
+    TUNNEL_MESSAGE_SEND_PACKET,
+    TUNNEL_MESSAGE_RECEIVE_PACKET
+};
+
 #ifdef TUNNEL_SINK
 static void command_request(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_started(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
@@ -205,11 +226,30 @@ struct userdata {
     uint32_t device_index;
     uint32_t channel;
 
+    /* With thread_io counter_delta is maintained in the IO thread */
     int64_t counter, counter_delta;
 
     pa_bool_t remote_corked:1;
     pa_bool_t remote_suspended:1;
 
+    /* If set the pstream is driven by the IO thread instead of the
+     * main loop, and u->pstream is not used */
+    pa_bool_t thread_io;
+
+    /* Maintained in the IO thread, for thread_io only */
+    pa_rtpoll_mainloop *thread_mainloop;
+    pa_pstream *thread_pstream;
+    uint32_t thread_create_tag;
+    uint32_t thread_channel;
+    pa_bool_t thread_failed;
+
+    /* What we ask the server to compress the audio with, and the
+     * codec itself once the stream is set up. The latter is created
+     * in the main thread before the stream is, and afterwards only
+     * used in the IO thread. */
+    pa_codec_type_t codec_type;
+    pa_codec *codec;
+
     pa_usec_t transport_usec; /* maintained in the main thread */
     pa_usec_t thread_transport_usec; /* maintained in the IO thread */
 
@@ -234,6 +274,35 @@ struct userdata {
 };
 
 static void request_latency(struct userdata *u);
+static int thread_io_process_msg(struct userdata *u, int code, void *data, int64_t offset);
+static void thread_fail(struct userdata *u);
+
+/* Called from main and IO thread context */
+static pa_msgobject *tunnel_msgobject(struct userdata *u) {
+    pa_assert(u);
+
+#ifdef TUNNEL_SINK
+    return PA_MSGOBJECT(u->sink);
+#else
+    return PA_MSGOBJECT(u->source);
+#endif
+}
+
+/* Called from main context */
+static void send_tagstruct(struct userdata *u, pa_tagstruct *t) {
+    pa_packet *packet;
+
+    pa_assert(u);
+    pa_assert(t);
+
+    if (!u->thread_io) {
+        pa_pstream_send_tagstruct(u->pstream, t);
+        return;
+    }
+
+    packet = pa_tagstruct_free_packet(t);
+    pa_asyncmsgq_post(u->thread_mq.inq, tunnel_msgobject(u), TUNNEL_MESSAGE_SEND_PACKET, packet, 0, NULL, (pa_free_cb_t) pa_packet_unref);
+}
 
 /* Called from main context */
 static void command_stream_or_client_event(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -431,7 +500,7 @@ static void stream_cork(struct userdata *u, pa_bool_t cork) {
     pa_tagstruct *t;
     pa_assert(u);
 
-    if (!u->pstream)
+    if (!u->pdispatch)
         return;
 
     t = pa_tagstruct_new(NULL, 0);
@@ -443,7 +512,7 @@ static void stream_cork(struct userdata *u, pa_bool_t cork) {
     pa_tagstruct_putu32(t, u->ctag++);
     pa_tagstruct_putu32(t, u->channel);
     pa_tagstruct_put_boolean(t, !!cork);
-    pa_pstream_send_tagstruct(u->pstream, t);
+    send_tagstruct(u, t);
 
     request_latency(u);
 }
@@ -461,6 +530,20 @@ static void stream_suspend_within_thread(struct userdata *u, pa_bool_t suspend)
 
 #ifdef TUNNEL_SINK
 
+/* Called from IO thread context */
+static void send_chunk(struct userdata *u, const pa_memchunk *chunk, size_t pcm_length) {
+    pa_assert(u);
+    pa_assert(chunk);
+
+    if (u->thread_io) {
+        if (u->thread_pstream)
+            pa_pstream_send_memblock(u->thread_pstream, u->thread_channel, 0, PA_SEEK_RELATIVE, chunk);
+
+        u->counter_delta += (int64_t) pcm_length;
+    } else
+        pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_POST, NULL, (int64_t) pcm_length, chunk, NULL);
+}
+
 /* Called from IO thread context */
 static void send_data(struct userdata *u) {
     pa_assert(u);
@@ -469,7 +552,24 @@ static void send_data(struct userdata *u) {
         pa_memchunk memchunk;
 
         pa_sink_render(u->sink, u->requested_bytes, &memchunk);
-        pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_POST, NULL, 0, &memchunk, NULL);
+
+        if (u->codec) {
+            pa_memchunk pcm = memchunk;
+
+            while (pcm.length > 0) {
+                pa_memchunk packet;
+                size_t l;
+
+                l = pa_codec_encode(u->codec, &pcm, &packet);
+                send_chunk(u, &packet, l);
+                pa_memblock_unref(packet.memblock);
+
+                pcm.index += l;
+                pcm.length -= l;
+            }
+        } else
+            send_chunk(u, &memchunk, memchunk.length);
+
         pa_memblock_unref(memchunk.memblock);
 
         u->requested_bytes -= memchunk.length;
@@ -529,9 +629,16 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
         case SINK_MESSAGE_UPDATE_LATENCY: {
             pa_usec_t y;
 
+            /* Correct by what we have written since we requested the
+             * update. We can access counter_delta here, since either
+             * we maintain it or the main thread is waiting for us */
+            offset += (int64_t) pa_bytes_to_usec((uint64_t) u->counter_delta, &u->sink->sample_spec);
+
             y = pa_bytes_to_usec((uint64_t) u->counter, &u->sink->sample_spec);
 
-            if (y > (pa_usec_t) offset)
+            if (offset < 0)
+                y = 0;
+            else if (y > (pa_usec_t) offset)
                 y -= (pa_usec_t) offset;
             else
                 y = 0;
@@ -553,9 +660,15 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
 
             pa_pstream_send_memblock(u->pstream, u->channel, 0, PA_SEEK_RELATIVE, chunk);
 
-            u->counter_delta += (int64_t) chunk->length;
+            /* offset is the amount of PCM the chunk was encoded from */
+            u->counter_delta += offset;
 
             return 0;
+
+        case TUNNEL_MESSAGE_CONNECT:
+        case TUNNEL_MESSAGE_SEND_PACKET:
+        case TUNNEL_MESSAGE_RECEIVE_PACKET:
+            return thread_io_process_msg(u, code, data, offset);
     }
 
     return pa_sink_process_msg(o, code, data, offset, chunk);
@@ -591,6 +704,50 @@ static int sink_set_state(pa_sink *s, pa_sink_state_t state) {
 
 #else
 
+/* Called from IO thread context, or from the main thread while it
+ * waits for us */
+static void source_post_chunk(struct userdata *u, const pa_memchunk *chunk) {
+    pa_memchunk c, pcm;
+
+    pa_assert(u);
+    pa_assert(chunk);
+
+    if (u->codec) {
+
+        if (!chunk->memblock) {
+            pa_codec_reset(u->codec);
+            return;
+        }
+
+        if (pa_codec_decode(u->codec, chunk, &pcm) < 0) {
+            thread_fail(u);
+            return;
+        }
+
+        if (!pcm.memblock)
+            return;
+
+        chunk = &pcm;
+    }
+
+    u->counter_delta += (int64_t) chunk->length;
+
+    pa_mcalign_push(u->mcalign, chunk);
+
+    if (chunk == &pcm)
+        pa_memblock_unref(pcm.memblock);
+
+    while (pa_mcalign_pop(u->mcalign, &c) >= 0) {
+
+        if (PA_SOURCE_IS_OPENED(u->source->thread_info.state))
+            pa_source_post(u->source, &c);
+
+        pa_memblock_unref(c.memblock);
+
+        u->counter += (int64_t) c.length;
+    }
+}
+
 /* This function is called from IO context -- except when it is not. */
 static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
     struct userdata *u = PA_SOURCE(o)->userdata;
@@ -616,23 +773,9 @@ static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t off
             return 0;
         }
 
-        case SOURCE_MESSAGE_POST: {
-            pa_memchunk c;
-
-            pa_mcalign_push(u->mcalign, chunk);
-
-            while (pa_mcalign_pop(u->mcalign, &c) >= 0) {
-
-                if (PA_SOURCE_IS_OPENED(u->source->thread_info.state))
-                    pa_source_post(u->source, &c);
-
-                pa_memblock_unref(c.memblock);
-
-                u->counter += (int64_t) c.length;
-            }
-
+        case SOURCE_MESSAGE_POST:
+            source_post_chunk(u, chunk);
             return 0;
-        }
 
         case SOURCE_MESSAGE_REMOTE_SUSPEND:
 
@@ -642,8 +785,19 @@ static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t off
         case SOURCE_MESSAGE_UPDATE_LATENCY: {
             pa_usec_t y;
 
+            /* Correct by what we have read since we requested the
+             * update. We can access counter_delta here, since either
+             * we maintain it or the main thread is waiting for us */
+            offset -= (int64_t) pa_bytes_to_usec((uint64_t) u->counter_delta, &u->source->sample_spec);
+
             y = pa_bytes_to_usec((uint64_t) u->counter, &u->source->sample_spec);
-            y += (pa_usec_t) offset;
+
+            if (offset >= 0)
+                y += (pa_usec_t) offset;
+            else if (y > (pa_usec_t) -offset)
+                y -= (pa_usec_t) -offset;
+            else
+                y = 0;
 
             pa_smoother_put(u->smoother, pa_rtclock_now(), y);
 
@@ -652,6 +806,11 @@ static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t off
 
             return 0;
         }
+
+        case TUNNEL_MESSAGE_CONNECT:
+        case TUNNEL_MESSAGE_SEND_PACKET:
+        case TUNNEL_MESSAGE_RECEIVE_PACKET:
+            return thread_io_process_msg(u, code, data, offset);
     }
 
     return pa_source_process_msg(o, code, data, offset, chunk);
@@ -696,6 +855,9 @@ static void thread_func(void *userdata) {
 
     pa_thread_mq_install(&u->thread_mq);
 
+    if (u->thread_io)
+        u->thread_mainloop = pa_rtpoll_mainloop_new(u->rtpoll);
+
     for (;;) {
         int ret;
 
@@ -719,6 +881,17 @@ fail:
     pa_asyncmsgq_wait_for(u->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
 
 finish:
+    if (u->thread_pstream) {
+        pa_pstream_unlink(u->thread_pstream);
+        pa_pstream_unref(u->thread_pstream);
+        u->thread_pstream = NULL;
+    }
+
+    if (u->thread_mainloop) {
+        pa_rtpoll_mainloop_free(u->thread_mainloop);
+        u->thread_mainloop = NULL;
+    }
+
     pa_log_debug("Thread shutting down");
 }
 
@@ -843,13 +1016,8 @@ static void stream_get_latency_callback(pa_pdispatch *pd, uint32_t command, uint
     delay += (int64_t) u->transport_usec;
 #endif
 
-    /* Now correct by what we have have read/written since we requested the update */
-#ifdef TUNNEL_SINK
-    delay += (int64_t) pa_bytes_to_usec((uint64_t) u->counter_delta, ss);
-#else
-    delay -= (int64_t) pa_bytes_to_usec((uint64_t) u->counter_delta, ss);
-#endif
-
+    /* The correction by what we have read/written since we requested
+     * the update is done by the IO thread */
 #ifdef TUNNEL_SINK
     pa_asyncmsgq_send(u->sink->asyncmsgq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_UPDATE_LATENCY, 0, delay, NULL);
 #else
@@ -881,11 +1049,14 @@ static void request_latency(struct userdata *u) {
 
     pa_tagstruct_put_timeval(t, pa_gettimeofday(&now));
 
-    pa_pstream_send_tagstruct(u->pstream, t);
+    send_tagstruct(u, t);
     pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, stream_get_latency_callback, u, NULL);
 
     u->ignore_latency_before = tag;
-    u->counter_delta = 0;
+
+    /* With thread_io this is done when the request is actually sent */
+    if (!u->thread_io)
+        u->counter_delta = 0;
 }
 
 /* Called from main context */
@@ -941,7 +1112,7 @@ static void update_description(struct userdata *u) {
     pa_tagstruct_putu32(t, u->ctag++);
     pa_tagstruct_putu32(t, u->channel);
     pa_tagstruct_puts(t, d);
-    pa_pstream_send_tagstruct(u->pstream, t);
+    send_tagstruct(u, t);
 
     pa_xfree(d);
 }
@@ -1332,7 +1503,7 @@ static void request_info(struct userdata *u) {
     t = pa_tagstruct_new(NULL, 0);
     pa_tagstruct_putu32(t, PA_COMMAND_GET_SERVER_INFO);
     pa_tagstruct_putu32(t, tag = u->ctag++);
-    pa_pstream_send_tagstruct(u->pstream, t);
+    send_tagstruct(u, t);
     pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, server_info_cb, u, NULL);
 
 #ifdef TUNNEL_SINK
@@ -1340,7 +1511,7 @@ static void request_info(struct userdata *u) {
     pa_tagstruct_putu32(t, PA_COMMAND_GET_SINK_INPUT_INFO);
     pa_tagstruct_putu32(t, tag = u->ctag++);
     pa_tagstruct_putu32(t, u->device_index);
-    pa_pstream_send_tagstruct(u->pstream, t);
+    send_tagstruct(u, t);
     pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, sink_input_info_cb, u, NULL);
 
     if (u->sink_name) {
@@ -1349,7 +1520,7 @@ static void request_info(struct userdata *u) {
         pa_tagstruct_putu32(t, tag = u->ctag++);
         pa_tagstruct_putu32(t, PA_INVALID_INDEX);
         pa_tagstruct_puts(t, u->sink_name);
-        pa_pstream_send_tagstruct(u->pstream, t);
+        send_tagstruct(u, t);
         pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, sink_info_cb, u, NULL);
     }
 #else
@@ -1359,7 +1530,7 @@ static void request_info(struct userdata *u) {
         pa_tagstruct_putu32(t, tag = u->ctag++);
         pa_tagstruct_putu32(t, PA_INVALID_INDEX);
         pa_tagstruct_puts(t, u->source_name);
-        pa_pstream_send_tagstruct(u->pstream, t);
+        send_tagstruct(u, t);
         pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, source_info_cb, u, NULL);
     }
 #endif
@@ -1412,7 +1583,7 @@ static void start_subscribe(struct userdata *u) {
 #endif
                         );
 
-    pa_pstream_send_tagstruct(u->pstream, t);
+    send_tagstruct(u, t);
 }
 
 /* Called from main context */
@@ -1492,6 +1663,18 @@ static void create_stream_callback(pa_pdispatch *pd, uint32_t command,  uint32_t
 /* #endif */
     }
 
+    if (u->version >= 19) {
+        uint32_t codec;
+
+        if (pa_tagstruct_getu32(t, &codec) < 0)
+            goto parse_error;
+
+        if (codec != (u->codec ? pa_codec_get_type(u->codec) : PA_CODEC_PCM)) {
+            pa_log("Server did not accept the %s codec.", pa_codec_type_to_string(u->codec_type));
+            goto fail;
+        }
+    }
+
     if (!pa_tagstruct_eof(t))
         goto parse_error;
 
@@ -1592,7 +1775,7 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
     } else
         pa_tagstruct_puts(reply, "PulseAudio");
 
-    pa_pstream_send_tagstruct(u->pstream, reply);
+    send_tagstruct(u, reply);
     /* We ignore the server's reply here */
 
     reply = pa_tagstruct_new(NULL, 0);
@@ -1686,7 +1869,23 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
         pa_tagstruct_put_boolean(reply, FALSE); /* fail on suspend */
     }
 
-    pa_pstream_send_tagstruct(u->pstream, reply);
+    if (u->version >= 19) {
+        pa_tagstruct_putu32(reply, u->codec_type);
+
+        /* Since our sample spec is fixed the server will go with what
+         * we ask for, create_stream_callback() double checks that */
+        pa_assert(!u->codec);
+
+        if (u->codec_type != PA_CODEC_PCM)
+#ifdef TUNNEL_SINK
+            u->codec = pa_codec_new(u->codec_type, &u->sink->sample_spec, pa_codec_packet_size(&u->sink->sample_spec, u->minreq), u->core->mempool);
+#else
+            u->codec = pa_codec_new(u->codec_type, &u->source->sample_spec, 0, u->core->mempool);
+#endif
+    } else if (u->codec_type != PA_CODEC_PCM)
+        pa_log_info("Server does not support compression, sending PCM.");
+
+    send_tagstruct(u, reply);
     pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, create_stream_callback, u, NULL);
 
     pa_log_debug("Connection authenticated, creating stream ...");
@@ -1709,12 +1908,9 @@ static void pstream_die_callback(pa_pstream *p, void *userdata) {
 }
 
 /* Called from main context */
-static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
-    struct userdata *u = userdata;
-
-    pa_assert(p);
-    pa_assert(packet);
+static void dispatch_packet(struct userdata *u, pa_packet *packet, const pa_creds *creds) {
     pa_assert(u);
+    pa_assert(packet);
 
     if (pa_pdispatch_run(u->pdispatch, packet, creds, u) < 0) {
         pa_log("Invalid packet");
@@ -1723,6 +1919,17 @@ static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, const pa_c
     }
 }
 
+/* Called from main context */
+static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
+    struct userdata *u = userdata;
+
+    pa_assert(p);
+    pa_assert(packet);
+    pa_assert(u);
+
+    dispatch_packet(u, packet, creds);
+}
+
 #ifndef TUNNEL_SINK
 /* Called from main context */
 static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
@@ -1739,10 +1946,219 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
     }
 
     pa_asyncmsgq_send(u->source->asyncmsgq, PA_MSGOBJECT(u->source), SOURCE_MESSAGE_POST, PA_UINT_TO_PTR(seek), offset, chunk);
+}
+#endif
 
-    u->counter_delta += (int64_t) chunk->length;
+/* Called from IO thread context */
+static void thread_fail(struct userdata *u) {
+    pa_assert(u);
+
+    if (u->thread_failed)
+        return;
+
+    u->thread_failed = TRUE;
+    pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->core), PA_CORE_MESSAGE_UNLOAD_MODULE, u->module, 0, NULL, NULL);
 }
+
+/* Called from IO thread context */
+static void thread_pstream_die_callback(pa_pstream *p, void *userdata) {
+    struct userdata *u = userdata;
+
+    pa_assert(p);
+    pa_assert(u);
+
+    pa_log_warn("Stream died.");
+    thread_fail(u);
+}
+
+/* Called from IO thread context */
+static void thread_pstream_packet_callback(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
+    struct userdata *u = userdata;
+    pa_tagstruct *t;
+    uint32_t command, tag;
+
+    pa_assert(p);
+    pa_assert(packet);
+    pa_assert(u);
+
+    /* The reply to our stream creation tells us the channel, and
+     * requests for more data are best handled right here. Everything
+     * else is forwarded to the main thread. */
+    t = pa_tagstruct_new(packet->data, packet->length);
+
+    if (pa_tagstruct_getu32(t, &command) >= 0 &&
+        pa_tagstruct_getu32(t, &tag) >= 0) {
+
+        if (command == PA_COMMAND_REPLY && tag == u->thread_create_tag) {
+            uint32_t channel;
+
+            if (pa_tagstruct_getu32(t, &channel) >= 0)
+                u->thread_channel = channel;
+        }
+#ifdef TUNNEL_SINK
+        else if (command == PA_COMMAND_REQUEST && u->thread_channel != PA_INVALID_INDEX) {
+            uint32_t channel, bytes;
+
+            if (pa_tagstruct_getu32(t, &channel) >= 0 &&
+                pa_tagstruct_getu32(t, &bytes) >= 0 &&
+                pa_tagstruct_eof(t) &&
+                channel == u->thread_channel) {
+
+                pa_tagstruct_free(t);
+
+                u->requested_bytes += bytes;
+
+                if (PA_SINK_IS_OPENED(u->sink->thread_info.state))
+                    send_data(u);
+
+                return;
+            }
+        }
 #endif
+    }
+
+    pa_tagstruct_free(t);
+
+    /* The credentials are not needed by any of our handlers */
+    pa_asyncmsgq_post(u->thread_mq.outq, tunnel_msgobject(u), TUNNEL_MESSAGE_RECEIVE_PACKET, pa_packet_ref(packet), 0, NULL, (pa_free_cb_t) pa_packet_unref);
+}
+
+#ifndef TUNNEL_SINK
+/* Called from IO thread context */
+static void thread_pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    struct userdata *u = userdata;
+
+    pa_assert(p);
+    pa_assert(chunk);
+    pa_assert(u);
+
+    if (channel != u->thread_channel) {
+        pa_log("Received memory block on bad channel.");
+        thread_fail(u);
+        return;
+    }
+
+    source_post_chunk(u, chunk);
+}
+#endif
+
+/* Called from IO thread context */
+static void thread_connect(struct userdata *u, const int *fds) {
+    pa_mainloop_api *api;
+    pa_iochannel *io;
+
+    pa_assert(u);
+    pa_assert(fds);
+    pa_assert(u->thread_mainloop);
+    pa_assert(!u->thread_pstream);
+
+    api = pa_rtpoll_mainloop_get_api(u->thread_mainloop);
+    io = pa_iochannel_new(api, fds[0], fds[1]);
+
+#ifdef HAVE_CREDS
+    if (pa_iochannel_creds_supported(io))
+        pa_iochannel_creds_enable(io);
+#endif
+
+    u->thread_pstream = pa_pstream_new(api, io, u->core->mempool);
+
+    pa_pstream_set_die_callback(u->thread_pstream, thread_pstream_die_callback, u);
+    pa_pstream_set_recieve_packet_callback(u->thread_pstream, thread_pstream_packet_callback, u);
+#ifndef TUNNEL_SINK
+    pa_pstream_set_recieve_memblock_callback(u->thread_pstream, thread_pstream_memblock_callback, u);
+#endif
+}
+
+/* Called from IO thread context */
+static void thread_send_packet(struct userdata *u, pa_packet *packet) {
+    pa_tagstruct *t;
+    uint32_t command, tag;
+    const pa_creds *creds = NULL;
+#ifdef HAVE_CREDS
+    pa_creds ucred;
+#endif
+
+    pa_assert(u);
+    pa_assert(packet);
+
+    if (!u->thread_pstream)
+        return;
+
+    /* Keep track of what the main thread asks the server for */
+    t = pa_tagstruct_new(packet->data, packet->length);
+
+    if (pa_tagstruct_getu32(t, &command) >= 0 &&
+        pa_tagstruct_getu32(t, &tag) >= 0) {
+
+        switch (command) {
+
+#ifdef TUNNEL_SINK
+            case PA_COMMAND_CREATE_PLAYBACK_STREAM:
+#else
+            case PA_COMMAND_CREATE_RECORD_STREAM:
+#endif
+                u->thread_create_tag = tag;
+                break;
+
+#ifdef TUNNEL_SINK
+            case PA_COMMAND_GET_PLAYBACK_LATENCY:
+#else
+            case PA_COMMAND_GET_RECORD_LATENCY:
+#endif
+                /* What request_latency() does without thread_io */
+                u->counter_delta = 0;
+                break;
+
+#ifdef HAVE_CREDS
+            case PA_COMMAND_AUTH:
+                ucred.uid = getuid();
+                ucred.gid = getgid();
+                creds = &ucred;
+                break;
+#endif
+
+            default:
+                ;
+        }
+    }
+
+    pa_tagstruct_free(t);
+
+    pa_pstream_send_packet(u->thread_pstream, packet, creds);
+}
+
+/* This function is called from IO context -- except for
+ * TUNNEL_MESSAGE_RECEIVE_PACKET, which is delivered to us in the main
+ * context. */
+static int thread_io_process_msg(struct userdata *u, int code, void *data, int64_t offset) {
+    pa_assert(u);
+    pa_assert(u->thread_io);
+
+    switch (code) {
+
+        case TUNNEL_MESSAGE_CONNECT:
+            thread_connect(u, data);
+            return 0;
+
+        case TUNNEL_MESSAGE_SEND_PACKET:
+            thread_send_packet(u, data);
+            return 0;
+
+        case TUNNEL_MESSAGE_RECEIVE_PACKET:
+
+            /* Drop what is left over while we are going down */
+#ifdef TUNNEL_SINK
+            if (PA_SINK_IS_LINKED(u->sink->state))
+#else
+            if (PA_SOURCE_IS_LINKED(u->source->state))
+#endif
+                dispatch_packet(u, data, NULL);
+
+            return 0;
+    }
+
+    pa_assert_not_reached();
+}
 
 /* Called from main context */
 static void on_connection(pa_socket_client *sc, pa_iochannel *io, void *userdata) {
@@ -1763,14 +2179,29 @@ static void on_connection(pa_socket_client *sc, pa_iochannel *io, void *userdata
         return;
     }
 
-    u->pstream = pa_pstream_new(u->core->mainloop, io, u->core->mempool);
     u->pdispatch = pa_pdispatch_new(u->core->mainloop, TRUE, command_table, PA_COMMAND_MAX);
 
-    pa_pstream_set_die_callback(u->pstream, pstream_die_callback, u);
-    pa_pstream_set_recieve_packet_callback(u->pstream, pstream_packet_callback, u);
+    if (u->thread_io) {
+        int fds[2];
+
+        /* Hand the connection over to the IO thread, which wraps it
+         * in its own iochannel */
+        fds[0] = pa_iochannel_get_recv_fd(io);
+        fds[1] = pa_iochannel_get_send_fd(io);
+        pa_iochannel_set_noclose(io, TRUE);
+        pa_iochannel_free(io);
+
+        pa_asyncmsgq_send(u->thread_mq.inq, tunnel_msgobject(u), TUNNEL_MESSAGE_CONNECT, fds, 0, NULL);
+
+    } else {
+        u->pstream = pa_pstream_new(u->core->mainloop, io, u->core->mempool);
+
+        pa_pstream_set_die_callback(u->pstream, pstream_die_callback, u);
+        pa_pstream_set_recieve_packet_callback(u->pstream, pstream_packet_callback, u);
 #ifndef TUNNEL_SINK
-    pa_pstream_set_recieve_memblock_callback(u->pstream, pstream_memblock_callback, u);
+        pa_pstream_set_recieve_memblock_callback(u->pstream, pstream_memblock_callback, u);
 #endif
+    }
 
     t = pa_tagstruct_new(NULL, 0);
     pa_tagstruct_putu32(t, PA_COMMAND_AUTH);
@@ -1780,19 +2211,21 @@ static void on_connection(pa_socket_client *sc, pa_iochannel *io, void *userdata
     pa_tagstruct_put_arbitrary(t, pa_auth_cookie_read(u->auth_cookie, PA_NATIVE_COOKIE_LENGTH), PA_NATIVE_COOKIE_LENGTH);
 
 #ifdef HAVE_CREDS
-{
-    pa_creds ucred;
+    if (!u->thread_io) {
+        pa_creds ucred;
 
-    if (pa_iochannel_creds_supported(io))
-        pa_iochannel_creds_enable(io);
+        if (pa_iochannel_creds_supported(io))
+            pa_iochannel_creds_enable(io);
 
-    ucred.uid = getuid();
-    ucred.gid = getgid();
+        ucred.uid = getuid();
+        ucred.gid = getgid();
 
-    pa_pstream_send_tagstruct_with_creds(u->pstream, t, &ucred);
-}
+        pa_pstream_send_tagstruct_with_creds(u->pstream, t, &ucred);
+    } else
+        /* The IO thread adds the credentials */
+        send_tagstruct(u, t);
 #else
-    pa_pstream_send_tagstruct(u->pstream, t);
+    send_tagstruct(u, t);
 #endif
 
     pa_pdispatch_register_reply(u->pdispatch, tag, DEFAULT_TIMEOUT, setup_complete_callback, u, NULL);
@@ -1816,7 +2249,7 @@ static void sink_set_volume(pa_sink *sink) {
     pa_tagstruct_putu32(t, u->ctag++);
     pa_tagstruct_putu32(t, u->device_index);
     pa_tagstruct_put_cvolume(t, &sink->real_volume);
-    pa_pstream_send_tagstruct(u->pstream, t);
+    send_tagstruct(u, t);
 }
 
 /* Called from main context */
@@ -1836,7 +2269,7 @@ static void sink_set_mute(pa_sink *sink) {
     pa_tagstruct_putu32(t, u->ctag++);
     pa_tagstruct_putu32(t, u->device_index);
     pa_tagstruct_put_boolean(t, !!sink->muted);
-    pa_pstream_send_tagstruct(u->pstream, t);
+    send_tagstruct(u, t);
 }
 
 #endif
@@ -1890,10 +2323,22 @@ int pa__init(pa_module*m) {
     u->transport_usec = u->thread_transport_usec = 0;
     u->remote_suspended = u->remote_corked = FALSE;
     u->counter = u->counter_delta = 0;
+    u->thread_io = FALSE;
+    u->thread_mainloop = NULL;
+    u->thread_pstream = NULL;
+    u->thread_create_tag = u->thread_channel = PA_INVALID_INDEX;
+    u->thread_failed = FALSE;
+    u->codec_type = PA_CODEC_PCM;
+    u->codec = NULL;
 
     u->rtpoll = pa_rtpoll_new();
     pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
 
+    if (pa_modargs_get_value_boolean(ma, "thread_io", &u->thread_io) < 0) {
+        pa_log("Failed to parse thread_io argument.");
+        goto fail;
+    }
+
     if (!(u->auth_cookie = pa_auth_cookie_get(u->core, pa_modargs_get_value(ma, "cookie", PA_NATIVE_COOKIE_FILE), PA_NATIVE_COOKIE_LENGTH)))
         goto fail;
 
@@ -1909,6 +2354,16 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if ((u->codec_type = pa_codec_type_from_string(pa_modargs_get_value(ma, "codec", "pcm"))) == PA_CODEC_MAX) {
+        pa_log("Invalid codec.");
+        goto fail;
+    }
+
+    if (!pa_codec_supported(u->codec_type, &ss)) {
+        pa_log("The %s codec does not support sample format %s.", pa_codec_type_to_string(u->codec_type), pa_sample_format_to_string(ss.format));
+        goto fail;
+    }
+
     if (!(u->client = pa_socket_client_new_string(m->core->mainloop, TRUE, u->server_name, PA_NATIVE_DEFAULT_PORT))) {
         pa_log("Failed to connect to server '%s'", u->server_name);
         goto fail;
@@ -2099,6 +2554,9 @@ void pa__done(pa_module*m) {
         pa_mcalign_free(u->mcalign);
 #endif
 
+    if (u->codec)
+        pa_codec_free(u->codec);
+
 #ifdef TUNNEL_SINK
     pa_xfree(u->sink_name);
 #else
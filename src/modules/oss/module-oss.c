@@ -55,6 +55,7 @@
 #include <signal.h>
 #include <poll.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
 
@@ -70,6 +71,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/tsched.h>
 
 #if defined(__NetBSD__) && !defined(SNDCTL_DSP_GETODELAY)
 #include <sys/audioio.h>
@@ -97,7 +99,8 @@ PA_MODULE_USAGE(
         "channel_map=<channel map> "
         "fragments=<number of fragments> "
         "fragment_size=<fragment size> "
-        "mmap=<enable memory mapping?>");
+        "mmap=<enable memory mapping?> "
+        "tsched=<enable timer-based scheduling for playback?>");
 #ifdef __linux__
 PA_MODULE_DEPRECATED("Please use module-alsa-card instead of module-oss!");
 #endif
@@ -140,6 +143,10 @@ struct userdata {
 
     int in_mmap_saved_nfrags, out_mmap_saved_nfrags;
 
+    /* Only used for write() based playback-only devices */
+    pa_tsched *tsched;
+    pa_bool_t first;
+
     pa_rtpoll_item *rtpoll_item;
 };
 
@@ -158,6 +165,7 @@ static const char* const valid_modargs[] = {
     "channels",
     "channel_map",
     "mmap",
+    "tsched",
     NULL
 };
 
@@ -491,6 +499,9 @@ static int suspend(struct userdata *u) {
 
     pa_log_info("Suspending...");
 
+    if (u->tsched)
+        pa_tsched_pause(u->tsched, pa_rtclock_now());
+
     if (u->out_mmap_memblocks) {
         unsigned i;
         for (i = 0; i < u->out_nfrags; i++)
@@ -621,6 +632,11 @@ static int unsuspend(struct userdata *u) {
     u->out_mmap_current = u->in_mmap_current = 0;
     u->out_mmap_saved_nfrags = u->in_mmap_saved_nfrags = 0;
 
+    if (u->tsched) {
+        pa_tsched_reset(u->tsched, pa_rtclock_now());
+        u->first = TRUE;
+    }
+
     pa_assert(!u->rtpoll_item);
 
     build_pollfd(u);
@@ -654,7 +670,12 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
             if (u->fd >= 0) {
                 if (u->use_mmap)
                     r = mmap_sink_get_latency(u);
-                else
+                else if (u->tsched) {
+                    r = pa_tsched_get_latency(u->tsched, pa_rtclock_now());
+
+                    if (u->memchunk.memblock)
+                        r += pa_bytes_to_usec(u->memchunk.length, &u->sink->sample_spec);
+                } else
                     r = io_sink_get_latency(u);
             }
 
@@ -876,6 +897,116 @@ static void source_set_volume(pa_source *s) {
     pa_log_info("Device doesn't support writing mixer settings: %s", pa_cstrerror(errno));
 }
 
+static void sink_update_requested_latency_cb(pa_sink *s) {
+    struct userdata *u;
+
+    pa_sink_assert_ref(s);
+    pa_assert_se(u = s->userdata);
+
+    /* OSS cannot rewind, hence there's no need to ask for one if we
+     * now use less of the buffer than before */
+    pa_tsched_update_requested_latency(u->tsched);
+}
+
+static int io_write_tsched(struct userdata *u, pa_bool_t on_timeout, pa_usec_t *sleep_usec, int *write_type) {
+    pa_usec_t max_sleep_usec, process_usec;
+    size_t n_bytes, left_to_play, fill_to;
+    audio_buf_info info;
+    pa_bool_t work_done = FALSE;
+
+    pa_assert(u);
+    pa_assert(u->tsched);
+    pa_assert(sleep_usec);
+
+    pa_tsched_sleep_time(u->tsched, &max_sleep_usec, &process_usec);
+
+    if (ioctl(u->fd, SNDCTL_DSP_GETOSPACE, &info) < 0) {
+        pa_log("SNDCTL_DSP_GETOSPACE: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    /* OSS doesn't tell us about underruns directly, an entirely empty
+     * buffer is the best indication we have. */
+    if (info.bytes < (int) u->out_hwbuf_size)
+        n_bytes = info.bytes > 0 ? (size_t) info.bytes : 0;
+    else
+        n_bytes = u->out_hwbuf_size + u->frame_size;
+
+    left_to_play = pa_tsched_check_left_to_play(u->tsched, n_bytes, on_timeout, !u->first);
+
+    /* We won't fill up the playback buffer before at least half the
+     * sleep time is over, see alsa-sink.c */
+    if (pa_bytes_to_usec(left_to_play, &u->sink->sample_spec) <= process_usec + max_sleep_usec/2) {
+        ssize_t l;
+
+        fill_to = u->out_hwbuf_size - pa_tsched_get_unused(u->tsched);
+
+        /* Round down to multiples of the fragment size, because OSS
+         * needs that (at least some versions do) */
+        l = fill_to > left_to_play ? (ssize_t) ((fill_to - left_to_play) / u->out_fragment_size * u->out_fragment_size) : 0;
+
+        while (l > 0) {
+            void *p;
+            ssize_t t;
+
+            if (u->memchunk.length <= 0)
+                pa_sink_render(u->sink, (size_t) l, &u->memchunk);
+
+            pa_assert(u->memchunk.length > 0);
+
+            p = pa_memblock_acquire(u->memchunk.memblock);
+            t = pa_write(u->fd, (uint8_t*) p + u->memchunk.index, PA_MIN(u->memchunk.length, (size_t) l), write_type);
+            pa_memblock_release(u->memchunk.memblock);
+
+            pa_assert(t != 0);
+
+            if (t < 0) {
+
+                if (errno == EINTR)
+                    continue;
+
+                else if (errno == EAGAIN)
+                    break;
+
+                pa_log("Failed to write data to DSP: %s", pa_cstrerror(errno));
+                return -1;
+            }
+
+            u->memchunk.index += (size_t) t;
+            u->memchunk.length -= (size_t) t;
+
+            if (u->memchunk.length <= 0) {
+                pa_memblock_unref(u->memchunk.memblock);
+                pa_memchunk_reset(&u->memchunk);
+            }
+
+            pa_tsched_written(u->tsched, (size_t) t);
+            left_to_play += (size_t) t;
+            l -= t;
+            work_done = TRUE;
+        }
+    }
+
+    if (work_done) {
+        pa_usec_t now = pa_rtclock_now();
+
+        if (u->first)
+            pa_tsched_start(u->tsched, now);
+
+        if (ioctl(u->fd, SNDCTL_DSP_GETOSPACE, &info) >= 0 && info.bytes >= 0 && info.bytes < (int) u->out_hwbuf_size)
+            pa_tsched_update_smoother(u->tsched, now, u->out_hwbuf_size - (size_t) info.bytes);
+    }
+
+    *sleep_usec = pa_bytes_to_usec(left_to_play, &u->sink->sample_spec);
+
+    if (*sleep_usec > process_usec)
+        *sleep_usec -= process_usec;
+    else
+        *sleep_usec = 0;
+
+    return 0;
+}
+
 static void thread_func(void *userdata) {
     struct userdata *u = userdata;
     int write_type = 0, read_type = 0;
@@ -901,7 +1032,20 @@ static void thread_func(void *userdata) {
 
         /* Render some data and write it to the dsp */
 
-        if (u->sink && PA_SINK_IS_OPENED(u->sink->thread_info.state) && ((revents & POLLOUT) || u->use_mmap || u->use_getospace)) {
+        if (u->tsched) {
+
+            if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
+                pa_usec_t sleep_usec = 0;
+
+                if (io_write_tsched(u, pa_rtpoll_timer_elapsed(u->rtpoll), &sleep_usec, &write_type) < 0)
+                    goto fail;
+
+                pa_tsched_set_timer(u->tsched, u->rtpoll, sleep_usec);
+                u->first = FALSE;
+            } else
+                pa_rtpoll_set_timer_disabled(u->rtpoll);
+
+        } else if (u->sink && PA_SINK_IS_OPENED(u->sink->thread_info.state) && ((revents & POLLOUT) || u->use_mmap || u->use_getospace)) {
 
             if (u->use_mmap) {
 
@@ -1121,7 +1265,7 @@ static void thread_func(void *userdata) {
             pollfd = pa_rtpoll_item_get_pollfd(u->rtpoll_item, NULL);
             pollfd->events = (short)
                 (((u->source && PA_SOURCE_IS_OPENED(u->source->thread_info.state)) ? POLLIN : 0) |
-                 ((u->sink && PA_SINK_IS_OPENED(u->sink->thread_info.state)) ? POLLOUT : 0));
+                 ((u->sink && !u->tsched && PA_SINK_IS_OPENED(u->sink->thread_info.state)) ? POLLOUT : 0));
         }
 
         /* Hmm, nothing to do. Let's sleep */
@@ -1164,7 +1308,7 @@ int pa__init(pa_module*m) {
     int fd = -1;
     int nfrags, orig_frag_size, frag_size;
     int mode, caps;
-    pa_bool_t record = TRUE, playback = TRUE, use_mmap = TRUE;
+    pa_bool_t record = TRUE, playback = TRUE, use_mmap = TRUE, use_tsched = FALSE, have_ospace = FALSE;
     pa_sample_spec ss;
     pa_channel_map map;
     pa_modargs *ma = NULL;
@@ -1215,6 +1359,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "tsched", &use_tsched) < 0) {
+        pa_log("Failed to parse tsched argument.");
+        goto fail;
+    }
+
     if ((fd = pa_oss_open(dev = pa_modargs_get_value(ma, "device", DEFAULT_DEVICE), &mode, &caps)) < 0)
         goto fail;
 
@@ -1282,6 +1431,7 @@ int pa__init(pa_module*m) {
         u->out_fragment_size = (uint32_t) info.fragsize;
         u->out_nfrags = (uint32_t) info.fragstotal;
         u->use_getospace = TRUE;
+        have_ospace = TRUE;
     }
 
     u->in_hwbuf_size = u->in_nfrags * u->in_fragment_size;
@@ -1394,7 +1544,12 @@ int pa__init(pa_module*m) {
             goto fail;
         }
 
-        u->sink = pa_sink_new(m->core, &sink_new_data, PA_SINK_HARDWARE|PA_SINK_LATENCY);
+        /* Timer-based scheduling needs to know the fill level of the
+         * buffer and would get in the way of recording on the same
+         * device, hence use it for write() based playback only */
+        use_tsched = use_tsched && !use_mmap && have_ospace && mode == O_WRONLY;
+
+        u->sink = pa_sink_new(m->core, &sink_new_data, PA_SINK_HARDWARE|PA_SINK_LATENCY|(use_tsched ? PA_SINK_DYNAMIC_LATENCY : 0));
         pa_sink_new_data_done(&sink_new_data);
         pa_xfree(name_buf);
 
@@ -1408,9 +1563,20 @@ int pa__init(pa_module*m) {
 
         pa_sink_set_asyncmsgq(u->sink, u->thread_mq.inq);
         pa_sink_set_rtpoll(u->sink, u->rtpoll);
-        pa_sink_set_fixed_latency(u->sink, pa_bytes_to_usec(u->out_hwbuf_size, &u->sink->sample_spec));
         u->sink->refresh_volume = TRUE;
 
+        if (use_tsched) {
+            u->tsched = pa_tsched_new(u->sink, u->out_hwbuf_size, pa_usec_to_bytes(PA_TSCHED_DEFAULT_WATERMARK_USEC, &u->sink->sample_spec), TRUE);
+            u->first = TRUE;
+
+            u->sink->update_requested_latency = sink_update_requested_latency_cb;
+            pa_sink_set_latency_range(u->sink, 0, pa_bytes_to_usec(u->out_hwbuf_size, &u->sink->sample_spec));
+
+            pa_log_info("Using timer-based scheduling, watermark is %0.2fms.",
+                        (double) pa_bytes_to_usec(pa_tsched_get_watermark(u->tsched), &u->sink->sample_spec) / PA_USEC_PER_MSEC);
+        } else
+            pa_sink_set_fixed_latency(u->sink, pa_bytes_to_usec(u->out_hwbuf_size, &u->sink->sample_spec));
+
         pa_sink_set_max_request(u->sink, u->out_hwbuf_size);
 
         if (use_mmap)
@@ -1537,6 +1703,9 @@ void pa__done(pa_module*m) {
     if (u->rtpoll_item)
         pa_rtpoll_item_free(u->rtpoll_item);
 
+    if (u->tsched)
+        pa_tsched_free(u->tsched);
+
     if (u->rtpoll)
         pa_rtpoll_free(u->rtpoll);
 
@@ -0,0 +1,235 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "jitter.h"
+
+struct slot {
+    pa_bool_t used;
+    pa_rtp_packet packet;
+};
+
+struct pa_rtp_jitter {
+    uint32_t rate;
+
+    /* Indexed by sequence number, holds the packets from next on */
+    struct slot slots[PA_RTP_JITTER_MAX_PACKETS];
+    unsigned n;
+
+    pa_bool_t started;
+    uint16_t next;              /* the one we hand out next */
+    uint16_t highest;           /* the latest one we got */
+
+    /* For the jitter estimate, in units of the RTP clock */
+    pa_bool_t have_last;
+    int64_t last_arrival;
+    uint32_t last_timestamp;
+    double jitter;
+
+    pa_atomic_t received, lost, reordered, duplicates, late, jitter_usec;
+};
+
+static struct slot* get_slot(pa_rtp_jitter *j, uint16_t sequence) {
+    return j->slots + (sequence % PA_RTP_JITTER_MAX_PACKETS);
+}
+
+pa_rtp_jitter* pa_rtp_jitter_new(uint32_t rate) {
+    pa_rtp_jitter *j;
+
+    pa_assert(rate > 0);
+
+    j = pa_xnew0(pa_rtp_jitter, 1);
+    j->rate = rate;
+
+    pa_atomic_store(&j->received, 0);
+    pa_atomic_store(&j->lost, 0);
+    pa_atomic_store(&j->reordered, 0);
+    pa_atomic_store(&j->duplicates, 0);
+    pa_atomic_store(&j->late, 0);
+    pa_atomic_store(&j->jitter_usec, 0);
+
+    return j;
+}
+
+void pa_rtp_jitter_free(pa_rtp_jitter *j) {
+    pa_assert(j);
+
+    pa_rtp_jitter_reset(j);
+    pa_xfree(j);
+}
+
+void pa_rtp_jitter_reset(pa_rtp_jitter *j) {
+    unsigned i;
+
+    pa_assert(j);
+
+    for (i = 0; i < PA_RTP_JITTER_MAX_PACKETS; i++)
+        if (j->slots[i].used) {
+            pa_memblock_unref(j->slots[i].packet.chunk.memblock);
+            j->slots[i].used = FALSE;
+        }
+
+    j->n = 0;
+    j->started = FALSE;
+    j->have_last = FALSE;
+}
+
+static void update_jitter(pa_rtp_jitter *j, uint32_t timestamp, pa_usec_t arrival) {
+    int64_t a, d;
+
+    /* RFC 3550, 6.4.1: the difference of the transit times of two
+     * packets, smoothed */
+    a = (int64_t) (arrival * j->rate / PA_USEC_PER_SEC);
+
+    if (j->have_last) {
+        d = (a - j->last_arrival) - (int64_t) (int32_t) (timestamp - j->last_timestamp);
+        j->jitter += ((double) (d < 0 ? -d : d) - j->jitter) / 16.0;
+
+        pa_atomic_store(&j->jitter_usec, (int) (j->jitter * PA_USEC_PER_SEC / j->rate));
+    }
+
+    j->have_last = TRUE;
+    j->last_arrival = a;
+    j->last_timestamp = timestamp;
+}
+
+pa_bool_t pa_rtp_jitter_put(pa_rtp_jitter *j, pa_rtp_packet *p, pa_usec_t arrival) {
+    struct slot *s;
+    int d;
+
+    pa_assert(j);
+    pa_assert(p);
+    pa_assert(p->chunk.memblock);
+
+    update_jitter(j, p->timestamp, arrival);
+
+    if (!j->started) {
+        j->started = TRUE;
+        j->next = j->highest = p->sequence;
+    }
+
+    d = (int16_t) (p->sequence - j->next);
+
+    if (d >= PA_RTP_JITTER_MAX_PACKETS || d < -PA_RTP_JITTER_MAX_PACKETS) {
+
+        /* Way off, the sender probably started over. We can't wait
+         * for the packets in between anyway. */
+        pa_log_debug("RTP sequence number jumped by %i, resynchronizing.", d);
+
+        if (d > 0)
+            pa_atomic_add(&j->lost, d);
+
+        pa_rtp_jitter_reset(j);
+        j->started = TRUE;
+        j->have_last = TRUE;
+        j->next = j->highest = p->sequence;
+
+    } else if (d < 0) {
+        pa_atomic_inc(&j->late);
+        pa_memblock_unref(p->chunk.memblock);
+        return FALSE;
+    }
+
+    s = get_slot(j, p->sequence);
+
+    /* Everything in the slots is from [next, next + MAX) */
+    if (s->used) {
+        pa_atomic_inc(&j->duplicates);
+        pa_memblock_unref(p->chunk.memblock);
+        return FALSE;
+    }
+
+    if ((int16_t) (p->sequence - j->highest) < 0)
+        pa_atomic_inc(&j->reordered);
+    else
+        j->highest = p->sequence;
+
+    s->packet = *p;
+    s->used = TRUE;
+    j->n++;
+
+    pa_atomic_inc(&j->received);
+
+    return TRUE;
+}
+
+pa_bool_t pa_rtp_jitter_get(pa_rtp_jitter *j, pa_rtp_packet *p, pa_bool_t force, unsigned *lost) {
+    struct slot *s;
+
+    pa_assert(j);
+    pa_assert(p);
+    pa_assert(lost);
+
+    *lost = 0;
+
+    if (j->n <= 0)
+        return FALSE;
+
+    s = get_slot(j, j->next);
+
+    if (!s->used) {
+        unsigned k;
+
+        if (!force)
+            return FALSE;
+
+        /* We have at least one packet, so this terminates */
+        for (k = 1; !(s = get_slot(j, (uint16_t) (j->next + k)))->used; k++)
+            ;
+
+        j->next = (uint16_t) (j->next + k);
+        pa_atomic_add(&j->lost, (int) k);
+        *lost = k;
+    }
+
+    *p = s->packet;
+    s->used = FALSE;
+    j->n--;
+    j->next++;
+
+    return TRUE;
+}
+
+unsigned pa_rtp_jitter_get_n(pa_rtp_jitter *j) {
+    pa_assert(j);
+
+    return j->n;
+}
+
+void pa_rtp_jitter_get_stats(pa_rtp_jitter *j, pa_rtp_jitter_stats *stats) {
+    pa_assert(j);
+    pa_assert(stats);
+
+    stats->received = (unsigned) pa_atomic_load(&j->received);
+    stats->lost = (unsigned) pa_atomic_load(&j->lost);
+    stats->reordered = (unsigned) pa_atomic_load(&j->reordered);
+    stats->duplicates = (unsigned) pa_atomic_load(&j->duplicates);
+    stats->late = (unsigned) pa_atomic_load(&j->late);
+    stats->jitter = (pa_usec_t) pa_atomic_load(&j->jitter_usec);
+}
@@ -0,0 +1,75 @@
+#ifndef foortpjitterhfoo
+#define foortpjitterhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+
+#include <pulsecore/macro.h>
+
+#include "rtp.h"
+
+/* A jitter buffer for the packets of one RTP session. Packets are
+ * handed out in the order of their sequence numbers. If one is
+ * missing, the buffer waits for it until it is told that it may not
+ * wait any longer, and then reports how many packets were lost.
+ *
+ * Only the thread receiving the packets may use it, except for
+ * pa_rtp_jitter_get_stats() which may be called from anywhere. */
+
+#define PA_RTP_JITTER_MAX_PACKETS 128
+
+typedef struct pa_rtp_jitter pa_rtp_jitter;
+
+typedef struct pa_rtp_jitter_stats {
+    unsigned received;
+    unsigned lost;
+    unsigned reordered;     /* arrived after a later packet */
+    unsigned duplicates;
+    unsigned late;          /* arrived after we gave up on them */
+    pa_usec_t jitter;       /* interarrival jitter, as in RFC 3550 */
+} pa_rtp_jitter_stats;
+
+/* rate is the RTP clock rate */
+pa_rtp_jitter* pa_rtp_jitter_new(uint32_t rate);
+void pa_rtp_jitter_free(pa_rtp_jitter *j);
+
+/* Takes over the reference to the payload of p. arrival is the local
+ * time the packet was received. Returns FALSE if the packet was
+ * dropped because it is a duplicate or too late. */
+pa_bool_t pa_rtp_jitter_put(pa_rtp_jitter *j, pa_rtp_packet *p, pa_usec_t arrival);
+
+/* Returns the next packet in sequence, passing the reference to the
+ * payload to the caller. If it hasn't arrived yet but later ones
+ * have, and force is TRUE, we skip to the earliest of these and
+ * return the number of packets in between in *lost. */
+pa_bool_t pa_rtp_jitter_get(pa_rtp_jitter *j, pa_rtp_packet *p, pa_bool_t force, unsigned *lost);
+
+/* Number of packets waiting */
+unsigned pa_rtp_jitter_get_n(pa_rtp_jitter *j);
+
+/* Drops all packets and starts over with the next one put */
+void pa_rtp_jitter_reset(pa_rtp_jitter *j);
+
+void pa_rtp_jitter_get_stats(pa_rtp_jitter *j, pa_rtp_jitter_stats *stats);
+
+#endif
@@ -53,6 +53,7 @@
 #include <pulsecore/atomic.h>
 #include <pulsecore/atomic.h>
 #include <pulsecore/time-smoother.h>
+#include <pulsecore/drift.h>
 #include <pulsecore/socket-util.h>
 #include <pulsecore/once.h>
 
@@ -61,6 +62,7 @@
 #include "rtp.h"
 #include "sdp.h"
 #include "sap.h"
+#include "jitter.h"
 
 PA_MODULE_AUTHOR("Lennart Poettering");
 PA_MODULE_DESCRIPTION("Receive data from a network via RTP/SAP/SDP");
@@ -78,6 +80,11 @@ PA_MODULE_USAGE(
 #define DEATH_TIMEOUT 20
 #define RATE_UPDATE_INTERVAL (5*PA_USEC_PER_SEC)
 #define LATENCY_USEC (500*PA_USEC_PER_MSEC)
+#define STATS_INTERVAL (5*PA_USEC_PER_SEC)
+
+/* Don't wait for a missing packet while more than this many later
+ * ones are waiting */
+#define JITTER_MAX_HELD 32
 
 static const char* const valid_modargs[] = {
     "sink",
@@ -94,7 +101,18 @@ struct session {
 
     pa_bool_t first_packet;
     uint32_t ssrc;
-    uint32_t offset;
+    uint32_t offset;            /* the timestamp we expect next */
+
+    /* The RTP timestamps, unwrapped, for the smoother */
+    uint32_t last_timestamp;
+    int64_t position;
+
+    pa_rtp_jitter *jitter;
+    pa_memchunk last_payload;   /* for concealing losses */
+    pa_atomic_t concealed;      /* frames */
+
+    /* What we last put into the proplist, main context only */
+    pa_rtp_jitter_stats stats;
 
     struct pa_sdp_info sdp_info;
 
@@ -108,6 +126,7 @@ struct session {
     pa_usec_t intended_latency;
     pa_usec_t sink_latency;
 
+    pa_drift *drift;
     pa_usec_t last_rate_update;
 };
 
@@ -119,6 +138,7 @@ struct userdata {
     pa_io_event* sap_event;
 
     pa_time_event *check_death_event;
+    pa_time_event *stats_event;
 
     char *sink_name;
 
@@ -145,12 +165,79 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *data, int64_t
     return pa_sink_input_process_msg(o, code, data, offset, chunk);
 }
 
+/* Called from I/O thread context */
+static size_t conceal(struct session *s, size_t nbytes) {
+    pa_memchunk c;
+
+    /* Packet loss concealment: we play the last packet once more,
+     * which is a lot less noticeable than a drop out for short
+     * gaps. Whatever is left of longer ones stays silent. */
+
+    if (!s->last_payload.memblock)
+        return 0;
+
+    c = s->last_payload;
+    c.length = PA_MIN(c.length, nbytes);
+
+    if (pa_memblockq_push(s->memblockq, &c) < 0)
+        return 0;
+
+    pa_atomic_add(&s->concealed, (int) (c.length / s->rtp_context.frame_size));
+
+    return c.length;
+}
+
+/* Called from I/O thread context */
+static void write_packet(struct session *s, pa_rtp_packet *p, unsigned lost) {
+    int64_t delta;
+
+    /* Where the packet goes is decided by its timestamp, not by when
+     * it arrived */
+    delta = (int64_t) (int32_t) (p->timestamp - s->offset) * (int64_t) s->rtp_context.frame_size;
+
+    if (lost > 0 && delta > 0)
+        delta -= (int64_t) conceal(s, (size_t) delta);
+
+    pa_memblockq_seek(s->memblockq, delta, PA_SEEK_RELATIVE, TRUE);
+
+    if (pa_memblockq_push(s->memblockq, &p->chunk) < 0) {
+        pa_log_warn("Queue overrun");
+        pa_memblockq_seek(s->memblockq, (int64_t) p->chunk.length, PA_SEEK_RELATIVE, TRUE);
+    }
+
+    /* The next timestamp we expect */
+    s->offset = p->timestamp + (uint32_t) (p->chunk.length / s->rtp_context.frame_size);
+
+    if (s->last_payload.memblock)
+        pa_memblock_unref(s->last_payload.memblock);
+
+    s->last_payload = p->chunk;
+}
+
+/* Called from I/O thread context */
+static void release_packets(struct session *s, size_t need) {
+    pa_rtp_packet p;
+    unsigned lost;
+
+    /* We wait for a missing packet as long as the queue has enough in
+     * front of the gap to keep playing */
+    while (pa_rtp_jitter_get(s->jitter, &p,
+                             pa_memblockq_get_length(s->memblockq) < need ||
+                             pa_rtp_jitter_get_n(s->jitter) >= JITTER_MAX_HELD,
+                             &lost))
+        write_packet(s, &p, lost);
+}
+
 /* Called from I/O thread context */
 static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk) {
     struct session *s;
     pa_sink_input_assert_ref(i);
     pa_assert_se(s = i->userdata);
 
+    /* If playback is about to reach a gap, it's too late to wait for
+     * the packet any longer */
+    release_packets(s, pa_memblockq_prebuf_active(s->memblockq) ? 0 : length);
+
     if (pa_memblockq_peek(s->memblockq, chunk) < 0)
         return -1;
 
@@ -196,18 +283,45 @@ static void sink_input_suspend_within_thread(pa_sink_input* i, pa_bool_t b) {
 
     if (b) {
         pa_smoother_pause(s->smoother, pa_rtclock_now());
+        pa_rtp_jitter_reset(s->jitter);
         pa_memblockq_flush_read(s->memblockq);
     } else
         s->first_packet = FALSE;
 }
 
+/* Called from I/O thread context */
+static pa_bool_t accept_packet(struct session *s, pa_rtp_packet *p) {
+
+    if (s->sdp_info.payload != p->payload ||
+        !PA_SINK_IS_OPENED(s->sink_input->sink->thread_info.state))
+        return FALSE;
+
+    if (!s->first_packet) {
+        s->first_packet = TRUE;
+
+        s->ssrc = p->ssrc;
+        s->offset = s->last_timestamp = p->timestamp;
+        s->position = pa_memblockq_get_write_index(s->memblockq) / (int64_t) s->rtp_context.frame_size;
+
+        pa_rtp_jitter_reset(s->jitter);
+
+        if (s->ssrc == s->userdata->module->core->cookie)
+            pa_log_warn("Detected RTP packet loop!");
+
+    } else if (s->ssrc != p->ssrc)
+        return FALSE;
+
+    return TRUE;
+}
+
 /* Called from I/O thread context */
 static int rtpoll_work_cb(pa_rtpoll_item *i) {
-    pa_memchunk chunk;
-    int64_t k, j, delta;
+    pa_rtp_packet packets[PA_RTP_MAX_BATCH];
     struct timeval now = { 0, 0 };
     struct session *s;
     struct pollfd *p;
+    int k, n;
+    pa_bool_t got = FALSE;
 
     pa_assert_se(s = pa_rtpoll_item_get_userdata(i));
 
@@ -223,79 +337,64 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
 
     p->revents = 0;
 
-    if (pa_rtp_recv(&s->rtp_context, &chunk, s->userdata->module->core->mempool, &now) < 0)
-        return 0;
-
-    if (s->sdp_info.payload != s->rtp_context.payload ||
-        !PA_SINK_IS_OPENED(s->sink_input->sink->thread_info.state)) {
-        pa_memblock_unref(chunk.memblock);
+    /* Take everything that is queued up in one go */
+    if ((n = pa_rtp_recv_many(&s->rtp_context, packets, PA_RTP_MAX_BATCH, s->userdata->module->core->mempool)) <= 0)
         return 0;
-    }
-
-    if (!s->first_packet) {
-        s->first_packet = TRUE;
 
-        s->ssrc = s->rtp_context.ssrc;
-        s->offset = s->rtp_context.timestamp;
+    for (k = 0; k < n; k++) {
+        pa_rtp_packet *pk = packets + k;
+        int32_t d;
 
-        if (s->ssrc == s->userdata->module->core->cookie)
-            pa_log_warn("Detected RTP packet loop!");
-    } else {
-        if (s->ssrc != s->rtp_context.ssrc) {
-            pa_memblock_unref(chunk.memblock);
-            return 0;
+        if (!accept_packet(s, pk)) {
+            pa_memblock_unref(pk->chunk.memblock);
+            continue;
         }
-    }
 
-    /* Check whether there was a timestamp overflow */
-    k = (int64_t) s->rtp_context.timestamp - (int64_t) s->offset;
-    j = (int64_t) 0x100000000LL - (int64_t) s->offset + (int64_t) s->rtp_context.timestamp;
+        now = pk->tstamp;
 
-    if ((k < 0 ? -k : k) < (j < 0 ? -j : j))
-        delta = k;
-    else
-        delta = j;
+        if (now.tv_sec == 0) {
+            PA_ONCE_BEGIN {
+                pa_log_warn("Using artificial time instead of timestamp");
+            } PA_ONCE_END;
+            pa_rtclock_get(&now);
+        } else
+            pa_rtclock_from_wallclock(&now);
 
-    pa_memblockq_seek(s->memblockq, delta * (int64_t) s->rtp_context.frame_size, PA_SEEK_RELATIVE, TRUE);
+        /* The smoother maps our clock to the clock of the sender, as
+         * given by the RTP timestamps. Packets that come out of order
+         * don't tell us anything new. */
+        d = (int32_t) (pk->timestamp - s->last_timestamp);
 
-    if (now.tv_sec == 0) {
-        PA_ONCE_BEGIN {
-            pa_log_warn("Using artificial time instead of timestamp");
-        } PA_ONCE_END;
-        pa_rtclock_get(&now);
-    } else
-        pa_rtclock_from_wallclock(&now);
+        if (d >= 0) {
+            s->position += d;
+            s->last_timestamp = pk->timestamp;
 
-    pa_smoother_put(s->smoother, pa_timeval_load(&now), pa_bytes_to_usec((uint64_t) pa_memblockq_get_write_index(s->memblockq), &s->sink_input->sample_spec));
+            pa_smoother_put(s->smoother, pa_timeval_load(&now), pa_bytes_to_usec((uint64_t) (s->position * (int64_t) s->rtp_context.frame_size), &s->sink_input->sample_spec));
 
-    /* Tell the smoother that we are rolling now, in case it is still paused */
-    pa_smoother_resume(s->smoother, pa_timeval_load(&now), TRUE);
+            /* Tell the smoother that we are rolling now, in case it is still paused */
+            pa_smoother_resume(s->smoother, pa_timeval_load(&now), TRUE);
+        }
 
-    if (pa_memblockq_push(s->memblockq, &chunk) < 0) {
-        pa_log_warn("Queue overrun");
-        pa_memblockq_seek(s->memblockq, (int64_t) chunk.length, PA_SEEK_RELATIVE, TRUE);
+        pa_rtp_jitter_put(s->jitter, pk, pa_timeval_load(&now));
+        got = TRUE;
     }
 
-/*     pa_log("blocks in q: %u", pa_memblockq_get_nblocks(s->memblockq)); */
+    if (!got)
+        return 0;
 
-    pa_memblock_unref(chunk.memblock);
+    release_packets(s, 0);
 
-    /* The next timestamp we expect */
-    s->offset = s->rtp_context.timestamp + (uint32_t) (chunk.length / s->rtp_context.frame_size);
+/*     pa_log("blocks in q: %u", pa_memblockq_get_nblocks(s->memblockq)); */
 
     pa_atomic_store(&s->timestamp, (int) now.tv_sec);
 
-    if (s->last_rate_update + RATE_UPDATE_INTERVAL < pa_timeval_load(&now)) {
-        pa_usec_t wi, ri, render_delay, sink_delay = 0, latency, fix;
-        unsigned fix_samples;
-
-        pa_log_debug("Updating sample rate");
+    if (s->sink_input->thread_info.resampler) {
+        pa_usec_t wi, ri, render_delay, sink_delay = 0, latency;
+        double rate;
 
         wi = pa_smoother_get(s->smoother, pa_timeval_load(&now));
         ri = pa_bytes_to_usec((uint64_t) pa_memblockq_get_read_index(s->memblockq), &s->sink_input->sample_spec);
 
-        pa_log_debug("wi=%lu ri=%lu", (unsigned long) wi, (unsigned long) ri);
-
         sink_delay = pa_sink_get_latency_within_thread(s->sink_input->sink);
         render_delay = pa_bytes_to_usec(pa_memblockq_get_length(s->sink_input->thread_info.render_memblockq), &s->sink_input->sink->sample_spec);
 
@@ -309,38 +408,18 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
         else
             latency = wi - ri;
 
-        pa_log_debug("Write index deviates by %0.2f ms, expected %0.2f ms", (double) latency/PA_USEC_PER_MSEC, (double)  s->intended_latency/PA_USEC_PER_MSEC);
-
-        /* Calculate deviation */
-        if (latency < s->intended_latency)
-            fix = s->intended_latency - latency;
-        else
-            fix = latency - s->intended_latency;
-
-        /* How many samples is this per second? */
-        fix_samples = (unsigned) (fix * (pa_usec_t) s->sink_input->thread_info.sample_spec.rate / (pa_usec_t) RATE_UPDATE_INTERVAL);
-
-        /* Check if deviation is in bounds */
-        if (fix_samples > s->sink_input->sample_spec.rate*.50)
-            pa_log_debug("Hmmm, rate fix is too large (%lu Hz), not applying.", (unsigned long) fix_samples);
-        else {
-            /* Fix up rate */
-            if (latency < s->intended_latency)
-                s->sink_input->sample_spec.rate -= fix_samples;
-            else
-                s->sink_input->sample_spec.rate += fix_samples;
-
-            if (s->sink_input->sample_spec.rate > PA_RATE_MAX)
-                s->sink_input->sample_spec.rate = PA_RATE_MAX;
-        }
-
-        pa_assert(pa_sample_spec_valid(&s->sink_input->sample_spec));
-
-        pa_resampler_set_input_rate(s->sink_input->thread_info.resampler, s->sink_input->sample_spec.rate);
+        /* The rate is corrected a little on every batch, so that it
+         * doesn't jump by the whole deviation every few seconds */
+        rate = pa_drift_update(s->drift, pa_timeval_load(&now), latency);
+        pa_resampler_set_rate_ratio(s->sink_input->thread_info.resampler, rate / s->sink_input->sample_spec.rate);
 
-        pa_log_debug("Updated sampling rate to %lu Hz.", (unsigned long) s->sink_input->sample_spec.rate);
+        if (s->last_rate_update + RATE_UPDATE_INTERVAL < pa_timeval_load(&now)) {
+            pa_log_debug("wi=%lu ri=%lu", (unsigned long) wi, (unsigned long) ri);
+            pa_log_debug("Write index deviates by %0.2f ms, expected %0.2f ms", (double) latency/PA_USEC_PER_MSEC, (double)  s->intended_latency/PA_USEC_PER_MSEC);
+            pa_log_debug("Sampling rate is %0.3f Hz.", rate);
 
-        s->last_rate_update = pa_timeval_load(&now);
+            s->last_rate_update = pa_timeval_load(&now);
+        }
     }
 
     if (pa_memblockq_is_readable(s->memblockq) &&
@@ -370,6 +449,7 @@ static void sink_input_attach(pa_sink_input *i) {
 
     pa_rtpoll_item_set_work_callback(s->rtpoll_item, rtpoll_work_cb);
     pa_rtpoll_item_set_userdata(s->rtpoll_item, s);
+    pa_drift_reset(s->drift);
 }
 
 /* Called from I/O thread context */
@@ -396,6 +476,7 @@ static int mcast_socket(const struct sockaddr* sa, socklen_t salen) {
     }
 
     pa_make_udp_socket_low_delay(fd);
+    pa_make_fd_nonblock(fd);
 
     one = 1;
     if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one)) < 0) {
@@ -529,6 +610,9 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
     if (s->intended_latency < s->sink_latency*2)
         s->intended_latency = s->sink_latency*2;
 
+    s->drift = pa_drift_new(s->sdp_info.sample_spec.rate, RATE_UPDATE_INTERVAL);
+    pa_drift_set_target(s->drift, s->intended_latency);
+
     s->memblockq = pa_memblockq_new(
             0,
             MEMBLOCKQ_MAXLENGTH,
@@ -543,6 +627,10 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
 
     pa_rtp_context_init_recv(&s->rtp_context, fd, pa_frame_size(&s->sdp_info.sample_spec));
 
+    s->jitter = pa_rtp_jitter_new(s->sdp_info.sample_spec.rate);
+    pa_memchunk_reset(&s->last_payload);
+    pa_atomic_store(&s->concealed, 0);
+
     pa_hashmap_put(s->userdata->by_origin, s->sdp_info.origin, s);
     u->n_sessions++;
     PA_LLIST_PREPEND(struct session, s->userdata->sessions, s);
@@ -576,11 +664,18 @@ static void session_free(struct session *s) {
     pa_hashmap_remove(s->userdata->by_origin, s->sdp_info.origin);
 
     pa_memblockq_free(s->memblockq);
+    pa_rtp_jitter_free(s->jitter);
+
+    if (s->last_payload.memblock)
+        pa_memblock_unref(s->last_payload.memblock);
+
     pa_sdp_info_destroy(&s->sdp_info);
     pa_rtp_context_destroy(&s->rtp_context);
 
     pa_smoother_free(s->smoother);
 
+    pa_drift_free(s->drift);
+
     pa_xfree(s);
 }
 
@@ -651,6 +746,43 @@ static void check_death_event_cb(pa_mainloop_api *m, pa_time_event *t, const str
     pa_core_rttime_restart(u->module->core, t, pa_rtclock_now() + DEATH_TIMEOUT * PA_USEC_PER_SEC);
 }
 
+static void stats_event_cb(pa_mainloop_api *m, pa_time_event *t, const struct timeval *tv, void *userdata) {
+    struct userdata *u = userdata;
+    struct session *s;
+
+    pa_assert(m);
+    pa_assert(t);
+    pa_assert(u);
+
+    /* The counters are kept in the IO thread, we just publish them */
+    for (s = u->sessions; s; s = s->next) {
+        pa_rtp_jitter_stats stats;
+        pa_proplist *pl;
+
+        pa_rtp_jitter_get_stats(s->jitter, &stats);
+
+        if (memcmp(&stats, &s->stats, sizeof(stats)) == 0)
+            continue;
+
+        s->stats = stats;
+
+        pl = pa_proplist_new();
+        pa_proplist_setf(pl, "rtp.packets_received", "%u", stats.received);
+        pa_proplist_setf(pl, "rtp.packets_lost", "%u", stats.lost);
+        pa_proplist_setf(pl, "rtp.packets_reordered", "%u", stats.reordered);
+        pa_proplist_setf(pl, "rtp.packets_duplicate", "%u", stats.duplicates);
+        pa_proplist_setf(pl, "rtp.packets_late", "%u", stats.late);
+        pa_proplist_setf(pl, "rtp.concealed_usec", "%llu",
+                         (unsigned long long) pa_bytes_to_usec((uint64_t) pa_atomic_load(&s->concealed) * s->rtp_context.frame_size, &s->sdp_info.sample_spec));
+        pa_proplist_setf(pl, "rtp.jitter_usec", "%llu", (unsigned long long) stats.jitter);
+
+        pa_sink_input_update_proplist(s->sink_input, PA_UPDATE_REPLACE, pl);
+        pa_proplist_free(pl);
+    }
+
+    pa_core_rttime_restart(u->module->core, t, pa_rtclock_now() + STATS_INTERVAL);
+}
+
 int pa__init(pa_module*m) {
     struct userdata *u;
     pa_modargs *ma = NULL;
@@ -705,6 +837,7 @@ int pa__init(pa_module*m) {
     u->by_origin = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
 
     u->check_death_event = pa_core_rttime_new(m->core, pa_rtclock_now() + DEATH_TIMEOUT * PA_USEC_PER_SEC, check_death_event_cb, u);
+    u->stats_event = pa_core_rttime_new(m->core, pa_rtclock_now() + STATS_INTERVAL, stats_event_cb, u);
 
     pa_modargs_free(ma);
 
@@ -735,6 +868,9 @@ void pa__done(pa_module*m) {
     if (u->check_death_event)
         m->core->mainloop->time_free(u->check_death_event);
 
+    if (u->stats_event)
+        m->core->mainloop->time_free(u->stats_event);
+
     pa_sap_context_destroy(&u->sap_context);
 
     if (u->by_origin) {
@@ -49,6 +49,10 @@
 #include <pulsecore/sample-util.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/socket-util.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/atomic.h>
 
 #include "module-rtp-send-symdef.h"
 
@@ -68,6 +72,7 @@ PA_MODULE_USAGE(
         "destination=<destination IP address> "
         "port=<port number> "
         "mtu=<maximum transfer unit> "
+        "ptime=<packet time in ms> "
         "loop=<loopback to local host?> "
         "ttl=<ttl value>"
 );
@@ -79,6 +84,9 @@ PA_MODULE_USAGE(
 #define MEMBLOCKQ_MAXLENGTH (1024*170)
 #define DEFAULT_MTU 1280
 #define SAP_INTERVAL (5*PA_USEC_PER_SEC)
+#define MAX_PTIME 100
+#define RTP_HEADER_SIZE 12
+#define MAX_DATAGRAM_SIZE 65507 /* The largest UDP payload over IPv4 */
 
 static const char* const valid_modargs[] = {
     "source",
@@ -88,6 +96,7 @@ static const char* const valid_modargs[] = {
     "destination",
     "port",
     "mtu" ,
+    "ptime",
     "loop",
     "ttl",
     NULL
@@ -97,15 +106,29 @@ struct userdata {
     pa_module *module;
 
     pa_source_output *source_output;
+
+    /* The packets are built and sent in a thread of our own, so that
+     * the source's thread doesn't have to wait for the network */
+    pa_thread *thread;
+    pa_thread_mq thread_mq;
+    pa_rtpoll *rtpoll;
+
     pa_memblockq *memblockq;
 
+    /* Bytes posted to our thread that haven't been sent yet */
+    pa_atomic_t queued;
+
     pa_rtp_context rtp_context;
     pa_sap_context sap_context;
-    size_t mtu;
+    size_t packet_size;
 
     pa_time_event *sap_event;
 };
 
+enum {
+    SOURCE_OUTPUT_MESSAGE_POST = PA_SOURCE_OUTPUT_MESSAGE_MAX
+};
+
 /* Called from I/O thread context */
 static int source_output_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
     struct userdata *u;
@@ -113,11 +136,28 @@ static int source_output_process_msg(pa_msgobject *o, int code, void *data, int6
 
     switch (code) {
         case PA_SOURCE_OUTPUT_MESSAGE_GET_LATENCY:
-            *((pa_usec_t*) data) = pa_bytes_to_usec(pa_memblockq_get_length(u->memblockq), &u->source_output->sample_spec);
+            *((pa_usec_t*) data) = pa_bytes_to_usec((uint64_t) pa_atomic_load(&u->queued), &u->source_output->sample_spec);
 
             /* Fall through, the default handler will add in the extra
              * latency added by the resampler */
             break;
+
+        case SOURCE_OUTPUT_MESSAGE_POST: {
+            size_t length;
+
+            /* This one is processed in our own thread */
+            if (pa_memblockq_push(u->memblockq, chunk) < 0) {
+                pa_log_warn("Failed to push chunk into memblockq.");
+                pa_atomic_sub(&u->queued, (int) chunk->length);
+                return 0;
+            }
+
+            length = pa_memblockq_get_length(u->memblockq);
+            pa_rtp_send(&u->rtp_context, u->packet_size, u->memblockq);
+            pa_atomic_sub(&u->queued, (int) (length - pa_memblockq_get_length(u->memblockq)));
+
+            return 0;
+        }
     }
 
     return pa_source_output_process_msg(o, code, data, offset, chunk);
@@ -129,12 +169,40 @@ static void source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
     pa_source_output_assert_ref(o);
     pa_assert_se(u = o->userdata);
 
-    if (pa_memblockq_push(u->memblockq, chunk) < 0) {
-        pa_log_warn("Failed to push chunk into memblockq.");
-        return;
+    pa_atomic_add(&u->queued, (int) chunk->length);
+    pa_asyncmsgq_post(u->thread_mq.inq, PA_MSGOBJECT(o), SOURCE_OUTPUT_MESSAGE_POST, NULL, 0, chunk, NULL);
+}
+
+static void thread_func(void *userdata) {
+    struct userdata *u = userdata;
+
+    pa_assert(u);
+
+    pa_log_debug("Thread starting up");
+
+    if (u->module->core->realtime_scheduling)
+        pa_make_realtime(u->module->core->realtime_priority+1);
+
+    pa_thread_mq_install(&u->thread_mq);
+
+    for (;;) {
+        int ret;
+
+        if ((ret = pa_rtpoll_run(u->rtpoll, TRUE)) < 0)
+            goto fail;
+
+        if (ret == 0)
+            goto finish;
     }
 
-    pa_rtp_send(&u->rtp_context, u->mtu, u->memblockq);
+fail:
+    /* If this was no regular exit from the loop we have to continue
+     * processing messages until we received PA_MESSAGE_SHUTDOWN */
+    pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->module->core), PA_CORE_MESSAGE_UNLOAD_MODULE, u->module, 0, NULL, NULL);
+    pa_asyncmsgq_wait_for(u->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
+
+finish:
+    pa_log_debug("Thread shutting down");
 }
 
 /* Called from main context */
@@ -163,10 +231,11 @@ static void sap_event_cb(pa_mainloop_api *m, pa_time_event *t, const struct time
 }
 
 int pa__init(pa_module*m) {
-    struct userdata *u;
+    struct userdata *u = NULL;
     pa_modargs *ma = NULL;
     const char *dest;
-    uint32_t port = DEFAULT_PORT, mtu;
+    uint32_t port = DEFAULT_PORT, mtu, ptime = 0;
+    size_t packet_size;
     uint32_t ttl = DEFAULT_TTL;
     sa_family_t af;
     int fd = -1, sap_fd = -1;
@@ -229,6 +298,33 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    packet_size = mtu;
+
+    if (pa_modargs_get_value_u32(ma, "ptime", &ptime) < 0 || ptime > MAX_PTIME) {
+        pa_log("ptime= expects a packet time in ms between 1 and %u.", MAX_PTIME);
+        goto fail;
+    }
+
+    if (ptime > 0) {
+        /* The packet time takes precedence over the default MTU, but
+         * not over one that was asked for explicitly */
+        packet_size = pa_usec_to_bytes(ptime * PA_USEC_PER_MSEC, &ss);
+
+        if (packet_size <= 0 ||
+            (pa_modargs_get_value(ma, "mtu", NULL) && packet_size > mtu)) {
+            pa_log("Packet time of %u ms doesn't fit into the MTU.", ptime);
+            goto fail;
+        }
+
+        if (packet_size > mtu)
+            pa_log_warn("Packets of %u ms exceed the default MTU of %lu bytes and will be fragmented.", ptime, (unsigned long) mtu);
+    }
+
+    if (packet_size + RTP_HEADER_SIZE > MAX_DATAGRAM_SIZE) {
+        pa_log("Packets of %lu bytes don't fit into a UDP datagram.", (unsigned long) packet_size);
+        goto fail;
+    }
+
     port = DEFAULT_PORT + ((uint32_t) (rand() % 512) << 1);
     if (pa_modargs_get_value_u32(ma, "port", &port) < 0 || port < 1 || port > 0xFFFF) {
         pa_log("port= expects a numerical argument between 1 and 65535.");
@@ -323,6 +419,8 @@ int pa__init(pa_module*m) {
     pa_proplist_sets(data.proplist, PA_PROP_MEDIA_NAME, "RTP Monitor Stream");
     pa_proplist_sets(data.proplist, "rtp.destination", dest);
     pa_proplist_setf(data.proplist, "rtp.mtu", "%lu", (unsigned long) mtu);
+    if (ptime > 0)
+        pa_proplist_setf(data.proplist, "rtp.ptime", "%lu", (unsigned long) ptime);
     pa_proplist_setf(data.proplist, "rtp.port", "%lu", (unsigned long) port);
     pa_proplist_setf(data.proplist, "rtp.ttl", "%lu", (unsigned long) ttl);
     data.driver = __FILE__;
@@ -345,12 +443,16 @@ int pa__init(pa_module*m) {
     o->kill = source_output_kill;
 
     pa_log_info("Configured source latency of %llu ms.",
-                (unsigned long long) pa_source_output_set_requested_latency(o, pa_bytes_to_usec(mtu, &o->sample_spec)) / PA_USEC_PER_MSEC);
+                (unsigned long long) pa_source_output_set_requested_latency(o, pa_bytes_to_usec(packet_size, &o->sample_spec)) / PA_USEC_PER_MSEC);
 
     m->userdata = o->userdata = u = pa_xnew(struct userdata, 1);
     u->module = m;
     u->source_output = o;
 
+    u->rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll);
+    u->thread = NULL;
+
     u->memblockq = pa_memblockq_new(
             0,
             MEMBLOCKQ_MAXLENGTH,
@@ -361,7 +463,9 @@ int pa__init(pa_module*m) {
             0,
             NULL);
 
-    u->mtu = mtu;
+    pa_atomic_store(&u->queued, 0);
+
+    u->packet_size = packet_size;
 
     k = sizeof(sa_dst);
     pa_assert_se((r = getsockname(fd, (struct sockaddr*) &sa_dst, &k)) >= 0);
@@ -372,13 +476,13 @@ int pa__init(pa_module*m) {
         p = pa_sdp_build(af,
                      (void*) &((struct sockaddr_in*) &sa_dst)->sin_addr,
                      (void*) &sa4.sin_addr,
-                     n, (uint16_t) port, payload, &ss);
+                     n, (uint16_t) port, payload, &ss, ptime);
 #ifdef HAVE_IPV6
     } else {
         p = pa_sdp_build(af,
                      (void*) &((struct sockaddr_in6*) &sa_dst)->sin6_addr,
                      (void*) &sa6.sin6_addr,
-                     n, (uint16_t) port, payload, &ss);
+                     n, (uint16_t) port, payload, &ss, ptime);
 #endif
     }
 
@@ -386,14 +490,20 @@ int pa__init(pa_module*m) {
 
     pa_rtp_context_init_send(&u->rtp_context, fd, m->core->cookie, payload, pa_frame_size(&ss));
     pa_sap_context_init_send(&u->sap_context, sap_fd, p);
+    fd = sap_fd = -1;
 
-    pa_log_info("RTP stream initialized with mtu %u on %s:%u ttl=%u, SSRC=0x%08x, payload=%u, initial sequence #%u", mtu, dest, port, ttl, u->rtp_context.ssrc, payload, u->rtp_context.sequence);
+    pa_log_info("RTP stream initialized with %lu bytes per packet on %s:%u ttl=%u, SSRC=0x%08x, payload=%u, initial sequence #%u", (unsigned long) packet_size, dest, port, ttl, u->rtp_context.ssrc, payload, u->rtp_context.sequence);
     pa_log_info("SDP-Data:\n%s\nEOF", p);
 
     pa_sap_send(&u->sap_context, 0);
 
     u->sap_event = pa_core_rttime_new(m->core, pa_rtclock_now() + SAP_INTERVAL, sap_event_cb, u);
 
+    if (!(u->thread = pa_thread_new(thread_func, u))) {
+        pa_log("Failed to create thread.");
+        goto fail;
+    }
+
     pa_source_output_put(u->source_output);
 
     pa_modargs_free(ma);
@@ -410,7 +520,9 @@ fail:
     if (sap_fd >= 0)
         pa_close(sap_fd);
 
-    if (o) {
+    if (u)
+        pa__done(m);
+    else if (o) {
         pa_source_output_unlink(o);
         pa_source_output_unref(o);
     }
@@ -428,11 +540,22 @@ void pa__done(pa_module*m) {
     if (u->sap_event)
         m->core->mainloop->time_free(u->sap_event);
 
-    if (u->source_output) {
+    if (u->source_output)
         pa_source_output_unlink(u->source_output);
-        pa_source_output_unref(u->source_output);
+
+    if (u->thread) {
+        pa_asyncmsgq_send(u->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+        pa_thread_free(u->thread);
     }
 
+    pa_thread_mq_done(&u->thread_mq);
+
+    if (u->source_output)
+        pa_source_output_unref(u->source_output);
+
+    if (u->rtpoll)
+        pa_rtpoll_free(u->rtpoll);
+
     pa_rtp_context_destroy(&u->rtp_context);
 
     pa_sap_send(&u->sap_context, 1);
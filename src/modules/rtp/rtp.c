@@ -56,6 +56,7 @@ pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssr
     c->ssrc = ssrc ? ssrc : (uint32_t) (rand()*rand());
     c->payload = (uint8_t) (payload & 127U);
     c->frame_size = frame_size;
+    c->max_packet_size = 0;
 
     pa_memchunk_reset(&c->memchunk);
 
@@ -64,31 +65,94 @@ pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssr
 
 #define MAX_IOVECS 16
 
+struct send_batch {
+    uint32_t header[PA_RTP_MAX_BATCH][3];
+    struct iovec iov[PA_RTP_MAX_BATCH][MAX_IOVECS];
+    pa_memblock *mb[PA_RTP_MAX_BATCH][MAX_IOVECS];
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msg[PA_RTP_MAX_BATCH];
+#else
+    struct msghdr msg[PA_RTP_MAX_BATCH];
+#endif
+};
+
+#ifdef HAVE_SENDMMSG
+#define BATCH_MSGHDR(b, i) (&(b)->msg[i].msg_hdr)
+#else
+#define BATCH_MSGHDR(b, i) (&(b)->msg[i])
+#endif
+
+static int send_batch(pa_rtp_context *c, struct send_batch *b, unsigned n) {
+    unsigned i, j, sent = 0;
+    int ret = 0;
+
+    pa_assert(n > 0);
+
+#ifdef HAVE_SENDMMSG
+    while (sent < n) {
+        int r;
+
+        if ((r = sendmmsg(c->fd, b->msg + sent, n - sent, MSG_DONTWAIT)) < 0)
+            break;
+
+        sent += (unsigned) r;
+    }
+#else
+    for (; sent < n; sent++)
+        if (sendmsg(c->fd, b->msg + sent, MSG_DONTWAIT) < 0)
+            break;
+#endif
+
+    if (sent < n) {
+        if (errno != EAGAIN && errno != EINTR) /* If the queue is full, just ignore it */
+            pa_log("sendmsg() failed: %s", pa_cstrerror(errno));
+        ret = -1;
+    }
+
+    for (i = 0; i < n; i++)
+        for (j = 1; j < BATCH_MSGHDR(b, i)->msg_iovlen; j++) {
+            pa_memblock_release(b->mb[i][j]);
+            pa_memblock_unref(b->mb[i][j]);
+        }
+
+    return ret;
+}
+
 int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
-    struct iovec iov[MAX_IOVECS];
-    pa_memblock* mb[MAX_IOVECS];
-    int iov_idx = 1;
-    size_t n = 0;
+    struct send_batch b;
+    unsigned n_packets = 0;
+    pa_bool_t empty = FALSE;
+    int ret = 0;
 
     pa_assert(c);
     pa_assert(size > 0);
     pa_assert(q);
 
-    if (pa_memblockq_get_length(q) < size)
-        return 0;
+    /* We cut the queue into packets of size bytes each, and hand as
+     * many of them as we have to the kernel at once */
 
-    for (;;) {
-        int r;
-        pa_memchunk chunk;
+    while (!empty && pa_memblockq_get_length(q) >= size) {
+        struct iovec *iov = b.iov[n_packets];
+        pa_memblock **mb = b.mb[n_packets];
+        struct msghdr *m = BATCH_MSGHDR(&b, n_packets);
+        uint32_t *header = b.header[n_packets];
+        size_t iov_idx = 1, n = 0;
 
-        pa_memchunk_reset(&chunk);
+        while (n < size && iov_idx < MAX_IOVECS) {
+            pa_memchunk chunk;
+            size_t k;
 
-        if ((r = pa_memblockq_peek(q, &chunk)) >= 0) {
+            pa_memchunk_reset(&chunk);
 
-            size_t k = n + chunk.length > size ? size - n : chunk.length;
+            if (pa_memblockq_peek(q, &chunk) < 0) {
+                empty = TRUE;
+                break;
+            }
 
             pa_assert(chunk.memblock);
 
+            k = n + chunk.length > size ? size - n : chunk.length;
+
             iov[iov_idx].iov_base = ((uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index);
             iov[iov_idx].iov_len = k;
             mb[iov_idx] = chunk.memblock;
@@ -100,56 +164,40 @@ int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
 
         pa_assert(n % c->frame_size == 0);
 
-        if (r < 0 || n >= size || iov_idx >= MAX_IOVECS) {
-            uint32_t header[3];
-            struct msghdr m;
-            ssize_t k;
-            int i;
-
-            if (n > 0) {
-                header[0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
-                header[1] = htonl(c->timestamp);
-                header[2] = htonl(c->ssrc);
-
-                iov[0].iov_base = (void*)header;
-                iov[0].iov_len = sizeof(header);
-
-                m.msg_name = NULL;
-                m.msg_namelen = 0;
-                m.msg_iov = iov;
-                m.msg_iovlen = (size_t) iov_idx;
-                m.msg_control = NULL;
-                m.msg_controllen = 0;
-                m.msg_flags = 0;
-
-                k = sendmsg(c->fd, &m, MSG_DONTWAIT);
-
-                for (i = 1; i < iov_idx; i++) {
-                    pa_memblock_release(mb[i]);
-                    pa_memblock_unref(mb[i]);
-                }
-
-                c->sequence++;
-            } else
-                k = 0;
-
-            c->timestamp += (unsigned) (n/c->frame_size);
-
-            if (k < 0) {
-                if (errno != EAGAIN && errno != EINTR) /* If the queue is full, just ignore it */
-                    pa_log("sendmsg() failed: %s", pa_cstrerror(errno));
-                return -1;
-            }
+        if (n <= 0)
+            break;
 
-            if (r < 0 || pa_memblockq_get_length(q) < size)
-                break;
+        header[0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
+        header[1] = htonl(c->timestamp);
+        header[2] = htonl(c->ssrc);
+
+        iov[0].iov_base = (void*)header;
+        iov[0].iov_len = sizeof(b.header[0]);
+
+        m->msg_name = NULL;
+        m->msg_namelen = 0;
+        m->msg_iov = iov;
+        m->msg_iovlen = iov_idx;
+        m->msg_control = NULL;
+        m->msg_controllen = 0;
+        m->msg_flags = 0;
+
+        c->sequence++;
+        c->timestamp += (unsigned) (n/c->frame_size);
 
-            n = 0;
-            iov_idx = 1;
+        if (++n_packets >= PA_RTP_MAX_BATCH) {
+            if (send_batch(c, &b, n_packets) < 0)
+                ret = -1;
+
+            n_packets = 0;
         }
     }
 
-    return 0;
+    if (n_packets > 0)
+        if (send_batch(c, &b, n_packets) < 0)
+            ret = -1;
+
+    return ret;
 }
 
 pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame_size) {
@@ -157,6 +205,7 @@ pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame
 
     c->fd = fd;
     c->frame_size = frame_size;
+    c->max_packet_size = 1500;
 
     pa_memchunk_reset(&c->memchunk);
     return c;
@@ -299,6 +348,201 @@ fail:
     return -1;
 }
 
+/* Checks the RTP header in front of a received packet and fills in
+ * everything but the chunk. Returns the length of the header. */
+static int parse_header(pa_rtp_context *c, const uint8_t *data, size_t size, pa_rtp_packet *p) {
+    uint32_t header;
+    unsigned cc;
+
+    if (size < 12) {
+        pa_log_warn("RTP packet too short.");
+        return -1;
+    }
+
+    memcpy(&header, data, sizeof(uint32_t));
+    memcpy(&p->timestamp, data + 4, sizeof(uint32_t));
+    memcpy(&p->ssrc, data + 8, sizeof(uint32_t));
+
+    header = ntohl(header);
+    p->timestamp = ntohl(p->timestamp);
+    p->ssrc = ntohl(p->ssrc);
+
+    if ((header >> 30) != 2) {
+        pa_log_warn("Unsupported RTP version.");
+        return -1;
+    }
+
+    if ((header >> 29) & 1) {
+        pa_log_warn("RTP padding not supported.");
+        return -1;
+    }
+
+    if ((header >> 28) & 1) {
+        pa_log_warn("RTP header extensions not supported.");
+        return -1;
+    }
+
+    cc = (header >> 24) & 0xF;
+    p->payload = (uint8_t) ((header >> 16) & 127U);
+    p->sequence = (uint16_t) (header & 0xFFFFU);
+
+    if (12 + cc*4 > size) {
+        pa_log_warn("RTP packet too short. (CSRC)");
+        return -1;
+    }
+
+    if ((size - 12 - cc*4) % c->frame_size != 0 || size == 12 + cc*4) {
+        pa_log_warn("Bad RTP packet size.");
+        return -1;
+    }
+
+    return (int) (12 + cc*4);
+}
+
+/* Returns the number of messages received */
+static int recv_batch(int fd, struct msghdr *m, size_t *length, unsigned n) {
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr mm[PA_RTP_MAX_BATCH];
+    unsigned i;
+    int r;
+
+    for (i = 0; i < n; i++) {
+        mm[i].msg_hdr = m[i];
+        mm[i].msg_len = 0;
+    }
+
+    if ((r = recvmmsg(fd, mm, n, 0, NULL)) < 0)
+        return -1;
+
+    for (i = 0; i < (unsigned) r; i++) {
+        m[i] = mm[i].msg_hdr;
+        length[i] = mm[i].msg_len;
+    }
+
+    return r;
+#else
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        ssize_t r;
+
+        if ((r = recvmsg(fd, m + i, 0)) < 0) {
+
+            /* Report errors only if we got nothing at all */
+            if (i > 0)
+                break;
+
+            return -1;
+        }
+
+        length[i] = (size_t) r;
+    }
+
+    return (int) i;
+#endif
+}
+
+int pa_rtp_recv_many(pa_rtp_context *c, pa_rtp_packet *packets, unsigned n, pa_mempool *pool) {
+    struct msghdr m[PA_RTP_MAX_BATCH];
+    struct iovec iov[PA_RTP_MAX_BATCH];
+    size_t length[PA_RTP_MAX_BATCH];
+    uint8_t aux[PA_RTP_MAX_BATCH][CMSG_SPACE(sizeof(struct timeval))];
+    size_t slot;
+    uint8_t *d;
+    unsigned i, k = 0;
+    int r;
+
+    pa_assert(c);
+    pa_assert(packets);
+    pa_assert(n > 0);
+    pa_assert(pool);
+
+    n = PA_MIN(n, (unsigned) PA_RTP_MAX_BATCH);
+
+    /* Every packet gets a slot of the largest size we have seen, in
+     * one block for the whole batch. We don't ask the socket for the
+     * size of the next packet, that would cost another syscall on
+     * every wakeup; truncated packets make the slots grow instead. */
+    slot = PA_ALIGN(c->max_packet_size);
+
+    if (c->memchunk.length < slot) {
+        if (c->memchunk.memblock)
+            pa_memblock_unref(c->memchunk.memblock);
+
+        c->memchunk.memblock = pa_memblock_new(pool, PA_MAX(slot, pa_mempool_block_size_max(pool)));
+        c->memchunk.index = 0;
+        c->memchunk.length = pa_memblock_get_length(c->memchunk.memblock);
+    }
+
+    n = PA_MIN(n, (unsigned) (c->memchunk.length / slot));
+    d = (uint8_t*) pa_memblock_acquire(c->memchunk.memblock) + c->memchunk.index;
+
+    for (i = 0; i < n; i++) {
+        iov[i].iov_base = d + i * slot;
+        iov[i].iov_len = slot;
+
+        m[i].msg_name = NULL;
+        m[i].msg_namelen = 0;
+        m[i].msg_iov = iov + i;
+        m[i].msg_iovlen = 1;
+        m[i].msg_control = aux[i];
+        m[i].msg_controllen = sizeof(aux[i]);
+        m[i].msg_flags = 0;
+    }
+
+    r = recv_batch(c->fd, m, length, n);
+    pa_memblock_release(c->memchunk.memblock);
+
+    if (r < 0) {
+        if (errno == EAGAIN || errno == EINTR)
+            return 0;
+
+        pa_log_warn("recvmsg() failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    for (i = 0; i < (unsigned) r; i++) {
+        pa_rtp_packet *p = packets + k;
+        struct cmsghdr *cm;
+        int hl;
+
+        if (m[i].msg_flags & MSG_TRUNC) {
+            pa_log_warn("RTP packet larger than %lu bytes, dropped.", (unsigned long) slot);
+            c->max_packet_size = PA_MAX(c->max_packet_size, 2 * slot);
+            continue;
+        }
+
+        if ((hl = parse_header(c, d + i * slot, length[i], p)) < 0)
+            continue;
+
+        p->chunk.memblock = pa_memblock_ref(c->memchunk.memblock);
+        p->chunk.index = c->memchunk.index + i * slot + (size_t) hl;
+        p->chunk.length = length[i] - (size_t) hl;
+
+        memset(&p->tstamp, 0, sizeof(p->tstamp));
+
+        for (cm = CMSG_FIRSTHDR(&m[i]); cm; cm = CMSG_NXTHDR(&m[i], cm))
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_TIMESTAMP) {
+                memcpy(&p->tstamp, CMSG_DATA(cm), sizeof(struct timeval));
+                break;
+            }
+
+        k++;
+    }
+
+    /* The slots we used are gone, the rest of the block is kept for
+     * the next batch */
+    c->memchunk.index += (size_t) r * slot;
+    c->memchunk.length -= (size_t) r * slot;
+
+    if (c->memchunk.length <= 0) {
+        pa_memblock_unref(c->memchunk.memblock);
+        pa_memchunk_reset(&c->memchunk);
+    }
+
+    return (int) k;
+}
+
 uint8_t pa_rtp_payload_from_sample_spec(const pa_sample_spec *ss) {
     pa_assert(ss);
 
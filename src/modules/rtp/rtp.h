@@ -24,6 +24,7 @@
 
 #include <inttypes.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <pulsecore/memblockq.h>
 #include <pulsecore/memchunk.h>
@@ -37,14 +38,39 @@ typedef struct pa_rtp_context {
     size_t frame_size;
 
     pa_memchunk memchunk;
+    size_t max_packet_size; /* receiving only */
 } pa_rtp_context;
 
+/* The most packets pa_rtp_send() and pa_rtp_recv_many() pass to the
+ * kernel at once */
+#define PA_RTP_MAX_BATCH 32
+
+typedef struct pa_rtp_packet {
+    pa_memchunk chunk;      /* the payload */
+    uint16_t sequence;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    uint8_t payload;
+    struct timeval tstamp;  /* when the kernel got it, zero if unknown */
+} pa_rtp_packet;
+
 pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssrc, uint8_t payload, size_t frame_size);
+
+/* Sends the data in q as packets of size bytes of payload each, using
+ * a single sendmmsg() per batch where available. Less than a packet
+ * is left in q for the next call. */
 int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q);
 
 pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame_size);
 int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp);
 
+/* Receives what is queued on the socket, up to n packets, with a
+ * single recvmmsg() where available. The socket should be
+ * non-blocking. The payloads of one batch share a memory block.
+ * Returns the number of valid packets stored in packets, -1 on
+ * error. */
+int pa_rtp_recv_many(pa_rtp_context *c, pa_rtp_packet *packets, unsigned n, pa_mempool *pool);
+
 void pa_rtp_context_destroy(pa_rtp_context *c);
 
 pa_sample_spec* pa_rtp_sample_spec_fixup(pa_sample_spec *ss);
@@ -41,9 +41,9 @@
 #include "sdp.h"
 #include "rtp.h"
 
-char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, uint16_t port, uint8_t payload, const pa_sample_spec *ss) {
+char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, uint16_t port, uint8_t payload, const pa_sample_spec *ss, unsigned ptime) {
     uint32_t ntp;
-    char buf_src[64], buf_dst[64], un[64];
+    char buf_src[64], buf_dst[64], un[64], buf_ptime[32] = "";
     const char *u, *f;
 
     pa_assert(src);
@@ -65,6 +65,9 @@ char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, u
     pa_assert_se(inet_ntop(af, src, buf_src, sizeof(buf_src)));
     pa_assert_se(inet_ntop(af, dst, buf_dst, sizeof(buf_dst)));
 
+    if (ptime > 0)
+        pa_snprintf(buf_ptime, sizeof(buf_ptime), "a=ptime:%u\n", ptime);
+
     return pa_sprintf_malloc(
             PA_SDP_HEADER
             "o=%s %lu 0 IN %s %s\n"
@@ -74,13 +77,15 @@ char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, u
             "a=recvonly\n"
             "m=audio %u RTP/AVP %i\n"
             "a=rtpmap:%i %s/%u/%u\n"
-            "a=type:broadcast\n",
+            "a=type:broadcast\n"
+            "%s",
             u, (unsigned long) ntp, af == AF_INET ? "IP4" : "IP6", buf_src,
             name,
             af == AF_INET ? "IP4" : "IP6", buf_dst,
             (unsigned long) ntp,
             port, payload,
-            payload, f, ss->rate, ss->channels);
+            payload, f, ss->rate, ss->channels,
+            buf_ptime);
 }
 
 static pa_sample_spec *parse_sdp_sample_spec(pa_sample_spec *ss, char *c) {
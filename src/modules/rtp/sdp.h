@@ -41,7 +41,7 @@ typedef struct pa_sdp_info {
     uint8_t payload;
 } pa_sdp_info;
 
-char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, uint16_t port, uint8_t payload, const pa_sample_spec *ss);
+char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, uint16_t port, uint8_t payload, const pa_sample_spec *ss, unsigned ptime);
 
 pa_sdp_info *pa_sdp_parse(const char *t, pa_sdp_info *info, int is_goodbye);
 
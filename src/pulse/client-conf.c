@@ -59,6 +59,8 @@ static const pa_client_conf default_conf = {
     .default_server = NULL,
     .autospawn = TRUE,
     .disable_shm = FALSE,
+    .disable_memfd = FALSE,
+    .transport_codec = PA_CODEC_PCM,
     .cookie_file = NULL,
     .cookie_valid = FALSE,
     .shm_size = 0
@@ -85,6 +87,23 @@ void pa_client_conf_free(pa_client_conf *c) {
     pa_xfree(c);
 }
 
+static int parse_codec(const char *filename, unsigned line, const char *section, const char *lvalue, const char *rvalue, void *data, void *userdata) {
+    pa_codec_type_t *type = data, t;
+
+    pa_assert(filename);
+    pa_assert(lvalue);
+    pa_assert(rvalue);
+    pa_assert(data);
+
+    if ((t = pa_codec_type_from_string(rvalue)) == PA_CODEC_MAX) {
+        pa_log(_("[%s:%u] Invalid transport codec '%s'."), filename, line, rvalue);
+        return -1;
+    }
+
+    *type = t;
+    return 0;
+}
+
 int pa_client_conf_load(pa_client_conf *c, const char *filename) {
     FILE *f = NULL;
     char *fn = NULL;
@@ -102,6 +121,9 @@ int pa_client_conf_load(pa_client_conf *c, const char *filename) {
         { "disable-shm",            pa_config_parse_bool,     &c->disable_shm, NULL },
         { "enable-shm",             pa_config_parse_not_bool, &c->disable_shm, NULL },
         { "shm-size-bytes",         pa_config_parse_size,     &c->shm_size, NULL },
+        { "disable-memfd",          pa_config_parse_bool,     &c->disable_memfd, NULL },
+        { "enable-memfd",           pa_config_parse_not_bool, &c->disable_memfd, NULL },
+        { "transport-codec",        parse_codec,              &c->transport_codec, NULL },
         { NULL,                     NULL,                     NULL, NULL },
     };
 
@@ -23,15 +23,17 @@
 ***/
 
 #include <pulsecore/native-common.h>
+#include <pulsecore/codec.h>
 
 /* A structure containing configuration data for PulseAudio clients. */
 
 typedef struct pa_client_conf {
     char *daemon_binary, *extra_arguments, *default_sink, *default_source, *default_server, *cookie_file;
-    pa_bool_t autospawn, disable_shm;
+    pa_bool_t autospawn, disable_shm, disable_memfd;
     uint8_t cookie[PA_NATIVE_COOKIE_LENGTH];
     pa_bool_t cookie_valid; /* non-zero, when cookie is valid */
     size_t shm_size;
+    pa_codec_type_t transport_codec;
 } pa_client_conf;
 
 /* Create a new configuration data object and reset it to defaults */
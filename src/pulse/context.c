@@ -199,7 +199,14 @@ pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *
 #endif
     pa_client_conf_env(c->conf);
 
-    if (!(c->mempool = pa_mempool_new(!c->conf->disable_shm, c->conf->shm_size))) {
+    c->mempool = NULL;
+
+#ifdef HAVE_CREDS
+    if (!c->conf->disable_shm && !c->conf->disable_memfd)
+        c->mempool = pa_mempool_new_memfd(c->conf->shm_size);
+#endif
+
+    if (!c->mempool && !(c->mempool = pa_mempool_new(!c->conf->disable_shm, c->conf->shm_size))) {
 
         if (!c->conf->disable_shm)
             c->mempool = pa_mempool_new(FALSE, c->conf->shm_size);
@@ -377,7 +384,22 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
 
     if ((s = pa_dynarray_get(c->record_streams, channel))) {
 
-        if (chunk->memblock) {
+        if (s->codec) {
+            pa_memchunk pcm;
+
+            pa_memblockq_seek(s->record_memblockq, offset, seek, TRUE);
+
+            if (!chunk->memblock)
+                pa_codec_reset(s->codec);
+            else if (pa_codec_decode(s->codec, chunk, &pcm) < 0) {
+                pa_context_fail(c, PA_ERR_PROTOCOL);
+                goto finish;
+            } else if (pcm.memblock) {
+                pa_memblockq_push_align(s->record_memblockq, &pcm);
+                pa_memblock_unref(pcm.memblock);
+            }
+
+        } else if (chunk->memblock) {
             pa_memblockq_seek(s->record_memblockq, offset, seek, TRUE);
             pa_memblockq_push_align(s->record_memblockq, chunk);
         } else
@@ -391,6 +413,7 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
         }
     }
 
+finish:
     pa_context_unref(c);
 }
 
@@ -450,7 +473,7 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
     switch(c->state) {
         case PA_CONTEXT_AUTHORIZING: {
             pa_tagstruct *reply;
-            pa_bool_t shm_on_remote = FALSE;
+            pa_bool_t shm_on_remote = FALSE, memfd_on_remote = FALSE;
 
             if (pa_tagstruct_getu32(t, &c->version) < 0 ||
                 !pa_tagstruct_eof(t)) {
@@ -472,6 +495,13 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
                 c->version &= 0x7FFFFFFFU;
             }
 
+            /* Starting with protocol version 17 the second MSB tells
+               us if the server accepted our memfd segment. */
+            if (c->version >= 17) {
+                memfd_on_remote = !!(c->version & 0x40000000U);
+                c->version &= 0x3FFFFFFFU;
+            }
+
             pa_log_debug("Protocol version: remote %u, local %u", c->version, PA_PROTOCOL_VERSION);
 
             /* Enable shared memory support if possible */
@@ -495,6 +525,15 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
             pa_log_debug("Negotiated SHM: %s", pa_yes_no(c->do_shm));
             pa_pstream_enable_shm(c->pstream, c->do_shm);
 
+            /* If the server doesn't take memfd we still use the SHM
+             * it sends us, but send our own data inline. */
+            if (c->do_shm && pa_mempool_is_memfd_backed(c->mempool)) {
+                pa_log_debug("Negotiated memfd: %s", pa_yes_no(memfd_on_remote));
+
+                if (memfd_on_remote)
+                    pa_pstream_enable_memfd(c->pstream, c->mempool);
+            }
+
             reply = pa_tagstruct_command(c, PA_COMMAND_SET_CLIENT_NAME, &tag);
 
             if (c->version >= 13) {
@@ -561,8 +600,11 @@ static void setup_context(pa_context *c, pa_iochannel *io) {
     pa_log_debug("SHM possible: %s", pa_yes_no(c->do_shm));
 
     /* Starting with protocol version 13 we use the MSB of the version
-     * tag for informing the other side if we could do SHM or not */
-    pa_tagstruct_putu32(t, PA_PROTOCOL_VERSION | (c->do_shm ? 0x80000000U : 0));
+     * tag for informing the other side if we could do SHM or not,
+     * starting with 17 the second MSB for memfd. */
+    pa_tagstruct_putu32(t, PA_PROTOCOL_VERSION |
+                        (c->do_shm ? 0x80000000U : 0) |
+                        (c->do_shm && pa_mempool_is_memfd_backed(c->mempool) ? 0x40000000U : 0));
     pa_tagstruct_put_arbitrary(t, c->conf->cookie, sizeof(c->conf->cookie));
 
 #ifdef HAVE_CREDS
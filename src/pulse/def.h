@@ -720,9 +720,13 @@ typedef enum pa_sink_flags {
     /**< This sink is in flat volume mode, i.e. always the maximum of
      * the volume of all connected inputs. \since 0.9.15 */
 
-    PA_SINK_DYNAMIC_LATENCY = 0x0080U
+    PA_SINK_DYNAMIC_LATENCY = 0x0080U,
     /**< The latency can be adjusted dynamically depending on the
      * needs of the connected streams. \since 0.9.15 */
+
+    PA_SINK_PARALLEL_RENDER = 0x0100U
+    /**< The streams connected to this sink are converted on several
+     * threads in parallel before they are mixed. \since 0.9.22 */
 } pa_sink_flags_t;
 
 /** \cond fulldocs */
@@ -734,6 +738,7 @@ typedef enum pa_sink_flags {
 #define PA_SINK_DECIBEL_VOLUME PA_SINK_DECIBEL_VOLUME
 #define PA_SINK_FLAT_VOLUME PA_SINK_FLAT_VOLUME
 #define PA_SINK_DYNAMIC_LATENCY PA_SINK_DYNAMIC_LATENCY
+#define PA_SINK_PARALLEL_RENDER PA_SINK_PARALLEL_RENDER
 /** \endcond */
 
 /** Sink state. \since 0.9.15 */
@@ -43,6 +43,7 @@
 #include <pulsecore/hashmap.h>
 #include <pulsecore/refcnt.h>
 #include <pulsecore/time-smoother.h>
+#include <pulsecore/codec.h>
 #ifdef HAVE_DBUS
 #include <pulsecore/dbus-util.h>
 #endif
@@ -156,6 +157,9 @@ struct pa_stream {
     uint32_t device_index;
     char *device_name;
 
+    /* Compresses/decompresses the audio data, NULL for plain PCM */
+    pa_codec *codec;
+
     /* playback */
     pa_memblock *write_memblock;
     void *write_data;
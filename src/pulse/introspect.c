@@ -83,6 +83,109 @@ pa_operation* pa_context_stat(pa_context *c, pa_stat_info_cb_t cb, void *userdat
     return pa_context_send_simple_command(c, PA_COMMAND_STAT, context_stat_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+/*** Render profile ***/
+
+/* Don't let a broken server make us allocate arbitrary amounts of memory */
+#define MAX_RENDER_HISTOGRAMS 16
+#define MAX_RENDER_HISTOGRAM_BUCKETS 64
+
+static void render_histograms_free(pa_render_histogram_info *h, uint32_t n) {
+    uint32_t j;
+
+    if (!h)
+        return;
+
+    for (j = 0; j < n; j++)
+        pa_xfree((uint32_t*) h[j].buckets);
+
+    pa_xfree(h);
+}
+
+static void context_get_render_profile_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    int eol = 1;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, FALSE) < 0)
+            goto finish;
+
+        eol = -1;
+    } else {
+
+        while (!pa_tagstruct_eof(t)) {
+            pa_render_profile_info i;
+            uint32_t facility, j;
+
+            pa_zero(i);
+
+            if (pa_tagstruct_getu32(t, &facility) < 0 ||
+                pa_tagstruct_getu32(t, &i.index) < 0 ||
+                pa_tagstruct_getu32(t, &i.sink) < 0 ||
+                pa_tagstruct_gets(t, &i.name) < 0 ||
+                pa_tagstruct_getu32(t, &i.n_histograms) < 0 ||
+                i.n_histograms > MAX_RENDER_HISTOGRAMS) {
+
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                goto finish;
+            }
+
+            i.facility = (pa_subscription_event_type_t) facility;
+            i.histograms = pa_xnew0(pa_render_histogram_info, i.n_histograms+1);
+
+            for (j = 0; j < i.n_histograms; j++) {
+                uint32_t *buckets, k;
+
+                if (pa_tagstruct_gets(t, &i.histograms[j].name) < 0 ||
+                    pa_tagstruct_getu32(t, &i.histograms[j].n_buckets) < 0 ||
+                    i.histograms[j].n_buckets > MAX_RENDER_HISTOGRAM_BUCKETS) {
+
+                    pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                    render_histograms_free(i.histograms, j);
+                    goto finish;
+                }
+
+                i.histograms[j].buckets = buckets = pa_xnew0(uint32_t, i.histograms[j].n_buckets);
+
+                for (k = 0; k < i.histograms[j].n_buckets; k++)
+                    if (pa_tagstruct_getu32(t, &buckets[k]) < 0) {
+                        pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                        render_histograms_free(i.histograms, j+1);
+                        goto finish;
+                    }
+            }
+
+            if (o->callback) {
+                pa_render_profile_info_cb_t cb = (pa_render_profile_info_cb_t) o->callback;
+                cb(o->context, &i, 0, o->userdata);
+            }
+
+            render_histograms_free(i.histograms, i.n_histograms);
+        }
+    }
+
+    if (o->callback) {
+        pa_render_profile_info_cb_t cb = (pa_render_profile_info_cb_t) o->callback;
+        cb(o->context, NULL, eol, o->userdata);
+    }
+
+finish:
+    pa_operation_done(o);
+    pa_operation_unref(o);
+}
+
+pa_operation* pa_context_get_render_profile_info_list(pa_context *c, pa_render_profile_info_cb_t cb, void *userdata) {
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 18, PA_ERR_NOTSUPPORTED);
+
+    return pa_context_send_simple_command(c, PA_COMMAND_GET_RENDER_PROFILE_INFO_LIST, context_get_render_profile_info_callback, (pa_operation_cb_t) cb, userdata);
+}
+
 /*** Server Info ***/
 
 static void context_get_server_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -78,6 +78,11 @@
  * Statistics about memory usage can be fetched using pa_context_stat(),
  * giving a pa_stat_info structure.
  *
+ * Latency histograms of the render path of all sinks and sink inputs
+ * can be fetched using pa_context_get_render_profile_info_list(),
+ * giving a pa_render_profile_info structure per sink and sink input.
+ * The server only starts to collect them on the first such request.
+ *
  * \subsection sinksrc_subsec Sinks and Sources
  *
  * The server can have an arbitrary number of sinks and sources. Each sink
@@ -587,6 +592,34 @@ typedef void (*pa_stat_info_cb_t) (pa_context *c, const pa_stat_info *i, void *u
 /** Get daemon memory block statistics */
 pa_operation* pa_context_stat(pa_context *c, pa_stat_info_cb_t cb, void *userdata);
 
+/** Latency histogram of a single probe in the render path of the
+ * daemon. Bucket n counts the calls that took between 2^n and
+ * 2^(n+1) ns, the last bucket also counts everything that took
+ * longer. \since 0.9.22 */
+typedef struct pa_render_histogram_info {
+    const char *name;                  /**< Name of the probe, e.g. "render", "mix" or "resample" */
+    uint32_t n_buckets;                /**< Number of entries in the bucket array */
+    const uint32_t *buckets;           /**< Number of calls per bucket */
+} pa_render_histogram_info;
+
+/** Render profile of a sink or a sink input. Please note that this
+ * structure can be extended as part of evolutionary API updates at
+ * any time in any new release. \since 0.9.22 */
+typedef struct pa_render_profile_info {
+    pa_subscription_event_type_t facility; /**< PA_SUBSCRIPTION_EVENT_SINK or PA_SUBSCRIPTION_EVENT_SINK_INPUT */
+    uint32_t index;                    /**< Index of the sink or sink input */
+    uint32_t sink;                     /**< For sink inputs the index of the sink it is connected to, PA_INVALID_INDEX otherwise */
+    const char *name;                  /**< Name of the sink or sink input */
+    uint32_t n_histograms;             /**< Number of entries in the histogram array */
+    pa_render_histogram_info *histograms; /**< Array of histograms, one per probe. Terminated by an entry with name set to NULL */
+} pa_render_profile_info;
+
+/** Callback prototype for pa_context_get_render_profile_info_list() \since 0.9.22 */
+typedef void (*pa_render_profile_info_cb_t) (pa_context *c, const pa_render_profile_info *i, int eol, void *userdata);
+
+/** Get the render profiles of all sinks and sink inputs \since 0.9.22 */
+pa_operation* pa_context_get_render_profile_info_list(pa_context *c, pa_render_profile_info_cb_t cb, void *userdata);
+
 /** @} */
 
 /** @{ \name Cached Samples */
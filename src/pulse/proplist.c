@@ -24,6 +24,7 @@
 #endif
 
 #include <string.h>
+#include <stdlib.h>
 #include <ctype.h>
 
 #include <pulse/xmalloc.h>
@@ -33,17 +34,103 @@
 #include <pulsecore/hashmap.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/proplist-util.h>
 
 #include "proplist.h"
 
-struct property {
-    char *key;
-    void *value;
-    size_t nbytes;
+/* Properties are immutable and reference counted, and so are the
+ * contents of a list as long as more than one list refers to
+ * them. Copying a list or merging one into another hence only
+ * increases reference counts, nothing is duplicated until somebody
+ * changes a shared list. */
+
+/* The keys everybody uses, sorted by their value. Properties with one
+ * of these keys point to the string here instead of carrying a copy
+ * of their own. */
+static const char* const well_known_keys[] = {
+    PA_PROP_APPLICATION_ICON,
+    PA_PROP_APPLICATION_ICON_NAME,
+    PA_PROP_APPLICATION_ID,
+    PA_PROP_APPLICATION_LANGUAGE,
+    PA_PROP_APPLICATION_NAME,
+    PA_PROP_APPLICATION_PROCESS_BINARY,
+    PA_PROP_APPLICATION_PROCESS_HOST,
+    PA_PROP_APPLICATION_PROCESS_ID,
+    PA_PROP_APPLICATION_PROCESS_MACHINE_ID,
+    PA_PROP_APPLICATION_PROCESS_SESSION_ID,
+    PA_PROP_APPLICATION_PROCESS_USER,
+    PA_PROP_APPLICATION_VERSION,
+    PA_PROP_DEVICE_ACCESS_MODE,
+    PA_PROP_DEVICE_API,
+    PA_PROP_DEVICE_BUFFERING_BUFFER_SIZE,
+    PA_PROP_DEVICE_BUFFERING_FRAGMENT_SIZE,
+    PA_PROP_DEVICE_BUS,
+    PA_PROP_DEVICE_BUS_PATH,
+    PA_PROP_DEVICE_CLASS,
+    PA_PROP_DEVICE_DESCRIPTION,
+    PA_PROP_DEVICE_FORM_FACTOR,
+    PA_PROP_DEVICE_ICON,
+    PA_PROP_DEVICE_ICON_NAME,
+    PA_PROP_DEVICE_INTENDED_ROLES,
+    PA_PROP_DEVICE_MASTER_DEVICE,
+    PA_PROP_DEVICE_PRODUCT_ID,
+    PA_PROP_DEVICE_PRODUCT_NAME,
+    PA_PROP_DEVICE_PROFILE_DESCRIPTION,
+    PA_PROP_DEVICE_PROFILE_NAME,
+    PA_PROP_DEVICE_SERIAL,
+    PA_PROP_DEVICE_STRING,
+    PA_PROP_DEVICE_VENDOR_ID,
+    PA_PROP_DEVICE_VENDOR_NAME,
+    PA_PROP_EVENT_DESCRIPTION,
+    PA_PROP_EVENT_ID,
+    PA_PROP_EVENT_MOUSE_BUTTON,
+    PA_PROP_EVENT_MOUSE_HPOS,
+    PA_PROP_EVENT_MOUSE_VPOS,
+    PA_PROP_EVENT_MOUSE_X,
+    PA_PROP_EVENT_MOUSE_Y,
+    PA_PROP_MEDIA_ARTIST,
+    PA_PROP_MEDIA_COPYRIGHT,
+    PA_PROP_MEDIA_FILENAME,
+    PA_PROP_MEDIA_ICON,
+    PA_PROP_MEDIA_ICON_NAME,
+    PA_PROP_MEDIA_LANGUAGE,
+    PA_PROP_MEDIA_NAME,
+    PA_PROP_MEDIA_ROLE,
+    PA_PROP_MEDIA_SOFTWARE,
+    PA_PROP_MEDIA_TITLE,
+    PA_PROP_MODULE_AUTHOR,
+    PA_PROP_MODULE_DESCRIPTION,
+    PA_PROP_MODULE_USAGE,
+    PA_PROP_MODULE_VERSION,
+    PA_PROP_WINDOW_DESKTOP,
+    PA_PROP_WINDOW_HEIGHT,
+    PA_PROP_WINDOW_HPOS,
+    PA_PROP_WINDOW_ICON,
+    PA_PROP_WINDOW_ICON_NAME,
+    PA_PROP_WINDOW_ID,
+    PA_PROP_WINDOW_NAME,
+    PA_PROP_WINDOW_VPOS,
+    PA_PROP_WINDOW_WIDTH,
+    PA_PROP_WINDOW_X,
+    PA_PROP_WINDOW_X11_DISPLAY,
+    PA_PROP_WINDOW_X11_MONITOR,
+    PA_PROP_WINDOW_X11_SCREEN,
+    PA_PROP_WINDOW_X11_XID,
+    PA_PROP_WINDOW_Y,
 };
 
-#define MAKE_HASHMAP(p) ((pa_hashmap*) (p))
-#define MAKE_PROPLIST(p) ((pa_proplist*) (p))
+static int key_compare(const void *a, const void *b) {
+    return strcmp(a, *(const char* const*) b);
+}
+
+static const char *intern_key(const char *key) {
+    const char* const *k;
+
+    if (!(k = bsearch(key, well_known_keys, PA_ELEMENTSOF(well_known_keys), sizeof(well_known_keys[0]), key_compare)))
+        return NULL;
+
+    return *k;
+}
 
 static pa_bool_t property_name_valid(const char *key) {
 
@@ -56,30 +143,165 @@ static pa_bool_t property_name_valid(const char *key) {
     return TRUE;
 }
 
-static void property_free(struct property *prop) {
+/* Value and key are stored in the same allocation as the property
+ * itself. The value is always followed by a NUL byte. */
+static struct pa_property *property_new(const char *key, const void *data, size_t nbytes) {
+    struct pa_property *prop;
+    const char *k;
+    size_t l;
+    uint8_t *d;
+
+    pa_assert(key);
+    pa_assert(data || nbytes == 0);
+
+    k = intern_key(key);
+    l = k ? 0 : strlen(key) + 1;
+
+    prop = pa_xmalloc(PA_ALIGN(sizeof(struct pa_property)) + nbytes + 1 + l);
+    PA_REFCNT_INIT(prop);
+
+    d = (uint8_t*) prop + PA_ALIGN(sizeof(struct pa_property));
+
+    if (nbytes > 0)
+        memcpy(d, data, nbytes);
+    d[nbytes] = 0;
+
+    prop->value = d;
+    prop->nbytes = nbytes;
+
+    if (!k) {
+        memcpy(d + nbytes + 1, key, l);
+        k = (char*) d + nbytes + 1;
+    }
+
+    prop->key = k;
+
+    return prop;
+}
+
+static struct pa_property *property_ref(struct pa_property *prop) {
     pa_assert(prop);
+    pa_assert(PA_REFCNT_VALUE(prop) >= 1);
 
-    pa_xfree(prop->key);
-    pa_xfree(prop->value);
-    pa_xfree(prop);
+    PA_REFCNT_INC(prop);
+    return prop;
+}
+
+static void property_unref(struct pa_property *prop) {
+    pa_assert(prop);
+    pa_assert(PA_REFCNT_VALUE(prop) >= 1);
+
+    if (PA_REFCNT_DEC(prop) <= 0)
+        pa_xfree(prop);
+}
+
+static void property_free_cb(void *p, void *userdata) {
+    property_unref(p);
+}
+
+static pa_proplist_data *data_new(void) {
+    pa_proplist_data *d;
+
+    d = pa_xnew(pa_proplist_data, 1);
+    PA_REFCNT_INIT(d);
+    d->properties = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+    pa_atomic_ptr_store(&d->serialized, NULL);
+
+    return d;
+}
+
+static void data_unref(pa_proplist_data *d) {
+    pa_assert(d);
+    pa_assert(PA_REFCNT_VALUE(d) >= 1);
+
+    if (PA_REFCNT_DEC(d) > 0)
+        return;
+
+    pa_hashmap_free(d->properties, property_free_cb, NULL);
+    pa_xfree(pa_atomic_ptr_load(&d->serialized));
+    pa_xfree(d);
+}
+
+static void set_data(pa_proplist *p, pa_proplist_data *d) {
+    pa_assert(p);
+    pa_assert(d);
+
+    if (p->data == d)
+        return;
+
+    PA_REFCNT_INC(d);
+    data_unref(p->data);
+    p->data = d;
+}
+
+/* Needs to be called before the contents of p are changed. If they
+ * are shared with other lists p gets a copy of its own. */
+static pa_proplist_data *make_writable(pa_proplist *p) {
+    pa_proplist_data *d;
+    void *state;
+    struct pa_property *prop;
+
+    pa_assert(p);
+
+    if (PA_REFCNT_VALUE(p->data) <= 1) {
+        void *s;
+
+        if ((s = pa_atomic_ptr_load(&p->data->serialized))) {
+            pa_atomic_ptr_store(&p->data->serialized, NULL);
+            pa_xfree(s);
+        }
+
+        return p->data;
+    }
+
+    d = data_new();
+
+    PA_HASHMAP_FOREACH(prop, p->data->properties, state)
+        pa_hashmap_put(d->properties, prop->key, property_ref(prop));
+
+    data_unref(p->data);
+    p->data = d;
+
+    return d;
+}
+
+/* Takes over the reference to prop. d needs to be writable. */
+static void data_put(pa_proplist_data *d, struct pa_property *prop) {
+    struct pa_property *old;
+
+    pa_assert(d);
+    pa_assert(prop);
+
+    if ((old = pa_hashmap_replace(d->properties, prop->key, prop)))
+        property_unref(old);
+    else
+        pa_assert_se(pa_hashmap_put(d->properties, prop->key, prop) == 0);
+}
+
+static void put_property(pa_proplist *p, struct pa_property *prop) {
+    pa_assert(p);
+
+    data_put(make_writable(p), prop);
 }
 
 pa_proplist* pa_proplist_new(void) {
-    return MAKE_PROPLIST(pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func));
+    pa_proplist *p;
+
+    p = pa_xnew(pa_proplist, 1);
+    p->data = data_new();
+
+    return p;
 }
 
 void pa_proplist_free(pa_proplist* p) {
     pa_assert(p);
 
-    pa_proplist_clear(p);
-    pa_hashmap_free(MAKE_HASHMAP(p), NULL, NULL);
+    data_unref(p->data);
+    pa_xfree(p);
 }
 
 /** Will accept only valid UTF-8 */
 int pa_proplist_sets(pa_proplist *p, const char *key, const char *value) {
-    struct property *prop;
-    pa_bool_t add = FALSE;
-
     pa_assert(p);
     pa_assert(key);
     pa_assert(value);
@@ -87,27 +309,15 @@ int pa_proplist_sets(pa_proplist *p, const char *key, const char *value) {
     if (!property_name_valid(key) || !pa_utf8_valid(value))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = TRUE;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = pa_xstrdup(value);
-    prop->nbytes = strlen(value)+1;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    put_property(p, property_new(key, value, strlen(value)+1));
 
     return 0;
 }
 
 /** Will accept only valid UTF-8 */
 static int proplist_setn(pa_proplist *p, const char *key, size_t key_length, const char *value, size_t value_length) {
-    struct property *prop;
-    pa_bool_t add = FALSE;
     char *k, *v;
+    int r = -1;
 
     pa_assert(p);
     pa_assert(key);
@@ -116,28 +326,15 @@ static int proplist_setn(pa_proplist *p, const char *key, size_t key_length, con
     k = pa_xstrndup(key, key_length);
     v = pa_xstrndup(value, value_length);
 
-    if (!property_name_valid(k) || !pa_utf8_valid(v)) {
-        pa_xfree(k);
-        pa_xfree(v);
-        return -1;
-    }
-
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), k))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = k;
-        add = TRUE;
-    } else {
-        pa_xfree(prop->value);
-        pa_xfree(k);
+    if (property_name_valid(k) && pa_utf8_valid(v)) {
+        put_property(p, property_new(k, v, strlen(v)+1));
+        r = 0;
     }
 
-    prop->value = v;
-    prop->nbytes = strlen(v)+1;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    pa_xfree(k);
+    pa_xfree(v);
 
-    return 0;
+    return r;
 }
 
 /** Will accept only valid UTF-8 */
@@ -156,8 +353,6 @@ int pa_proplist_setp(pa_proplist *p, const char *pair) {
 }
 
 static int proplist_sethex(pa_proplist *p, const char *key, size_t key_length, const char *value, size_t value_length) {
-    struct property *prop;
-    pa_bool_t add = FALSE;
     char *k, *v;
     uint8_t *d;
     size_t dn;
@@ -183,31 +378,17 @@ static int proplist_sethex(pa_proplist *p, const char *key, size_t key_length, c
         return -1;
     }
 
-    pa_xfree(v);
+    put_property(p, property_new(k, d, dn));
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), k))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = k;
-        add = TRUE;
-    } else {
-        pa_xfree(prop->value);
-        pa_xfree(k);
-    }
-
-    d[dn] = 0;
-    prop->value = d;
-    prop->nbytes = dn;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    pa_xfree(k);
+    pa_xfree(v);
+    pa_xfree(d);
 
     return 0;
 }
 
 /** Will accept only valid UTF-8 */
 int pa_proplist_setf(pa_proplist *p, const char *key, const char *format, ...) {
-    struct property *prop;
-    pa_bool_t add = FALSE;
     va_list ap;
     char *v;
 
@@ -225,19 +406,9 @@ int pa_proplist_setf(pa_proplist *p, const char *key, const char *format, ...) {
     if (!pa_utf8_valid(v))
         goto fail;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = TRUE;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = v;
-    prop->nbytes = strlen(v)+1;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    put_property(p, property_new(key, v, strlen(v)+1));
 
+    pa_xfree(v);
     return 0;
 
 fail:
@@ -246,9 +417,6 @@ fail:
 }
 
 int pa_proplist_set(pa_proplist *p, const char *key, const void *data, size_t nbytes) {
-    struct property *prop;
-    pa_bool_t add = FALSE;
-
     pa_assert(p);
     pa_assert(key);
     pa_assert(data || nbytes == 0);
@@ -256,27 +424,13 @@ int pa_proplist_set(pa_proplist *p, const char *key, const void *data, size_t nb
     if (!property_name_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = TRUE;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = pa_xmalloc(nbytes+1);
-    if (nbytes > 0)
-        memcpy(prop->value, data, nbytes);
-    ((char*) prop->value)[nbytes] = 0;
-    prop->nbytes = nbytes;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    put_property(p, property_new(key, data, nbytes));
 
     return 0;
 }
 
 const char *pa_proplist_gets(pa_proplist *p, const char *key) {
-    struct property *prop;
+    struct pa_property *prop;
 
     pa_assert(p);
     pa_assert(key);
@@ -284,7 +438,7 @@ const char *pa_proplist_gets(pa_proplist *p, const char *key) {
     if (!property_name_valid(key))
         return NULL;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!(prop = pa_hashmap_get(p->data->properties, key)))
         return NULL;
 
     if (prop->nbytes <= 0)
@@ -303,7 +457,7 @@ const char *pa_proplist_gets(pa_proplist *p, const char *key) {
 }
 
 int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *nbytes) {
-    struct property *prop;
+    struct pa_property *prop;
 
     pa_assert(p);
     pa_assert(key);
@@ -313,7 +467,7 @@ int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *
     if (!property_name_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!(prop = pa_hashmap_get(p->data->properties, key)))
         return -1;
 
     *data = prop->value;
@@ -323,27 +477,37 @@ int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *
 }
 
 void pa_proplist_update(pa_proplist *p, pa_update_mode_t mode, pa_proplist *other) {
-    struct property *prop;
+    pa_proplist_data *d;
+    struct pa_property *prop;
     void *state = NULL;
 
     pa_assert(p);
     pa_assert(mode == PA_UPDATE_SET || mode == PA_UPDATE_MERGE || mode == PA_UPDATE_REPLACE);
     pa_assert(other);
 
-    if (mode == PA_UPDATE_SET)
-        pa_proplist_clear(p);
+    /* If the result is going to be an exact copy of other, just share
+     * its contents */
+    if (mode == PA_UPDATE_SET || pa_hashmap_isempty(p->data->properties)) {
+        set_data(p, other->data);
+        return;
+    }
+
+    if (p->data == other->data || pa_hashmap_isempty(other->data->properties))
+        return;
+
+    d = make_writable(p);
 
-    while ((prop = pa_hashmap_iterate(MAKE_HASHMAP(other), &state, NULL))) {
+    while ((prop = pa_hashmap_iterate(other->data->properties, &state, NULL))) {
 
-        if (mode == PA_UPDATE_MERGE && pa_proplist_contains(p, prop->key))
+        if (mode == PA_UPDATE_MERGE && pa_hashmap_get(d->properties, prop->key))
             continue;
 
-        pa_assert_se(pa_proplist_set(p, prop->key, prop->value, prop->nbytes) == 0);
+        data_put(d, property_ref(prop));
     }
 }
 
 int pa_proplist_unset(pa_proplist *p, const char *key) {
-    struct property *prop;
+    struct pa_property *prop;
 
     pa_assert(p);
     pa_assert(key);
@@ -351,10 +515,12 @@ int pa_proplist_unset(pa_proplist *p, const char *key) {
     if (!property_name_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_remove(MAKE_HASHMAP(p), key)))
+    if (!pa_hashmap_get(p->data->properties, key))
         return -2;
 
-    property_free(prop);
+    pa_assert_se(prop = pa_hashmap_remove(make_writable(p)->properties, key));
+    property_unref(prop);
+
     return 0;
 }
 
@@ -377,9 +543,9 @@ int pa_proplist_unset_many(pa_proplist *p, const char * const keys[]) {
 }
 
 const char *pa_proplist_iterate(pa_proplist *p, void **state) {
-    struct property *prop;
+    struct pa_property *prop;
 
-    if (!(prop = pa_hashmap_iterate(MAKE_HASHMAP(p), state, NULL)))
+    if (!(prop = pa_hashmap_iterate(p->data->properties, state, NULL)))
         return NULL;
 
     return prop->key;
@@ -631,13 +797,14 @@ pa_proplist *pa_proplist_from_string(const char *s) {
     }
 
 success:
-    return MAKE_PROPLIST(pl);
+    return pl;
 
 fail:
     pa_proplist_free(pl);
     return NULL;
 }
 
+
 int pa_proplist_contains(pa_proplist *p, const char *key) {
     pa_assert(p);
     pa_assert(key);
@@ -645,27 +812,43 @@ int pa_proplist_contains(pa_proplist *p, const char *key) {
     if (!property_name_valid(key))
         return -1;
 
-    if (!(pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!(pa_hashmap_get(p->data->properties, key)))
         return 0;
 
     return 1;
 }
 
 void pa_proplist_clear(pa_proplist *p) {
-    struct property *prop;
+    pa_proplist_data *d;
+    struct pa_property *prop;
     pa_assert(p);
 
-    while ((prop = pa_hashmap_steal_first(MAKE_HASHMAP(p))))
-        property_free(prop);
+    if (pa_hashmap_isempty(p->data->properties))
+        return;
+
+    /* Don't bother copying what is going to be thrown away anyway */
+    if (PA_REFCNT_VALUE(p->data) > 1) {
+        d = data_new();
+        data_unref(p->data);
+        p->data = d;
+        return;
+    }
+
+    d = make_writable(p);
+
+    while ((prop = pa_hashmap_steal_first(d->properties)))
+        property_unref(prop);
 }
 
 pa_proplist* pa_proplist_copy(pa_proplist *template) {
     pa_proplist *p;
 
-    pa_assert_se(p = pa_proplist_new());
+    if (!template)
+        return pa_proplist_new();
 
-    if (template)
-        pa_proplist_update(p, PA_UPDATE_REPLACE, template);
+    p = pa_xnew(pa_proplist, 1);
+    p->data = template->data;
+    PA_REFCNT_INC(p->data);
 
     return p;
 }
@@ -673,11 +856,11 @@ pa_proplist* pa_proplist_copy(pa_proplist *template) {
 unsigned pa_proplist_size(pa_proplist *p) {
     pa_assert(p);
 
-    return pa_hashmap_size(MAKE_HASHMAP(p));
+    return pa_hashmap_size(p->data->properties);
 }
 
 int pa_proplist_isempty(pa_proplist *p) {
     pa_assert(p);
 
-    return pa_hashmap_isempty(MAKE_HASHMAP(p));
+    return pa_hashmap_isempty(p->data->properties);
 }
@@ -144,6 +144,8 @@ pa_stream *pa_stream_new_with_proplist(
     s->suspended = FALSE;
     s->corked = FALSE;
 
+    s->codec = NULL;
+
     s->write_memblock = NULL;
     s->write_data = NULL;
 
@@ -236,6 +238,9 @@ static void stream_free(pa_stream *s) {
     if (s->record_memblockq)
         pa_memblockq_free(s->record_memblockq);
 
+    if (s->codec)
+        pa_codec_free(s->codec);
+
     if (s->proplist)
         pa_proplist_free(s->proplist);
 
@@ -977,6 +982,24 @@ void pa_create_stream_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag,
             s->timing_info.configured_sink_usec = usec;
     }
 
+    if (s->context->version >= 19 && s->direction != PA_STREAM_UPLOAD) {
+        uint32_t codec;
+
+        if (pa_tagstruct_getu32(t, &codec) < 0 ||
+            codec >= PA_CODEC_MAX ||
+            !pa_codec_supported(codec, &s->sample_spec)) {
+            pa_context_fail(s->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
+        pa_assert(!s->codec);
+
+        if (codec != PA_CODEC_PCM)
+            s->codec = pa_codec_new(codec, &s->sample_spec,
+                                    s->direction == PA_STREAM_PLAYBACK ? pa_codec_packet_size(&s->sample_spec, s->buffer_attr.minreq) : 0,
+                                    s->context->mempool);
+    }
+
     if (!pa_tagstruct_eof(t)) {
         pa_context_fail(s->context, PA_ERR_PROTOCOL);
         goto finish;
@@ -1175,6 +1198,13 @@ static int create_stream(
         pa_tagstruct_put_boolean(t, flags & PA_STREAM_FAIL_ON_SUSPEND);
     }
 
+    if (s->context->version >= 19) {
+
+        /* Compression only pays off when we don't talk to the server
+         * via a local socket */
+        pa_tagstruct_putu32(t, s->context->is_local ? PA_CODEC_PCM : s->context->conf->transport_codec);
+    }
+
     pa_pstream_send_tagstruct(s->context->pstream, t);
     pa_pdispatch_register_reply(s->context->pdispatch, tag, DEFAULT_TIMEOUT, pa_create_stream_callback, s, NULL);
 
@@ -1267,6 +1297,27 @@ int pa_stream_cancel_write(
     return 0;
 }
 
+static void send_encoded(pa_stream *s, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk) {
+    pa_memchunk pcm = *chunk;
+
+    /* Each packet goes into a block of its own, the seek is applied
+     * with the first one */
+    while (pcm.length > 0) {
+        pa_memchunk packet;
+        size_t l;
+
+        l = pa_codec_encode(s->codec, &pcm, &packet);
+        pa_pstream_send_memblock(s->context->pstream, s->channel, offset, seek, &packet);
+        pa_memblock_unref(packet.memblock);
+
+        offset = 0;
+        seek = PA_SEEK_RELATIVE;
+
+        pcm.index += l;
+        pcm.length -= l;
+    }
+}
+
 int pa_stream_write(
         pa_stream *s,
         const void *data,
@@ -1290,8 +1341,43 @@ int pa_stream_write(
                        ((const char*) data + length <= (const char*) s->write_data + pa_memblock_get_length(s->write_memblock))),
                       PA_ERR_INVALID);
     PA_CHECK_VALIDITY(s->context, !free_cb || !s->write_memblock, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY(s->context, !s->codec || length % pa_frame_size(&s->sample_spec) == 0, PA_ERR_INVALID);
 
-    if (s->write_memblock) {
+    if (s->codec) {
+        pa_memchunk chunk;
+
+        /* The packets are always sent inline, hence there is no need
+         * to copy the data into blocks of our own first */
+
+        chunk.index = 0;
+        chunk.length = length;
+
+        if (s->write_memblock) {
+            pa_memblock_release(s->write_memblock);
+
+            chunk.memblock = s->write_memblock;
+            chunk.index = (const char *) data - (const char *) s->write_data;
+
+            s->write_memblock = NULL;
+            s->write_data = NULL;
+
+            send_encoded(s, offset, seek, &chunk);
+            pa_memblock_unref(chunk.memblock);
+
+        } else {
+
+            if (length > 0) {
+                chunk.memblock = pa_memblock_new_fixed(s->context->mempool, (void*) data, length, TRUE);
+
+                send_encoded(s, offset, seek, &chunk);
+                pa_memblock_unref_fixed(chunk.memblock);
+            }
+
+            if (free_cb)
+                free_cb((void*) data);
+        }
+
+    } else if (s->write_memblock) {
         pa_memchunk chunk;
 
         /* pa_stream_write_begin() was called before */
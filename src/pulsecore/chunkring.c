@@ -0,0 +1,119 @@
+/***
+  This file is part of PulseAudio.
+
+  Copyright 2004-2006 Lennart Poettering
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/memblock.h>
+
+#include "chunkring.h"
+
+#define CHUNKRING_SIZE 64
+
+struct pa_chunkring {
+    unsigned size;
+
+    /* Only touched by the writer resp. the reader */
+    unsigned write_idx;
+    unsigned read_idx;
+
+    /* The number of filled slots, this is the only thing both sides
+     * share besides the slots themselves */
+    pa_atomic_t n_filled;
+};
+
+#define PA_CHUNKRING_SLOTS(x) ((pa_memchunk*) ((uint8_t*) (x) + PA_ALIGN(sizeof(struct pa_chunkring))))
+
+pa_chunkring* pa_chunkring_new(unsigned size) {
+    pa_chunkring *r;
+
+    if (!size)
+        size = CHUNKRING_SIZE;
+
+    pa_assert(pa_is_power_of_two(size));
+
+    r = pa_xmalloc0(PA_ALIGN(sizeof(pa_chunkring)) + (sizeof(pa_memchunk) * size));
+    r->size = size;
+    pa_atomic_store(&r->n_filled, 0);
+
+    return r;
+}
+
+void pa_chunkring_free(pa_chunkring *r) {
+    pa_memchunk chunk;
+
+    pa_assert(r);
+
+    while (pa_chunkring_pop(r, &chunk) >= 0)
+        pa_memblock_unref(chunk.memblock);
+
+    pa_xfree(r);
+}
+
+int pa_chunkring_push(pa_chunkring *r, const pa_memchunk *chunk) {
+    pa_memchunk *slot;
+
+    pa_assert(r);
+    pa_assert(chunk);
+    pa_assert(chunk->memblock);
+
+    if (pa_atomic_load(&r->n_filled) >= (int) r->size)
+        return -1;
+
+    slot = PA_CHUNKRING_SLOTS(r) + (r->write_idx & (r->size - 1));
+    *slot = *chunk;
+    pa_memblock_ref(slot->memblock);
+
+    r->write_idx++;
+
+    /* This is a full barrier, so the slot contents are visible
+     * before the reader can see the slot being filled */
+    pa_atomic_inc(&r->n_filled);
+
+    return 0;
+}
+
+int pa_chunkring_pop(pa_chunkring *r, pa_memchunk *chunk) {
+    pa_memchunk *slot;
+
+    pa_assert(r);
+    pa_assert(chunk);
+
+    if (pa_atomic_load(&r->n_filled) <= 0)
+        return -1;
+
+    slot = PA_CHUNKRING_SLOTS(r) + (r->read_idx & (r->size - 1));
+    *chunk = *slot;
+    pa_memchunk_reset(slot);
+
+    r->read_idx++;
+
+    /* Hand the slot back to the writer only after we copied it out */
+    pa_atomic_dec(&r->n_filled);
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef foopulsechunkringhfoo
+#define foopulsechunkringhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  Copyright 2004-2006 Lennart Poettering
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/def.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memchunk.h>
+
+/* A fixed size, lock-free and wait-free ring of memchunks for exactly
+ * one writer and one reader thread. Unlike pa_asyncq there is no
+ * fdsem attached: pushing never wakes up the reader and popping never
+ * wakes up the writer. It is meant for audio data that the reader
+ * picks up on its own schedule anyway (i.e. when rendering), with
+ * anything that needs an immediate reaction still being sent through
+ * a pa_asyncmsgq.
+ *
+ * pa_chunkring_push() takes a reference to the memblock, ownership
+ * of that reference is passed on to the caller of
+ * pa_chunkring_pop(). */
+
+typedef struct pa_chunkring pa_chunkring;
+
+pa_chunkring* pa_chunkring_new(unsigned size);
+void pa_chunkring_free(pa_chunkring *r);
+
+/* Returns -1 if the ring is full */
+int pa_chunkring_push(pa_chunkring *r, const pa_memchunk *chunk);
+
+/* Returns -1 if the ring is empty */
+int pa_chunkring_pop(pa_chunkring *r, pa_memchunk *chunk);
+
+#endif
@@ -0,0 +1,802 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <math.h>
+
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+
+#include "codec.h"
+
+/* Every packet starts with this header, all values little endian:
+ *
+ *   u8  codec type
+ *   u8  number of channels
+ *   u16 number of frames
+ *   u32 length of the payload following the header
+ *
+ * The payload contains the channels one after the other.
+ *
+ * PA_CODEC_LOSSLESS: u8 predictor order 0-4, followed by that many
+ * warm-up samples as s16, a u8 Rice parameter and the Rice coded
+ * residuals, padded to full bytes. Order 0xFF means the samples follow
+ * uncompressed as s16 instead. This is the fixed predictor scheme of
+ * FLAC.
+ *
+ * PA_CODEC_ADPCM: s16 predictor and u8 step index the IMA ADPCM decoder
+ * starts with, one byte padding, followed by a nibble per sample, the
+ * lower nibble first. */
+
+#define HEADER_SIZE 8
+
+/* Keeps the latency down and the frame count within 16 bits */
+#define MAX_PACKET_FRAMES 4096
+
+#define MAX_ORDER 4
+#define ORDER_VERBATIM 0xFF
+#define MAX_RICE_PARAMETER 20
+
+struct pa_codec {
+    pa_codec_type_t type;
+    pa_sample_spec sample_spec;
+    size_t frame_size;
+    unsigned packet_frames;
+    pa_mempool *pool;
+
+    /* Planar samples of one packet */
+    int32_t *work;
+
+    struct {
+        int32_t predictor;
+        int index;
+    } adpcm[PA_CHANNELS_MAX];
+
+    /* Partially received packets */
+    uint8_t *buffer;
+    size_t buffer_length, buffer_allocated;
+};
+
+static const char* const type_table[PA_CODEC_MAX] = {
+    [PA_CODEC_PCM] = "pcm",
+    [PA_CODEC_LOSSLESS] = "lossless",
+    [PA_CODEC_ADPCM] = "adpcm"
+};
+
+const char *pa_codec_type_to_string(pa_codec_type_t type) {
+    if (type >= PA_CODEC_MAX)
+        return NULL;
+
+    return type_table[type];
+}
+
+pa_codec_type_t pa_codec_type_from_string(const char *s) {
+    pa_codec_type_t i;
+
+    pa_assert(s);
+
+    for (i = 0; i < PA_CODEC_MAX; i++)
+        if (pa_streq(type_table[i], s))
+            return i;
+
+    return PA_CODEC_MAX;
+}
+
+pa_bool_t pa_codec_supported(pa_codec_type_t type, const pa_sample_spec *ss) {
+    pa_assert(ss);
+
+    switch (type) {
+
+        case PA_CODEC_PCM:
+            return TRUE;
+
+        case PA_CODEC_LOSSLESS:
+            return ss->format == PA_SAMPLE_S16LE || ss->format == PA_SAMPLE_S16BE;
+
+        case PA_CODEC_ADPCM:
+            return
+                ss->format == PA_SAMPLE_S16LE || ss->format == PA_SAMPLE_S16BE ||
+                ss->format == PA_SAMPLE_FLOAT32LE || ss->format == PA_SAMPLE_FLOAT32BE;
+
+        case PA_CODEC_MAX:
+            ;
+    }
+
+    return FALSE;
+}
+
+size_t pa_codec_packet_size(const pa_sample_spec *ss, size_t unit) {
+    size_t fs, frames, n;
+
+    pa_assert(ss);
+
+    fs = pa_frame_size(ss);
+    frames = unit / fs;
+
+    if (frames <= 0)
+        frames = pa_usec_to_bytes(20 * PA_USEC_PER_MSEC, ss) / fs;
+
+    /* Split large units evenly, so that packets stay aligned to them */
+    n = (frames + MAX_PACKET_FRAMES - 1) / MAX_PACKET_FRAMES;
+
+    return ((frames + n - 1) / n) * fs;
+}
+
+pa_codec *pa_codec_new(pa_codec_type_t type, const pa_sample_spec *ss, size_t packet_size, pa_mempool *pool) {
+    pa_codec *c;
+
+    pa_assert(ss);
+    pa_assert(pool);
+    pa_assert(type > PA_CODEC_PCM && type < PA_CODEC_MAX);
+    pa_assert(pa_codec_supported(type, ss));
+
+    c = pa_xnew0(pa_codec, 1);
+    c->type = type;
+    c->sample_spec = *ss;
+    c->frame_size = pa_frame_size(ss);
+    c->pool = pool;
+
+    c->packet_frames = (unsigned) PA_CLAMP(packet_size / c->frame_size, (size_t) 1, (size_t) MAX_PACKET_FRAMES);
+    c->work = pa_xnew(int32_t, MAX_PACKET_FRAMES * ss->channels);
+
+    pa_codec_reset(c);
+
+    return c;
+}
+
+void pa_codec_free(pa_codec *c) {
+    pa_assert(c);
+
+    pa_xfree(c->work);
+    pa_xfree(c->buffer);
+    pa_xfree(c);
+}
+
+pa_codec_type_t pa_codec_get_type(pa_codec *c) {
+    pa_assert(c);
+
+    return c->type;
+}
+
+void pa_codec_reset(pa_codec *c) {
+    unsigned i;
+
+    pa_assert(c);
+
+    for (i = 0; i < c->sample_spec.channels; i++) {
+        c->adpcm[i].predictor = 0;
+        c->adpcm[i].index = 0;
+    }
+
+    c->buffer_length = 0;
+}
+
+static void load_samples(pa_codec *c, const void *src, unsigned n) {
+    unsigned i, ch, channels = c->sample_spec.channels;
+
+    switch (c->sample_spec.format) {
+
+        case PA_SAMPLE_S16LE:
+        case PA_SAMPLE_S16BE: {
+            const int16_t *s = src;
+            pa_bool_t le = c->sample_spec.format == PA_SAMPLE_S16LE;
+
+            for (i = 0; i < n; i++)
+                for (ch = 0; ch < channels; ch++, s++)
+                    c->work[ch * n + i] = le ? PA_INT16_FROM_LE(*s) : PA_INT16_FROM_BE(*s);
+
+            break;
+        }
+
+        case PA_SAMPLE_FLOAT32LE:
+        case PA_SAMPLE_FLOAT32BE: {
+            const float *s = src;
+            pa_bool_t swap = c->sample_spec.format != PA_SAMPLE_FLOAT32NE;
+
+            for (i = 0; i < n; i++)
+                for (ch = 0; ch < channels; ch++, s++) {
+                    float v = PA_MAYBE_FLOAT32_SWAP(swap, *s);
+
+                    v = PA_CLAMP_UNLIKELY(v, -1.0f, 1.0f);
+                    c->work[ch * n + i] = (int32_t) lrintf(v * 0x7FFF);
+                }
+
+            break;
+        }
+
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void store_samples(pa_codec *c, void *dst, unsigned n) {
+    unsigned i, ch, channels = c->sample_spec.channels;
+
+    switch (c->sample_spec.format) {
+
+        case PA_SAMPLE_S16LE:
+        case PA_SAMPLE_S16BE: {
+            int16_t *d = dst;
+            pa_bool_t le = c->sample_spec.format == PA_SAMPLE_S16LE;
+
+            for (i = 0; i < n; i++)
+                for (ch = 0; ch < channels; ch++, d++) {
+                    int16_t v = (int16_t) c->work[ch * n + i];
+                    *d = le ? PA_INT16_TO_LE(v) : PA_INT16_TO_BE(v);
+                }
+
+            break;
+        }
+
+        case PA_SAMPLE_FLOAT32LE:
+        case PA_SAMPLE_FLOAT32BE: {
+            float *d = dst;
+            pa_bool_t swap = c->sample_spec.format != PA_SAMPLE_FLOAT32NE;
+
+            for (i = 0; i < n; i++)
+                for (ch = 0; ch < channels; ch++, d++) {
+                    float v = (float) c->work[ch * n + i] / 0x7FFF;
+                    *d = PA_MAYBE_FLOAT32_SWAP(swap, v);
+                }
+
+            break;
+        }
+
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void write_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+static uint16_t read_u16(const uint8_t *p) {
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static void write_u32(uint8_t *p, uint32_t v) {
+    write_u16(p, (uint16_t) v);
+    write_u16(p + 2, (uint16_t) (v >> 16));
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    return (uint32_t) read_u16(p) | ((uint32_t) read_u16(p + 2) << 16);
+}
+
+/* Lossless */
+
+struct bit_writer {
+    uint8_t *data;
+    size_t index;
+    uint64_t acc;
+    unsigned bits;
+};
+
+static void put_bits(struct bit_writer *w, uint32_t v, unsigned n) {
+    pa_assert(n <= 32);
+
+    w->acc = (w->acc << n) | v;
+    w->bits += n;
+
+    while (w->bits >= 8) {
+        w->bits -= 8;
+        w->data[w->index++] = (uint8_t) (w->acc >> w->bits);
+    }
+}
+
+static void put_rice(struct bit_writer *w, uint32_t u, unsigned k) {
+    uint32_t q = u >> k;
+
+    for (; q >= 16; q -= 16)
+        put_bits(w, 0, 16);
+
+    put_bits(w, 1, q + 1);
+
+    if (k > 0)
+        put_bits(w, u & ((1U << k) - 1), k);
+}
+
+static size_t flush_bits(struct bit_writer *w) {
+    if (w->bits > 0)
+        put_bits(w, 0, 8 - w->bits);
+
+    return w->index;
+}
+
+struct bit_reader {
+    const uint8_t *data;
+    size_t length;
+    size_t index; /* in bits */
+};
+
+static int get_bits(struct bit_reader *r, unsigned n, uint32_t *v) {
+    uint32_t x = 0;
+
+    if (r->index + n > r->length * 8)
+        return -1;
+
+    for (; n > 0; n--, r->index++)
+        x = (x << 1) | ((r->data[r->index >> 3] >> (7 - (r->index & 7))) & 1);
+
+    *v = x;
+    return 0;
+}
+
+static int get_rice(struct bit_reader *r, unsigned k, uint32_t *u) {
+    uint32_t q = 0, b;
+
+    for (;;) {
+        if (r->index >= r->length * 8)
+            return -1;
+
+        /* Skip whole zero bytes quickly */
+        if ((r->index & 7) == 0 && r->data[r->index >> 3] == 0) {
+            r->index += 8;
+            q += 8;
+        } else {
+            b = (r->data[r->index >> 3] >> (7 - (r->index & 7))) & 1;
+            r->index++;
+
+            if (b)
+                break;
+
+            q++;
+        }
+
+        /* Residuals of s16 data are never that large */
+        if (q > (1U << 22))
+            return -1;
+    }
+
+    if (q > (UINT32_MAX >> k))
+        return -1;
+
+    if (get_bits(r, k, &b) < 0)
+        return -1;
+
+    *u = (q << k) | b;
+    return 0;
+}
+
+static inline int32_t predict(const int32_t *x, unsigned i, unsigned order) {
+    switch (order) {
+        case 0: return 0;
+        case 1: return x[i-1];
+        case 2: return 2*x[i-1] - x[i-2];
+        case 3: return 3*x[i-1] - 3*x[i-2] + x[i-3];
+        case 4: return 4*x[i-1] - 6*x[i-2] + 4*x[i-3] - x[i-4];
+    }
+
+    pa_assert_not_reached();
+}
+
+static inline uint32_t zigzag(int32_t r) {
+    return ((uint32_t) r << 1) ^ (uint32_t) (r >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t u) {
+    return (int32_t) (u >> 1) ^ -(int32_t) (u & 1);
+}
+
+static uint64_t rice_bits(const int32_t *x, unsigned n, unsigned order, unsigned k) {
+    uint64_t bits;
+    unsigned i;
+
+    bits = (uint64_t) (n - order) * (k + 1);
+
+    for (i = order; i < n; i++)
+        bits += zigzag(x[i] - predict(x, i, order)) >> k;
+
+    return bits;
+}
+
+static size_t encode_lossless_channel(const int32_t *x, unsigned n, uint8_t *d) {
+    unsigned order, best_order = 0, k, best_k = 0, i;
+    uint64_t best_sum = (uint64_t) -1, best_bits = (uint64_t) -1;
+    struct bit_writer w;
+
+    /* Pick the predictor that leaves the smallest residuals... */
+    for (order = 0; order <= MAX_ORDER && order < n; order++) {
+        uint64_t sum = 0;
+
+        for (i = order; i < n; i++)
+            sum += zigzag(x[i] - predict(x, i, order));
+
+        if (sum < best_sum) {
+            best_sum = sum;
+            best_order = order;
+        }
+    }
+
+    /* ...and the Rice parameter that fits their mean best */
+    for (k = 0; k < MAX_RICE_PARAMETER && ((uint64_t) (n - best_order) << (k + 1)) < best_sum; k++)
+        ;
+
+    for (i = k > 0 ? k - 1 : 0; i <= k; i++) {
+        uint64_t bits = rice_bits(x, n, best_order, i);
+
+        if (bits < best_bits) {
+            best_bits = bits;
+            best_k = i;
+        }
+    }
+
+    if (2 + 2 * best_order + (best_bits + 7) / 8 >= 1 + 2 * (uint64_t) n) {
+        d[0] = ORDER_VERBATIM;
+
+        for (i = 0; i < n; i++)
+            write_u16(d + 1 + 2 * i, (uint16_t) x[i]);
+
+        return 1 + 2 * n;
+    }
+
+    d[0] = (uint8_t) best_order;
+
+    for (i = 0; i < best_order; i++)
+        write_u16(d + 1 + 2 * i, (uint16_t) x[i]);
+
+    d[1 + 2 * best_order] = (uint8_t) best_k;
+
+    w.data = d + 2 + 2 * best_order;
+    w.index = 0;
+    w.acc = 0;
+    w.bits = 0;
+
+    for (i = best_order; i < n; i++)
+        put_rice(&w, zigzag(x[i] - predict(x, i, best_order)), best_k);
+
+    return 2 + 2 * best_order + flush_bits(&w);
+}
+
+static int decode_lossless_channel(int32_t *x, unsigned n, const uint8_t *s, size_t length, size_t *consumed) {
+    unsigned order, k, i;
+    struct bit_reader r;
+
+    if (length < 1)
+        return -1;
+
+    order = s[0];
+
+    if (order == ORDER_VERBATIM) {
+        if (length < 1 + 2 * (size_t) n)
+            return -1;
+
+        for (i = 0; i < n; i++)
+            x[i] = (int16_t) read_u16(s + 1 + 2 * i);
+
+        *consumed = 1 + 2 * n;
+        return 0;
+    }
+
+    if (order > MAX_ORDER || order > n || length < 2 + 2 * (size_t) order)
+        return -1;
+
+    for (i = 0; i < order; i++)
+        x[i] = (int16_t) read_u16(s + 1 + 2 * i);
+
+    if ((k = s[1 + 2 * order]) > MAX_RICE_PARAMETER)
+        return -1;
+
+    r.data = s + 2 + 2 * order;
+    r.length = length - 2 - 2 * order;
+    r.index = 0;
+
+    for (i = order; i < n; i++) {
+        uint32_t u;
+        int64_t v;
+
+        if (get_rice(&r, k, &u) < 0)
+            return -1;
+
+        /* The residual comes from the client and may be anything */
+        v = (int64_t) predict(x, i, order) + unzigzag(u);
+
+        if (v < -0x8000 || v > 0x7FFF)
+            return -1;
+
+        x[i] = (int32_t) v;
+    }
+
+    *consumed = 2 + 2 * order + (r.index + 7) / 8;
+    return 0;
+}
+
+/* IMA ADPCM */
+
+static const int adpcm_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int adpcm_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static inline void adpcm_step(int32_t *predictor, int *index, unsigned nibble) {
+    int step = adpcm_step_table[*index];
+    int32_t diff = step >> 3;
+
+    if (nibble & 4)
+        diff += step;
+    if (nibble & 2)
+        diff += step >> 1;
+    if (nibble & 1)
+        diff += step >> 2;
+
+    *predictor += (nibble & 8) ? -diff : diff;
+    *predictor = PA_CLAMP(*predictor, -0x8000, 0x7FFF);
+
+    *index += adpcm_index_table[nibble];
+    *index = PA_CLAMP(*index, 0, 88);
+}
+
+static size_t encode_adpcm_channel(pa_codec *c, unsigned ch, const int32_t *x, unsigned n, uint8_t *d) {
+    int32_t predictor = c->adpcm[ch].predictor;
+    int index = c->adpcm[ch].index;
+    unsigned i;
+
+    write_u16(d, (uint16_t) predictor);
+    d[2] = (uint8_t) index;
+    d[3] = 0;
+    d += 4;
+
+    for (i = 0; i < n; i++) {
+        int step = adpcm_step_table[index];
+        int32_t diff = x[i] - predictor;
+        unsigned nibble = 0;
+
+        if (diff < 0) {
+            nibble = 8;
+            diff = -diff;
+        }
+
+        if (diff >= step) {
+            nibble |= 4;
+            diff -= step;
+        }
+        if (diff >= step >> 1) {
+            nibble |= 2;
+            diff -= step >> 1;
+        }
+        if (diff >= step >> 2)
+            nibble |= 1;
+
+        adpcm_step(&predictor, &index, nibble);
+
+        if (i & 1)
+            d[i / 2] |= (uint8_t) (nibble << 4);
+        else
+            d[i / 2] = (uint8_t) nibble;
+    }
+
+    c->adpcm[ch].predictor = predictor;
+    c->adpcm[ch].index = index;
+
+    return 4 + (n + 1) / 2;
+}
+
+static int decode_adpcm_channel(int32_t *x, unsigned n, const uint8_t *s, size_t length, size_t *consumed) {
+    int32_t predictor;
+    int index;
+    unsigned i;
+
+    if (length < 4 + ((size_t) n + 1) / 2)
+        return -1;
+
+    predictor = (int16_t) read_u16(s);
+
+    if ((index = s[2]) > 88)
+        return -1;
+
+    s += 4;
+
+    for (i = 0; i < n; i++) {
+        adpcm_step(&predictor, &index, (i & 1) ? s[i / 2] >> 4 : s[i / 2] & 0xF);
+        x[i] = predictor;
+    }
+
+    *consumed = 4 + (n + 1) / 2;
+    return 0;
+}
+
+static size_t max_payload(pa_codec *c, unsigned n) {
+    if (c->type == PA_CODEC_LOSSLESS)
+        return (1 + 2 * (size_t) n) * c->sample_spec.channels;
+
+    return (4 + ((size_t) n + 1) / 2) * c->sample_spec.channels;
+}
+
+size_t pa_codec_encode(pa_codec *c, const pa_memchunk *chunk, pa_memchunk *packet) {
+    unsigned n, ch;
+    size_t length = 0;
+    void *src;
+    uint8_t *d;
+
+    pa_assert(c);
+    pa_assert(chunk);
+    pa_assert(chunk->memblock);
+    pa_assert(packet);
+
+    n = (unsigned) PA_MIN(chunk->length / c->frame_size, c->packet_frames);
+    pa_assert(n > 0);
+
+    src = pa_memblock_acquire(chunk->memblock);
+    load_samples(c, (uint8_t*) src + chunk->index, n);
+    pa_memblock_release(chunk->memblock);
+
+    packet->memblock = pa_memblock_new(c->pool, HEADER_SIZE + max_payload(c, n));
+    packet->index = 0;
+
+    d = pa_memblock_acquire(packet->memblock);
+
+    for (ch = 0; ch < c->sample_spec.channels; ch++) {
+        uint8_t *p = d + HEADER_SIZE + length;
+
+        if (c->type == PA_CODEC_LOSSLESS)
+            length += encode_lossless_channel(c->work + ch * n, n, p);
+        else
+            length += encode_adpcm_channel(c, ch, c->work + ch * n, n, p);
+    }
+
+    d[0] = (uint8_t) c->type;
+    d[1] = c->sample_spec.channels;
+    write_u16(d + 2, (uint16_t) n);
+    write_u32(d + 4, (uint32_t) length);
+
+    pa_memblock_release(packet->memblock);
+
+    packet->length = HEADER_SIZE + length;
+
+    return n * c->frame_size;
+}
+
+/* Returns the size of the packet at p, 0 if incomplete, (size_t) -1 if corrupt */
+static size_t check_packet(pa_codec *c, const uint8_t *p, size_t length, unsigned *n) {
+    size_t payload;
+
+    if (length < HEADER_SIZE)
+        return 0;
+
+    *n = read_u16(p + 2);
+    payload = read_u32(p + 4);
+
+    if (p[0] != c->type ||
+        p[1] != c->sample_spec.channels ||
+        *n <= 0 || *n > MAX_PACKET_FRAMES ||
+        payload > max_payload(c, *n))
+        return (size_t) -1;
+
+    if (length < HEADER_SIZE + payload)
+        return 0;
+
+    return HEADER_SIZE + payload;
+}
+
+static int decode_packet(pa_codec *c, const uint8_t *p, size_t length, unsigned n, void *dst) {
+    unsigned ch;
+
+    p += HEADER_SIZE;
+    length -= HEADER_SIZE;
+
+    for (ch = 0; ch < c->sample_spec.channels; ch++) {
+        size_t consumed;
+        int r;
+
+        if (c->type == PA_CODEC_LOSSLESS)
+            r = decode_lossless_channel(c->work + ch * n, n, p, length, &consumed);
+        else
+            r = decode_adpcm_channel(c->work + ch * n, n, p, length, &consumed);
+
+        if (r < 0)
+            return -1;
+
+        p += consumed;
+        length -= consumed;
+    }
+
+    if (length > 0)
+        return -1;
+
+    store_samples(c, dst, n);
+    return 0;
+}
+
+int pa_codec_decode(pa_codec *c, const pa_memchunk *data, pa_memchunk *chunk) {
+    size_t index = 0, frames = 0, l;
+    uint8_t *d;
+    unsigned n;
+
+    pa_assert(c);
+    pa_assert(data);
+    pa_assert(data->memblock);
+    pa_assert(chunk);
+
+    pa_memchunk_reset(chunk);
+
+    if (c->buffer_length + data->length > c->buffer_allocated) {
+        c->buffer_allocated = PA_MAX(c->buffer_length + data->length, 2 * c->buffer_allocated);
+        c->buffer = pa_xrealloc(c->buffer, c->buffer_allocated);
+    }
+
+    d = pa_memblock_acquire(data->memblock);
+    memcpy(c->buffer + c->buffer_length, d + data->index, data->length);
+    pa_memblock_release(data->memblock);
+
+    c->buffer_length += data->length;
+
+    /* Find out how much we can decode */
+    while ((l = check_packet(c, c->buffer + index, c->buffer_length - index, &n)) > 0) {
+
+        if (l == (size_t) -1) {
+            pa_log_warn("Received corrupt %s packet.", pa_codec_type_to_string(c->type));
+            return -1;
+        }
+
+        index += l;
+        frames += n;
+    }
+
+    if (frames <= 0)
+        return 0;
+
+    chunk->memblock = pa_memblock_new(c->pool, frames * c->frame_size);
+    chunk->length = frames * c->frame_size;
+
+    d = pa_memblock_acquire(chunk->memblock);
+
+    for (index = 0; (l = check_packet(c, c->buffer + index, c->buffer_length - index, &n)) > 0; index += l) {
+
+        if (decode_packet(c, c->buffer + index, l, n, d + chunk->index) < 0) {
+            pa_log_warn("Received corrupt %s packet.", pa_codec_type_to_string(c->type));
+            pa_memblock_release(chunk->memblock);
+            pa_memblock_unref(chunk->memblock);
+            pa_memchunk_reset(chunk);
+            return -1;
+        }
+
+        chunk->index += n * c->frame_size;
+    }
+
+    pa_memblock_release(chunk->memblock);
+
+    chunk->index = 0;
+
+    c->buffer_length -= index;
+    memmove(c->buffer, c->buffer + index, c->buffer_length);
+
+    return 0;
+}
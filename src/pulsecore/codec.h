@@ -0,0 +1,76 @@
+#ifndef foopulsecodechfoo
+#define foopulsecodechfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/memchunk.h>
+
+/* Compression of the audio data of a stream, for transports where
+ * bandwidth matters more than CPU time. The encoder turns PCM into
+ * self-delimiting packets. The decoder may be fed those in arbitrary
+ * pieces, as they come out of a pa_pstream. */
+
+/* These values are sent over the wire, don't change them */
+typedef enum pa_codec_type {
+    PA_CODEC_PCM = 0,           /* No compression at all */
+    PA_CODEC_LOSSLESS = 1,      /* Fixed linear prediction and Rice coding */
+    PA_CODEC_ADPCM = 2,         /* IMA ADPCM, lossy, 4 bits per sample */
+    PA_CODEC_MAX
+} pa_codec_type_t;
+
+typedef struct pa_codec pa_codec;
+
+const char *pa_codec_type_to_string(pa_codec_type_t type);
+pa_codec_type_t pa_codec_type_from_string(const char *s);
+
+/* Returns TRUE if the codec can encode this sample type. PA_CODEC_PCM
+ * supports everything. */
+pa_bool_t pa_codec_supported(pa_codec_type_t type, const pa_sample_spec *ss);
+
+/* Returns how many bytes of PCM should go into one packet for a
+ * stream that is requested/sent in units of 'unit' bytes */
+size_t pa_codec_packet_size(const pa_sample_spec *ss, size_t unit);
+
+/* Creates a codec for encoding and decoding one stream. packet_size
+ * is the maximum amount of PCM that goes into one packet, it is
+ * rounded down to a multiple of the frame size. */
+pa_codec *pa_codec_new(pa_codec_type_t type, const pa_sample_spec *ss, size_t packet_size, pa_mempool *pool);
+void pa_codec_free(pa_codec *c);
+
+pa_codec_type_t pa_codec_get_type(pa_codec *c);
+
+/* Encodes the beginning of the frame aligned chunk into one packet
+ * that is returned in *packet. Returns how much of chunk was
+ * consumed. */
+size_t pa_codec_encode(pa_codec *c, const pa_memchunk *chunk, pa_memchunk *packet);
+
+/* Feeds the decoder with encoded data. Everything that could be
+ * decoded is returned in *chunk, whose memblock is NULL if there was
+ * nothing. Returns a negative value if the data is corrupt. */
+int pa_codec_decode(pa_codec *c, const pa_memchunk *data, pa_memchunk *chunk);
+
+/* Forget about partially received packets and the encoder state */
+void pa_codec_reset(pa_codec *c);
+
+#endif
@@ -141,7 +141,9 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
     c->realtime_priority = 5;
     c->disable_remixing = FALSE;
     c->disable_lfe_remixing = FALSE;
+    c->shared_resamplers = FALSE;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 3;
+    pa_atomic_store(&c->render_profiling, 0);
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
         pa_hook_init(&c->hooks[j], c);
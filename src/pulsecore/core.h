@@ -157,10 +157,15 @@ struct pa_core {
     pa_bool_t realtime_scheduling:1;
     pa_bool_t disable_remixing:1;
     pa_bool_t disable_lfe_remixing:1;
+    pa_bool_t shared_resamplers:1;
 
     pa_resample_method_t resample_method;
     int realtime_priority;
 
+    /* Set once a client asked for the render profile, the IO threads
+     * skip the histogram probes until then */
+    pa_atomic_t render_profiling;
+
     /* hooks */
     pa_hook hooks[PA_CORE_HOOK_MAX];
 };
@@ -135,5 +135,10 @@ void pa_cpu_init_arm (void) {
 
     if (flags & PA_CPU_ARM_V6)
         pa_volume_func_init_arm (flags);
+
+    if (flags & PA_CPU_ARM_NEON) {
+        pa_mix_func_init_neon (flags);
+        pa_resampler_func_init_neon (flags);
+    }
 #endif /* defined (__arm__) */
 }
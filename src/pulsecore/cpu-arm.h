@@ -39,4 +39,8 @@ void pa_cpu_init_arm (void);
 /* some optimized functions */
 void pa_volume_func_init_arm(pa_cpu_arm_flag_t flags);
 
+void pa_mix_func_init_neon(pa_cpu_arm_flag_t flags);
+
+void pa_resampler_func_init_neon(pa_cpu_arm_flag_t flags);
+
 #endif /* foocpuarmhfoo */
@@ -41,9 +41,24 @@ get_cpuid (uint32_t op, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d)
         "  pop %%"PA_REG_b"    \n\t"
 
         : "=a" (*a), "=S" (*b), "=c" (*c), "=d" (*d)
-        : "0" (op)
+        : "0" (op), "2" (0)
     );
 }
+
+static uint32_t
+get_xgetbv (uint32_t index)
+{
+    uint32_t eax, edx;
+
+    __asm__ __volatile__ (
+        "  xgetbv              \n\t"
+
+        : "=a" (eax), "=d" (edx)
+        : "c" (index)
+    );
+
+    return eax;
+}
 #endif
 
 void pa_cpu_init_x86 (void) {
@@ -77,6 +92,17 @@ void pa_cpu_init_x86 (void) {
 
         if (ecx & (1<<20))
           flags |= PA_CPU_X86_SSE4_2;
+
+        /* AVX needs the OS to save the YMM state on context switches */
+        if ((ecx & (1<<27)) && (ecx & (1<<28)) && (get_xgetbv (0) & 0x6) == 0x6)
+          flags |= PA_CPU_X86_AVX;
+    }
+
+    if (level >= 7) {
+        get_cpuid (0x00000007, &eax, &ebx, &ecx, &edx);
+
+        if ((ebx & (1<<5)) && (flags & PA_CPU_X86_AVX))
+          flags |= PA_CPU_X86_AVX2;
     }
 
     /* get extended level */
@@ -97,7 +123,7 @@ void pa_cpu_init_x86 (void) {
           flags |= PA_CPU_X86_3DNOW;
     }
 
-    pa_log_info ("CPU flags: %s%s%s%s%s%s%s%s%s%s",
+    pa_log_info ("CPU flags: %s%s%s%s%s%s%s%s%s%s%s%s",
     (flags & PA_CPU_X86_MMX) ? "MMX " : "",
     (flags & PA_CPU_X86_SSE) ? "SSE " : "",
     (flags & PA_CPU_X86_SSE2) ? "SSE2 " : "",
@@ -105,6 +131,8 @@ void pa_cpu_init_x86 (void) {
     (flags & PA_CPU_X86_SSSE3) ? "SSSE3 " : "",
     (flags & PA_CPU_X86_SSE4_1) ? "SSE4_1 " : "",
     (flags & PA_CPU_X86_SSE4_2) ? "SSE4_2 " : "",
+    (flags & PA_CPU_X86_AVX) ? "AVX " : "",
+    (flags & PA_CPU_X86_AVX2) ? "AVX2 " : "",
     (flags & PA_CPU_X86_MMXEXT) ? "MMXEXT " : "",
     (flags & PA_CPU_X86_3DNOW) ? "3DNOW " : "",
     (flags & PA_CPU_X86_3DNOWEXT) ? "3DNOWEXT " : "");
@@ -119,6 +147,8 @@ void pa_cpu_init_x86 (void) {
         pa_volume_func_init_sse (flags);
         pa_remap_func_init_sse (flags);
         pa_convert_func_init_sse (flags);
+        pa_mix_func_init_sse (flags);
+        pa_resampler_func_init_sse (flags);
     }
 
 #endif /* defined (__i386__) || defined (__amd64__) */
@@ -35,7 +35,9 @@ typedef enum pa_cpu_x86_flag {
     PA_CPU_X86_SSE4_1    = (1 << 6),
     PA_CPU_X86_SSE4_2    = (1 << 7),
     PA_CPU_X86_3DNOW     = (1 << 8),
-    PA_CPU_X86_3DNOWEXT  = (1 << 9)
+    PA_CPU_X86_3DNOWEXT  = (1 << 9),
+    PA_CPU_X86_AVX       = (1 << 10),
+    PA_CPU_X86_AVX2      = (1 << 11)
 } pa_cpu_x86_flag_t;
 
 void pa_cpu_init_x86 (void);
@@ -68,4 +70,8 @@ void pa_remap_func_init_sse(pa_cpu_x86_flag_t flags);
 
 void pa_convert_func_init_sse (pa_cpu_x86_flag_t flags);
 
+void pa_mix_func_init_sse (pa_cpu_x86_flag_t flags);
+
+void pa_resampler_func_init_sse(pa_cpu_x86_flag_t flags);
+
 #endif /* foocpux86hfoo */
@@ -0,0 +1,157 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/macro.h>
+
+#include "drift.h"
+
+/*
+ * The latency changes with the difference between the rate at which
+ * data is produced and the rate at which we consume it:
+ *
+ *   d latency / dt = drift - correction
+ *
+ * We control the correction with a PI controller on the latency
+ * error:
+ *
+ *   correction = Kp * e + Ki * integral(e)
+ *
+ * With Kp = 2/T and Ki = 1/T^2 the closed loop is critically damped
+ * with time constant T. The measurements jitter by up to a fragment
+ * since data is passed around in blocks, hence the error is run
+ * through a first order low pass with a time constant much shorter
+ * than T before it is used.
+ */
+
+struct pa_drift {
+    double base_rate;
+    double kp, ki;
+    double filter_time; /* in s */
+
+    pa_usec_t target;
+
+    pa_bool_t valid;
+    pa_usec_t last;
+    double error;       /* filtered, in s */
+    double integral;    /* relative rate deviation, i.e. the drift estimate */
+    double rate;
+};
+
+pa_drift* pa_drift_new(uint32_t base_rate, pa_usec_t time_constant) {
+    pa_drift *d;
+    double t;
+
+    pa_assert(base_rate > 0);
+    pa_assert(time_constant > 0);
+
+    t = (double) time_constant / PA_USEC_PER_SEC;
+
+    d = pa_xnew0(pa_drift, 1);
+    d->base_rate = base_rate;
+    d->kp = 2.0 / t;
+    d->ki = 1.0 / (t * t);
+    d->filter_time = t / 10.0;
+    d->target = (pa_usec_t) -1;
+    d->rate = base_rate;
+
+    return d;
+}
+
+void pa_drift_free(pa_drift *d) {
+    pa_assert(d);
+
+    pa_xfree(d);
+}
+
+void pa_drift_set_target(pa_drift *d, pa_usec_t target) {
+    pa_assert(d);
+
+    if (d->target == target)
+        return;
+
+    d->target = target;
+
+    /* The filtered error is relative to the old target */
+    d->valid = FALSE;
+}
+
+pa_usec_t pa_drift_get_target(pa_drift *d) {
+    pa_assert(d);
+
+    return d->target;
+}
+
+double pa_drift_update(pa_drift *d, pa_usec_t now, pa_usec_t latency) {
+    double e, dt, c;
+
+    pa_assert(d);
+
+    if (d->target == (pa_usec_t) -1)
+        return d->rate;
+
+    e = ((double) latency - (double) d->target) / PA_USEC_PER_SEC;
+
+    if (!d->valid || now <= d->last) {
+
+        /* Start the filter right at the first measurement, so that
+         * we don't need to wait for it to settle */
+        if (!d->valid)
+            d->error = e;
+
+        d->last = now;
+        d->valid = TRUE;
+        return d->rate;
+    }
+
+    dt = (double) (now - d->last) / PA_USEC_PER_SEC;
+    d->last = now;
+
+    d->error += (e - d->error) * dt / (d->filter_time + dt);
+
+    /* Clamping the integral keeps it from winding up while the
+     * output is saturated */
+    d->integral += d->ki * d->error * dt;
+    d->integral = PA_CLAMP(d->integral, -PA_DRIFT_MAX_DEVIATION, PA_DRIFT_MAX_DEVIATION);
+
+    c = d->kp * d->error + d->integral;
+    c = PA_CLAMP(c, -PA_DRIFT_MAX_DEVIATION, PA_DRIFT_MAX_DEVIATION);
+
+    d->rate = d->base_rate * (1.0 + c);
+
+    return d->rate;
+}
+
+double pa_drift_get_rate(pa_drift *d) {
+    pa_assert(d);
+
+    return d->rate;
+}
+
+void pa_drift_reset(pa_drift *d) {
+    pa_assert(d);
+
+    d->valid = FALSE;
+}
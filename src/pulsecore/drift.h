@@ -0,0 +1,67 @@
+#ifndef foopulsedrifthfoo
+#define foopulsedrifthfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+
+#include <pulsecore/macro.h>
+
+/* Clock drift compensation for streams that are passed between two
+ * devices running on different clocks, as in module-combine,
+ * module-loopback and module-rtp-recv. The latency (or queue length)
+ * between the two clocks is fed in every time data is passed on. A
+ * PI controller derives the resampler input rate from it that keeps
+ * the latency at the target. The integral part converges to the real
+ * clock drift, so the rate is a fractional value that does not jump
+ * around once things are settled.
+ *
+ * The object is not thread safe, everything but pa_drift_new() and
+ * pa_drift_free() is supposed to be called from the IO thread that
+ * runs the stream. */
+
+/* Never deviate from the nominal rate by more than this */
+#define PA_DRIFT_MAX_DEVIATION 0.05
+
+typedef struct pa_drift pa_drift;
+
+/* time_constant controls how fast we react: an error in latency is
+ * mostly corrected after twice that time. Larger values mean
+ * smoother rate changes. */
+pa_drift* pa_drift_new(uint32_t base_rate, pa_usec_t time_constant);
+void pa_drift_free(pa_drift *d);
+
+/* The latency we want to keep. (pa_usec_t) -1 disables the controller
+ * until a target is set, the rate is left alone in that case. */
+void pa_drift_set_target(pa_drift *d, pa_usec_t target);
+pa_usec_t pa_drift_get_target(pa_drift *d);
+
+/* Feeds a new measurement of the latency taken at now and returns
+ * the input rate to use from now on, in Hz */
+double pa_drift_update(pa_drift *d, pa_usec_t now, pa_usec_t latency);
+
+/* The current rate, as returned by the last pa_drift_update() */
+double pa_drift_get_rate(pa_drift *d);
+
+/* Forget the current measurements, for example after an underrun or
+ * when the stream has been moved. The estimated drift is kept. */
+void pa_drift_reset(pa_drift *d);
+
+#endif
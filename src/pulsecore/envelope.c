@@ -624,7 +624,7 @@ void pa_envelope_apply(pa_envelope *e, pa_memchunk *chunk) {
 
                     for (c = 0; c < e->sample_spec.channels; c++, t++) {
                         int16_t k = st_ulaw2linear16(*t);
-                        *t = (uint8_t) st_14linear2ulaw((int16_t) (((factor * k) / 0x10000) >> 2));
+                        *t = (uint8_t) st_14linear2ulaw((int16_t) PA_CLAMP_UNLIKELY(((factor * k) / 0x10000) >> 2, -0x2000, 0x1FFF));
                     }
                 }
 
@@ -641,7 +641,7 @@ void pa_envelope_apply(pa_envelope *e, pa_memchunk *chunk) {
 
                     for (c = 0; c < e->sample_spec.channels; c++, t++) {
                         int16_t k = st_alaw2linear16(*t);
-                        *t = (uint8_t) st_13linear2alaw((int16_t) (((factor * k) / 0x10000) >> 3));
+                        *t = (uint8_t) st_13linear2alaw((int16_t) PA_CLAMP_UNLIKELY(((factor * k) / 0x10000) >> 3, -0x1000, 0xFFF));
                     }
                 }
 
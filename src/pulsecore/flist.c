@@ -23,10 +23,14 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/atomic.h>
+#include <pulsecore/llist.h>
 #include <pulsecore/log.h>
+#include <pulsecore/mutex.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
@@ -63,11 +67,30 @@
  * stack or queue, which however requires DCAS to be simple. Patches
  * welcome.
  *
- * Please note that this algorithm is home grown.*/
+ * Please note that this algorithm is home grown.
+ *
+ * Since the list is shared by all threads the counters and the cells
+ * bounce between the CPU caches when it is used heavily. Lists
+ * created with pa_flist_new_with_magazines() hence put a small per
+ * thread cache -- a "magazine", as slab allocators call it -- in
+ * front of the shared list. Pushing and popping usually only touches
+ * the magazine of the calling thread. Only when it runs full or empty
+ * half of it is moved from or to the shared list in one go, which
+ * requires only a single update of the counters. All magazines are
+ * also kept in a list, protected by a mutex since they are created
+ * and destroyed only rarely, so that pa_flist_free() can reach the
+ * ones of the other threads. */
 
 #define FLIST_SIZE 128
 #define N_EXTRA_SCAN 3
 
+/* Entries per thread cache, half of it is moved at once */
+#define MAGAZINE_SIZE 32
+
+/* Assumed size of a cache line, used to keep data modified by
+ * different threads apart */
+#define CACHE_LINE_SIZE 64
+
 /* For debugging purposes we can define _Y to put and extra thread
  * yield between each operation. */
 
@@ -77,14 +100,41 @@
 #define _Y do { } while(0)
 #endif
 
+/* A counter on a cache line of its own */
+typedef union padded_atomic {
+    pa_atomic_t value;
+    uint8_t padding[CACHE_LINE_SIZE];
+} padded_atomic;
+
 struct pa_flist {
     unsigned size;
-    pa_atomic_t length;
-    pa_atomic_t read_idx;
-    pa_atomic_t write_idx;
+    pa_atomic_ptr_t *cells;
+
+    pa_free_cb_t free_cb;
+    pa_tls *magazines;
+
+    pa_mutex *mutex;
+    PA_LLIST_HEAD(struct magazine, all_magazines);
+
+    /* Separates the fields above, which are only read, from the
+     * counters */
+    uint8_t padding[CACHE_LINE_SIZE];
+
+    padded_atomic length;
+    padded_atomic read_idx;
+    padded_atomic write_idx;
 };
 
-#define PA_FLIST_CELLS(x) ((pa_atomic_ptr_t*) ((uint8_t*) (x) + PA_ALIGN(sizeof(struct pa_flist))))
+typedef struct magazine {
+    pa_flist *flist;
+    unsigned n;
+    void *items[MAGAZINE_SIZE];
+
+    PA_LLIST_FIELDS(struct magazine);
+} magazine;
+
+#define CELLS_OFFSET (sizeof(struct pa_flist) + CACHE_LINE_SIZE)
+#define ALIGN_CACHE_LINE(p) ((void*) (((uintptr_t) (p) + CACHE_LINE_SIZE - 1) & ~(uintptr_t) (CACHE_LINE_SIZE - 1)))
 
 pa_flist *pa_flist_new(unsigned size) {
     pa_flist *l;
@@ -94,13 +144,14 @@ pa_flist *pa_flist_new(unsigned size) {
 
     pa_assert(pa_is_power_of_two(size));
 
-    l = pa_xmalloc0(PA_ALIGN(sizeof(pa_flist)) + (sizeof(pa_atomic_ptr_t) * size));
+    l = pa_xmalloc0(CELLS_OFFSET + (sizeof(pa_atomic_ptr_t) * size));
 
     l->size = size;
+    l->cells = ALIGN_CACHE_LINE((uint8_t*) l + sizeof(struct pa_flist));
 
-    pa_atomic_store(&l->read_idx, 0);
-    pa_atomic_store(&l->write_idx, 0);
-    pa_atomic_store(&l->length, 0);
+    pa_atomic_store(&l->read_idx.value, 0);
+    pa_atomic_store(&l->write_idx.value, 0);
+    pa_atomic_store(&l->length.value, 0);
 
     return l;
 }
@@ -109,123 +160,244 @@ static unsigned reduce(pa_flist *l, unsigned value) {
     return value & (l->size - 1);
 }
 
-void pa_flist_free(pa_flist *l, pa_free_cb_t free_cb) {
-    pa_assert(l);
-
-    if (free_cb) {
-        pa_atomic_ptr_t*cells;
-        unsigned idx;
-
-        cells = PA_FLIST_CELLS(l);
-
-        for (idx = 0; idx < l->size; idx ++) {
-            void *p;
-
-            if ((p = pa_atomic_ptr_load(&cells[idx])))
-                free_cb(p);
-        }
-    }
-
-    pa_xfree(l);
-}
-
-int pa_flist_push(pa_flist*l, void *p) {
-    unsigned idx, n;
-    pa_atomic_ptr_t*cells;
+/* Moves up to n entries to the shared list, returns how many it took */
+static unsigned shared_push(pa_flist *l, void **p, unsigned n) {
+    unsigned idx, k, pushed = 0;
 #ifdef PROFILE
     unsigned len;
 #endif
 
-    pa_assert(l);
-    pa_assert(p);
-
-    cells = PA_FLIST_CELLS(l);
-
-    n = l->size + N_EXTRA_SCAN - (unsigned) pa_atomic_load(&l->length);
+    k = l->size + N_EXTRA_SCAN - (unsigned) pa_atomic_load(&l->length.value);
 
 #ifdef PROFILE
-    len = n;
+    len = k;
 #endif
 
     _Y;
-    idx = reduce(l, (unsigned) pa_atomic_load(&l->write_idx));
+    idx = reduce(l, (unsigned) pa_atomic_load(&l->write_idx.value));
 
-    for (; n > 0 ; n--) {
+    for (; k > 0 && pushed < n; k--) {
 
         _Y;
 
-        if (pa_atomic_ptr_cmpxchg(&cells[idx], NULL, p)) {
-
-            _Y;
-            pa_atomic_inc(&l->write_idx);
+        if (pa_atomic_ptr_cmpxchg(&l->cells[idx], NULL, p[pushed]))
+            pushed++;
 
-            _Y;
-            pa_atomic_inc(&l->length);
+        _Y;
+        idx = reduce(l, idx + 1);
+    }
 
-            return 0;
-        }
+    if (pushed > 0) {
+        _Y;
+        pa_atomic_add(&l->write_idx.value, (int) pushed);
 
         _Y;
-        idx = reduce(l, idx + 1);
+        pa_atomic_add(&l->length.value, (int) pushed);
     }
 
 #ifdef PROFILE
-    if (len > N_EXTRA_SCAN)
+    if (pushed < n && len > N_EXTRA_SCAN)
         pa_log_warn("Didn't  find free cell after %u iterations.", len);
 #endif
 
-    return -1;
+    return pushed;
 }
 
-void* pa_flist_pop(pa_flist*l) {
-    unsigned idx, n;
-    pa_atomic_ptr_t *cells;
+/* Takes up to n entries from the shared list, returns how many it found */
+static unsigned shared_pop(pa_flist *l, void **p, unsigned n) {
+    unsigned idx, k, popped = 0;
 #ifdef PROFILE
     unsigned len;
 #endif
 
-    pa_assert(l);
-
-    cells = PA_FLIST_CELLS(l);
-
-    n = (unsigned) pa_atomic_load(&l->length) + N_EXTRA_SCAN;
+    k = (unsigned) pa_atomic_load(&l->length.value) + N_EXTRA_SCAN;
 
 #ifdef PROFILE
-    len = n;
+    len = k;
 #endif
 
     _Y;
-    idx = reduce(l, (unsigned) pa_atomic_load(&l->read_idx));
+    idx = reduce(l, (unsigned) pa_atomic_load(&l->read_idx.value));
 
-    for (; n > 0 ; n--) {
-        void *p;
+    for (; k > 0 && popped < n; k--) {
+        void *q;
 
         _Y;
-        p = pa_atomic_ptr_load(&cells[idx]);
+        q = pa_atomic_ptr_load(&l->cells[idx]);
 
-        if (p) {
+        if (q) {
 
             _Y;
-            if (!pa_atomic_ptr_cmpxchg(&cells[idx], p, NULL))
+            if (!pa_atomic_ptr_cmpxchg(&l->cells[idx], q, NULL))
                 continue;
 
-            _Y;
-            pa_atomic_inc(&l->read_idx);
-
-            _Y;
-            pa_atomic_dec(&l->length);
-
-            return p;
+            p[popped++] = q;
         }
 
         _Y;
         idx = reduce(l, idx+1);
     }
 
+    if (popped > 0) {
+        _Y;
+        pa_atomic_add(&l->read_idx.value, (int) popped);
+
+        _Y;
+        pa_atomic_sub(&l->length.value, (int) popped);
+    }
+
 #ifdef PROFILE
-    if (len > N_EXTRA_SCAN)
+    if (popped < n && len > N_EXTRA_SCAN)
         pa_log_warn("Didn't find used cell after %u iterations.", len);
 #endif
 
-    return NULL;
+    return popped;
+}
+
+/* Returns the remaining entries of a magazine to the shared list, or
+ * frees them if there is no room */
+static void magazine_flush(magazine *m) {
+    unsigned k;
+
+    k = shared_push(m->flist, m->items, m->n);
+
+    for (; k < m->n; k++)
+        if (m->flist->free_cb)
+            m->flist->free_cb(m->items[k]);
+
+    m->n = 0;
+}
+
+/* Called when a thread exits */
+static void magazine_free(void *p) {
+    magazine *m = p;
+    pa_flist *l = m->flist;
+
+    magazine_flush(m);
+
+    pa_mutex_lock(l->mutex);
+    PA_LLIST_REMOVE(struct magazine, l->all_magazines, m);
+    pa_mutex_unlock(l->mutex);
+
+    pa_xfree(m);
+}
+
+static magazine *get_magazine(pa_flist *l) {
+    magazine *m;
+
+    if (PA_LIKELY(m = pa_tls_get(l->magazines)))
+        return m;
+
+    m = pa_xnew(magazine, 1);
+    m->flist = l;
+    m->n = 0;
+
+    pa_mutex_lock(l->mutex);
+    PA_LLIST_PREPEND(struct magazine, l->all_magazines, m);
+    pa_mutex_unlock(l->mutex);
+
+    pa_tls_set(l->magazines, m);
+
+    return m;
+}
+
+pa_flist *pa_flist_new_with_magazines(unsigned size, pa_free_cb_t free_cb) {
+    pa_flist *l;
+
+    l = pa_flist_new(size);
+    l->free_cb = free_cb;
+
+    /* If we cannot get a TLS slot we simply use the shared list
+     * only */
+    if ((l->magazines = pa_tls_new(magazine_free))) {
+        l->mutex = pa_mutex_new(FALSE, FALSE);
+        PA_LLIST_HEAD_INIT(struct magazine, l->all_magazines);
+    }
+
+    return l;
+}
+
+void pa_flist_free(pa_flist *l, pa_free_cb_t free_cb) {
+    pa_assert(l);
+
+    if (l->magazines) {
+        magazine *m;
+
+        /* Threads exiting from now on won't touch their magazines
+         * anymore, we free all of them here */
+        pa_tls_free(l->magazines);
+
+        while ((m = l->all_magazines)) {
+            unsigned k;
+
+            for (k = 0; k < m->n; k++)
+                if (free_cb)
+                    free_cb(m->items[k]);
+
+            PA_LLIST_REMOVE(struct magazine, l->all_magazines, m);
+            pa_xfree(m);
+        }
+
+        pa_mutex_free(l->mutex);
+    }
+
+    if (free_cb) {
+        unsigned idx;
+
+        for (idx = 0; idx < l->size; idx ++) {
+            void *p;
+
+            if ((p = pa_atomic_ptr_load(&l->cells[idx])))
+                free_cb(p);
+        }
+    }
+
+    pa_xfree(l);
+}
+
+int pa_flist_push(pa_flist*l, void *p) {
+    magazine *m;
+
+    pa_assert(l);
+    pa_assert(p);
+
+    if (!l->magazines)
+        return shared_push(l, &p, 1) > 0 ? 0 : -1;
+
+    m = get_magazine(l);
+
+    if (PA_UNLIKELY(m->n >= MAGAZINE_SIZE)) {
+        unsigned k;
+
+        /* Hand the older half over to the other threads */
+        k = shared_push(l, m->items, MAGAZINE_SIZE/2);
+        memmove(m->items, m->items + k, (m->n - k) * sizeof(void*));
+        m->n -= k;
+
+        if (m->n >= MAGAZINE_SIZE)
+            return -1;
+    }
+
+    m->items[m->n++] = p;
+    return 0;
+}
+
+void* pa_flist_pop(pa_flist*l) {
+    magazine *m;
+
+    pa_assert(l);
+
+    if (!l->magazines) {
+        void *p;
+
+        return shared_pop(l, &p, 1) > 0 ? p : NULL;
+    }
+
+    m = get_magazine(l);
+
+    if (PA_UNLIKELY(m->n <= 0))
+        if ((m->n = shared_pop(l, m->items, MAGAZINE_SIZE/2)) <= 0)
+            return NULL;
+
+    return m->items[--m->n];
 }
@@ -34,6 +34,15 @@ typedef struct pa_flist pa_flist;
 
 /* Size is required to be a power of two, or 0 for the default size */
 pa_flist * pa_flist_new(unsigned size);
+
+/* Like pa_flist_new(), but every thread gets a small private cache in
+ * front of the shared list, which avoids contention if the list is
+ * used from many threads. When a thread exits the entries in its
+ * cache are returned to the shared list, or passed to free_cb if
+ * there is no room. The list must hence outlive all threads using
+ * it. pa_flist_free() also takes care of the caches of threads that
+ * are still around. */
+pa_flist * pa_flist_new_with_magazines(unsigned size, pa_free_cb_t free_cb);
 void pa_flist_free(pa_flist *l, pa_free_cb_t free_cb);
 
 /* Please note that this routine might fail! */
@@ -49,7 +58,7 @@ void* pa_flist_pop(pa_flist*l);
         pa_once once;                                                   \
     } name##_flist = { NULL, PA_ONCE_INIT };                            \
     static void name##_flist_init(void) {                               \
-        name##_flist.flist = pa_flist_new(size);                        \
+        name##_flist.flist = pa_flist_new_with_magazines(size, free_cb); \
     }                                                                   \
     static inline pa_flist* name##_flist_get(void) {                    \
         pa_run_once(&name##_flist.once, name##_flist_init);             \
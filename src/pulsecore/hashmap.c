@@ -31,16 +31,15 @@
 #include <pulsecore/log.h>
 #include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/hashtable.h>
 
 #include "hashmap.h"
 
-#define NBUCKETS 127
-
 struct hashmap_entry {
     const void *key;
     void *value;
+    unsigned hash;
 
-    struct hashmap_entry *bucket_next, *bucket_previous;
     struct hashmap_entry *iterate_next, *iterate_previous;
 };
 
@@ -48,22 +47,24 @@ struct pa_hashmap {
     pa_hash_func_t hash_func;
     pa_compare_func_t compare_func;
 
+    pa_hashtable by_key;
+
     struct hashmap_entry *iterate_list_head, *iterate_list_tail;
     unsigned n_entries;
 };
 
-#define BY_HASH(h) ((struct hashmap_entry**) ((uint8_t*) (h) + PA_ALIGN(sizeof(pa_hashmap))))
-
 PA_STATIC_FLIST_DECLARE(entries, 0, pa_xfree);
 
 pa_hashmap *pa_hashmap_new(pa_hash_func_t hash_func, pa_compare_func_t compare_func) {
     pa_hashmap *h;
 
-    h = pa_xmalloc0(PA_ALIGN(sizeof(pa_hashmap)) + NBUCKETS*sizeof(struct hashmap_entry*));
+    h = pa_xnew(pa_hashmap, 1);
 
     h->hash_func = hash_func ? hash_func : pa_idxset_trivial_hash_func;
     h->compare_func = compare_func ? compare_func : pa_idxset_trivial_compare_func;
 
+    pa_hashtable_init(&h->by_key);
+
     h->n_entries = 0;
     h->iterate_list_head = h->iterate_list_tail = NULL;
 
@@ -85,16 +86,8 @@ static void remove_entry(pa_hashmap *h, struct hashmap_entry *e) {
     else
         h->iterate_list_head = e->iterate_next;
 
-    /* Remove from hash table bucket list */
-    if (e->bucket_next)
-        e->bucket_next->bucket_previous = e->bucket_previous;
-
-    if (e->bucket_previous)
-        e->bucket_previous->bucket_next = e->bucket_next;
-    else {
-        unsigned hash = h->hash_func(e->key) % NBUCKETS;
-        BY_HASH(h)[hash] = e->bucket_next;
-    }
+    /* Remove from hash table */
+    pa_hashtable_remove(&h->by_key, e->hash, e);
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(entries), e) < 0)
         pa_xfree(e);
@@ -115,19 +108,21 @@ void pa_hashmap_free(pa_hashmap*h, pa_free2_cb_t free_cb, void *userdata) {
             free_cb(data, userdata);
     }
 
+    pa_hashtable_done(&h->by_key);
     pa_xfree(h);
 }
 
+static pa_bool_t key_match(const void *entry, const void *key, void *userdata) {
+    const struct hashmap_entry *e = entry;
+    pa_hashmap *h = userdata;
+
+    return h->compare_func(e->key, key) == 0;
+}
+
 static struct hashmap_entry *hash_scan(pa_hashmap *h, unsigned hash, const void *key) {
-    struct hashmap_entry *e;
     pa_assert(h);
-    pa_assert(hash < NBUCKETS);
 
-    for (e = BY_HASH(h)[hash]; e; e = e->bucket_next)
-        if (h->compare_func(e->key, key) == 0)
-            return e;
-
-    return NULL;
+    return pa_hashtable_get(&h->by_key, hash, key_match, key, h);
 }
 
 int pa_hashmap_put(pa_hashmap *h, const void *key, void *value) {
@@ -136,7 +131,7 @@ int pa_hashmap_put(pa_hashmap *h, const void *key, void *value) {
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
+    hash = h->hash_func(key);
 
     if (hash_scan(h, hash, key))
         return -1;
@@ -146,13 +141,10 @@ int pa_hashmap_put(pa_hashmap *h, const void *key, void *value) {
 
     e->key = key;
     e->value = value;
+    e->hash = hash;
 
     /* Insert into hash table */
-    e->bucket_next = BY_HASH(h)[hash];
-    e->bucket_previous = NULL;
-    if (BY_HASH(h)[hash])
-        BY_HASH(h)[hash]->bucket_previous = e;
-    BY_HASH(h)[hash] = e;
+    pa_hashtable_put(&h->by_key, hash, e);
 
     /* Insert into iteration list */
     e->iterate_previous = h->iterate_list_tail;
@@ -178,7 +170,7 @@ void* pa_hashmap_get(pa_hashmap *h, const void *key) {
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
+    hash = h->hash_func(key);
 
     if (!(e = hash_scan(h, hash, key)))
         return NULL;
@@ -186,6 +178,22 @@ void* pa_hashmap_get(pa_hashmap *h, const void *key) {
     return e->value;
 }
 
+void* pa_hashmap_replace(pa_hashmap *h, const void *key, void *value) {
+    struct hashmap_entry *e;
+    void *data;
+
+    pa_assert(h);
+
+    if (!(e = hash_scan(h, h->hash_func(key), key)))
+        return NULL;
+
+    data = e->value;
+    e->key = key;
+    e->value = value;
+
+    return data;
+}
+
 void* pa_hashmap_remove(pa_hashmap *h, const void *key) {
     struct hashmap_entry *e;
     unsigned hash;
@@ -193,7 +201,7 @@ void* pa_hashmap_remove(pa_hashmap *h, const void *key) {
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
+    hash = h->hash_func(key);
 
     if (!(e = hash_scan(h, hash, key)))
         return NULL;
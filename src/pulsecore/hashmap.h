@@ -43,6 +43,11 @@ int pa_hashmap_put(pa_hashmap *h, const void *key, void *value);
 /* Return an entry from the hashmap */
 void* pa_hashmap_get(pa_hashmap *h, const void *key);
 
+/* Replaces key and value of an existing entry, which keeps its place
+ * in the iteration order. Returns the old value, or NULL if there was
+ * no such entry, in which case nothing is added. */
+void* pa_hashmap_replace(pa_hashmap *h, const void *key, void *value);
+
 /* Returns the data of the entry while removing */
 void* pa_hashmap_remove(pa_hashmap *h, const void *key);
 
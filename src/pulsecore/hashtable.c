@@ -0,0 +1,195 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/macro.h>
+
+#include "hashtable.h"
+
+/* The table size is always a power of two, and never below this
+ * once something has been added */
+#define MIN_SIZE 8U
+
+/* Grow when more than 7/8 of the slots are taken, shrink when less
+ * than 1/8 are */
+#define TOO_FULL(n, size) ((n) * 8U > (size) * 7U)
+#define TOO_EMPTY(n, size) ((n) * 8U < (size))
+
+/* The hash functions we get passed are often weak in the lower bits,
+ * e.g. the trivial one hashing aligned pointers. Since we only look
+ * at those bits, mix everything into them first. This is the
+ * finalizer of MurmurHash3. */
+static inline unsigned mix(unsigned h) {
+    uint32_t k = (uint32_t) h;
+
+    k ^= k >> 16;
+    k *= 0x85ebca6bU;
+    k ^= k >> 13;
+    k *= 0xc2b2ae35U;
+    k ^= k >> 16;
+
+    return (unsigned) k;
+}
+
+/* How far the entry in slot pos is away from where it wants to be */
+static inline unsigned distance(unsigned pos, unsigned hash, unsigned mask) {
+    return (pos - hash) & mask;
+}
+
+static void insert_slot(struct pa_hashtable_slot *slots, unsigned mask, struct pa_hashtable_slot s) {
+    unsigned pos, d = 0;
+
+    pos = s.hash & mask;
+
+    /* Robin hood: whoever is closer to its home slot has to make
+     * way */
+    for (;;) {
+        unsigned sd;
+
+        if (!slots[pos].entry) {
+            slots[pos] = s;
+            return;
+        }
+
+        if ((sd = distance(pos, slots[pos].hash, mask)) < d) {
+            struct pa_hashtable_slot tmp = slots[pos];
+
+            slots[pos] = s;
+            s = tmp;
+            d = sd;
+        }
+
+        pos = (pos + 1) & mask;
+        d++;
+    }
+}
+
+static void resize(pa_hashtable *t, unsigned size) {
+    struct pa_hashtable_slot *old;
+    unsigned i, old_size;
+
+    old = t->slots;
+    old_size = t->size;
+
+    t->size = size;
+    t->slots = pa_xnew0(struct pa_hashtable_slot, size);
+
+    for (i = 0; i < old_size; i++)
+        if (old[i].entry)
+            insert_slot(t->slots, size - 1, old[i]);
+
+    pa_xfree(old);
+}
+
+void pa_hashtable_init(pa_hashtable *t) {
+    pa_assert(t);
+
+    t->slots = NULL;
+    t->size = t->n_entries = 0;
+}
+
+void pa_hashtable_done(pa_hashtable *t) {
+    pa_assert(t);
+
+    pa_xfree(t->slots);
+    pa_hashtable_init(t);
+}
+
+void pa_hashtable_put(pa_hashtable *t, unsigned hash, void *entry) {
+    struct pa_hashtable_slot s;
+
+    pa_assert(t);
+    pa_assert(entry);
+
+    if (t->size <= 0)
+        resize(t, MIN_SIZE);
+    else if (TOO_FULL(t->n_entries + 1, t->size))
+        resize(t, t->size * 2);
+
+    s.hash = mix(hash);
+    s.entry = entry;
+    insert_slot(t->slots, t->size - 1, s);
+
+    t->n_entries++;
+}
+
+void *pa_hashtable_get(pa_hashtable *t, unsigned hash, pa_hashtable_match_func_t match, const void *key, void *userdata) {
+    unsigned mask, pos, d = 0;
+
+    pa_assert(t);
+    pa_assert(match);
+
+    if (t->n_entries <= 0)
+        return NULL;
+
+    hash = mix(hash);
+    mask = t->size - 1;
+    pos = hash & mask;
+
+    for (;;) {
+        struct pa_hashtable_slot *s = t->slots + pos;
+
+        /* If we were there, we'd have taken this slot */
+        if (!s->entry || distance(pos, s->hash, mask) < d)
+            return NULL;
+
+        if (s->hash == hash && match(s->entry, key, userdata))
+            return s->entry;
+
+        pos = (pos + 1) & mask;
+        d++;
+    }
+}
+
+void pa_hashtable_remove(pa_hashtable *t, unsigned hash, void *entry) {
+    unsigned mask, pos, next;
+
+    pa_assert(t);
+    pa_assert(entry);
+    pa_assert(t->n_entries > 0);
+
+    hash = mix(hash);
+    mask = t->size - 1;
+
+    for (pos = hash & mask; t->slots[pos].entry != entry; pos = (pos + 1) & mask)
+        pa_assert(t->slots[pos].entry);
+
+    /* Shift the following entries back by one, up to the first one
+     * that is already in its home slot */
+    for (next = (pos + 1) & mask;
+         t->slots[next].entry && distance(next, t->slots[next].hash, mask) > 0;
+         next = (next + 1) & mask) {
+
+        t->slots[pos] = t->slots[next];
+        pos = next;
+    }
+
+    t->slots[pos].entry = NULL;
+    t->n_entries--;
+
+    if (t->size > MIN_SIZE && TOO_EMPTY(t->n_entries, t->size))
+        resize(t, t->size / 2);
+}
@@ -0,0 +1,58 @@
+#ifndef foopulsecorehashtablehfoo
+#define foopulsecorehashtablehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulsecore/macro.h>
+
+/* The lookup table behind pa_hashmap and pa_idxset: an open
+ * addressing hash table with robin hood probing that maps hash values
+ * to entry pointers. It grows and shrinks with the number of entries
+ * and allocates nothing before the first one is added. The entries themselves, and
+ * hence their order, are owned by the user; a rehash only moves the
+ * pointers around. */
+
+struct pa_hashtable_slot {
+    unsigned hash;
+    void *entry;
+};
+
+typedef struct pa_hashtable {
+    struct pa_hashtable_slot *slots;
+    unsigned size, n_entries;
+} pa_hashtable;
+
+/* Returns TRUE if entry is the one that is looked for */
+typedef pa_bool_t (*pa_hashtable_match_func_t)(const void *entry, const void *key, void *userdata);
+
+void pa_hashtable_init(pa_hashtable *t);
+void pa_hashtable_done(pa_hashtable *t);
+
+/* Adds an entry. There is no check whether an equal one already exists */
+void pa_hashtable_put(pa_hashtable *t, unsigned hash, void *entry);
+
+/* Returns the entry with this hash that match() accepts, or NULL.
+ * match() is only called for entries with an equal hash value. */
+void *pa_hashtable_get(pa_hashtable *t, unsigned hash, pa_hashtable_match_func_t match, const void *key, void *userdata);
+
+/* Removes the entry, which has to be in the table under this hash */
+void pa_hashtable_remove(pa_hashtable *t, unsigned hash, void *entry);
+
+#endif
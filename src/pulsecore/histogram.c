@@ -0,0 +1,76 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <time.h>
+#include <sys/time.h>
+
+#include <pulse/timeval.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/macro.h>
+
+#include "histogram.h"
+
+uint64_t pa_histogram_now(void) {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) >= 0)
+        return (uint64_t) ts.tv_sec * PA_NSEC_PER_SEC + (uint64_t) ts.tv_nsec;
+#endif
+
+    {
+        struct timeval tv;
+        return pa_timeval_load(pa_rtclock_get(&tv)) * PA_NSEC_PER_USEC;
+    }
+}
+
+void pa_histogram_reset(pa_histogram *h) {
+    unsigned i;
+
+    pa_assert(h);
+
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS; i++)
+        pa_atomic_store(&h->buckets[i], 0);
+}
+
+void pa_histogram_add(pa_histogram *h, uint64_t nsec) {
+    unsigned b = 0;
+
+    pa_assert(h);
+
+    /* Find the highest bit set */
+    while (nsec > 1 && b < PA_HISTOGRAM_BUCKETS-1) {
+        nsec >>= 1;
+        b++;
+    }
+
+    pa_atomic_inc(&h->buckets[b]);
+}
+
+unsigned pa_histogram_get(pa_histogram *h, unsigned bucket) {
+    pa_assert(h);
+    pa_assert(bucket < PA_HISTOGRAM_BUCKETS);
+
+    return (unsigned) pa_atomic_load(&h->buckets[bucket]);
+}
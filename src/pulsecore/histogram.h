@@ -0,0 +1,63 @@
+#ifndef foopulsehistogramhfoo
+#define foopulsehistogramhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/atomic.h>
+
+/* A tiny lock-free latency histogram used to profile the render
+ * path. Bucket n counts durations in [2^n, 2^(n+1)) ns, the last
+ * bucket everything that took longer. There is supposed to be only a
+ * single writer (the IO thread owning the object), readers from other
+ * threads might see a slightly inconsistent snapshot, which is fine
+ * for statistics. */
+
+#define PA_HISTOGRAM_BUCKETS 32
+
+typedef struct pa_histogram {
+    pa_atomic_t buckets[PA_HISTOGRAM_BUCKETS];
+} pa_histogram;
+
+/* Monotonic time in ns, used as the base for the probes */
+uint64_t pa_histogram_now(void);
+
+void pa_histogram_reset(pa_histogram *h);
+void pa_histogram_add(pa_histogram *h, uint64_t nsec);
+
+/* Returns the start time for a probe, or 0 if profiling is
+ * disabled. This keeps clock_gettime() out of the RT path unless
+ * somebody actually asked for the numbers. */
+static inline uint64_t pa_histogram_start(pa_bool_t enabled) {
+    return enabled ? pa_histogram_now() : 0;
+}
+
+/* Accounts the time passed since start, as returned by
+ * pa_histogram_start(). Does nothing if the probe was not started. */
+static inline void pa_histogram_add_since(pa_histogram *h, uint64_t start) {
+    if (start > 0)
+        pa_histogram_add(h, pa_histogram_now() - start);
+}
+
+unsigned pa_histogram_get(pa_histogram *h, unsigned bucket);
+
+#endif
@@ -32,17 +32,15 @@
 #include <pulsecore/log.h>
 #include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/hashtable.h>
 
 #include "idxset.h"
 
-#define NBUCKETS 127
-
 struct idxset_entry {
     uint32_t idx;
     void *data;
+    unsigned hash;
 
-    struct idxset_entry *data_next, *data_previous;
-    struct idxset_entry *index_next, *index_previous;
     struct idxset_entry *iterate_next, *iterate_previous;
 };
 
@@ -52,13 +50,12 @@ struct pa_idxset {
 
     uint32_t current_index;
 
+    pa_hashtable by_data, by_index;
+
     struct idxset_entry *iterate_list_head, *iterate_list_tail;
     unsigned n_entries;
 };
 
-#define BY_DATA(i) ((struct idxset_entry**) ((uint8_t*) (i) + PA_ALIGN(sizeof(pa_idxset))))
-#define BY_INDEX(i) (BY_DATA(i) + NBUCKETS)
-
 PA_STATIC_FLIST_DECLARE(entries, 0, pa_xfree);
 
 unsigned pa_idxset_string_hash_func(const void *p) {
@@ -86,11 +83,14 @@ int pa_idxset_trivial_compare_func(const void *a, const void *b) {
 pa_idxset* pa_idxset_new(pa_hash_func_t hash_func, pa_compare_func_t compare_func) {
     pa_idxset *s;
 
-    s = pa_xmalloc0(PA_ALIGN(sizeof(pa_idxset)) + NBUCKETS*2*sizeof(struct idxset_entry*));
+    s = pa_xnew(pa_idxset, 1);
 
     s->hash_func = hash_func ? hash_func : pa_idxset_trivial_hash_func;
     s->compare_func = compare_func ? compare_func : pa_idxset_trivial_compare_func;
 
+    pa_hashtable_init(&s->by_data);
+    pa_hashtable_init(&s->by_index);
+
     s->current_index = 0;
     s->n_entries = 0;
     s->iterate_list_head = s->iterate_list_tail = NULL;
@@ -113,25 +113,9 @@ static void remove_entry(pa_idxset *s, struct idxset_entry *e) {
     else
         s->iterate_list_head = e->iterate_next;
 
-    /* Remove from data hash table */
-    if (e->data_next)
-        e->data_next->data_previous = e->data_previous;
-
-    if (e->data_previous)
-        e->data_previous->data_next = e->data_next;
-    else {
-        unsigned hash = s->hash_func(e->data) % NBUCKETS;
-        BY_DATA(s)[hash] = e->data_next;
-    }
-
-    /* Remove from index hash table */
-    if (e->index_next)
-        e->index_next->index_previous = e->index_previous;
-
-    if (e->index_previous)
-        e->index_previous->index_next = e->index_next;
-    else
-        BY_INDEX(s)[e->idx % NBUCKETS] = e->index_next;
+    /* Remove from hash tables */
+    pa_hashtable_remove(&s->by_data, e->hash, e);
+    pa_hashtable_remove(&s->by_index, e->idx, e);
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(entries), e) < 0)
         pa_xfree(e);
@@ -152,32 +136,35 @@ void pa_idxset_free(pa_idxset *s, pa_free2_cb_t free_cb, void *userdata) {
             free_cb(data, userdata);
     }
 
+    pa_hashtable_done(&s->by_data);
+    pa_hashtable_done(&s->by_index);
     pa_xfree(s);
 }
 
+static pa_bool_t data_match(const void *entry, const void *p, void *userdata) {
+    const struct idxset_entry *e = entry;
+    pa_idxset *s = userdata;
+
+    return s->compare_func(e->data, p) == 0;
+}
+
+static pa_bool_t index_match(const void *entry, const void *idx, void *userdata) {
+    const struct idxset_entry *e = entry;
+
+    return e->idx == *(const uint32_t*) idx;
+}
+
 static struct idxset_entry* data_scan(pa_idxset *s, unsigned hash, const void *p) {
-    struct idxset_entry *e;
     pa_assert(s);
-    pa_assert(hash < NBUCKETS);
     pa_assert(p);
 
-    for (e = BY_DATA(s)[hash]; e; e = e->data_next)
-        if (s->compare_func(e->data, p) == 0)
-            return e;
-
-    return NULL;
+    return pa_hashtable_get(&s->by_data, hash, data_match, p, s);
 }
 
-static struct idxset_entry* index_scan(pa_idxset *s, unsigned hash, uint32_t idx) {
-    struct idxset_entry *e;
+static struct idxset_entry* index_scan(pa_idxset *s, uint32_t idx) {
     pa_assert(s);
-    pa_assert(hash < NBUCKETS);
-
-    for (e = BY_INDEX(s)[hash]; e; e = e->index_next)
-        if (e->idx == idx)
-            return e;
 
-    return NULL;
+    return pa_hashtable_get(&s->by_index, idx, index_match, &idx, NULL);
 }
 
 int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
@@ -186,7 +173,7 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
 
     pa_assert(s);
 
-    hash = s->hash_func(p) % NBUCKETS;
+    hash = s->hash_func(p);
 
     if ((e = data_scan(s, hash, p))) {
         if (idx)
@@ -200,22 +187,11 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
 
     e->data = p;
     e->idx = s->current_index++;
+    e->hash = hash;
 
-    /* Insert into data hash table */
-    e->data_next = BY_DATA(s)[hash];
-    e->data_previous = NULL;
-    if (BY_DATA(s)[hash])
-        BY_DATA(s)[hash]->data_previous = e;
-    BY_DATA(s)[hash] = e;
-
-    hash = e->idx % NBUCKETS;
-
-    /* Insert into index hash table */
-    e->index_next = BY_INDEX(s)[hash];
-    e->index_previous = NULL;
-    if (BY_INDEX(s)[hash])
-        BY_INDEX(s)[hash]->index_previous = e;
-    BY_INDEX(s)[hash] = e;
+    /* Insert into hash tables */
+    pa_hashtable_put(&s->by_data, hash, e);
+    pa_hashtable_put(&s->by_index, e->idx, e);
 
     /* Insert into iteration list */
     e->iterate_previous = s->iterate_list_tail;
@@ -239,14 +215,11 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
 }
 
 void* pa_idxset_get_by_index(pa_idxset*s, uint32_t idx) {
-    unsigned hash;
     struct idxset_entry *e;
 
     pa_assert(s);
 
-    hash = idx % NBUCKETS;
-
-    if (!(e = index_scan(s, hash, idx)))
+    if (!(e = index_scan(s, idx)))
         return NULL;
 
     return e->data;
@@ -258,7 +231,7 @@ void* pa_idxset_get_by_data(pa_idxset*s, const void *p, uint32_t *idx) {
 
     pa_assert(s);
 
-    hash = s->hash_func(p) % NBUCKETS;
+    hash = s->hash_func(p);
 
     if (!(e = data_scan(s, hash, p)))
         return NULL;
@@ -271,14 +244,11 @@ void* pa_idxset_get_by_data(pa_idxset*s, const void *p, uint32_t *idx) {
 
 void* pa_idxset_remove_by_index(pa_idxset*s, uint32_t idx) {
     struct idxset_entry *e;
-    unsigned hash;
     void *data;
 
     pa_assert(s);
 
-    hash = idx % NBUCKETS;
-
-    if (!(e = index_scan(s, hash, idx)))
+    if (!(e = index_scan(s, idx)))
         return NULL;
 
     data = e->data;
@@ -294,7 +264,7 @@ void* pa_idxset_remove_by_data(pa_idxset*s, const void *data, uint32_t *idx) {
 
     pa_assert(s);
 
-    hash = s->hash_func(data) % NBUCKETS;
+    hash = s->hash_func(data);
 
     if (!(e = data_scan(s, hash, data)))
         return NULL;
@@ -310,15 +280,12 @@ void* pa_idxset_remove_by_data(pa_idxset*s, const void *data, uint32_t *idx) {
 }
 
 void* pa_idxset_rrobin(pa_idxset *s, uint32_t *idx) {
-    unsigned hash;
     struct idxset_entry *e;
 
     pa_assert(s);
     pa_assert(idx);
 
-    hash = *idx % NBUCKETS;
-
-    e = index_scan(s, hash, *idx);
+    e = index_scan(s, *idx);
 
     if (e && e->iterate_next)
         e = e->iterate_next;
@@ -400,7 +367,6 @@ void* pa_idxset_first(pa_idxset *s, uint32_t *idx) {
 
 void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
     struct idxset_entry *e;
-    unsigned hash;
 
     pa_assert(s);
     pa_assert(idx);
@@ -408,9 +374,7 @@ void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
     if (*idx == PA_IDXSET_INVALID)
         return NULL;
 
-    hash = *idx % NBUCKETS;
-
-    if ((e = index_scan(s, hash, *idx))) {
+    if ((e = index_scan(s, *idx))) {
 
         e = e->iterate_next;
 
@@ -429,9 +393,7 @@ void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
 
         for ((*idx)++; *idx < s->current_index; (*idx)++) {
 
-            hash = *idx % NBUCKETS;
-
-            if ((e = index_scan(s, hash, *idx))) {
+            if ((e = index_scan(s, *idx))) {
                 *idx = e->idx;
                 return e->data;
             }
@@ -229,8 +229,87 @@ ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l) {
     return r;
 }
 
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, unsigned n) {
+    ssize_t r;
+
+    pa_assert(io);
+    pa_assert(iov);
+    pa_assert(n > 0);
+    pa_assert(io->ofd >= 0);
+
+#ifdef HAVE_SYS_UIO_H
+    for (;;) {
+
+#ifdef HAVE_SYS_SOCKET_H
+        /* Like pa_write() we prefer sendmsg() to avoid SIGPIPE and
+         * fall back to writev() for anything that is no socket */
+        if (io->ofd_type == 0) {
+            struct msghdr mh;
+
+            memset(&mh, 0, sizeof(mh));
+            mh.msg_iov = (struct iovec*) iov;
+            mh.msg_iovlen = n;
+
+            if ((r = sendmsg(io->ofd, &mh, MSG_NOSIGNAL)) < 0 && errno == ENOTSOCK) {
+                io->ofd_type = 1;
+                continue;
+            }
+        } else
+#endif
+            r = writev(io->ofd, iov, (int) n);
+
+        if (r < 0 && errno == EINTR)
+            continue;
+
+        break;
+    }
+#else
+    pa_assert(iov[0].iov_len > 0);
+    r = pa_write(io->ofd, iov[0].iov_base, iov[0].iov_len, &io->ofd_type);
+#endif
+
+    if (r >= 0) {
+        io->writable = FALSE;
+        enable_mainloop_sources(io);
+    }
+
+    return r;
+}
+
+ssize_t pa_iochannel_readv(pa_iochannel*io, const struct iovec *iov, unsigned n) {
+    ssize_t r;
+
+    pa_assert(io);
+    pa_assert(iov);
+    pa_assert(n > 0);
+    pa_assert(io->ifd >= 0);
+
+#ifdef HAVE_SYS_UIO_H
+    for (;;) {
+        if ((r = readv(io->ifd, iov, (int) n)) < 0 && errno == EINTR)
+            continue;
+
+        break;
+    }
+#else
+    pa_assert(iov[0].iov_len > 0);
+    r = pa_read(io->ifd, iov[0].iov_base, iov[0].iov_len, &io->ifd_type);
+#endif
+
+    if (r >= 0) {
+        io->readable = FALSE;
+        enable_mainloop_sources(io);
+    }
+
+    return r;
+}
+
 #ifdef HAVE_CREDS
 
+#ifndef MSG_CMSG_CLOEXEC
+#define MSG_CMSG_CLOEXEC 0
+#endif
+
 pa_bool_t pa_iochannel_creds_supported(pa_iochannel *io) {
     struct sockaddr_un sa;
     socklen_t l;
@@ -314,26 +393,46 @@ ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l
 }
 
 ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *creds, pa_bool_t *creds_valid) {
+    struct iovec iov;
+
+    pa_assert(data);
+    pa_assert(l);
+
+    memset(&iov, 0, sizeof(iov));
+    iov.iov_base = data;
+    iov.iov_len = l;
+
+    return pa_iochannel_readv_with_creds(io, &iov, 1, creds, creds_valid);
+}
+
+ssize_t pa_iochannel_readv_with_creds(pa_iochannel*io, const struct iovec *iov, unsigned n, pa_creds *creds, pa_bool_t *creds_valid) {
+    return pa_iochannel_readv_with_ancil(io, iov, n, creds, creds_valid, NULL, NULL);
+}
+
+ssize_t pa_iochannel_write_with_fd(pa_iochannel*io, const void*data, size_t l, int fd) {
     ssize_t r;
     struct msghdr mh;
     struct iovec iov;
     union {
         struct cmsghdr hdr;
-        uint8_t data[CMSG_SPACE(sizeof(struct ucred))];
+        uint8_t data[CMSG_SPACE(sizeof(int))];
     } cmsg;
 
     pa_assert(io);
     pa_assert(data);
     pa_assert(l);
-    pa_assert(io->ifd >= 0);
-    pa_assert(creds);
-    pa_assert(creds_valid);
+    pa_assert(io->ofd >= 0);
+    pa_assert(fd >= 0);
 
     memset(&iov, 0, sizeof(iov));
-    iov.iov_base = data;
+    iov.iov_base = (void*) data;
     iov.iov_len = l;
 
     memset(&cmsg, 0, sizeof(cmsg));
+    cmsg.hdr.cmsg_len = CMSG_LEN(sizeof(int));
+    cmsg.hdr.cmsg_level = SOL_SOCKET;
+    cmsg.hdr.cmsg_type = SCM_RIGHTS;
+    memcpy(CMSG_DATA(&cmsg.hdr), &fd, sizeof(int));
 
     memset(&mh, 0, sizeof(mh));
     mh.msg_name = NULL;
@@ -344,14 +443,58 @@ ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_cr
     mh.msg_controllen = sizeof(cmsg);
     mh.msg_flags = 0;
 
-    if ((r = recvmsg(io->ifd, &mh, 0)) >= 0) {
+    if ((r = sendmsg(io->ofd, &mh, MSG_NOSIGNAL)) >= 0) {
+        io->writable = FALSE;
+        enable_mainloop_sources(io);
+    }
+
+    return r;
+}
+
+ssize_t pa_iochannel_readv_with_ancil(pa_iochannel*io, const struct iovec *iov, unsigned n, pa_creds *creds, pa_bool_t *creds_valid, int *fds, unsigned *n_fds) {
+    ssize_t r;
+    struct msghdr mh;
+    union {
+        struct cmsghdr hdr;
+        uint8_t data[CMSG_SPACE(sizeof(struct ucred)) + CMSG_SPACE(sizeof(int) * PA_IOCHANNEL_FDS_MAX)];
+    } cmsg;
+    unsigned fds_max = 0;
+
+    pa_assert(io);
+    pa_assert(iov);
+    pa_assert(n > 0);
+    pa_assert(io->ifd >= 0);
+    pa_assert(creds);
+    pa_assert(creds_valid);
+    pa_assert(!fds == !n_fds);
+
+    if (n_fds) {
+        fds_max = *n_fds;
+        *n_fds = 0;
+    }
+
+    memset(&cmsg, 0, sizeof(cmsg));
+
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_name = NULL;
+    mh.msg_namelen = 0;
+    mh.msg_iov = (struct iovec*) iov;
+    mh.msg_iovlen = n;
+    mh.msg_control = &cmsg;
+    mh.msg_controllen = sizeof(cmsg);
+    mh.msg_flags = 0;
+
+    if ((r = recvmsg(io->ifd, &mh, MSG_CMSG_CLOEXEC)) >= 0) {
         struct cmsghdr *cmh;
 
         *creds_valid = 0;
 
         for (cmh = CMSG_FIRSTHDR(&mh); cmh; cmh = CMSG_NXTHDR(&mh, cmh)) {
 
-            if (cmh->cmsg_level == SOL_SOCKET && cmh->cmsg_type == SCM_CREDENTIALS) {
+            if (cmh->cmsg_level != SOL_SOCKET)
+                continue;
+
+            if (cmh->cmsg_type == SCM_CREDENTIALS) {
                 struct ucred u;
                 pa_assert(cmh->cmsg_len == CMSG_LEN(sizeof(struct ucred)));
                 memcpy(&u, CMSG_DATA(cmh), sizeof(struct ucred));
@@ -359,7 +502,21 @@ ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_cr
                 creds->gid = u.gid;
                 creds->uid = u.uid;
                 *creds_valid = TRUE;
-                break;
+
+            } else if (cmh->cmsg_type == SCM_RIGHTS) {
+                unsigned i, k = (unsigned) ((cmh->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+
+                /* Whatever the caller is not prepared to take we
+                 * close right away, so that nothing leaks */
+                for (i = 0; i < k; i++) {
+                    int fd;
+                    memcpy(&fd, CMSG_DATA(cmh) + i * sizeof(int), sizeof(int));
+
+                    if (n_fds && *n_fds < fds_max)
+                        fds[(*n_fds)++] = fd;
+                    else
+                        pa_close(fd);
+                }
             }
         }
 
@@ -29,6 +29,15 @@
 
 #include <sys/types.h>
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#else
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
+
 #include <pulse/mainloop-api.h>
 #include <pulsecore/creds.h>
 #include <pulsecore/macro.h>
@@ -56,12 +65,25 @@ void pa_iochannel_free(pa_iochannel*io);
 ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l);
 ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l);
 
+/* Scatter/gather versions of the above. Where writev()/readv() are
+ * not available only the first buffer is transferred. */
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, unsigned n);
+ssize_t pa_iochannel_readv(pa_iochannel*io, const struct iovec *iov, unsigned n);
+
 #ifdef HAVE_CREDS
 pa_bool_t pa_iochannel_creds_supported(pa_iochannel *io);
 int pa_iochannel_creds_enable(pa_iochannel *io);
 
 ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l, const pa_creds *ucred);
 ssize_t pa_iochannel_read_with_creds(pa_iochannel*io, void*data, size_t l, pa_creds *ucred, pa_bool_t *creds_valid);
+ssize_t pa_iochannel_readv_with_creds(pa_iochannel*io, const struct iovec *iov, unsigned n, pa_creds *ucred, pa_bool_t *creds_valid);
+
+/* Pass a file descriptor along with the data. On the receiving side
+ * up to *n_fds descriptors are stored in fds, and *n_fds is set to the
+ * number actually received. */
+#define PA_IOCHANNEL_FDS_MAX 4
+ssize_t pa_iochannel_write_with_fd(pa_iochannel*io, const void*data, size_t l, int fd);
+ssize_t pa_iochannel_readv_with_ancil(pa_iochannel*io, const struct iovec *iov, unsigned n, pa_creds *ucred, pa_bool_t *creds_valid, int *fds, unsigned *n_fds);
 #endif
 
 pa_bool_t pa_iochannel_is_readable(pa_iochannel*io);
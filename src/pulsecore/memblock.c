@@ -94,6 +94,10 @@ struct pa_memimport_segment {
     pa_shm memory;
     pa_memtrap *trap;
     unsigned n_blocks;
+
+    /* memfd segments cannot be reattached by their ID, hence we keep
+     * them around until the import goes away */
+    pa_bool_t permanent;
 };
 
 /* A collection of multiple segments */
@@ -536,7 +540,7 @@ static void memblock_free(pa_memblock *b) {
                                  PA_UINT32_TO_PTR(b->per_type.imported.id)));
 
             pa_assert(segment->n_blocks >= 1);
-            if (-- segment->n_blocks <= 0)
+            if (-- segment->n_blocks <= 0 && !segment->permanent)
                 segment_detach(segment);
 
             pa_mutex_unlock(import->mutex);
@@ -700,13 +704,13 @@ static void memblock_replace_import(pa_memblock *b) {
     memblock_make_local(b);
 
     pa_assert(segment->n_blocks >= 1);
-    if (-- segment->n_blocks <= 0)
+    if (-- segment->n_blocks <= 0 && !segment->permanent)
         segment_detach(segment);
 
     pa_mutex_unlock(import->mutex);
 }
 
-pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
+static pa_mempool* mempool_new(pa_bool_t shared, pa_bool_t memfd, size_t size) {
     pa_mempool *p;
     char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
 
@@ -728,13 +732,17 @@ pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
             p->n_blocks = 2;
     }
 
-    if (pa_shm_create_rw(&p->memory, p->n_blocks * p->block_size, shared, 0700) < 0) {
+    if ((memfd ?
+         pa_shm_create_memfd_rw(&p->memory, p->n_blocks * p->block_size) :
+         pa_shm_create_rw(&p->memory, p->n_blocks * p->block_size, shared, 0700)) < 0) {
+        pa_mutex_free(p->mutex);
+        pa_semaphore_free(p->semaphore);
         pa_xfree(p);
         return NULL;
     }
 
     pa_log_debug("Using %s memory pool with %u slots of size %s each, total size is %s, maximum usable slot size is %lu",
-                 p->memory.shared ? "shared" : "private",
+                 p->memory.memfd ? "memfd" : (p->memory.shared ? "shared" : "private"),
                  p->n_blocks,
                  pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->block_size),
                  pa_bytes_snprint(t2, sizeof(t2), (unsigned) (p->n_blocks * p->block_size)),
@@ -751,6 +759,18 @@ pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
     return p;
 }
 
+pa_mempool* pa_mempool_new(pa_bool_t shared, size_t size) {
+    return mempool_new(shared, FALSE, size);
+}
+
+pa_mempool* pa_mempool_new_memfd(size_t size) {
+
+    if (!pa_shm_memfd_supported())
+        return NULL;
+
+    return mempool_new(TRUE, TRUE, size);
+}
+
 void pa_mempool_free(pa_mempool *p) {
     pa_assert(p);
 
@@ -874,6 +894,20 @@ pa_bool_t pa_mempool_is_shared(pa_mempool *p) {
     return !!p->memory.shared;
 }
 
+/* No lock necessary */
+pa_bool_t pa_mempool_is_memfd_backed(pa_mempool *p) {
+    pa_assert(p);
+
+    return !!p->memory.memfd;
+}
+
+/* No lock necessary */
+int pa_mempool_get_memfd_fd(pa_mempool *p) {
+    pa_assert(p);
+
+    return p->memory.memfd ? p->memory.fd : -1;
+}
+
 /* For recieving blocks from other nodes */
 pa_memimport* pa_memimport_new(pa_mempool *p, pa_memimport_release_cb_t cb, void *userdata) {
     pa_memimport *i;
@@ -932,10 +966,51 @@ static void segment_detach(pa_memimport_segment *seg) {
     pa_xfree(seg);
 }
 
+/* Self-locked. Takes over the fd in any case */
+int pa_memimport_attach_memfd(pa_memimport *i, uint32_t shm_id, int memfd_fd) {
+    pa_memimport_segment *seg;
+    int ret = -1;
+
+    pa_assert(i);
+    pa_assert(memfd_fd >= 0);
+
+    pa_mutex_lock(i->mutex);
+
+    if (pa_hashmap_get(i->segments, PA_UINT32_TO_PTR(shm_id)) ||
+        pa_hashmap_size(i->segments) >= PA_MEMIMPORT_SEGMENTS_MAX)
+        goto finish;
+
+    seg = pa_xnew0(pa_memimport_segment, 1);
+
+    if (pa_shm_attach_memfd_ro(&seg->memory, shm_id, memfd_fd) < 0) {
+        pa_xfree(seg);
+        goto finish;
+    }
+
+    /* The segment owns the fd now */
+    memfd_fd = -1;
+
+    seg->import = i;
+    seg->trap = pa_memtrap_add(seg->memory.ptr, seg->memory.size);
+    seg->permanent = TRUE;
+
+    pa_hashmap_put(i->segments, PA_UINT32_TO_PTR(seg->memory.id), seg);
+    ret = 0;
+
+finish:
+    pa_mutex_unlock(i->mutex);
+
+    if (memfd_fd >= 0)
+        pa_close(memfd_fd);
+
+    return ret;
+}
+
 /* Self-locked. Not multiple-caller safe */
 void pa_memimport_free(pa_memimport *i) {
     pa_memexport *e;
     pa_memblock *b;
+    pa_memimport_segment *seg;
 
     pa_assert(i);
 
@@ -944,7 +1019,11 @@ void pa_memimport_free(pa_memimport *i) {
     while ((b = pa_hashmap_first(i->blocks)))
         memblock_replace_import(b);
 
-    pa_assert(pa_hashmap_size(i->segments) == 0);
+    while ((seg = pa_hashmap_first(i->segments))) {
+        pa_assert(seg->permanent);
+        pa_assert(seg->n_blocks == 0);
+        segment_detach(seg);
+    }
 
     pa_mutex_unlock(i->mutex);
 
@@ -1149,12 +1228,16 @@ static pa_memblock *memblock_shared_copy(pa_mempool *p, pa_memblock *b) {
     pa_assert(p);
     pa_assert(b);
 
-    if (b->type == PA_MEMBLOCK_IMPORTED ||
-        b->type == PA_MEMBLOCK_POOL ||
-        b->type == PA_MEMBLOCK_POOL_EXTERNAL) {
-        pa_assert(b->pool == p);
+    /* Blocks from other pools (e.g. a per-client pool being fed from
+     * the core pool) and blocks that were passed to us as memfd are
+     * never handed on to somebody else, the former because the peer
+     * cannot see that memory, the latter to keep clients isolated
+     * from each other. */
+    if (b->pool == p &&
+        (b->type == PA_MEMBLOCK_POOL ||
+         b->type == PA_MEMBLOCK_POOL_EXTERNAL ||
+         (b->type == PA_MEMBLOCK_IMPORTED && !b->per_type.imported.segment->memory.memfd)))
         return pa_memblock_ref(b);
-    }
 
     if (!(n = pa_memblock_new_pool(p, b->length)))
         return NULL;
@@ -1175,7 +1258,6 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32
     pa_assert(shm_id);
     pa_assert(offset);
     pa_assert(size);
-    pa_assert(b->pool == e->pool);
 
     if (!(b = memblock_shared_copy(e->pool, b)))
         return -1;
@@ -123,6 +123,12 @@ const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p);
 void pa_mempool_vacuum(pa_mempool *p);
 int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id);
 pa_bool_t pa_mempool_is_shared(pa_mempool *p);
+
+/* A shared pool backed by an anonymous memfd segment. Returns NULL
+ * if memfd is not available on this system. */
+pa_mempool* pa_mempool_new_memfd(size_t size);
+pa_bool_t pa_mempool_is_memfd_backed(pa_mempool *p);
+int pa_mempool_get_memfd_fd(pa_mempool *p);
 size_t pa_mempool_block_size_max(pa_mempool *p);
 
 /* For recieving blocks from other nodes */
@@ -131,6 +137,10 @@ void pa_memimport_free(pa_memimport *i);
 pa_memblock* pa_memimport_get(pa_memimport *i, uint32_t block_id, uint32_t shm_id, size_t offset, size_t size);
 int pa_memimport_process_revoke(pa_memimport *i, uint32_t block_id);
 
+/* Make a memfd segment of the peer known under the ID it will use to
+ * refer to it. Takes over the fd. */
+int pa_memimport_attach_memfd(pa_memimport *i, uint32_t shm_id, int memfd_fd);
+
 /* For sending blocks to other nodes */
 pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void *userdata);
 void pa_memexport_free(pa_memexport *e);
@@ -38,8 +38,18 @@
 
 #include "memblockq.h"
 
+/* How many blocks we walk from the cached read/write position before
+ * we give up and look the index up in the tree instead */
+#define FINGER_STEPS 4
+
 struct list_item {
     struct list_item *next, *prev;
+
+    /* The blocks also form a treap ordered like the list, so that we
+     * can find the block for an arbitrary index in O(log n) */
+    struct list_item *parent, *left, *right;
+    uint32_t priority;
+
     int64_t index;
     pa_memchunk chunk;
 };
@@ -49,6 +59,8 @@ PA_STATIC_FLIST_DECLARE(list_items, 0, pa_xfree);
 struct pa_memblockq {
     struct list_item *blocks, *blocks_tail;
     struct list_item *current_read, *current_write;
+    struct list_item *root;
+    uint32_t seed;
     unsigned n_blocks;
     size_t maxlength, tlength, base, prebuf, minreq, maxrewind;
     int64_t read_index, write_index;
@@ -57,6 +69,12 @@ struct pa_memblockq {
     pa_mcalign *mcalign;
     int64_t missing;
     size_t requested;
+
+    /* Write combining: small chunks are copied into the free space of
+     * this block, which is taken from combine_pool */
+    pa_mempool *combine_pool;
+    size_t combine_threshold;
+    pa_memchunk combine;
 };
 
 pa_memblockq* pa_memblockq_new(
@@ -76,6 +94,8 @@ pa_memblockq* pa_memblockq_new(
     bq = pa_xnew(pa_memblockq, 1);
     bq->blocks = bq->blocks_tail = NULL;
     bq->current_read = bq->current_write = NULL;
+    bq->root = NULL;
+    bq->seed = 0x9e3779b9;
     bq->n_blocks = 0;
 
     bq->base = base;
@@ -84,6 +104,10 @@ pa_memblockq* pa_memblockq_new(
     pa_log_debug("memblockq requested: maxlength=%lu, tlength=%lu, base=%lu, prebuf=%lu, minreq=%lu maxrewind=%lu",
                  (unsigned long) maxlength, (unsigned long) tlength, (unsigned long) base, (unsigned long) prebuf, (unsigned long) minreq, (unsigned long) maxrewind);
 
+    bq->combine_pool = NULL;
+    bq->combine_threshold = 0;
+    pa_memchunk_reset(&bq->combine);
+
     bq->missing = 0;
     bq->requested = bq->maxlength = bq->tlength = bq->prebuf = bq->minreq = bq->maxrewind = 0;
     bq->in_prebuf = TRUE;
@@ -116,13 +140,144 @@ void pa_memblockq_free(pa_memblockq* bq) {
     if (bq->silence.memblock)
         pa_memblock_unref(bq->silence.memblock);
 
+    if (bq->combine.memblock)
+        pa_memblock_unref(bq->combine.memblock);
+
     if (bq->mcalign)
         pa_mcalign_free(bq->mcalign);
 
     pa_xfree(bq);
 }
 
+static uint32_t next_priority(pa_memblockq *bq) {
+    /* xorshift32, the priorities only need to be independent of the
+     * indexes for the treap to stay balanced */
+    bq->seed ^= bq->seed << 13;
+    bq->seed ^= bq->seed >> 17;
+    bq->seed ^= bq->seed << 5;
+
+    return bq->seed;
+}
+
+/* Rotates n above its parent, keeping the in-order sequence intact */
+static void tree_rotate(pa_memblockq *bq, struct list_item *n) {
+    struct list_item *p, *g;
+
+    pa_assert(bq);
+    pa_assert(n);
+    pa_assert_se(p = n->parent);
+
+    g = p->parent;
+
+    if (p->left == n) {
+        if ((p->left = n->right))
+            p->left->parent = p;
+        n->right = p;
+    } else {
+        pa_assert(p->right == n);
+
+        if ((p->right = n->left))
+            p->right->parent = p;
+        n->left = p;
+    }
+
+    p->parent = n;
+    n->parent = g;
+
+    if (!g)
+        bq->root = n;
+    else if (g->left == p)
+        g->left = n;
+    else
+        g->right = n;
+}
+
+/* Called after n has been linked into the list */
+static void tree_insert(pa_memblockq *bq, struct list_item *n) {
+    pa_assert(bq);
+    pa_assert(n);
+
+    n->left = n->right = NULL;
+    n->priority = next_priority(bq);
+
+    /* n goes right between its list neighbours. Either the left one
+     * has no right child, or the right one is the leftmost node of
+     * that subtree and hence has no left child. */
+    if (n->prev && !n->prev->right) {
+        n->prev->right = n;
+        n->parent = n->prev;
+    } else if (n->next) {
+        pa_assert(!n->next->left);
+        n->next->left = n;
+        n->parent = n->next;
+    } else {
+        pa_assert(!bq->root);
+        bq->root = n;
+        n->parent = NULL;
+    }
+
+    while (n->parent && n->parent->priority < n->priority)
+        tree_rotate(bq, n);
+}
+
+static void tree_remove(pa_memblockq *bq, struct list_item *n) {
+    pa_assert(bq);
+    pa_assert(n);
+
+    /* Rotate it down until it is a leaf */
+    while (n->left || n->right) {
+        struct list_item *c;
+
+        if (!n->left)
+            c = n->right;
+        else if (!n->right)
+            c = n->left;
+        else
+            c = n->left->priority > n->right->priority ? n->left : n->right;
+
+        tree_rotate(bq, c);
+    }
+
+    if (!n->parent)
+        bq->root = NULL;
+    else if (n->parent->left == n)
+        n->parent->left = NULL;
+    else
+        n->parent->right = NULL;
+}
+
+/* Returns the first block that ends right of idx */
+static struct list_item* tree_find_read(pa_memblockq *bq, int64_t idx) {
+    struct list_item *n, *r = NULL;
+
+    for (n = bq->root; n;)
+        if (n->index + (int64_t) n->chunk.length > idx) {
+            r = n;
+            n = n->left;
+        } else
+            n = n->right;
+
+    return r;
+}
+
+/* Returns the last block that starts at or left of idx */
+static struct list_item* tree_find_write(pa_memblockq *bq, int64_t idx) {
+    struct list_item *n, *r = NULL;
+
+    for (n = bq->root; n;)
+        if (n->index <= idx) {
+            r = n;
+            n = n->right;
+        } else
+            n = n->left;
+
+    return r;
+}
+
 static void fix_current_read(pa_memblockq *bq) {
+    struct list_item *q;
+    unsigned i;
+
     pa_assert(bq);
 
     if (PA_UNLIKELY(!bq->blocks)) {
@@ -130,27 +285,35 @@ static void fix_current_read(pa_memblockq *bq) {
         return;
     }
 
-    if (PA_UNLIKELY(!bq->current_read))
-        bq->current_read = bq->blocks;
-
-    /* Scan left */
-    while (PA_UNLIKELY(bq->current_read->index > bq->read_index))
+    /* current_read shall point to the first block that ends right of
+     * the read index. It may be NULL in case everything in the queue
+     * was already played. Most of the time the read index moved only
+     * a little since the last call, so we try the old position
+     * first. */
 
-        if (bq->current_read->prev)
-            bq->current_read = bq->current_read->prev;
-        else
-            break;
+    if (PA_LIKELY(q = bq->current_read))
+        for (i = 0; i < FINGER_STEPS; i++) {
 
-    /* Scan right */
-    while (PA_LIKELY(bq->current_read != NULL) && PA_UNLIKELY(bq->current_read->index + (int64_t) bq->current_read->chunk.length <= bq->read_index))
-        bq->current_read = bq->current_read->next;
+            if (q->prev && q->prev->index + (int64_t) q->prev->chunk.length > bq->read_index)
+                q = q->prev;
+            else if (q->index + (int64_t) q->chunk.length <= bq->read_index) {
+                if (!(q = q->next)) {
+                    bq->current_read = NULL;
+                    return;
+                }
+            } else {
+                bq->current_read = q;
+                return;
+            }
+        }
 
-    /* At this point current_read will either point at or left of the
-       next block to play. It may be NULL in case everything in
-       the queue was already played */
+    bq->current_read = tree_find_read(bq, bq->read_index);
 }
 
 static void fix_current_write(pa_memblockq *bq) {
+    struct list_item *q;
+    unsigned i;
+
     pa_assert(bq);
 
     if (PA_UNLIKELY(!bq->blocks)) {
@@ -158,24 +321,50 @@ static void fix_current_write(pa_memblockq *bq) {
         return;
     }
 
-    if (PA_UNLIKELY(!bq->current_write))
-        bq->current_write = bq->blocks_tail;
+    /* current_write shall point to the last block that starts at or
+     * left of the write index, i.e. the one we write into or right
+     * after. It may be NULL in case everything in the queue is still
+     * to be played. */
 
-    /* Scan right */
-    while (PA_UNLIKELY(bq->current_write->index + (int64_t) bq->current_write->chunk.length <= bq->write_index))
+    if (PA_LIKELY(q = bq->current_write))
+        for (i = 0; i < FINGER_STEPS; i++) {
 
-        if (bq->current_write->next)
-            bq->current_write = bq->current_write->next;
-        else
-            break;
+            if (q->index > bq->write_index) {
+                if (!(q = q->prev)) {
+                    bq->current_write = NULL;
+                    return;
+                }
+            } else if (q->next && q->next->index <= bq->write_index)
+                q = q->next;
+            else {
+                bq->current_write = q;
+                return;
+            }
+        }
+
+    bq->current_write = tree_find_write(bq, bq->write_index);
+}
+
+/* Links n into the list right after q, or at the front if q is NULL */
+static void insert_block(pa_memblockq *bq, struct list_item *n, struct list_item *q) {
+    pa_assert(bq);
+    pa_assert(n);
+
+    n->prev = q;
+
+    if ((n->next = q ? q->next : bq->blocks))
+        n->next->prev = n;
+    else
+        bq->blocks_tail = n;
+
+    if (q)
+        q->next = n;
+    else
+        bq->blocks = n;
 
-    /* Scan left */
-    while (PA_LIKELY(bq->current_write != NULL) && PA_UNLIKELY(bq->current_write->index > bq->write_index))
-        bq->current_write = bq->current_write->prev;
+    tree_insert(bq, n);
 
-    /* At this point current_write will either point at or right of
-       the next block to write data to. It may be NULL in case
-       everything in the queue is still to be played */
+    bq->n_blocks++;
 }
 
 static void drop_block(pa_memblockq *bq, struct list_item *q) {
@@ -204,6 +393,8 @@ static void drop_block(pa_memblockq *bq, struct list_item *q) {
     if (bq->current_read == q)
         bq->current_read = q->next;
 
+    tree_remove(bq, q);
+
     pa_memblock_unref(q->chunk.memblock);
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(list_items), q) < 0)
@@ -212,6 +403,27 @@ static void drop_block(pa_memblockq *bq, struct list_item *q) {
     bq->n_blocks--;
 }
 
+/* If the block following q continues q in the same memblock, fold it
+ * into q. This happens when a hole is filled or an overwritten range
+ * is written back with the original data. */
+static void merge_next(pa_memblockq *bq, struct list_item *q) {
+    struct list_item *n;
+
+    pa_assert(bq);
+    pa_assert(q);
+
+    if (!(n = q->next))
+        return;
+
+    if (n->chunk.memblock != q->chunk.memblock ||
+        q->chunk.index + q->chunk.length != n->chunk.index ||
+        q->index + (int64_t) q->chunk.length != n->index)
+        return;
+
+    q->chunk.length += n->chunk.length;
+    drop_block(bq, n);
+}
+
 static void drop_backlog(pa_memblockq *bq) {
     int64_t boundary;
     pa_assert(bq);
@@ -246,6 +458,41 @@ static pa_bool_t can_push(pa_memblockq *bq, size_t l) {
     return TRUE;
 }
 
+/* Copies the data of in into the current combining block and returns
+ * the chunk there in out */
+static void write_combine(pa_memblockq *bq, const pa_memchunk *in, pa_memchunk *out) {
+    pa_assert(bq);
+    pa_assert(in);
+    pa_assert(out);
+
+    if (!bq->combine.memblock || bq->combine.length < in->length) {
+
+        /* If the queue doesn't reference the old block anymore we can
+         * simply start over in it */
+        if (bq->combine.memblock && pa_memblock_ref_is_one(bq->combine.memblock))
+            bq->combine.index = 0;
+        else {
+            if (bq->combine.memblock)
+                pa_memblock_unref(bq->combine.memblock);
+
+            bq->combine.memblock = pa_memblock_new(bq->combine_pool, (size_t) -1);
+            bq->combine.index = 0;
+        }
+
+        bq->combine.length = pa_memblock_get_length(bq->combine.memblock);
+        pa_assert(bq->combine.length >= in->length);
+    }
+
+    out->memblock = bq->combine.memblock;
+    out->index = bq->combine.index;
+    out->length = in->length;
+
+    pa_memchunk_memcpy(out, (pa_memchunk*) in);
+
+    bq->combine.index += in->length;
+    bq->combine.length -= in->length;
+}
+
 int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
     struct list_item *q, *n;
     pa_memchunk chunk;
@@ -264,7 +511,15 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
         return -1;
 
     old = bq->write_index;
-    chunk = *uchunk;
+
+    /* Successive small chunks end up contiguous in the combining
+     * block, and are merged into a single entry below */
+    if (bq->combine_threshold > 0 &&
+        uchunk->length < bq->combine_threshold &&
+        uchunk->memblock != bq->combine.memblock)
+        write_combine(bq, uchunk, &chunk);
+    else
+        chunk = *uchunk;
 
     fix_current_write(bq);
     q = bq->current_write;
@@ -326,17 +581,11 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
 
                 /* Drop it from the new entry */
                 p->index = q->index + (int64_t) d;
+                p->chunk.index += d;
                 p->chunk.length -= d;
 
                 /* Add it to the list */
-                p->prev = q;
-                if ((p->next = q->next))
-                    q->next->prev = p;
-                else
-                    bq->blocks_tail = p;
-                q->next = p;
-
-                bq->n_blocks++;
+                insert_block(bq, p, q);
             }
 
             /* Truncate the chunk */
@@ -379,6 +628,7 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
 
             q->chunk.length += chunk.length;
             bq->write_index += (int64_t) chunk.length;
+            merge_next(bq, q);
             goto finish;
         }
     } else
@@ -392,20 +642,8 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
     n->index = bq->write_index;
     bq->write_index += (int64_t) n->chunk.length;
 
-    n->next = q ? q->next : bq->blocks;
-    n->prev = q;
-
-    if (n->next)
-        n->next->prev = n;
-    else
-        bq->blocks_tail = n;
-
-    if (n->prev)
-        n->prev->next = n;
-    else
-        bq->blocks = n;
-
-    bq->n_blocks++;
+    insert_block(bq, n, q);
+    merge_next(bq, n);
 
 finish:
 
@@ -526,6 +764,13 @@ void pa_memblockq_drop(pa_memblockq *bq, size_t length) {
         if (update_prebuf(bq))
             break;
 
+        /* If we cannot run dry on the way we can skip the whole thing
+         * at once */
+        if (bq->prebuf <= 0 || bq->read_index + (int64_t) length <= bq->write_index) {
+            bq->read_index += (int64_t) length;
+            break;
+        }
+
         fix_current_read(bq);
 
         if (bq->current_read) {
@@ -942,6 +1187,22 @@ void pa_memblockq_silence(pa_memblockq *bq) {
     pa_assert(bq->n_blocks == 0);
 }
 
+void pa_memblockq_set_write_combining(pa_memblockq *bq, pa_mempool *pool, size_t threshold) {
+    pa_assert(bq);
+    pa_assert(pool || threshold <= 0);
+
+    if (bq->combine.memblock) {
+        pa_memblock_unref(bq->combine.memblock);
+        pa_memchunk_reset(&bq->combine);
+    }
+
+    if (pool && threshold > pa_mempool_block_size_max(pool))
+        threshold = pa_mempool_block_size_max(pool);
+
+    bq->combine_pool = pool;
+    bq->combine_threshold = threshold;
+}
+
 unsigned pa_memblockq_get_nblocks(pa_memblockq *bq) {
     pa_assert(bq);
 
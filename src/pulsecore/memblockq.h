@@ -179,6 +179,11 @@ void pa_memblockq_silence(pa_memblockq *bq);
 /* Check whether we currently are in prebuf state */
 pa_bool_t pa_memblockq_prebuf_active(pa_memblockq *bq);
 
+/* Copy pushed chunks shorter than threshold bytes into larger blocks
+ * taken from pool, so that many small writes are stored as a few
+ * large entries. Pass 0 as threshold to disable. */
+void pa_memblockq_set_write_combining(pa_memblockq *bq, pa_mempool *pool, size_t threshold);
+
 /* Return how many items are currently stored in the queue */
 unsigned pa_memblockq_get_nblocks(pa_memblockq *bq);
 
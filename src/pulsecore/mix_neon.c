@@ -0,0 +1,286 @@
+/***
+  This file is part of PulseAudio.
+
+  Copyright 2004-2006 Lennart Poettering
+  Copyright 2009 Wim Taymans <wim.taymans@collabora.co.uk>
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-arm.h"
+
+#include "sample-util.h"
+
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+/* Like the SSE versions these mix a group of samples of all streams
+ * at a time, keeping the sums in NEON registers. %[v] points to the
+ * padded volumes of the current channel of the first stream and is
+ * moved along with %[m]. */
+
+#define MIX_OFFSET_PTR offsetof(pa_mix_info, ptr)
+
+static void mix_s16ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int16_t *data, unsigned n) {
+
+    for (; n > 0; n--) {
+        int32_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+
+            if (PA_LIKELY(cv > 0))
+                sum += (int32_t) (((int64_t) *((int16_t*) m->ptr) * cv) >> 16);
+
+            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
+        }
+
+        *(data++) = (int16_t) PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_s32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int32_t *data, unsigned n) {
+
+    for (; n > 0; n--) {
+        int64_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+
+            if (PA_LIKELY(cv > 0))
+                sum += ((int64_t) *((int32_t*) m->ptr) * cv) >> 16;
+
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
+        }
+
+        *(data++) = (int32_t) PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_float32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, float *data, unsigned n) {
+
+    for (; n > 0; n--) {
+        float sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum += *((float*) m->ptr) * m->linear[channel].f;
+            m->ptr = (uint8_t*) m->ptr + sizeof(float);
+        }
+
+        *(data++) = sum;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void
+pa_mix_s16ne_neon (pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length)
+{
+    unsigned channel = 0, step, n;
+    pa_mix_info *m;
+    void *v, *temp;
+
+    length /= sizeof (int16_t);
+    step = 8 % channels;
+
+    for (; length >= 8; length -= 8) {
+        m = streams;
+        v = &streams->linear[channel];
+        n = nstreams;
+
+        __asm__ __volatile__ (
+            " vmov.i32 q8, #0                 \n\t"
+            " vmov.i32 q9, #0                 \n\t"
+
+            "1:                               \n\t"
+            " ldr %[t], [%[m], %[ptr]]        \n\t"
+            " vld1.16 {d0-d1}, [%[t]]!        \n\t" /* p7 .. p0 */
+            " str %[t], [%[m], %[ptr]]        \n\t"
+            " vld1.32 {d4-d7}, [%[v]]         \n\t" /* v7 .. v0 */
+
+            " vmovl.s16 q1, d1                \n\t"
+            " vmovl.s16 q0, d0                \n\t"
+            " vmull.s32 q10, d0, d4           \n\t" /* p * v */
+            " vmull.s32 q11, d1, d5           \n\t"
+            " vmull.s32 q12, d2, d6           \n\t"
+            " vmull.s32 q13, d3, d7           \n\t"
+            " vshrn.i64 d20, q10, #16         \n\t" /* >> 16 */
+            " vshrn.i64 d21, q11, #16         \n\t"
+            " vshrn.i64 d24, q12, #16         \n\t"
+            " vshrn.i64 d25, q13, #16         \n\t"
+            " vadd.i32 q8, q8, q10            \n\t"
+            " vadd.i32 q9, q9, q12            \n\t"
+
+            " add %[m], %[m], %[size]         \n\t"
+            " add %[v], %[v], %[size]         \n\t"
+            " subs %[n], %[n], #1             \n\t"
+            " bne 1b                          \n\t"
+
+            " vqmovn.s32 d16, q8              \n\t" /* clamp to 16 bit */
+            " vqmovn.s32 d17, q9              \n\t"
+            " vst1.16 {d16-d17}, [%[d]]       \n\t"
+
+            : [m] "+r" (m), [v] "+r" (v), [n] "+r" (n), [t] "=&r" (temp)
+            : [d] "r" (data), [ptr] "I" (MIX_OFFSET_PTR), [size] "r" (sizeof (pa_mix_info))
+            : "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7",
+              "d16", "d17", "d18", "d19", "d20", "d21", "d22", "d23", "d24", "d25", "d26", "d27"
+        );
+
+        data += 8;
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s16ne_tail (streams, nstreams, channels, channel, data, length);
+}
+
+static void
+pa_mix_s32ne_neon (pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length)
+{
+    unsigned channel = 0, step, n;
+    pa_mix_info *m;
+    void *v, *temp;
+
+    length /= sizeof (int32_t);
+    step = 4 % channels;
+
+    for (; length >= 4; length -= 4) {
+        m = streams;
+        v = &streams->linear[channel];
+        n = nstreams;
+
+        __asm__ __volatile__ (
+            " vmov.i64 q8, #0                 \n\t"
+            " vmov.i64 q9, #0                 \n\t"
+
+            "1:                               \n\t"
+            " ldr %[t], [%[m], %[ptr]]        \n\t"
+            " vld1.32 {d0-d1}, [%[t]]!        \n\t" /* p3 .. p0 */
+            " str %[t], [%[m], %[ptr]]        \n\t"
+            " vld1.32 {d4-d5}, [%[v]]         \n\t" /* v3 .. v0 */
+
+            " vmull.s32 q10, d0, d4           \n\t" /* p * v */
+            " vmull.s32 q11, d1, d5           \n\t"
+            " vshr.s64 q10, q10, #16          \n\t" /* >> 16 */
+            " vshr.s64 q11, q11, #16          \n\t"
+            " vadd.i64 q8, q8, q10            \n\t"
+            " vadd.i64 q9, q9, q11            \n\t"
+
+            " add %[m], %[m], %[size]         \n\t"
+            " add %[v], %[v], %[size]         \n\t"
+            " subs %[n], %[n], #1             \n\t"
+            " bne 1b                          \n\t"
+
+            " vqmovn.s64 d16, q8              \n\t" /* clamp to 32 bit */
+            " vqmovn.s64 d17, q9              \n\t"
+            " vst1.32 {d16-d17}, [%[d]]       \n\t"
+
+            : [m] "+r" (m), [v] "+r" (v), [n] "+r" (n), [t] "=&r" (temp)
+            : [d] "r" (data), [ptr] "I" (MIX_OFFSET_PTR), [size] "r" (sizeof (pa_mix_info))
+            : "cc", "memory", "d0", "d1", "d4", "d5",
+              "d16", "d17", "d18", "d19", "d20", "d21", "d22", "d23"
+        );
+
+        data += 4;
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s32ne_tail (streams, nstreams, channels, channel, data, length);
+}
+
+static void
+pa_mix_float32ne_neon (pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length)
+{
+    unsigned channel = 0, step, n;
+    pa_mix_info *m;
+    void *v, *temp;
+
+    length /= sizeof (float);
+    step = 8 % channels;
+
+    for (; length >= 8; length -= 8) {
+        m = streams;
+        v = &streams->linear[channel];
+        n = nstreams;
+
+        __asm__ __volatile__ (
+            " vmov.i32 q8, #0                 \n\t"
+            " vmov.i32 q9, #0                 \n\t"
+
+            "1:                               \n\t"
+            " ldr %[t], [%[m], %[ptr]]        \n\t"
+            " vld1.32 {d0-d3}, [%[t]]!        \n\t" /* p7 .. p0 */
+            " str %[t], [%[m], %[ptr]]        \n\t"
+            " vld1.32 {d4-d7}, [%[v]]         \n\t" /* v7 .. v0 */
+
+            " vmla.f32 q8, q0, q2             \n\t"
+            " vmla.f32 q9, q1, q3             \n\t"
+
+            " add %[m], %[m], %[size]         \n\t"
+            " add %[v], %[v], %[size]         \n\t"
+            " subs %[n], %[n], #1             \n\t"
+            " bne 1b                          \n\t"
+
+            " vst1.32 {d16-d19}, [%[d]]       \n\t"
+
+            : [m] "+r" (m), [v] "+r" (v), [n] "+r" (n), [t] "=&r" (temp)
+            : [d] "r" (data), [ptr] "I" (MIX_OFFSET_PTR), [size] "r" (sizeof (pa_mix_info))
+            : "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7",
+              "d16", "d17", "d18", "d19"
+        );
+
+        data += 8;
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_float32ne_tail (streams, nstreams, channels, channel, data, length);
+}
+
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+
+void pa_mix_func_init_neon (pa_cpu_arm_flag_t flags) {
+#if defined (__arm__) && defined (__ARM_NEON__)
+    pa_log_info("Initialising ARM NEON optimized mixing functions.");
+
+    pa_set_mix_func (PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_neon);
+    pa_set_mix_func (PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_neon);
+    pa_set_mix_func (PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_neon);
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+}
@@ -0,0 +1,515 @@
+/***
+  This file is part of PulseAudio.
+
+  Copyright 2004-2006 Lennart Poettering
+  Copyright 2009 Wim Taymans <wim.taymans@collabora.co.uk>
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-x86.h"
+
+#include "sample-util.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+/* All mixers below handle a group of samples for all streams in one
+ * go: the inner loop walks the pa_mix_info array, loads the next
+ * samples of each stream together with the (padded) volumes for the
+ * current channel offset and accumulates into registers. Only when
+ * all streams have been summed the group is clamped and stored. The
+ * few samples that are left at the end are done in C. */
+
+#define MIX_OFFSET_PTR    offsetof(pa_mix_info, ptr)
+#define MIX_OFFSET_LINEAR offsetof(pa_mix_info, linear)
+
+/* s = | 0 | p |, v = | vh | vl |, result in v = p * v >> 16, uses xmm4/xmm5 */
+#define MIX_32x16(s,v)                                                      \
+      " pxor %%xmm4, %%xmm4          \n\t"                                  \
+      " pcmpgtw "#s", %%xmm4         \n\t" /* .. |  0  | s(p) | */          \
+      " pand "#v", %%xmm4            \n\t" /* .. |  0  |  (vl) | */         \
+      " movdqa "#s", %%xmm5          \n\t"                                  \
+      " pmulhuw "#v", "#s"           \n\t" /* .. |  0  | vl*p | */          \
+      " psubd %%xmm4, "#s"           \n\t" /* .. |  0  | vl*p | + sign correct */ \
+      " psrld $16, "#v"              \n\t" /* .. |  0  |  vh  | */          \
+      " pmaddwd %%xmm5, "#v"         \n\t" /* .. |   p * vh    | */         \
+      " paddd "#s", "#v"             \n\t" /* .. |   p * v     | */
+
+/* same as above for 8 samples at a time, uses ymm4/ymm5 */
+#define MIX_32x16_AVX2(s,v)                                                 \
+      " vpxor %%ymm4, %%ymm4, %%ymm4 \n\t"                                  \
+      " vpcmpgtw "#s", %%ymm4, %%ymm4\n\t"                                  \
+      " vpand "#v", %%ymm4, %%ymm4   \n\t"                                  \
+      " vpmulhuw "#v", "#s", %%ymm5  \n\t"                                  \
+      " vpsubd %%ymm4, %%ymm5, %%ymm5\n\t"                                  \
+      " vpsrld $16, "#v", "#v"       \n\t"                                  \
+      " vpmaddwd "#s", "#v", "#v"    \n\t"                                  \
+      " vpaddd %%ymm5, "#v", "#v"    \n\t"
+
+static const PA_DECLARE_ALIGNED (16, double, s32_scale[4]) = { 1.0 / 0x10000, 1.0 / 0x10000, 1.0 / 0x10000, 1.0 / 0x10000 };
+static const PA_DECLARE_ALIGNED (16, double, s32_max[4]) = { 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF };
+static const PA_DECLARE_ALIGNED (16, double, s32_min[4]) = { -0x80000000LL, -0x80000000LL, -0x80000000LL, -0x80000000LL };
+
+static void mix_s16ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int16_t *data, unsigned n) {
+
+    for (; n > 0; n--) {
+        int32_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, lo, hi, cv = m->linear[channel].i;
+
+            if (PA_LIKELY(cv > 0)) {
+                hi = cv >> 16;
+                lo = cv & 0xFFFF;
+
+                v = *((int16_t*) m->ptr);
+                v = ((v * lo) >> 16) + (v * hi);
+                sum += v;
+            }
+
+            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
+        }
+
+        *(data++) = (int16_t) PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_s32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int32_t *data, unsigned n) {
+
+    for (; n > 0; n--) {
+        int64_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+
+            if (PA_LIKELY(cv > 0))
+                sum += ((int64_t) *((int32_t*) m->ptr) * cv) >> 16;
+
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
+        }
+
+        *(data++) = (int32_t) PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_float32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, float *data, unsigned n) {
+
+    for (; n > 0; n--) {
+        float sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum += *((float*) m->ptr) * m->linear[channel].f;
+            m->ptr = (uint8_t*) m->ptr + sizeof(float);
+        }
+
+        *(data++) = sum;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void
+pa_mix_s16ne_sse2 (pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length)
+{
+    pa_reg_x86 channel = 0, step, n, temp;
+    pa_mix_info *m;
+
+    length /= sizeof (int16_t);
+    step = 8 % channels;
+
+    for (; length >= 8; length -= 8) {
+        m = streams;
+        n = nstreams;
+
+        __asm__ __volatile__ (
+            " pxor %%xmm6, %%xmm6             \n\t"
+            " pxor %%xmm7, %%xmm7             \n\t"
+
+            "1:                               \n\t"
+            " mov %c[ptr](%[m]), %[t]         \n\t"
+            " movdqu (%[t]), %%xmm0           \n\t" /* |  p7 .. p0  | */
+            " add $16, %[t]                   \n\t"
+            " mov %[t], %c[ptr](%[m])         \n\t"
+
+            " movdqu %c[lin](%[m], %[c], 4), %%xmm2    \n\t" /* | v3 .. v0 | */
+            " movdqu %c[lin]+16(%[m], %[c], 4), %%xmm3 \n\t" /* | v7 .. v4 | */
+
+            " pxor %%xmm4, %%xmm4             \n\t"
+            " movdqa %%xmm0, %%xmm1           \n\t"
+            " punpcklwd %%xmm4, %%xmm0        \n\t" /* | 0 | p3 | .. | 0 | p0 | */
+            " punpckhwd %%xmm4, %%xmm1        \n\t" /* | 0 | p7 | .. | 0 | p4 | */
+            MIX_32x16 (%%xmm0, %%xmm2)
+            MIX_32x16 (%%xmm1, %%xmm3)
+            " paddd %%xmm2, %%xmm6            \n\t"
+            " paddd %%xmm3, %%xmm7            \n\t"
+
+            " add %[size], %[m]               \n\t"
+            " dec %[n]                        \n\t"
+            " jne 1b                          \n\t"
+
+            " packssdw %%xmm7, %%xmm6         \n\t" /* clamp to 16 bit */
+            " movdqu %%xmm6, (%[d])           \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [t] "=&r" (temp)
+            : [c] "r" (channel), [d] "r" (data),
+              [ptr] "i" (MIX_OFFSET_PTR), [lin] "i" (MIX_OFFSET_LINEAR), [size] "i" (sizeof (pa_mix_info))
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+
+        data += 8;
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s16ne_tail (streams, nstreams, channels, (unsigned) channel, data, length);
+}
+
+static void
+pa_mix_s32ne_sse2 (pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length)
+{
+    pa_reg_x86 channel = 0, step, n, temp;
+    pa_mix_info *m;
+
+    length /= sizeof (int32_t);
+    step = 4 % channels;
+
+    /* The 32x32 bit products do not fit in an integer SSE2 lane, so we
+     * accumulate in double precision and round once at the end. */
+    for (; length >= 4; length -= 4) {
+        m = streams;
+        n = nstreams;
+
+        __asm__ __volatile__ (
+            " xorpd %%xmm6, %%xmm6            \n\t"
+            " xorpd %%xmm7, %%xmm7            \n\t"
+
+            "1:                               \n\t"
+            " mov %c[ptr](%[m]), %[t]         \n\t"
+            " cvtdq2pd (%[t]), %%xmm0         \n\t" /* | p1 | p0 | */
+            " cvtdq2pd 8(%[t]), %%xmm1        \n\t" /* | p3 | p2 | */
+            " add $16, %[t]                   \n\t"
+            " mov %[t], %c[ptr](%[m])         \n\t"
+
+            " cvtdq2pd %c[lin](%[m], %[c], 4), %%xmm2   \n\t" /* | v1 | v0 | */
+            " cvtdq2pd %c[lin]+8(%[m], %[c], 4), %%xmm3 \n\t" /* | v3 | v2 | */
+
+            " mulpd %%xmm2, %%xmm0            \n\t"
+            " mulpd %%xmm3, %%xmm1            \n\t"
+            " addpd %%xmm0, %%xmm6            \n\t"
+            " addpd %%xmm1, %%xmm7            \n\t"
+
+            " add %[size], %[m]               \n\t"
+            " dec %[n]                        \n\t"
+            " jne 1b                          \n\t"
+
+            " mulpd %[scale], %%xmm6          \n\t" /* >> 16 */
+            " mulpd %[scale], %%xmm7          \n\t"
+            " minpd %[max], %%xmm6            \n\t" /* clamp to 32 bit */
+            " minpd %[max], %%xmm7            \n\t"
+            " maxpd %[min], %%xmm6            \n\t"
+            " maxpd %[min], %%xmm7            \n\t"
+            " cvtpd2dq %%xmm6, %%xmm6         \n\t"
+            " cvtpd2dq %%xmm7, %%xmm7         \n\t"
+            " punpcklqdq %%xmm7, %%xmm6       \n\t"
+            " movdqu %%xmm6, (%[d])           \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [t] "=&r" (temp)
+            : [c] "r" (channel), [d] "r" (data),
+              [ptr] "i" (MIX_OFFSET_PTR), [lin] "i" (MIX_OFFSET_LINEAR), [size] "i" (sizeof (pa_mix_info)),
+              [scale] "m" (*s32_scale), [max] "m" (*s32_max), [min] "m" (*s32_min)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm6", "xmm7"
+        );
+
+        data += 4;
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s32ne_tail (streams, nstreams, channels, (unsigned) channel, data, length);
+}
+
+static void
+pa_mix_float32ne_sse (pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length)
+{
+    pa_reg_x86 channel = 0, step, n, temp;
+    pa_mix_info *m;
+
+    length /= sizeof (float);
+    step = 8 % channels;
+
+    for (; length >= 8; length -= 8) {
+        m = streams;
+        n = nstreams;
+
+        __asm__ __volatile__ (
+            " xorps %%xmm6, %%xmm6            \n\t"
+            " xorps %%xmm7, %%xmm7            \n\t"
+
+            "1:                               \n\t"
+            " mov %c[ptr](%[m]), %[t]         \n\t"
+            " movups (%[t]), %%xmm0           \n\t" /* | p3 .. p0 | */
+            " movups 16(%[t]), %%xmm1         \n\t" /* | p7 .. p4 | */
+            " add $32, %[t]                   \n\t"
+            " mov %[t], %c[ptr](%[m])         \n\t"
+
+            " movups %c[lin](%[m], %[c], 4), %%xmm2    \n\t" /* | v3 .. v0 | */
+            " movups %c[lin]+16(%[m], %[c], 4), %%xmm3 \n\t" /* | v7 .. v4 | */
+
+            " mulps %%xmm2, %%xmm0            \n\t"
+            " mulps %%xmm3, %%xmm1            \n\t"
+            " addps %%xmm0, %%xmm6            \n\t"
+            " addps %%xmm1, %%xmm7            \n\t"
+
+            " add %[size], %[m]               \n\t"
+            " dec %[n]                        \n\t"
+            " jne 1b                          \n\t"
+
+            " movups %%xmm6, (%[d])           \n\t"
+            " movups %%xmm7, 16(%[d])         \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [t] "=&r" (temp)
+            : [c] "r" (channel), [d] "r" (data),
+              [ptr] "i" (MIX_OFFSET_PTR), [lin] "i" (MIX_OFFSET_LINEAR), [size] "i" (sizeof (pa_mix_info))
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm6", "xmm7"
+        );
+
+        data += 8;
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_float32ne_tail (streams, nstreams, channels, (unsigned) channel, data, length);
+}
+
+static void
+pa_mix_s16ne_avx2 (pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length)
+{
+    pa_reg_x86 channel = 0, step, n, temp;
+    pa_mix_info *m;
+
+    length /= sizeof (int16_t);
+    step = 16 % channels;
+
+    for (; length >= 16; length -= 16) {
+        m = streams;
+        n = nstreams;
+
+        __asm__ __volatile__ (
+            " vpxor %%ymm6, %%ymm6, %%ymm6    \n\t"
+            " vpxor %%ymm7, %%ymm7, %%ymm7    \n\t"
+
+            "1:                               \n\t"
+            " mov %c[ptr](%[m]), %[t]         \n\t"
+            " vpmovzxwd (%[t]), %%ymm0        \n\t" /* | 0 | p7  | .. | 0 | p0 | */
+            " vpmovzxwd 16(%[t]), %%ymm1      \n\t" /* | 0 | p15 | .. | 0 | p8 | */
+            " add $32, %[t]                   \n\t"
+            " mov %[t], %c[ptr](%[m])         \n\t"
+
+            " vmovdqu %c[lin](%[m], %[c], 4), %%ymm2    \n\t" /* | v7 .. v0  | */
+            " vmovdqu %c[lin]+32(%[m], %[c], 4), %%ymm3 \n\t" /* | v15 .. v8 | */
+
+            MIX_32x16_AVX2 (%%ymm0, %%ymm2)
+            MIX_32x16_AVX2 (%%ymm1, %%ymm3)
+            " vpaddd %%ymm2, %%ymm6, %%ymm6   \n\t"
+            " vpaddd %%ymm3, %%ymm7, %%ymm7   \n\t"
+
+            " add %[size], %[m]               \n\t"
+            " dec %[n]                        \n\t"
+            " jne 1b                          \n\t"
+
+            " vpackssdw %%ymm7, %%ymm6, %%ymm6 \n\t" /* clamp, packs per 128 bit lane */
+            " vpermq $0xd8, %%ymm6, %%ymm6    \n\t" /* restore sample order */
+            " vmovdqu %%ymm6, (%[d])          \n\t"
+            " vzeroupper                      \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [t] "=&r" (temp)
+            : [c] "r" (channel), [d] "r" (data),
+              [ptr] "i" (MIX_OFFSET_PTR), [lin] "i" (MIX_OFFSET_LINEAR), [size] "i" (sizeof (pa_mix_info))
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+        );
+
+        data += 16;
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s16ne_tail (streams, nstreams, channels, (unsigned) channel, data, length);
+}
+
+static void
+pa_mix_s32ne_avx2 (pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length)
+{
+    pa_reg_x86 channel = 0, step, n, temp;
+    pa_mix_info *m;
+
+    length /= sizeof (int32_t);
+    step = 8 % channels;
+
+    for (; length >= 8; length -= 8) {
+        m = streams;
+        n = nstreams;
+
+        __asm__ __volatile__ (
+            " vxorpd %%ymm6, %%ymm6, %%ymm6   \n\t"
+            " vxorpd %%ymm7, %%ymm7, %%ymm7   \n\t"
+
+            "1:                               \n\t"
+            " mov %c[ptr](%[m]), %[t]         \n\t"
+            " vcvtdq2pd (%[t]), %%ymm0        \n\t" /* | p3 .. p0 | */
+            " vcvtdq2pd 16(%[t]), %%ymm1      \n\t" /* | p7 .. p4 | */
+            " add $32, %[t]                   \n\t"
+            " mov %[t], %c[ptr](%[m])         \n\t"
+
+            " vcvtdq2pd %c[lin](%[m], %[c], 4), %%ymm2    \n\t" /* | v3 .. v0 | */
+            " vcvtdq2pd %c[lin]+16(%[m], %[c], 4), %%ymm3 \n\t" /* | v7 .. v4 | */
+
+            " vmulpd %%ymm2, %%ymm0, %%ymm0   \n\t"
+            " vmulpd %%ymm3, %%ymm1, %%ymm1   \n\t"
+            " vaddpd %%ymm0, %%ymm6, %%ymm6   \n\t"
+            " vaddpd %%ymm1, %%ymm7, %%ymm7   \n\t"
+
+            " add %[size], %[m]               \n\t"
+            " dec %[n]                        \n\t"
+            " jne 1b                          \n\t"
+
+            " vbroadcastsd %[scale], %%ymm0   \n\t"
+            " vbroadcastsd %[max], %%ymm1     \n\t"
+            " vbroadcastsd %[min], %%ymm2     \n\t"
+            " vmulpd %%ymm0, %%ymm6, %%ymm6   \n\t" /* >> 16 */
+            " vmulpd %%ymm0, %%ymm7, %%ymm7   \n\t"
+            " vminpd %%ymm1, %%ymm6, %%ymm6   \n\t" /* clamp to 32 bit */
+            " vminpd %%ymm1, %%ymm7, %%ymm7   \n\t"
+            " vmaxpd %%ymm2, %%ymm6, %%ymm6   \n\t"
+            " vmaxpd %%ymm2, %%ymm7, %%ymm7   \n\t"
+            " vcvtpd2dq %%ymm6, %%xmm6        \n\t"
+            " vcvtpd2dq %%ymm7, %%xmm7        \n\t"
+            " vmovdqu %%xmm6, (%[d])          \n\t"
+            " vmovdqu %%xmm7, 16(%[d])        \n\t"
+            " vzeroupper                      \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [t] "=&r" (temp)
+            : [c] "r" (channel), [d] "r" (data),
+              [ptr] "i" (MIX_OFFSET_PTR), [lin] "i" (MIX_OFFSET_LINEAR), [size] "i" (sizeof (pa_mix_info)),
+              [scale] "m" (*s32_scale), [max] "m" (*s32_max), [min] "m" (*s32_min)
+            : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm6", "xmm7"
+        );
+
+        data += 8;
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_s32ne_tail (streams, nstreams, channels, (unsigned) channel, data, length);
+}
+
+static void
+pa_mix_float32ne_avx2 (pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length)
+{
+    pa_reg_x86 channel = 0, step, n, temp;
+    pa_mix_info *m;
+
+    length /= sizeof (float);
+    step = 16 % channels;
+
+    for (; length >= 16; length -= 16) {
+        m = streams;
+        n = nstreams;
+
+        __asm__ __volatile__ (
+            " vxorps %%ymm6, %%ymm6, %%ymm6   \n\t"
+            " vxorps %%ymm7, %%ymm7, %%ymm7   \n\t"
+
+            "1:                               \n\t"
+            " mov %c[ptr](%[m]), %[t]         \n\t"
+            " vmovups (%[t]), %%ymm0          \n\t" /* | p7 .. p0  | */
+            " vmovups 32(%[t]), %%ymm1        \n\t" /* | p15 .. p8 | */
+            " add $64, %[t]                   \n\t"
+            " mov %[t], %c[ptr](%[m])         \n\t"
+
+            " vmulps %c[lin](%[m], %[c], 4), %%ymm0, %%ymm0    \n\t"
+            " vmulps %c[lin]+32(%[m], %[c], 4), %%ymm1, %%ymm1 \n\t"
+            " vaddps %%ymm0, %%ymm6, %%ymm6   \n\t"
+            " vaddps %%ymm1, %%ymm7, %%ymm7   \n\t"
+
+            " add %[size], %[m]               \n\t"
+            " dec %[n]                        \n\t"
+            " jne 1b                          \n\t"
+
+            " vmovups %%ymm6, (%[d])          \n\t"
+            " vmovups %%ymm7, 32(%[d])        \n\t"
+            " vzeroupper                      \n\t"
+
+            : [m] "+r" (m), [n] "+r" (n), [t] "=&r" (temp)
+            : [c] "r" (channel), [d] "r" (data),
+              [ptr] "i" (MIX_OFFSET_PTR), [lin] "i" (MIX_OFFSET_LINEAR), [size] "i" (sizeof (pa_mix_info))
+            : "cc", "memory", "xmm0", "xmm1", "xmm6", "xmm7"
+        );
+
+        data += 16;
+        if ((channel += step) >= channels)
+            channel -= channels;
+    }
+
+    mix_float32ne_tail (streams, nstreams, channels, (unsigned) channel, data, length);
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_mix_func_init_sse (pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized mixing functions.");
+
+        pa_set_mix_func (PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_avx2);
+        pa_set_mix_func (PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_avx2);
+        pa_set_mix_func (PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_avx2);
+    } else if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized mixing functions.");
+
+        pa_set_mix_func (PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_sse2);
+        pa_set_mix_func (PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_sse2);
+        pa_set_mix_func (PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_sse);
+    } else if (flags & PA_CPU_X86_SSE) {
+        pa_log_info("Initialising SSE optimized mixing functions.");
+
+        pa_set_mix_func (PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_sse);
+    }
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
@@ -169,6 +169,9 @@ enum {
     PA_COMMAND_SET_SINK_PORT,
     PA_COMMAND_SET_SOURCE_PORT,
 
+    /* Supported since protocol v18 (0.9.22) */
+    PA_COMMAND_GET_RENDER_PROFILE_INFO_LIST,
+
     PA_COMMAND_MAX
 };
 
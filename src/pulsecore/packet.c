@@ -27,19 +27,43 @@
 
 #include <pulse/xmalloc.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/flist.h>
 
 #include "packet.h"
 
+/* Each of them takes up 4K, so don't keep too many around. The limit
+ * only applies to the shared list: every thread that allocates
+ * packets keeps a magazine of them on top of it, which is why the
+ * shared part is kept small. */
+PA_STATIC_FLIST_DECLARE(packets, 16, pa_xfree);
+PA_STATIC_FLIST_DECLARE(small_packets, 128, pa_xfree);
+
 pa_packet* pa_packet_new(size_t length) {
     pa_packet *p;
 
     pa_assert(length > 0);
 
-    p = pa_xmalloc(PA_ALIGN(sizeof(pa_packet)) + length);
+    if (length <= PA_PACKET_POOL_SIZE_SMALL) {
+
+        if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(small_packets))))
+            p = pa_xmalloc(PA_ALIGN(sizeof(pa_packet)) + PA_PACKET_POOL_SIZE_SMALL);
+
+        p->type = PA_PACKET_POOLED_SMALL;
+
+    } else if (length > PA_PACKET_POOL_SIZE/2 && length <= PA_PACKET_POOL_SIZE) {
+
+        if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(packets))))
+            p = pa_xmalloc(PA_ALIGN(sizeof(pa_packet)) + PA_PACKET_POOL_SIZE);
+
+        p->type = PA_PACKET_POOLED;
+    } else {
+        p = pa_xmalloc(PA_ALIGN(sizeof(pa_packet)) + length);
+        p->type = PA_PACKET_APPENDED;
+    }
+
     PA_REFCNT_INIT(p);
     p->length = length;
     p->data = (uint8_t*) p + PA_ALIGN(sizeof(pa_packet));
-    p->type = PA_PACKET_APPENDED;
 
     return p;
 }
@@ -74,6 +98,13 @@ void pa_packet_unref(pa_packet *p) {
     if (PA_REFCNT_DEC(p) <= 0) {
         if (p->type == PA_PACKET_DYNAMIC)
             pa_xfree(p->data);
+        else if (p->type == PA_PACKET_POOLED &&
+                 pa_flist_push(PA_STATIC_FLIST_GET(packets), p) >= 0)
+            return;
+        else if (p->type == PA_PACKET_POOLED_SMALL &&
+                 pa_flist_push(PA_STATIC_FLIST_GET(small_packets), p) >= 0)
+            return;
+
         pa_xfree(p);
     }
 }
@@ -27,13 +27,23 @@
 
 #include <pulsecore/refcnt.h>
 
+/* Packets are recycled instead of being freed in two size classes:
+ * small ones, which covers most command packets, and ones that
+ * together with their header fit into 4K. Only packets that fill at
+ * least half of the larger class are put there, so that queues of
+ * packets don't take up much more memory than their data. */
+#define PA_PACKET_POOL_SIZE_SMALL (256U - 64U)
+#define PA_PACKET_POOL_SIZE (4096U - 64U)
+
 typedef struct pa_packet {
     PA_REFCNT_DECLARE;
-    enum { PA_PACKET_APPENDED, PA_PACKET_DYNAMIC } type;
+    enum { PA_PACKET_APPENDED, PA_PACKET_DYNAMIC, PA_PACKET_POOLED, PA_PACKET_POOLED_SMALL } type;
     size_t length;
     uint8_t *data;
 } pa_packet;
 
+/* The data is stored in the same allocation as the packet. The length
+ * may be lowered later on, to no less than 1. */
 pa_packet* pa_packet_new(size_t length);
 pa_packet* pa_packet_new_dynamic(void* data, size_t length);
 
@@ -184,7 +184,8 @@ static const char *command_names[PA_COMMAND_MAX] = {
 
     /* Supported since protocol v16 (0.9.16) */
     [PA_COMMAND_SET_SINK_PORT] = "SET_SINK_PORT",
-    [PA_COMMAND_SET_SOURCE_PORT] = "SET_SOURCE_PORT"
+    [PA_COMMAND_SET_SOURCE_PORT] = "SET_SOURCE_PORT",
+    [PA_COMMAND_GET_RENDER_PROFILE_INFO_LIST] = "GET_RENDER_PROFILE_INFO_LIST"
 };
 
 #endif
@@ -24,6 +24,48 @@
 
 #include <pulse/proplist.h>
 
+#include <pulsecore/atomic.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/refcnt.h>
+
+/* The insides of a pa_proplist. They are implemented in libpulse, but
+ * pa_tagstruct in libpulsecommon needs to get at the cached
+ * serialization. Both are always built from the same tree. */
+
+/* A property is never changed after it has been created, so that it
+ * may be shared between lists */
+struct pa_property {
+    PA_REFCNT_DECLARE;
+
+    const char *key;
+    void *value;
+    size_t nbytes;
+};
+
+/* A copy of the serialized tagstruct form of a list. The data
+ * follows the header. */
+typedef struct pa_proplist_serialized {
+    size_t length;
+} pa_proplist_serialized;
+
+#define PA_PROPLIST_SERIALIZED_DATA(s) ((uint8_t*) (s) + PA_ALIGN(sizeof(pa_proplist_serialized)))
+
+/* The contents of a list, shared between copies until one of them is
+ * modified */
+typedef struct pa_proplist_data {
+    PA_REFCNT_DECLARE;
+
+    pa_hashmap *properties;
+
+    /* A pa_proplist_serialized, or NULL if there is none yet. Dropped
+     * whenever the contents change. */
+    pa_atomic_ptr_t serialized;
+} pa_proplist_data;
+
+struct pa_proplist {
+    pa_proplist_data *data;
+};
+
 void pa_init_proplist(pa_proplist *p);
 
 #endif
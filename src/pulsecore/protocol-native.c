@@ -58,6 +58,8 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/ipacl.h>
 #include <pulsecore/thread-mq.h>
+#include <pulsecore/chunkring.h>
+#include <pulsecore/codec.h>
 
 #include "protocol-native.h"
 
@@ -83,6 +85,9 @@ typedef struct record_stream {
     pa_source_output *source_output;
     pa_memblockq *memblockq;
 
+    /* Compresses what we send, NULL for plain PCM */
+    pa_codec *codec;
+
     pa_bool_t adjust_latency:1;
     pa_bool_t early_requests:1;
 
@@ -117,6 +122,15 @@ typedef struct playback_stream {
     pa_sink_input *sink_input;
     pa_memblockq *memblockq;
 
+    /* Decompresses what the client sends, NULL for plain PCM */
+    pa_codec *codec;
+
+    /* Plain audio data bypasses the sink's asyncmsgq through this
+     * ring, see playback_stream_post_data() */
+    pa_chunkring *ring;
+    pa_atomic_t ring_wakeup, ring_wakeup_pending;
+    pa_atomic_t ring_barrier;
+
     pa_bool_t adjust_latency:1;
     pa_bool_t early_requests:1;
 
@@ -126,7 +140,13 @@ typedef struct playback_stream {
     uint32_t syncid;
 
     pa_atomic_t missing;
+    pa_atomic_t request_pending;
     pa_usec_t configured_sink_latency;
+
+    /* Data requests are sent at most once per batch_usec, only
+     * accessed from IO context */
+    pa_usec_t batch_usec, last_request;
+    pa_bool_t request_deferred:1;
     pa_buffer_attr buffer_attr;
 
     /* Only updated after SINK_INPUT_MESSAGE_UPDATE_LATENCY */
@@ -170,6 +190,9 @@ struct pa_native_connection {
     uint32_t rrobin_index;
     pa_subscription *subscription;
     pa_time_event *auth_timeout_event;
+
+    /* Private memfd pool we export to this client from, if negotiated */
+    pa_mempool *rw_mempool;
 };
 
 #define PA_NATIVE_CONNECTION(o) (pa_native_connection_cast(o))
@@ -199,7 +222,8 @@ enum {
     SINK_INPUT_MESSAGE_SEEK,
     SINK_INPUT_MESSAGE_PREBUF_FORCE,
     SINK_INPUT_MESSAGE_UPDATE_LATENCY,
-    SINK_INPUT_MESSAGE_UPDATE_BUFFER_ATTR
+    SINK_INPUT_MESSAGE_UPDATE_BUFFER_ATTR,
+    SINK_INPUT_MESSAGE_RING_WAKEUP /* data is waiting in the ring while we are in an underrun */
 };
 
 enum {
@@ -260,6 +284,7 @@ static void command_remove_sample(pa_pdispatch *pd, uint32_t command, uint32_t t
 static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_get_render_profile_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_volume(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_mute(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
@@ -380,6 +405,8 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_SET_SINK_PORT] = command_set_sink_or_source_port,
     [PA_COMMAND_SET_SOURCE_PORT] = command_set_sink_or_source_port,
 
+    [PA_COMMAND_GET_RENDER_PROFILE_INFO_LIST] = command_get_render_profile_info_list,
+
     [PA_COMMAND_EXTENSION] = command_extension
 };
 
@@ -473,6 +500,9 @@ static void record_stream_free(pa_object *o) {
 
     record_stream_unlink(s);
 
+    if (s->codec)
+        pa_codec_free(s->codec);
+
     pa_memblockq_free(s->memblockq);
     pa_xfree(s);
 }
@@ -661,6 +691,7 @@ static record_stream* record_stream_new(
     s->parent.process_msg = record_stream_process_msg;
     s->connection = c;
     s->source_output = source_output;
+    s->codec = NULL;
     s->buffer_attr = *attr;
     s->adjust_latency = adjust_latency;
     s->early_requests = early_requests;
@@ -744,7 +775,11 @@ static void playback_stream_free(pa_object* o) {
 
     playback_stream_unlink(s);
 
+    if (s->codec)
+        pa_codec_free(s->codec);
+
     pa_memblockq_free(s->memblockq);
+    pa_chunkring_free(s->ring);
     pa_xfree(s);
 }
 
@@ -762,6 +797,10 @@ static int playback_stream_process_msg(pa_msgobject *o, int code, void*userdata,
             pa_tagstruct *t;
             int l = 0;
 
+            /* Let the IO thread post the next request before we
+             * take what is missing, so that nothing gets lost */
+            pa_atomic_store(&s->request_pending, 0);
+
             for (;;) {
                 if ((l = pa_atomic_load(&s->missing)) <= 0)
                     return 0;
@@ -1075,13 +1114,23 @@ static playback_stream* playback_stream_new(
     s->connection = c;
     s->syncid = syncid;
     s->sink_input = sink_input;
+    s->codec = NULL;
     s->is_underrun = TRUE;
     s->drain_request = FALSE;
     pa_atomic_store(&s->missing, 0);
+    pa_atomic_store(&s->request_pending, 0);
+    s->batch_usec = c->options->batch_usec;
+    s->last_request = 0;
+    s->request_deferred = FALSE;
     s->buffer_attr = *a;
     s->adjust_latency = adjust_latency;
     s->early_requests = early_requests;
 
+    s->ring = pa_chunkring_new(0);
+    pa_atomic_store(&s->ring_wakeup, 1);
+    pa_atomic_store(&s->ring_wakeup_pending, 0);
+    pa_atomic_store(&s->ring_barrier, 0);
+
     s->sink_input->parent.process_msg = sink_input_process_msg;
     s->sink_input->pop = sink_input_pop_cb;
     s->sink_input->process_rewind = sink_input_process_rewind_cb;
@@ -1109,6 +1158,9 @@ static playback_stream* playback_stream_new(
             &silence);
     pa_memblock_unref(silence.memblock);
 
+    if (c->options->write_combine > 0)
+        pa_memblockq_set_write_combining(s->memblockq, c->protocol->core->mempool, c->options->write_combine);
+
     pa_memblockq_get_attr(s->memblockq, &s->buffer_attr);
 
     *missing = (uint32_t) pa_memblockq_pop_missing(s->memblockq);
@@ -1131,7 +1183,7 @@ static playback_stream* playback_stream_new(
 /* Called from IO context */
 static void playback_stream_request_bytes(playback_stream *s) {
     size_t m, minreq;
-    int previous_missing;
+    int missing;
 
     playback_stream_assert_ref(s);
 
@@ -1143,16 +1195,43 @@ static void playback_stream_request_bytes(playback_stream *s) {
     /*        pa_memblockq_get_minreq(s->memblockq), */
     /*        pa_memblockq_get_length(s->memblockq)); */
 
-    if (m <= 0)
+    if (m > 0)
+        missing = pa_atomic_add(&s->missing, (int) m) + (int) m;
+    else if (s->request_deferred)
+        missing = pa_atomic_load(&s->missing);
+    else
         return;
 
 /*     pa_log("request_bytes(%lu)", (unsigned long) m); */
 
-    previous_missing = pa_atomic_add(&s->missing, (int) m);
     minreq = pa_memblockq_get_minreq(s->memblockq);
 
-    if (pa_memblockq_prebuf_active(s->memblockq) ||
-        (previous_missing < (int) minreq && previous_missing + (int) m >= (int) minreq))
+    if (!pa_memblockq_prebuf_active(s->memblockq)) {
+
+        if (missing < (int) minreq)
+            return;
+
+        /* In batching mode we collect the requests of one window into
+         * a single one, as long as the client still has more than
+         * minreq left to play */
+        if (s->batch_usec > 0 &&
+            missing + (int) minreq < (int) pa_memblockq_get_tlength(s->memblockq)) {
+            pa_usec_t now = pa_rtclock_now();
+
+            if (now < s->last_request + s->batch_usec) {
+                s->request_deferred = TRUE;
+                return;
+            }
+
+            s->last_request = now;
+        }
+    }
+
+    s->request_deferred = FALSE;
+
+    /* There's no point in sending another message as long as the
+     * main thread hasn't picked up the previous one */
+    if (pa_atomic_cmpxchg(&s->request_pending, 0, 1))
         pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_REQUEST_DATA, NULL, 0, NULL, NULL);
 }
 
@@ -1245,6 +1324,9 @@ static void native_connection_free(pa_object *o) {
     pa_pstream_unref(c->pstream);
     pa_client_free(c->client);
 
+    if (c->rw_mempool)
+        pa_mempool_free(c->rw_mempool);
+
     pa_xfree(c);
 }
 
@@ -1271,7 +1353,27 @@ static void native_connection_send_memblock(pa_native_connection *c) {
             if (schunk.length > r->buffer_attr.fragsize)
                 schunk.length = r->buffer_attr.fragsize;
 
-            pa_pstream_send_memblock(c->pstream, r->index, 0, PA_SEEK_RELATIVE, &schunk);
+            if (r->codec) {
+                pa_memchunk pchunk;
+
+                /* The client decodes packet by packet, so each one
+                 * is sent as a block of its own */
+                schunk.length = pa_frame_align(schunk.length, &r->source_output->sample_spec);
+                pchunk = schunk;
+
+                while (pchunk.length > 0) {
+                    pa_memchunk packet;
+                    size_t l;
+
+                    l = pa_codec_encode(r->codec, &pchunk, &packet);
+                    pa_pstream_send_memblock(c->pstream, r->index, 0, PA_SEEK_RELATIVE, &packet);
+                    pa_memblock_unref(packet.memblock);
+
+                    pchunk.index += l;
+                    pchunk.length -= l;
+                }
+            } else
+                pa_pstream_send_memblock(c->pstream, r->index, 0, PA_SEEK_RELATIVE, &schunk);
 
             pa_memblockq_drop(r->memblockq, schunk.length);
             pa_memblock_unref(schunk.memblock);
@@ -1322,6 +1424,42 @@ static void handle_seek(playback_stream *s, int64_t indexw) {
     playback_stream_request_bytes(s);
 }
 
+/* Called from thread context */
+static void playback_stream_push(playback_stream *s, pa_memchunk *chunk) {
+    playback_stream_assert_ref(s);
+    pa_assert(chunk);
+
+/*     pa_log("sink input post: %lu %lli", (unsigned long) chunk->length, (long long) pa_memblockq_get_write_index(s->memblockq)); */
+
+    if (pa_memblockq_push_align(s->memblockq, chunk) < 0) {
+
+        if (pa_log_ratelimit())
+            pa_log_warn("Failed to push data into queue");
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_OVERFLOW, NULL, 0, NULL, NULL);
+        pa_memblockq_seek(s->memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, TRUE);
+    }
+}
+
+/* Called from thread context */
+static void playback_stream_flush_ring(playback_stream *s) {
+    pa_memchunk chunk;
+    int64_t windex;
+    pa_bool_t pushed = FALSE;
+
+    playback_stream_assert_ref(s);
+
+    windex = pa_memblockq_get_write_index(s->memblockq);
+
+    while (pa_chunkring_pop(s->ring, &chunk) >= 0) {
+        playback_stream_push(s, &chunk);
+        pa_memblock_unref(chunk.memblock);
+        pushed = TRUE;
+    }
+
+    if (pushed)
+        handle_seek(s, windex);
+}
+
 /* Called from thread context */
 static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
     pa_sink_input *i = PA_SINK_INPUT(o);
@@ -1331,6 +1469,10 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
     s = PLAYBACK_STREAM(i->userdata);
     playback_stream_assert_ref(s);
 
+    /* Whatever is in the ring was written before this message was
+     * sent, so let's make sure it ends up in the queue first */
+    playback_stream_flush_ring(s);
+
     switch (code) {
 
         case SINK_INPUT_MESSAGE_SEEK: {
@@ -1345,6 +1487,8 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             pa_memblockq_seek(s->memblockq, offset, PA_PTR_TO_UINT(userdata), PA_PTR_TO_UINT(userdata) == PA_SEEK_RELATIVE);
 
             handle_seek(s, windex);
+
+            pa_atomic_dec(&s->ring_barrier);
             return 0;
         }
 
@@ -1354,24 +1498,23 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             pa_assert(chunk);
 
             windex = pa_memblockq_get_write_index(s->memblockq);
-
-/*             pa_log("sink input post: %lu %lli", (unsigned long) chunk->length, (long long) windex); */
-
-            if (pa_memblockq_push_align(s->memblockq, chunk) < 0) {
-
-                if (pa_log_ratelimit())
-                    pa_log_warn("Failed to push data into queue");
-                pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), PLAYBACK_STREAM_MESSAGE_OVERFLOW, NULL, 0, NULL, NULL);
-                pa_memblockq_seek(s->memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, TRUE);
-            }
-
+            playback_stream_push(s, chunk);
             handle_seek(s, windex);
 
 /*             pa_log("sink input post2: %lu", (unsigned long) pa_memblockq_get_length(s->memblockq)); */
 
+            pa_atomic_dec(&s->ring_barrier);
             return 0;
         }
 
+        case SINK_INPUT_MESSAGE_RING_WAKEUP:
+            /* The ring has already been flushed above, but the main
+             * thread might have added more since, without sending
+             * another wakeup */
+            pa_atomic_store(&s->ring_wakeup_pending, 0);
+            playback_stream_flush_ring(s);
+            return 0;
+
         case SINK_INPUT_MESSAGE_DRAIN:
         case SINK_INPUT_MESSAGE_FLUSH:
         case SINK_INPUT_MESSAGE_PREBUF_FORCE:
@@ -1406,6 +1549,7 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
             /* Do the same for all other members in the sync group */
             for (isync = i->sync_prev; isync; isync = isync->sync_prev) {
                 playback_stream *ssync = PLAYBACK_STREAM(isync->userdata);
+                playback_stream_flush_ring(ssync);
                 windex = pa_memblockq_get_write_index(ssync->memblockq);
                 func(ssync->memblockq);
                 handle_seek(ssync, windex);
@@ -1413,6 +1557,7 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
 
             for (isync = i->sync_next; isync; isync = isync->sync_next) {
                 playback_stream *ssync = PLAYBACK_STREAM(isync->userdata);
+                playback_stream_flush_ring(ssync);
                 windex = pa_memblockq_get_write_index(ssync->memblockq);
                 func(ssync->memblockq);
                 handle_seek(ssync, windex);
@@ -1425,6 +1570,8 @@ static int sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int
                     s->drain_tag = PA_PTR_TO_UINT(userdata);
                     s->drain_request = TRUE;
                 }
+
+                pa_atomic_dec(&s->ring_barrier);
             }
 
             return 0;
@@ -1485,9 +1632,20 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
 
 /*     pa_log("%s, pop(): %lu", pa_proplist_gets(i->proplist, PA_PROP_MEDIA_NAME), (unsigned long) pa_memblockq_get_length(s->memblockq)); */
 
-    if (pa_memblockq_is_readable(s->memblockq))
+    playback_stream_flush_ring(s);
+
+    if (!pa_memblockq_is_readable(s->memblockq)) {
+        /* From now on the main thread needs to wake us up when it
+         * puts data into the ring. Check the ring once more
+         * afterwards, since it might have missed the flag. */
+        pa_atomic_store(&s->ring_wakeup, 1);
+        playback_stream_flush_ring(s);
+    }
+
+    if (pa_memblockq_is_readable(s->memblockq)) {
         s->is_underrun = FALSE;
-    else {
+        pa_atomic_store(&s->ring_wakeup, 0);
+    } else {
         if (!s->is_underrun)
             pa_log_debug("Underrun on '%s', %lu bytes in queue.", pa_strnull(pa_proplist_gets(i->proplist, PA_PROP_MEDIA_NAME)), (unsigned long) pa_memblockq_get_length(s->memblockq));
 
@@ -1850,6 +2008,7 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
     pa_sink_input_flags_t flags = 0;
     pa_proplist *p;
     pa_bool_t volume_set = TRUE;
+    uint32_t codec = PA_CODEC_PCM;
     int ret = PA_ERR_INVALID;
 
     pa_native_connection_assert_ref(c);
@@ -1939,6 +2098,15 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
         }
     }
 
+    if (c->version >= 19) {
+
+        if (pa_tagstruct_getu32(t, &codec) < 0) {
+            protocol_error(c);
+            pa_proplist_free(p);
+            return;
+        }
+    }
+
     if (!pa_tagstruct_eof(t)) {
         protocol_error(c);
         pa_proplist_free(p);
@@ -1983,6 +2151,13 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
 
     CHECK_VALIDITY(c->pstream, s, tag, ret);
 
+    /* Codecs we don't know or that can't handle the sample spec we
+     * ended up with are silently replaced by plain PCM */
+    if (codec != PA_CODEC_PCM && codec < PA_CODEC_MAX && pa_codec_supported(codec, &ss)) {
+        s->codec = pa_codec_new(codec, &ss, 0, c->protocol->core->mempool);
+        pa_log_debug("Client sends %s compressed audio.", pa_codec_type_to_string(codec));
+    }
+
     reply = reply_new(tag);
     pa_tagstruct_putu32(reply, s->index);
     pa_assert(s->sink_input);
@@ -2017,6 +2192,9 @@ static void command_create_playback_stream(pa_pdispatch *pd, uint32_t command, u
     if (c->version >= 13)
         pa_tagstruct_put_usec(reply, s->configured_sink_latency);
 
+    if (c->version >= 19)
+        pa_tagstruct_putu32(reply, s->codec ? pa_codec_get_type(s->codec) : PA_CODEC_PCM);
+
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
@@ -2106,6 +2284,7 @@ static void command_create_record_stream(pa_pdispatch *pd, uint32_t command, uin
     pa_proplist *p;
     uint32_t direct_on_input_idx = PA_INVALID_INDEX;
     pa_sink_input *direct_on_input = NULL;
+    uint32_t codec = PA_CODEC_PCM;
     int ret = PA_ERR_INVALID;
 
     pa_native_connection_assert_ref(c);
@@ -2186,6 +2365,15 @@ static void command_create_record_stream(pa_pdispatch *pd, uint32_t command, uin
         }
     }
 
+    if (c->version >= 19) {
+
+        if (pa_tagstruct_getu32(t, &codec) < 0) {
+            protocol_error(c);
+            pa_proplist_free(p);
+            return;
+        }
+    }
+
     if (!pa_tagstruct_eof(t)) {
         protocol_error(c);
         pa_proplist_free(p);
@@ -2235,6 +2423,11 @@ static void command_create_record_stream(pa_pdispatch *pd, uint32_t command, uin
 
     CHECK_VALIDITY(c->pstream, s, tag, ret);
 
+    if (codec != PA_CODEC_PCM && codec < PA_CODEC_MAX && pa_codec_supported(codec, &ss)) {
+        s->codec = pa_codec_new(codec, &ss, pa_codec_packet_size(&ss, s->buffer_attr.fragsize), c->protocol->core->mempool);
+        pa_log_debug("Sending %s compressed audio to client.", pa_codec_type_to_string(codec));
+    }
+
     reply = reply_new(tag);
     pa_tagstruct_putu32(reply, s->index);
     pa_assert(s->source_output);
@@ -2264,6 +2457,9 @@ static void command_create_record_stream(pa_pdispatch *pd, uint32_t command, uin
     if (c->version >= 13)
         pa_tagstruct_put_usec(reply, s->configured_source_latency);
 
+    if (c->version >= 19)
+        pa_tagstruct_putu32(reply, s->codec ? pa_codec_get_type(s->codec) : PA_CODEC_PCM);
+
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
@@ -2293,6 +2489,7 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     const void*cookie;
     pa_tagstruct *reply;
     pa_bool_t shm_on_remote = FALSE, do_shm;
+    pa_bool_t memfd_on_remote = FALSE, do_memfd;
 
     pa_native_connection_assert_ref(c);
     pa_assert(t);
@@ -2318,6 +2515,13 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
         c->version &= 0x7FFFFFFFU;
     }
 
+    /* Starting with protocol version 17 the second MSB reflects if
+     * the remote can pass its memory as memfd. */
+    if (c->version >= 17) {
+        memfd_on_remote = !!(c->version & 0x40000000U);
+        c->version &= 0x3FFFFFFFU;
+    }
+
     pa_log_debug("Protocol version: remote %u, local %u", c->version, PA_PROTOCOL_VERSION);
 
     pa_proplist_setf(c->client->proplist, "native-protocol.version", "%u", c->version);
@@ -2402,8 +2606,20 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     pa_log_debug("Negotiated SHM: %s", pa_yes_no(do_shm));
     pa_pstream_enable_shm(c->pstream, do_shm);
 
+    /* With memfd each client gets a pool of its own that we export
+     * to it from, and which nobody else can map. */
+    do_memfd = FALSE;
+
+#ifdef HAVE_CREDS
+    if (do_shm && memfd_on_remote && c->version >= 17 && !c->rw_mempool)
+        if ((c->rw_mempool = pa_mempool_new_memfd(0)))
+            do_memfd = TRUE;
+#endif
+
+    pa_log_debug("Negotiated memfd: %s", pa_yes_no(do_memfd));
+
     reply = reply_new(tag);
-    pa_tagstruct_putu32(reply, PA_PROTOCOL_VERSION | (do_shm ? 0x80000000 : 0));
+    pa_tagstruct_putu32(reply, PA_PROTOCOL_VERSION | (do_shm ? 0x80000000 : 0) | (do_memfd ? 0x40000000 : 0));
 
 #ifdef HAVE_CREDS
 {
@@ -2419,6 +2635,11 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
 #else
     pa_pstream_send_tagstruct(c->pstream, reply);
 #endif
+
+    /* Only after the reply, so that the client knows about memfd
+     * before our segment arrives */
+    if (do_memfd)
+        pa_pstream_enable_memfd(c->pstream, c->rw_mempool);
 }
 
 static void command_set_client_name(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -2516,6 +2737,7 @@ static void command_drain_playback_stream(pa_pdispatch *pd, uint32_t command, ui
     CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_NOENTITY);
     CHECK_VALIDITY(c->pstream, playback_stream_isinstance(s), tag, PA_ERR_NOENTITY);
 
+    pa_atomic_inc(&s->ring_barrier);
     pa_asyncmsgq_post(s->sink_input->sink->asyncmsgq, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_DRAIN, PA_UINT_TO_PTR(tag), 0, NULL, NULL);
 }
 
@@ -3249,6 +3471,68 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
+static void histogram_fill_tagstruct(pa_tagstruct *t, const char *name, pa_histogram *h) {
+    unsigned b;
+
+    pa_tagstruct_puts(t, name);
+    pa_tagstruct_putu32(t, PA_HISTOGRAM_BUCKETS);
+
+    for (b = 0; b < PA_HISTOGRAM_BUCKETS; b++)
+        pa_tagstruct_putu32(t, pa_histogram_get(h, b));
+}
+
+static void command_get_render_profile_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    pa_tagstruct *reply;
+    pa_sink *sink;
+    pa_sink_input *si;
+    uint32_t idx;
+    unsigned p;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (!pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+
+    /* The probes stay off until somebody is interested in them, so
+     * the first reply only contains empty histograms */
+    pa_atomic_store(&c->protocol->core->render_profiling, 1);
+
+    reply = reply_new(tag);
+
+    /* The histograms are updated lock-free by the IO threads, so
+     * we can simply read them from here */
+
+    PA_IDXSET_FOREACH(sink, c->protocol->core->sinks, idx) {
+        pa_tagstruct_putu32(reply, PA_SUBSCRIPTION_EVENT_SINK);
+        pa_tagstruct_putu32(reply, sink->index);
+        pa_tagstruct_putu32(reply, PA_INVALID_INDEX);
+        pa_tagstruct_puts(reply, sink->name);
+        pa_tagstruct_putu32(reply, PA_SINK_PROBE_MAX);
+
+        for (p = 0; p < PA_SINK_PROBE_MAX; p++)
+            histogram_fill_tagstruct(reply, pa_sink_probe_to_string(p), &sink->profile[p]);
+    }
+
+    PA_IDXSET_FOREACH(si, c->protocol->core->sink_inputs, idx) {
+        pa_tagstruct_putu32(reply, PA_SUBSCRIPTION_EVENT_SINK_INPUT);
+        pa_tagstruct_putu32(reply, si->index);
+        pa_tagstruct_putu32(reply, si->sink ? si->sink->index : PA_INVALID_INDEX);
+        pa_tagstruct_puts(reply, pa_strnull(pa_proplist_gets(si->proplist, PA_PROP_MEDIA_NAME)));
+        pa_tagstruct_putu32(reply, PA_SINK_INPUT_PROBE_MAX);
+
+        for (p = 0; p < PA_SINK_INPUT_PROBE_MAX; p++)
+            histogram_fill_tagstruct(reply, pa_sink_input_probe_to_string(p), &si->profile[p]);
+    }
+
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
 static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     pa_tagstruct *reply;
@@ -4394,6 +4678,44 @@ static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, const pa_c
     }
 }
 
+/* Called from main context */
+static void playback_stream_post_data(playback_stream *s, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk) {
+    pa_asyncmsgq *q;
+
+    playback_stream_assert_ref(s);
+    pa_assert(chunk);
+
+    q = s->sink_input->sink->asyncmsgq;
+
+    /* Plain data is put into the ring, which the IO thread empties
+     * whenever it renders or handles a message for us. That only
+     * works as long as no message it needs to be ordered against is
+     * still in flight. Unless the IO thread is sitting in an underrun
+     * and waiting for us there is no need to wake it up. */
+    if (chunk->memblock && seek == PA_SEEK_RELATIVE && offset == 0 &&
+        pa_atomic_load(&s->ring_barrier) <= 0 &&
+        pa_chunkring_push(s->ring, chunk) >= 0) {
+
+        if (pa_atomic_load(&s->ring_wakeup) && pa_atomic_cmpxchg(&s->ring_wakeup_pending, 0, 1))
+            pa_asyncmsgq_post(q, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_RING_WAKEUP, NULL, 0, NULL, NULL);
+
+        return;
+    }
+
+    if (chunk->memblock) {
+        if (seek != PA_SEEK_RELATIVE || offset != 0) {
+            pa_atomic_inc(&s->ring_barrier);
+            pa_asyncmsgq_post(q, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_SEEK, PA_UINT_TO_PTR(seek), offset, NULL, NULL);
+        }
+
+        pa_atomic_inc(&s->ring_barrier);
+        pa_asyncmsgq_post(q, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_POST_DATA, NULL, 0, chunk, NULL);
+    } else {
+        pa_atomic_inc(&s->ring_barrier);
+        pa_asyncmsgq_post(q, PA_MSGOBJECT(s->sink_input), SINK_INPUT_MESSAGE_SEEK, PA_UINT_TO_PTR(seek), offset+chunk->length, NULL, NULL);
+    }
+}
+
 static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     output_stream *stream;
@@ -4412,14 +4734,35 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
 
     if (playback_stream_isinstance(stream)) {
         playback_stream *ps = PLAYBACK_STREAM(stream);
+        pa_memchunk pcm;
 
-        if (chunk->memblock) {
-            if (seek != PA_SEEK_RELATIVE || offset != 0)
-                pa_asyncmsgq_post(ps->sink_input->sink->asyncmsgq, PA_MSGOBJECT(ps->sink_input), SINK_INPUT_MESSAGE_SEEK, PA_UINT_TO_PTR(seek), offset, NULL, NULL);
+        if (!ps->codec) {
+            playback_stream_post_data(ps, offset, seek, chunk);
+            return;
+        }
+
+        /* The seek comes with the first piece of a packet, apply it
+         * before anything of that packet is decoded */
+        if (offset != 0 || seek != PA_SEEK_RELATIVE) {
+            pa_memchunk_reset(&pcm);
+            playback_stream_post_data(ps, offset, seek, &pcm);
+        }
+
+        if (!chunk->memblock) {
+            pa_log_debug("Client sent block with compressed data we could not access, dropping.");
+            pa_codec_reset(ps->codec);
+            return;
+        }
+
+        if (pa_codec_decode(ps->codec, chunk, &pcm) < 0) {
+            protocol_error(c);
+            return;
+        }
 
-            pa_asyncmsgq_post(ps->sink_input->sink->asyncmsgq, PA_MSGOBJECT(ps->sink_input), SINK_INPUT_MESSAGE_POST_DATA, NULL, 0, chunk, NULL);
-        } else
-            pa_asyncmsgq_post(ps->sink_input->sink->asyncmsgq, PA_MSGOBJECT(ps->sink_input), SINK_INPUT_MESSAGE_SEEK, PA_UINT_TO_PTR(seek), offset+chunk->length, NULL, NULL);
+        if (pcm.memblock) {
+            playback_stream_post_data(ps, 0, PA_SEEK_RELATIVE, &pcm);
+            pa_memblock_unref(pcm.memblock);
+        }
 
     } else {
         upload_stream *u = UPLOAD_STREAM(stream);
@@ -4621,6 +4964,7 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
 
     c->rrobin_index = PA_IDXSET_INVALID;
     c->subscription = NULL;
+    c->rw_mempool = NULL;
 
     pa_idxset_put(p->connections, c, NULL);
 
@@ -4804,6 +5148,7 @@ void pa_native_options_unref(pa_native_options *o) {
 int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
     pa_bool_t enabled;
     const char *acl;
+    uint32_t batch_usec, write_combine;
 
     pa_assert(o);
     pa_assert(PA_REFCNT_VALUE(o) >= 1);
@@ -4814,6 +5159,22 @@ int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
         return -1;
     }
 
+    batch_usec = (uint32_t) o->batch_usec;
+    if (pa_modargs_get_value_u32(ma, "batch-usec", &batch_usec) < 0) {
+        pa_log("batch-usec= expects a numerical argument.");
+        return -1;
+    }
+
+    o->batch_usec = (pa_usec_t) batch_usec;
+
+    write_combine = (uint32_t) o->write_combine;
+    if (pa_modargs_get_value_u32(ma, "write-combine", &write_combine) < 0) {
+        pa_log("write-combine= expects a numerical argument.");
+        return -1;
+    }
+
+    o->write_combine = (size_t) write_combine;
+
     enabled = TRUE;
     if (pa_modargs_get_value_boolean(ma, "auth-group-enabled", &enabled) < 0) {
         pa_log("auth-group-enabled= expects a boolean argument.");
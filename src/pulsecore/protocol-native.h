@@ -47,6 +47,14 @@ typedef struct pa_native_options {
     char *auth_group;
     pa_ip_acl *auth_ip_acl;
     pa_auth_cookie *auth_cookie;
+
+    /* Time window in which data requests for a playback stream are
+     * coalesced, 0 to send them right away */
+    pa_usec_t batch_usec;
+
+    /* Playback data written in pieces smaller than this is copied into
+     * larger blocks, 0 to queue it as it comes */
+    size_t write_combine;
 } pa_native_options;
 
 typedef enum pa_native_hook {
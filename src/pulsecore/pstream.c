@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #ifdef HAVE_SYS_SOCKET_H
@@ -49,15 +50,17 @@
 #include <pulsecore/refcnt.h>
 #include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/core-util.h>
 
 #include "pstream.h"
 
 /* We piggyback information if audio data blocks are stored in SHM on the seek mode */
-#define PA_FLAG_SHMDATA    0x80000000LU
-#define PA_FLAG_SHMRELEASE 0x40000000LU
-#define PA_FLAG_SHMREVOKE  0xC0000000LU
-#define PA_FLAG_SHMMASK    0xFF000000LU
-#define PA_FLAG_SEEKMASK   0x000000FFLU
+#define PA_FLAG_SHMDATA     0x80000000LU
+#define PA_FLAG_SHMRELEASE  0x40000000LU
+#define PA_FLAG_SHMREVOKE   0xC0000000LU
+#define PA_FLAG_SHMREGISTER 0x20000000LU
+#define PA_FLAG_SHMMASK     0xFF000000LU
+#define PA_FLAG_SEEKMASK    0x000000FFLU
 
 /* The sequence descriptor header consists of 5 32bit integers: */
 enum {
@@ -83,6 +86,14 @@ typedef uint32_t pa_pstream_descriptor[PA_PSTREAM_DESCRIPTOR_MAX];
 #define PA_PSTREAM_DESCRIPTOR_SIZE (PA_PSTREAM_DESCRIPTOR_MAX*sizeof(uint32_t))
 #define FRAME_SIZE_MAX_ALLOW PA_SCACHE_ENTRY_SIZE_MAX /* allow uploading a single sample in one frame at max */
 
+/* How many queued items we gather into a single writev() */
+#define WRITE_BATCH_MAX 8
+
+/* How much we read beyond the end of the current descriptor or
+ * payload, so that the next frame's descriptor (and with luck the
+ * entire next frame) comes with the same readv() */
+#define READ_AHEAD_MAX 4096
+
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
 struct item_info {
@@ -90,7 +101,8 @@ struct item_info {
         PA_PSTREAM_ITEM_PACKET,
         PA_PSTREAM_ITEM_MEMBLOCK,
         PA_PSTREAM_ITEM_SHMRELEASE,
-        PA_PSTREAM_ITEM_SHMREVOKE
+        PA_PSTREAM_ITEM_SHMREVOKE,
+        PA_PSTREAM_ITEM_SHMREGISTER
     } type;
 
     /* packet info */
@@ -108,6 +120,23 @@ struct item_info {
 
     /* release/revoke info */
     uint32_t block_id;
+
+    /* register info */
+    uint32_t shm_id;
+    int memfd_fd;
+};
+
+struct write_info {
+    pa_pstream_descriptor descriptor;
+    struct item_info* current;
+    uint32_t shm_info[PA_PSTREAM_SHM_MAX];
+    void *data;
+    size_t index;
+    pa_memchunk memchunk;
+#ifdef HAVE_CREDS
+    pa_bool_t send_creds;
+    int send_fd;
+#endif
 };
 
 struct pa_pstream {
@@ -121,14 +150,10 @@ struct pa_pstream {
 
     pa_bool_t dead;
 
-    struct {
-        pa_pstream_descriptor descriptor;
-        struct item_info* current;
-        uint32_t shm_info[PA_PSTREAM_SHM_MAX];
-        void *data;
-        size_t index;
-        pa_memchunk memchunk;
-    } write;
+    /* Items taken from the send queue that are currently being
+     * written, a ring starting at write_idx */
+    struct write_info write[WRITE_BATCH_MAX];
+    unsigned write_idx, n_write;
 
     struct {
         pa_pstream_descriptor descriptor;
@@ -139,7 +164,16 @@ struct pa_pstream {
         size_t index;
     } read;
 
+    struct {
+        uint8_t data[READ_AHEAD_MAX];
+        size_t index, length;
+#ifdef HAVE_CREDS
+        pa_bool_t creds_valid;
+#endif
+    } read_ahead;
+
     pa_bool_t use_shm;
+    pa_bool_t use_memfd;
     pa_memimport *import;
     pa_memexport *export;
 
@@ -164,8 +198,13 @@ struct pa_pstream {
     pa_mempool *mempool;
 
 #ifdef HAVE_CREDS
-    pa_creds read_creds, write_creds;
-    pa_bool_t read_creds_valid, send_creds_now;
+    pa_creds read_creds;
+    pa_bool_t read_creds_valid;
+
+    /* memfds that came in with the data but whose registration frame
+     * we haven't processed yet */
+    int read_fds[PA_IOCHANNEL_FDS_MAX];
+    unsigned n_read_fds;
 #endif
 };
 
@@ -180,9 +219,15 @@ static void do_something(pa_pstream *p) {
 
     p->mainloop->defer_enable(p->defer_event, 0);
 
-    if (!p->dead && pa_iochannel_is_readable(p->io)) {
-        if (do_read(p) < 0)
-            goto fail;
+    if (!p->dead && (p->read_ahead.length > 0 || pa_iochannel_is_readable(p->io))) {
+
+        /* Don't leave anything in the read-ahead buffer, the
+         * iochannel won't tell us about it again */
+        do {
+            if (do_read(p) < 0)
+                goto fail;
+        } while (!p->dead && p->read_ahead.length > 0);
+
     } else if (!p->dead && pa_iochannel_is_hungup(p->io))
         goto fail;
 
@@ -228,6 +273,7 @@ static void memimport_release_cb(pa_memimport *i, uint32_t block_id, void *userd
 
 pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *pool) {
     pa_pstream *p;
+    unsigned i;
 
     pa_assert(m);
     pa_assert(io);
@@ -245,12 +291,16 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
 
     p->send_queue = pa_queue_new();
 
-    p->write.current = NULL;
-    p->write.index = 0;
-    pa_memchunk_reset(&p->write.memchunk);
+    for (i = 0; i < WRITE_BATCH_MAX; i++) {
+        p->write[i].current = NULL;
+        p->write[i].index = 0;
+        pa_memchunk_reset(&p->write[i].memchunk);
+    }
+    p->write_idx = p->n_write = 0;
     p->read.memblock = NULL;
     p->read.packet = NULL;
     p->read.index = 0;
+    p->read_ahead.index = p->read_ahead.length = 0;
 
     p->recieve_packet_callback = NULL;
     p->recieve_packet_callback_userdata = NULL;
@@ -268,6 +318,7 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
     p->mempool = pool;
 
     p->use_shm = FALSE;
+    p->use_memfd = FALSE;
     p->export = NULL;
 
     /* We do importing unconditionally */
@@ -277,8 +328,9 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
     pa_iochannel_socket_set_sndbuf(io, pa_mempool_block_size_max(p->mempool));
 
 #ifdef HAVE_CREDS
-    p->send_creds_now = FALSE;
     p->read_creds_valid = FALSE;
+    p->read_ahead.creds_valid = FALSE;
+    p->n_read_fds = 0;
 #endif
     return p;
 }
@@ -300,17 +352,21 @@ static void item_free(void *item, void *q) {
 }
 
 static void pstream_free(pa_pstream *p) {
+    unsigned i;
+
     pa_assert(p);
 
     pa_pstream_unlink(p);
 
     pa_queue_free(p->send_queue, item_free, NULL);
 
-    if (p->write.current)
-        item_free(p->write.current, NULL);
+    for (i = 0; i < WRITE_BATCH_MAX; i++) {
+        if (p->write[i].current)
+            item_free(p->write[i].current, NULL);
 
-    if (p->write.memchunk.memblock)
-        pa_memblock_unref(p->write.memchunk.memblock);
+        if (p->write[i].memchunk.memblock)
+            pa_memblock_unref(p->write[i].memchunk.memblock);
+    }
 
     if (p->read.memblock)
         pa_memblock_unref(p->read.memblock);
@@ -465,62 +521,71 @@ static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userda
         pa_pstream_send_revoke(p, block_id);
 }
 
-static void prepare_next_write_item(pa_pstream *p) {
+static struct write_info* get_write_info(pa_pstream *p, unsigned i) {
+    return p->write + ((p->write_idx + i) % WRITE_BATCH_MAX);
+}
+
+static pa_bool_t prepare_next_write_item(pa_pstream *p, struct write_info *w) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(w);
+    pa_assert(!w->current);
 
-    p->write.current = pa_queue_pop(p->send_queue);
+    w->current = pa_queue_pop(p->send_queue);
 
-    if (!p->write.current)
-        return;
+    if (!w->current)
+        return FALSE;
 
-    p->write.index = 0;
-    p->write.data = NULL;
-    pa_memchunk_reset(&p->write.memchunk);
+    w->index = 0;
+    w->data = NULL;
+    pa_memchunk_reset(&w->memchunk);
 
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
 
-    if (p->write.current->type == PA_PSTREAM_ITEM_PACKET) {
+    if (w->current->type == PA_PSTREAM_ITEM_PACKET) {
 
-        pa_assert(p->write.current->packet);
-        p->write.data = p->write.current->packet->data;
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->packet->length);
+        pa_assert(w->current->packet);
+        w->data = w->current->packet->data;
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) w->current->packet->length);
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
+
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMREGISTER) {
+
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREGISTER);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->shm_id);
 
     } else {
         uint32_t flags;
         pa_bool_t send_payload = TRUE;
 
-        pa_assert(p->write.current->type == PA_PSTREAM_ITEM_MEMBLOCK);
-        pa_assert(p->write.current->chunk.memblock);
+        pa_assert(w->current->type == PA_PSTREAM_ITEM_MEMBLOCK);
+        pa_assert(w->current->chunk.memblock);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(p->write.current->channel);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) p->write.current->offset) >> 32));
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) p->write.current->offset));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(w->current->channel);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) w->current->offset) >> 32));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) w->current->offset));
 
-        flags = (uint32_t) (p->write.current->seek_mode & PA_FLAG_SEEKMASK);
+        flags = (uint32_t) (w->current->seek_mode & PA_FLAG_SEEKMASK);
 
-        if (p->use_shm) {
+        if (p->use_shm && p->export) {
             uint32_t block_id, shm_id;
             size_t offset, length;
 
-            pa_assert(p->export);
-
             if (pa_memexport_put(p->export,
-                                 p->write.current->chunk.memblock,
+                                 w->current->chunk.memblock,
                                  &block_id,
                                  &shm_id,
                                  &offset,
@@ -529,106 +594,176 @@ static void prepare_next_write_item(pa_pstream *p) {
                 flags |= PA_FLAG_SHMDATA;
                 send_payload = FALSE;
 
-                p->write.shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
-                p->write.shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
-                p->write.shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + p->write.current->chunk.index));
-                p->write.shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
+                w->shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
+                w->shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
+                w->shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + w->current->chunk.index));
+                w->shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) w->current->chunk.length);
 
-                p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(sizeof(p->write.shm_info));
-                p->write.data = p->write.shm_info;
+                w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(sizeof(w->shm_info));
+                w->data = w->shm_info;
             }
 /*             else */
 /*                 pa_log_warn("Failed to export memory block."); */
         }
 
         if (send_payload) {
-            p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
-            p->write.memchunk = p->write.current->chunk;
-            pa_memblock_ref(p->write.memchunk.memblock);
-            p->write.data = NULL;
+            w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) w->current->chunk.length);
+            w->memchunk = w->current->chunk;
+            pa_memblock_ref(w->memchunk.memblock);
+            w->data = NULL;
         }
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
     }
 
 #ifdef HAVE_CREDS
-    if ((p->send_creds_now = p->write.current->with_creds))
-        p->write_creds = p->write.current->creds;
+    w->send_creds = w->current->with_creds;
+    w->send_fd = w->current->type == PA_PSTREAM_ITEM_SHMREGISTER ? w->current->memfd_fd : -1;
 #endif
+
+    return TRUE;
+}
+
+static void finish_write_item(pa_pstream *p) {
+    struct write_info *w;
+
+    pa_assert(p);
+    pa_assert(p->n_write > 0);
+
+    w = get_write_info(p, 0);
+
+    pa_assert(w->current);
+    item_free(w->current, NULL);
+    w->current = NULL;
+
+    if (w->memchunk.memblock)
+        pa_memblock_unref(w->memchunk.memblock);
+
+    pa_memchunk_reset(&w->memchunk);
+
+    p->write_idx = (p->write_idx + 1) % WRITE_BATCH_MAX;
+    p->n_write--;
 }
 
 static int do_write(pa_pstream *p) {
-    void *d;
-    size_t l;
+    struct iovec iov[2*WRITE_BATCH_MAX];
+    pa_memblock *release_memblock[WRITE_BATCH_MAX];
+    unsigned n_iov = 0, n_release = 0, i;
+    pa_bool_t finished = FALSE;
     ssize_t r;
-    pa_memblock *release_memblock = NULL;
+#ifdef HAVE_CREDS
+    const pa_creds *creds = NULL;
+    int fd = -1;
+#endif
 
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    if (!p->write.current)
-        prepare_next_write_item(p);
+    while (p->n_write < WRITE_BATCH_MAX &&
+           prepare_next_write_item(p, get_write_info(p, p->n_write)))
+        p->n_write++;
 
-    if (!p->write.current)
+    if (p->n_write <= 0)
         return 0;
 
-    if (p->write.index < PA_PSTREAM_DESCRIPTOR_SIZE) {
-        d = (uint8_t*) p->write.descriptor + p->write.index;
-        l = PA_PSTREAM_DESCRIPTOR_SIZE - p->write.index;
-    } else {
-        pa_assert(p->write.data || p->write.memchunk.memblock);
+    /* Gather what is left of the descriptors and payloads of all
+     * prepared items into one vector */
+    for (i = 0; i < p->n_write; i++) {
+        struct write_info *w = get_write_info(p, i);
+        size_t length = ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
 
-        if (p->write.data)
-            d = p->write.data;
-        else {
-            d = (uint8_t*) pa_memblock_acquire(p->write.memchunk.memblock) + p->write.memchunk.index;
-            release_memblock = p->write.memchunk.memblock;
+#ifdef HAVE_CREDS
+        /* Credentials and file descriptors are passed along with a
+         * write of their own */
+        if (w->send_creds || w->send_fd >= 0) {
+            if (i > 0)
+                break;
+
+            if (w->send_creds)
+                creds = &w->current->creds;
+            else
+                fd = w->send_fd;
         }
+#endif
+
+        if (w->index < PA_PSTREAM_DESCRIPTOR_SIZE) {
+            iov[n_iov].iov_base = (uint8_t*) w->descriptor + w->index;
+            iov[n_iov].iov_len = PA_PSTREAM_DESCRIPTOR_SIZE - w->index;
+            n_iov++;
+        }
+
+        if (length > 0 && w->index < PA_PSTREAM_DESCRIPTOR_SIZE + length) {
+            size_t skip = w->index > PA_PSTREAM_DESCRIPTOR_SIZE ? w->index - PA_PSTREAM_DESCRIPTOR_SIZE : 0;
+            void *d;
 
-        d = (uint8_t*) d + p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE;
-        l = ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE);
+            pa_assert(w->data || w->memchunk.memblock);
+
+            if (w->data)
+                d = w->data;
+            else {
+                d = (uint8_t*) pa_memblock_acquire(w->memchunk.memblock) + w->memchunk.index;
+                release_memblock[n_release++] = w->memchunk.memblock;
+            }
+
+            iov[n_iov].iov_base = (uint8_t*) d + skip;
+            iov[n_iov].iov_len = length - skip;
+            n_iov++;
+        }
+
+#ifdef HAVE_CREDS
+        if (creds || fd >= 0)
+            break;
+#endif
     }
 
-    pa_assert(l > 0);
+    pa_assert(n_iov > 0);
 
 #ifdef HAVE_CREDS
-    if (p->send_creds_now) {
+    if (creds) {
+
+        if ((r = pa_iochannel_write_with_creds(p->io, iov[0].iov_base, iov[0].iov_len, creds)) < 0)
+            goto fail;
+
+        get_write_info(p, 0)->send_creds = FALSE;
+    } else if (fd >= 0) {
 
-        if ((r = pa_iochannel_write_with_creds(p->io, d, l, &p->write_creds)) < 0)
+        if ((r = pa_iochannel_write_with_fd(p->io, iov[0].iov_base, iov[0].iov_len, fd)) < 0)
             goto fail;
 
-        p->send_creds_now = FALSE;
+        get_write_info(p, 0)->send_fd = -1;
     } else
 #endif
 
-    if ((r = pa_iochannel_write(p->io, d, l)) < 0)
+    if ((r = pa_iochannel_writev(p->io, iov, n_iov)) < 0)
         goto fail;
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
-
-    p->write.index += (size_t) r;
-
-    if (p->write.index >= PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) {
-        pa_assert(p->write.current);
-        item_free(p->write.current, NULL);
-        p->write.current = NULL;
+    for (i = 0; i < n_release; i++)
+        pa_memblock_release(release_memblock[i]);
 
-        if (p->write.memchunk.memblock)
-            pa_memblock_unref(p->write.memchunk.memblock);
+    /* Now find out how far we got */
+    while (r > 0) {
+        struct write_info *w = get_write_info(p, 0);
+        size_t left = PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - w->index;
 
-        pa_memchunk_reset(&p->write.memchunk);
+        if ((size_t) r < left) {
+            w->index += (size_t) r;
+            break;
+        }
 
-        if (p->drain_callback && !pa_pstream_is_pending(p))
-            p->drain_callback(p, p->drain_callback_userdata);
+        r -= (ssize_t) left;
+        finish_write_item(p);
+        finished = TRUE;
     }
 
+    if (finished && p->drain_callback && !pa_pstream_is_pending(p))
+        p->drain_callback(p, p->drain_callback_userdata);
+
     return 0;
 
 fail:
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+    for (i = 0; i < n_release; i++)
+        pa_memblock_release(release_memblock[i]);
 
     return -1;
 }
@@ -658,20 +793,56 @@ static int do_read(pa_pstream *p) {
         l = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (p->read.index - PA_PSTREAM_DESCRIPTOR_SIZE);
     }
 
+    if (p->read_ahead.length > 0) {
+
+        /* Serve what we already read ahead before going to the socket again */
+        r = (ssize_t) PA_MIN(l, p->read_ahead.length);
+        memcpy(d, p->read_ahead.data + p->read_ahead.index, (size_t) r);
+
+        p->read_ahead.index += (size_t) r;
+        p->read_ahead.length -= (size_t) r;
+
 #ifdef HAVE_CREDS
-    {
-        pa_bool_t b = 0;
+        /* The credentials came with a single frame, don't hand them
+         * out again for the frames that follow it in the buffer */
+        if (p->read_ahead.creds_valid) {
+            p->read_creds_valid = TRUE;
+            p->read_ahead.creds_valid = FALSE;
+        }
+#endif
+    } else {
+        struct iovec iov[2];
 
-        if ((r = pa_iochannel_read_with_creds(p->io, d, l, &p->read_creds, &b)) <= 0)
-            goto fail;
+        iov[0].iov_base = d;
+        iov[0].iov_len = l;
+        iov[1].iov_base = p->read_ahead.data;
+        iov[1].iov_len = sizeof(p->read_ahead.data);
 
-        p->read_creds_valid = p->read_creds_valid || b;
-    }
+#ifdef HAVE_CREDS
+        {
+            pa_bool_t b = 0;
+            unsigned n_fds = PA_IOCHANNEL_FDS_MAX - p->n_read_fds;
+
+            if ((r = pa_iochannel_readv_with_ancil(p->io, iov, 2, &p->read_creds, &b, p->read_fds + p->n_read_fds, &n_fds)) <= 0)
+                goto fail;
+
+            p->n_read_fds += n_fds;
+
+            p->read_creds_valid = p->read_creds_valid || b;
+            p->read_ahead.creds_valid = b;
+        }
 #else
-    if ((r = pa_iochannel_read(p->io, d, l)) <= 0)
-        goto fail;
+        if ((r = pa_iochannel_readv(p->io, iov, 2)) <= 0)
+            goto fail;
 #endif
 
+        if ((size_t) r > l) {
+            p->read_ahead.index = 0;
+            p->read_ahead.length = (size_t) r - l;
+            r = (ssize_t) l;
+        }
+    }
+
     if (release_memblock)
         pa_memblock_release(release_memblock);
 
@@ -694,7 +865,11 @@ static int do_read(pa_pstream *p) {
 
 /*             pa_log("Got release frame for %u", ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])); */
 
-            pa_assert(p->export);
+            if (!p->export) {
+                pa_log_warn("Received release frame for a block we never exported.");
+                return -1;
+            }
+
             pa_memexport_process_release(p->export, ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
 
             goto frame_done;
@@ -709,6 +884,36 @@ static int do_read(pa_pstream *p) {
             pa_memimport_process_revoke(p->import, ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
 
             goto frame_done;
+
+        } else if (flags == PA_FLAG_SHMREGISTER) {
+#ifdef HAVE_CREDS
+            int fd;
+
+            /* This is a memfd registration frame with no payload, the
+             * fd itself came in as ancillary data */
+
+            if (!p->use_memfd) {
+                pa_log_warn("Received memfd registration on a socket where memfd is disabled.");
+                return -1;
+            }
+
+            if (p->n_read_fds <= 0) {
+                pa_log_warn("Received memfd registration frame without file descriptor.");
+                return -1;
+            }
+
+            fd = p->read_fds[0];
+            memmove(p->read_fds, p->read_fds + 1, sizeof(int) * --p->n_read_fds);
+
+            pa_assert(p->import);
+            if (pa_memimport_attach_memfd(p->import, ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]), fd) < 0)
+                pa_log_warn("Failed to attach memfd segment.");
+
+            goto frame_done;
+#else
+            pa_log_warn("Received memfd registration on a system without fd passing.");
+            return -1;
+#endif
         }
 
         length = ntohl(p->read.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
@@ -943,7 +1148,7 @@ pa_bool_t pa_pstream_is_pending(pa_pstream *p) {
     if (p->dead)
         b = FALSE;
     else
-        b = p->write.current || !pa_queue_isempty(p->send_queue);
+        b = p->n_write > 0 || !pa_queue_isempty(p->send_queue);
 
     return b;
 }
@@ -987,6 +1192,11 @@ void pa_pstream_unlink(pa_pstream *p) {
         p->io = NULL;
     }
 
+#ifdef HAVE_CREDS
+    while (p->n_read_fds > 0)
+        pa_close(p->read_fds[--p->n_read_fds]);
+#endif
+
     if (p->defer_event) {
         p->mainloop->defer_free(p->defer_event);
         p->defer_event = NULL;
@@ -1006,7 +1216,10 @@ void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable) {
 
     if (enable) {
 
-        if (!p->export)
+        /* A memfd segment is of no use to the peer before
+         * pa_pstream_enable_memfd() passed it along, until then we
+         * send our own data inline */
+        if (!p->export && !pa_mempool_is_memfd_backed(p->mempool))
             p->export = pa_memexport_new(p->mempool, memexport_revoke_cb, p);
 
     } else {
@@ -1018,6 +1231,44 @@ void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable) {
     }
 }
 
+void pa_pstream_enable_memfd(pa_pstream *p, pa_mempool *export_pool) {
+#ifdef HAVE_CREDS
+    struct item_info *item;
+#endif
+
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(p->use_shm);
+    pa_assert(export_pool);
+
+#ifdef HAVE_CREDS
+    p->use_memfd = TRUE;
+
+    /* Export from the pool given to us, blocks of other pools are
+     * copied into it when sent */
+    if (p->export)
+        pa_memexport_free(p->export);
+    p->export = pa_memexport_new(export_pool, memexport_revoke_cb, p);
+
+    if (!pa_mempool_is_memfd_backed(export_pool) || p->dead)
+        return;
+
+    /* The peer cannot open our segment by name, so pass it along
+     * before anything that might refer to it */
+    if (!(item = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
+        item = pa_xnew(struct item_info, 1);
+    item->type = PA_PSTREAM_ITEM_SHMREGISTER;
+    item->memfd_fd = pa_mempool_get_memfd_fd(export_pool);
+    pa_assert_se(pa_mempool_get_shm_id(export_pool, &item->shm_id) >= 0);
+    item->with_creds = FALSE;
+
+    pa_queue_push(p->send_queue, item);
+    p->mainloop->defer_enable(p->defer_event, 1);
+#else
+    pa_assert_not_reached();
+#endif
+}
+
 pa_bool_t pa_pstream_get_shm(pa_pstream *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
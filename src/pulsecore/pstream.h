@@ -64,6 +64,10 @@ void pa_pstream_set_revoke_callback(pa_pstream *p, pa_pstream_block_id_cb_t cb,
 pa_bool_t pa_pstream_is_pending(pa_pstream *p);
 
 void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable);
+
+/* Needs SHM to be enabled already. Exports from export_pool from now
+ * on and, if it is memfd backed, passes its fd to the peer */
+void pa_pstream_enable_memfd(pa_pstream *p, pa_mempool *export_pool);
 pa_bool_t pa_pstream_get_shm(pa_pstream *p);
 
 #endif
@@ -0,0 +1,182 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/semaphore.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+#include "render-pool.h"
+
+struct worker {
+    pa_render_pool *pool;
+    pa_thread *thread;
+    pa_semaphore *semaphore;
+};
+
+struct pa_render_pool {
+    struct worker *workers;
+    unsigned n_workers;
+    int rtprio;
+
+    pa_semaphore *done;
+    pa_bool_t quit;
+
+    /* The current batch. Written by the caller before the workers are
+     * woken up, the semaphores take care of the memory barriers. */
+    pa_render_pool_cb_t cb;
+    void *userdata;
+    unsigned n;
+    pa_atomic_t next;
+    pa_thread_mq *thread_mq;
+};
+
+static void work(pa_render_pool *p) {
+    int idx;
+
+    /* Whoever is faster takes the next job, so a slow stream only
+     * delays the one thread that works on it */
+    while ((idx = pa_atomic_inc(&p->next)) < (int) p->n)
+        p->cb(p->userdata, (unsigned) idx);
+}
+
+static void thread_func(void *userdata) {
+    struct worker *w = userdata;
+    pa_render_pool *p = w->pool;
+
+    pa_log_debug("Render worker starting up");
+
+    if (p->rtprio > 0)
+        pa_make_realtime(p->rtprio);
+
+    for (;;) {
+        pa_semaphore_wait(w->semaphore);
+
+        if (p->quit)
+            break;
+
+        if (p->thread_mq) {
+            if (!pa_thread_mq_get())
+                pa_thread_mq_install(p->thread_mq);
+
+            pa_assert(pa_thread_mq_get() == p->thread_mq);
+        }
+
+        work(p);
+
+        pa_semaphore_post(p->done);
+    }
+
+    pa_log_debug("Render worker shutting down");
+}
+
+pa_render_pool* pa_render_pool_new(unsigned n_threads, int rtprio) {
+    pa_render_pool *p;
+    unsigned i;
+
+    pa_assert(n_threads > 0);
+
+    p = pa_xnew0(pa_render_pool, 1);
+    p->rtprio = rtprio;
+    p->done = pa_semaphore_new(0);
+    pa_atomic_store(&p->next, 0);
+
+    p->workers = pa_xnew0(struct worker, n_threads);
+
+    for (i = 0; i < n_threads; i++) {
+        struct worker *w = p->workers + i;
+
+        w->pool = p;
+        w->semaphore = pa_semaphore_new(0);
+
+        if (!(w->thread = pa_thread_new(thread_func, w))) {
+            pa_log("Failed to create render worker thread.");
+            pa_semaphore_free(w->semaphore);
+            pa_render_pool_free(p);
+            return NULL;
+        }
+
+        p->n_workers++;
+    }
+
+    return p;
+}
+
+void pa_render_pool_free(pa_render_pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+
+    p->quit = TRUE;
+
+    for (i = 0; i < p->n_workers; i++)
+        pa_semaphore_post(p->workers[i].semaphore);
+
+    for (i = 0; i < p->n_workers; i++) {
+        pa_thread_free(p->workers[i].thread);
+        pa_semaphore_free(p->workers[i].semaphore);
+    }
+
+    pa_xfree(p->workers);
+    pa_semaphore_free(p->done);
+    pa_xfree(p);
+}
+
+unsigned pa_render_pool_get_n_threads(pa_render_pool *p) {
+    pa_assert(p);
+
+    return p->n_workers;
+}
+
+void pa_render_pool_run(pa_render_pool *p, unsigned n, pa_render_pool_cb_t cb, void *userdata) {
+    unsigned i, n_wake;
+
+    pa_assert(p);
+    pa_assert(cb);
+
+    if (n <= 0)
+        return;
+
+    p->cb = cb;
+    p->userdata = userdata;
+    p->n = n;
+    p->thread_mq = pa_thread_mq_get();
+    pa_atomic_store(&p->next, 0);
+
+    /* We take our share ourselves, so don't wake up more workers than
+     * there are jobs left for them */
+    n_wake = PA_MIN(p->n_workers, n - 1);
+
+    for (i = 0; i < n_wake; i++)
+        pa_semaphore_post(p->workers[i].semaphore);
+
+    work(p);
+
+    for (i = 0; i < n_wake; i++)
+        pa_semaphore_wait(p->done);
+}
@@ -0,0 +1,48 @@
+#ifndef foopulserenderpoolhfoo
+#define foopulserenderpoolhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+/* A small pool of worker threads that an IO thread can hand a batch
+ * of independent jobs to, used by sinks to peek their inputs in
+ * parallel. The calling thread works on the batch, too, and
+ * pa_render_pool_run() only returns when all jobs have finished, so
+ * everything the jobs wrote is visible to the caller afterwards.
+ *
+ * The workers run with the thread_mq of the calling thread installed,
+ * so that the IO context assertions in the jobs hold. Only one thread
+ * may run batches on a pool. */
+
+typedef struct pa_render_pool pa_render_pool;
+
+typedef void (*pa_render_pool_cb_t)(void *userdata, unsigned idx);
+
+/* Starts n_threads workers, at the given realtime priority if rtprio
+ * is > 0 */
+pa_render_pool* pa_render_pool_new(unsigned n_threads, int rtprio);
+void pa_render_pool_free(pa_render_pool *p);
+
+unsigned pa_render_pool_get_n_threads(pa_render_pool *p);
+
+/* Calls cb(userdata, idx) once for every idx in [0, n), in no
+ * particular order and on any thread of the pool */
+void pa_render_pool_run(pa_render_pool *p, unsigned n, pa_render_pool_cb_t cb, void *userdata);
+
+#endif
@@ -0,0 +1,430 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/refcnt.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/memblockq.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/source.h>
+#include <pulsecore/source-output.h>
+
+#include "resampler-group.h"
+
+#define MEMBLOCKQ_MAXLENGTH (32*1024*1024)
+#define MAX_MIX_CHANNELS 32
+
+struct pa_resampler_group {
+    PA_REFCNT_DECLARE;
+
+    pa_sink *sink;
+
+    pa_sample_spec sample_spec;
+    pa_channel_map channel_map;
+    pa_resample_method_t method;
+    pa_resample_flags_t flags;
+
+    pa_resampler *resampler;
+
+    /* Taken from the silence cache of the core right away, since
+     * mix() might run on a render worker */
+    pa_memchunk silence;
+
+    PA_LLIST_FIELDS(pa_resampler_group);
+
+    struct {
+        pa_hashmap *inputs;
+
+        /* We maintain a history of mixed and resampled data here */
+        pa_memblockq *render_memblockq;
+
+        /* Set when members came or went, so that the next rewind
+         * mixes everything again */
+        pa_bool_t rewrite:1;
+    } thread_info;
+};
+
+/* Called from main context */
+pa_resampler_group* pa_resampler_group_get(
+        pa_sink *s,
+        const pa_sample_spec *ss,
+        const pa_channel_map *map,
+        pa_resample_method_t method,
+        pa_resample_flags_t flags) {
+
+    pa_resampler_group *g;
+    pa_resampler *r;
+    char st[PA_SAMPLE_SPEC_SNPRINT_MAX];
+
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(ss);
+    pa_assert(map);
+
+    PA_LLIST_FOREACH(g, s->resampler_groups)
+        if (pa_sample_spec_equal(&g->sample_spec, ss) &&
+            pa_channel_map_equal(&g->channel_map, map) &&
+            g->method == method &&
+            g->flags == flags) {
+
+            PA_REFCNT_INC(g);
+            return g;
+        }
+
+    if (!(r = pa_resampler_new(s->core->mempool, ss, map, &s->sample_spec, &s->channel_map, method, flags)))
+        return NULL;
+
+    g = pa_xnew0(pa_resampler_group, 1);
+    PA_REFCNT_INIT(g);
+    g->sink = s;
+    g->sample_spec = *ss;
+    g->channel_map = *map;
+    g->method = method;
+    g->flags = flags;
+    g->resampler = r;
+
+    pa_silence_memchunk_get(&s->core->silence_cache, s->core->mempool, &g->silence, ss, 0);
+
+    g->thread_info.inputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    g->thread_info.render_memblockq = pa_memblockq_new(
+            0,
+            MEMBLOCKQ_MAXLENGTH,
+            0,
+            pa_frame_size(&s->sample_spec),
+            0,
+            1,
+            0,
+            &s->silence);
+
+    PA_LLIST_PREPEND(pa_resampler_group, s->resampler_groups, g);
+
+    pa_log_debug("Created shared resampler for %s on sink %s.", pa_sample_spec_snprint(st, sizeof(st), ss), s->name);
+
+    return g;
+}
+
+/* Called from main context */
+void pa_resampler_group_unref(pa_resampler_group *g) {
+    pa_assert(g);
+    pa_assert(PA_REFCNT_VALUE(g) >= 1);
+    pa_assert_ctl_context();
+
+    if (PA_REFCNT_DEC(g) > 0)
+        return;
+
+    /* All members have been detached before they let go */
+    pa_assert(pa_hashmap_isempty(g->thread_info.inputs));
+
+    PA_LLIST_REMOVE(pa_resampler_group, g->sink->resampler_groups, g);
+
+    pa_hashmap_free(g->thread_info.inputs, NULL, NULL);
+    pa_memblockq_free(g->thread_info.render_memblockq);
+    pa_resampler_free(g->resampler);
+    pa_memblock_unref(g->silence.memblock);
+    pa_xfree(g);
+}
+
+/* Called from main and IO context */
+pa_resampler* pa_resampler_group_get_resampler(pa_resampler_group *g) {
+    pa_assert(g);
+
+    return g->resampler;
+}
+
+/* Called from IO context */
+void pa_resampler_group_attach_input(pa_resampler_group *g, pa_sink_input *i) {
+    pa_assert(g);
+    pa_sink_input_assert_ref(i);
+    pa_sink_assert_io_context(g->sink);
+    pa_assert(i->thread_info.group == g);
+
+    if (pa_hashmap_isempty(g->thread_info.inputs)) {
+        pa_hashmap_put(g->sink->thread_info.resampler_groups, g, g);
+        pa_resampler_group_update_max_rewind(g, g->sink->thread_info.max_rewind);
+    }
+
+    pa_hashmap_put(g->thread_info.inputs, PA_UINT32_TO_PTR(i->index), i);
+
+    g->thread_info.rewrite = TRUE;
+}
+
+/* Called from IO context */
+void pa_resampler_group_detach_input(pa_resampler_group *g, pa_sink_input *i) {
+    pa_assert(g);
+    pa_sink_input_assert_ref(i);
+    pa_sink_assert_io_context(g->sink);
+
+    pa_assert_se(pa_hashmap_remove(g->thread_info.inputs, PA_UINT32_TO_PTR(i->index)) == i);
+
+    if (!pa_hashmap_isempty(g->thread_info.inputs)) {
+        g->thread_info.rewrite = TRUE;
+        return;
+    }
+
+    /* Nobody left to play what we mixed already */
+    pa_hashmap_remove(g->sink->thread_info.resampler_groups, g);
+    pa_memblockq_flush_read(g->thread_info.render_memblockq);
+    pa_resampler_reset(g->resampler);
+    g->thread_info.rewrite = FALSE;
+}
+
+/* Called from IO context */
+static void post_direct(pa_resampler_group *g, pa_sink_input *i, const pa_memchunk *chunk) {
+    pa_memchunk r;
+    pa_source_output *o;
+    void *state = NULL;
+
+    /* Directly connected outputs, i.e. peak meters, want to see the
+     * stream on its own, so only these streams need to be resampled
+     * separately. */
+
+    if (!i->thread_info.direct_resampler)
+        if (!(i->thread_info.direct_resampler = pa_resampler_new(
+                      i->core->mempool,
+                      &g->sample_spec, &g->channel_map,
+                      &g->sink->sample_spec, &g->sink->channel_map,
+                      g->method, g->flags)))
+            return;
+
+    pa_resampler_run(i->thread_info.direct_resampler, chunk ? chunk : &g->silence, &r);
+
+    if (!r.memblock)
+        return;
+
+    while ((o = pa_hashmap_iterate(i->thread_info.direct_outputs, &state, NULL))) {
+        pa_source_output_assert_ref(o);
+        pa_assert(o->direct_on_input == i);
+        pa_source_post_direct(g->sink->monitor_source, o, &r);
+    }
+
+    pa_memblock_unref(r.memblock);
+}
+
+/* Called from IO context */
+static void mix(pa_resampler_group *g, size_t length, pa_memchunk *result) {
+    pa_mix_info info[MAX_MIX_CHANNELS];
+    pa_sink_input *i;
+    void *state = NULL;
+    unsigned n = 0, k;
+    pa_bool_t monitor;
+
+    /* Like the sink, we don't peek those that don't fit in anymore,
+     * they are dropped along with the others below */
+    while ((i = pa_hashmap_iterate(g->thread_info.inputs, &state, NULL)) && n < MAX_MIX_CHANNELS) {
+        pa_memchunk chunk;
+        pa_cvolume volume;
+
+        pa_sink_input_peek(i, length, &chunk, &volume);
+        pa_assert(pa_cvolume_is_norm(&volume));
+
+        if (chunk.length < length)
+            length = chunk.length;
+
+        if (pa_memblock_is_silence(chunk.memblock)) {
+            pa_memblock_unref(chunk.memblock);
+            continue;
+        }
+
+        info[n].chunk = chunk;
+        info[n].userdata = i;
+        pa_cvolume_reset(&info[n].volume, g->sample_spec.channels);
+        n++;
+    }
+
+    if (n == 0) {
+        *result = g->silence;
+        pa_memblock_ref(result->memblock);
+
+        if (result->length > length)
+            result->length = length;
+
+    } else if (n == 1) {
+        *result = info[0].chunk;
+        pa_memblock_ref(result->memblock);
+
+        if (result->length > length)
+            result->length = length;
+
+    } else {
+        void *ptr;
+
+        result->memblock = pa_memblock_new(g->sink->core->mempool, length);
+
+        ptr = pa_memblock_acquire(result->memblock);
+        result->length = pa_mix(info, n, ptr, length, &g->sample_spec, NULL, FALSE);
+        pa_memblock_release(result->memblock);
+
+        result->index = 0;
+    }
+
+    monitor = g->sink->monitor_source && PA_SOURCE_IS_LINKED(g->sink->monitor_source->thread_info.state);
+
+    PA_HASHMAP_FOREACH(i, g->thread_info.inputs, state) {
+        pa_memchunk *c = NULL;
+
+        if (monitor && pa_hashmap_size(i->thread_info.direct_outputs) > 0) {
+
+            for (k = 0; k < n; k++)
+                if (info[k].userdata == i) {
+                    c = &info[k].chunk;
+                    c->length = result->length;
+                    break;
+                }
+
+            post_direct(g, i, c);
+        }
+
+        pa_sink_input_drop(i, result->length);
+    }
+
+    for (k = 0; k < n; k++)
+        pa_memblock_unref(info[k].chunk.memblock);
+}
+
+/* Called from IO context */
+void pa_resampler_group_peek(pa_resampler_group *g, size_t slength, pa_memchunk *chunk) {
+    size_t block_size_max;
+
+    pa_assert(g);
+    pa_sink_assert_io_context(g->sink);
+    pa_assert(slength > 0);
+    pa_assert(chunk);
+
+    block_size_max = pa_resampler_max_block_size(g->resampler);
+
+    while (!pa_memblockq_is_readable(g->thread_info.render_memblockq)) {
+        pa_memchunk mchunk, rchunk;
+        size_t ilength;
+
+        ilength = pa_resampler_request(g->resampler, slength);
+
+        if (ilength > block_size_max)
+            ilength = block_size_max;
+
+        if (ilength <= 0)
+            ilength = pa_frame_size(&g->sample_spec);
+
+        mix(g, ilength, &mchunk);
+
+        pa_resampler_run(g->resampler, &mchunk, &rchunk);
+        pa_memblock_unref(mchunk.memblock);
+
+        if (rchunk.memblock) {
+            pa_memblockq_push_align(g->thread_info.render_memblockq, &rchunk);
+            pa_memblock_unref(rchunk.memblock);
+        }
+    }
+
+    pa_assert_se(pa_memblockq_peek(g->thread_info.render_memblockq, chunk) >= 0);
+
+    pa_assert(chunk->length > 0);
+    pa_assert(chunk->memblock);
+}
+
+/* Called from IO context */
+void pa_resampler_group_drop(pa_resampler_group *g, size_t nbytes) {
+    pa_assert(g);
+    pa_sink_assert_io_context(g->sink);
+    pa_assert(pa_frame_aligned(nbytes, &g->sink->sample_spec));
+
+    pa_memblockq_drop(g->thread_info.render_memblockq, nbytes);
+}
+
+/* Called from IO context */
+void pa_resampler_group_process_rewind(pa_resampler_group *g, size_t nbytes) {
+    pa_sink_input *i;
+    void *state;
+    size_t lbq, ilength;
+    pa_bool_t rewrite;
+
+    pa_assert(g);
+    pa_sink_assert_io_context(g->sink);
+
+    lbq = pa_memblockq_get_length(g->thread_info.render_memblockq);
+
+    if (nbytes > 0)
+        pa_memblockq_rewind(g->thread_info.render_memblockq, nbytes);
+
+    rewrite = g->thread_info.rewrite;
+
+    PA_HASHMAP_FOREACH(i, g->thread_info.inputs, state)
+        if (i->thread_info.rewrite_nbytes != 0)
+            rewrite = TRUE;
+
+    if (!rewrite) {
+        /* What we mixed is still valid, we just play it again */
+        PA_HASHMAP_FOREACH(i, g->thread_info.inputs, state)
+            pa_sink_input_process_rewind(i, 0);
+
+        return;
+    }
+
+    /* Somebody wants to change what we already mixed, so everything
+     * from where the sink will continue has to be mixed again. All
+     * members go back by the same amount to stay in sync. */
+    ilength = pa_resampler_request(g->resampler, nbytes + lbq) + pa_resampler_get_delay(g->resampler);
+
+    pa_log_debug("Have to mix %lu bytes again for shared resampler.", (unsigned long) ilength);
+
+    PA_HASHMAP_FOREACH(i, g->thread_info.inputs, state)
+        pa_sink_input_process_rewind(i, ilength);
+
+    pa_memblockq_seek(g->thread_info.render_memblockq, - ((int64_t) (nbytes + lbq)), PA_SEEK_RELATIVE, TRUE);
+    pa_resampler_reset(g->resampler);
+
+    g->thread_info.rewrite = FALSE;
+}
+
+/* Called from IO context */
+void pa_resampler_group_update_max_rewind(pa_resampler_group *g, size_t nbytes) {
+    pa_assert(g);
+    pa_sink_assert_io_context(g->sink);
+
+    pa_memblockq_set_maxrewind(g->thread_info.render_memblockq, nbytes);
+}
+
+/* Called from IO context */
+size_t pa_resampler_group_get_length(pa_resampler_group *g) {
+    pa_assert(g);
+
+    return pa_memblockq_get_length(g->thread_info.render_memblockq);
+}
+
+/* Called from IO context */
+pa_bool_t pa_resampler_group_has_direct_outputs(pa_resampler_group *g) {
+    pa_sink_input *i;
+    void *state;
+
+    pa_assert(g);
+
+    PA_HASHMAP_FOREACH(i, g->thread_info.inputs, state)
+        if (pa_hashmap_size(i->thread_info.direct_outputs) > 0)
+            return TRUE;
+
+    return FALSE;
+}
@@ -0,0 +1,81 @@
+#ifndef foopulseresamplergrouphfoo
+#define foopulseresamplergrouphfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+#include <pulse/channelmap.h>
+
+#include <pulsecore/resampler.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+
+/* If shared resamplers are enabled, the sink inputs of a sink that
+ * have the same sample spec and channel map and don't change their
+ * rate form a group. The members apply their volume in their own
+ * sample spec and leave their data there, the group mixes it and
+ * converts the mix to the sample spec of the sink with a single
+ * resampler. Resampling then costs in proportion to the number of
+ * different formats played, not to the number of streams.
+ *
+ * From the sink's point of view a group is just one more stream that
+ * is mixed in, with the render queue of the group holding the history
+ * for rewinds. The render queues of the members stay in their own
+ * sample spec.
+ *
+ * Groups are looked up and released from main context while the sink
+ * input is not attached to the IO thread. Everything else is called
+ * from the IO thread of the sink. */
+
+/* Returns a reference to the group on the sink that converts from
+ * the given format, creating it if necessary. Returns NULL if the
+ * conversion isn't supported. */
+pa_resampler_group* pa_resampler_group_get(
+        pa_sink *s,
+        const pa_sample_spec *ss,
+        const pa_channel_map *map,
+        pa_resample_method_t method,
+        pa_resample_flags_t flags);
+
+void pa_resampler_group_unref(pa_resampler_group *g);
+
+/* Used for conversions between the domain of the members and the
+ * sink, never run it directly */
+pa_resampler* pa_resampler_group_get_resampler(pa_resampler_group *g);
+
+void pa_resampler_group_attach_input(pa_resampler_group *g, pa_sink_input *i);
+void pa_resampler_group_detach_input(pa_resampler_group *g, pa_sink_input *i);
+
+/* Same semantics as pa_sink_input_peek() and friends, in the sample
+ * spec of the sink. The volume has already been applied. */
+void pa_resampler_group_peek(pa_resampler_group *g, size_t slength, pa_memchunk *chunk);
+void pa_resampler_group_drop(pa_resampler_group *g, size_t nbytes);
+void pa_resampler_group_process_rewind(pa_resampler_group *g, size_t nbytes);
+void pa_resampler_group_update_max_rewind(pa_resampler_group *g, size_t nbytes);
+
+/* What has been mixed and resampled but not played yet, in the
+ * sample spec of the sink */
+size_t pa_resampler_group_get_length(pa_resampler_group *g);
+
+/* Whether any member has directly connected outputs. These are fed
+ * from pa_resampler_group_peek(), too. */
+pa_bool_t pa_resampler_group_has_direct_outputs(pa_resampler_group *g);
+
+#endif
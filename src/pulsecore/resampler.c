@@ -24,6 +24,7 @@
 #endif
 
 #include <string.h>
+#include <math.h>
 
 #ifdef HAVE_LIBSAMPLERATE
 #include <samplerate.h>
@@ -36,6 +37,7 @@
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/strbuf.h>
+#include <pulsecore/core-util.h>
 
 #include "ffmpeg/avcodec.h"
 
@@ -45,12 +47,22 @@
 /* Number of samples of extra space we allow the resamplers to return */
 #define EXTRA_FRAMES 128
 
+/* Older speex versions overflow when the denominator of the
+ * resampling ratio squared doesn't fit in 32 bit */
+#define SPEEX_MAX_DEN 65535U
+
+/* Rate ratios closer to each other than this are considered equal,
+ * that is far below what any of the backends can resolve */
+#define RATIO_EPSILON 1e-12
+
 struct pa_resampler {
     pa_resample_method_t method;
     pa_resample_flags_t flags;
 
     pa_sample_spec i_ss, o_ss;
     pa_channel_map i_cm, o_cm;
+    double ratio;
+    pa_bool_t unity_ratio;
     size_t i_fz, o_fz, w_sz;
     pa_mempool *mempool;
 
@@ -67,12 +79,14 @@ struct pa_resampler {
 
     void (*impl_free)(pa_resampler *r);
     void (*impl_update_rates)(pa_resampler *r);
+    void (*impl_update_ratio)(pa_resampler *r);
     void (*impl_resample)(pa_resampler *r, const pa_memchunk *in, unsigned in_samples, pa_memchunk *out, unsigned *out_samples);
     void (*impl_reset)(pa_resampler *r);
+    unsigned (*impl_get_delay)(pa_resampler *r);
 
     struct { /* data specific to the trivial resampler */
-        unsigned o_counter;
-        unsigned i_counter;
+        uint64_t phase; /* of the next output frame, in input frames, Q32 */
+        uint64_t step;
     } trivial;
 
     struct { /* data specific to the peak finder pseudo resampler */
@@ -92,12 +106,31 @@ struct pa_resampler {
 
     struct { /* data specific to speex */
         SpeexResamplerState* state;
+        uint32_t num, den;
+        double error;
     } speex;
 
     struct { /* data specific to ffmpeg */
         struct AVResampleContext *state;
         pa_memchunk buf[PA_CHANNELS_MAX];
     } ffmpeg;
+
+    struct { /* data specific to the polyphase resampler */
+        float *exact_table, *interp_table;
+        void *exact_mem, *interp_mem;
+        unsigned taps;
+        double cutoff, beta;
+        unsigned in_num, out_den;   /* the reduced nominal ratio */
+
+        pa_bool_t exact;
+        unsigned phase;             /* position between two inputs, in 1/out_den when exact */
+        uint32_t frac;              /* ... and in Q32 when interpolating */
+        uint64_t step;              /* input samples per output sample, Q32 */
+
+        float *buf[PA_CHANNELS_MAX]; /* planar history and new input */
+        unsigned buf_len, buf_size;
+        unsigned pos;               /* of the first tap of the next output in buf */
+    } polyphase;
 };
 
 static int copy_init(pa_resampler *r);
@@ -105,6 +138,7 @@ static int trivial_init(pa_resampler*r);
 static int speex_init(pa_resampler*r);
 static int ffmpeg_init(pa_resampler*r);
 static int peaks_init(pa_resampler*r);
+static int polyphase_init(pa_resampler*r);
 #ifdef HAVE_LIBSAMPLERATE
 static int libsamplerate_init(pa_resampler*r);
 #endif
@@ -152,6 +186,9 @@ static int (* const init_table[])(pa_resampler*r) = {
     [PA_RESAMPLER_AUTO]                    = NULL,
     [PA_RESAMPLER_COPY]                    = copy_init,
     [PA_RESAMPLER_PEAKS]                   = peaks_init,
+    [PA_RESAMPLER_POLYPHASE_BASE+0]        = polyphase_init,
+    [PA_RESAMPLER_POLYPHASE_BASE+1]        = polyphase_init,
+    [PA_RESAMPLER_POLYPHASE_BASE+2]        = polyphase_init,
 };
 
 pa_resampler* pa_resampler_new(
@@ -205,12 +242,16 @@ pa_resampler* pa_resampler_new(
 
     r->impl_free = NULL;
     r->impl_update_rates = NULL;
+    r->impl_update_ratio = NULL;
     r->impl_resample = NULL;
     r->impl_reset = NULL;
+    r->impl_get_delay = NULL;
 
     /* Fill sample specs */
     r->i_ss = *a;
     r->o_ss = *b;
+    r->ratio = 1.0;
+    r->unity_ratio = TRUE;
 
     /* set up the remap structure */
     r->remap.i_ss = &r->i_ss;
@@ -346,20 +387,53 @@ void pa_resampler_set_output_rate(pa_resampler *r, uint32_t rate) {
     r->impl_update_rates(r);
 }
 
+void pa_resampler_set_rate_ratio(pa_resampler *r, double ratio) {
+    pa_assert(r);
+    pa_assert(ratio > 0.5 && ratio < 2.0);
+
+    if (fabs(r->ratio - ratio) < RATIO_EPSILON || !r->impl_update_ratio)
+        return;
+
+    r->unity_ratio = fabs(ratio - 1.0) < RATIO_EPSILON;
+    r->ratio = r->unity_ratio ? 1.0 : ratio;
+
+    r->impl_update_ratio(r);
+}
+
+double pa_resampler_get_rate_ratio(pa_resampler *r) {
+    pa_assert(r);
+
+    return r->ratio;
+}
+
 size_t pa_resampler_request(pa_resampler *r, size_t out_length) {
+    size_t frames;
+
     pa_assert(r);
 
+    frames = (out_length + r->o_fz-1) / r->o_fz;
+
     /* Let's round up here */
 
-    return (((((out_length + r->o_fz-1) / r->o_fz) * r->i_ss.rate) + r->o_ss.rate-1) / r->o_ss.rate) * r->i_fz;
+    if (!r->unity_ratio)
+        return (size_t) ceil((double) frames * r->i_ss.rate * r->ratio / r->o_ss.rate) * r->i_fz;
+
+    return (((frames * r->i_ss.rate) + r->o_ss.rate-1) / r->o_ss.rate) * r->i_fz;
 }
 
 size_t pa_resampler_result(pa_resampler *r, size_t in_length) {
+    size_t frames;
+
     pa_assert(r);
 
+    frames = (in_length + r->i_fz-1) / r->i_fz;
+
     /* Let's round up here */
 
-    return (((((in_length + r->i_fz-1) / r->i_fz) * r->o_ss.rate) + r->i_ss.rate-1) / r->i_ss.rate) * r->o_fz;
+    if (!r->unity_ratio)
+        return (size_t) ceil((double) frames * r->o_ss.rate / (r->i_ss.rate * r->ratio)) * r->o_fz;
+
+    return (((frames * r->o_ss.rate) + r->i_ss.rate-1) / r->i_ss.rate) * r->o_fz;
 }
 
 size_t pa_resampler_max_block_size(pa_resampler *r) {
@@ -383,6 +457,10 @@ size_t pa_resampler_max_block_size(pa_resampler *r) {
 
     fs = pa_frame_size(&ss);
 
+    /* A slowed down input results in more output */
+    if (r->ratio < 1.0)
+        return (size_t) ((double) (((block_size_max/fs - EXTRA_FRAMES)*r->i_ss.rate)/ss.rate) * r->ratio) * r->i_fz;
+
     return (((block_size_max/fs - EXTRA_FRAMES)*r->i_ss.rate)/ss.rate)*r->i_fz;
 }
 
@@ -393,6 +471,15 @@ void pa_resampler_reset(pa_resampler *r) {
         r->impl_reset(r);
 }
 
+size_t pa_resampler_get_delay(pa_resampler *r) {
+    pa_assert(r);
+
+    if (r->impl_get_delay)
+        return r->impl_get_delay(r) * r->i_fz;
+
+    return 0;
+}
+
 pa_resample_method_t pa_resampler_get_method(pa_resampler *r) {
     pa_assert(r);
 
@@ -455,7 +542,10 @@ static const char * const resample_methods[] = {
     "ffmpeg",
     "auto",
     "copy",
-    "peaks"
+    "peaks",
+    "polyphase-0",
+    "polyphase-1",
+    "polyphase-2"
 };
 
 const char *pa_resample_method_to_string(pa_resample_method_t m) {
@@ -494,6 +584,9 @@ pa_resample_method_t pa_parse_resample_method(const char *string) {
     if (!strcmp(string, "speex-float"))
         return PA_RESAMPLER_SPEEX_FLOAT_BASE + 3;
 
+    if (!strcmp(string, "polyphase"))
+        return PA_RESAMPLER_POLYPHASE_BASE + 1;
+
     return PA_RESAMPLER_INVALID;
 }
 
@@ -1120,7 +1213,10 @@ static pa_memchunk *resample(pa_resampler *r, pa_memchunk *input) {
     in_n_samples = (unsigned) (input->length / r->w_sz);
     in_n_frames = (unsigned) (in_n_samples / r->o_ss.channels);
 
-    out_n_frames = ((in_n_frames*r->o_ss.rate)/r->i_ss.rate)+EXTRA_FRAMES;
+    if (!r->unity_ratio)
+        out_n_frames = (unsigned) ((double) in_n_frames * r->o_ss.rate / (r->i_ss.rate * r->ratio)) + EXTRA_FRAMES;
+    else
+        out_n_frames = ((in_n_frames*r->o_ss.rate)/r->i_ss.rate)+EXTRA_FRAMES;
     out_n_samples = out_n_frames * r->o_ss.channels;
 
     r->buf3.index = 0;
@@ -1223,7 +1319,9 @@ static void libsamplerate_resample(pa_resampler *r, const pa_memchunk *input, un
     data.data_out = (float*) ((uint8_t*) pa_memblock_acquire(output->memblock) + output->index);
     data.output_frames = (long int) *out_n_frames;
 
-    data.src_ratio = (double) r->o_ss.rate / r->i_ss.rate;
+    /* If the ratio changed since the last call libsamplerate glides
+     * to the new one over the length of this block */
+    data.src_ratio = (double) r->o_ss.rate / (r->i_ss.rate * r->ratio);
     data.end_of_input = 0;
 
     pa_assert_se(src_process(r->src.state, &data) == 0);
@@ -1238,7 +1336,13 @@ static void libsamplerate_resample(pa_resampler *r, const pa_memchunk *input, un
 static void libsamplerate_update_rates(pa_resampler *r) {
     pa_assert(r);
 
-    pa_assert_se(src_set_ratio(r->src.state, (double) r->o_ss.rate / r->i_ss.rate) == 0);
+    pa_assert_se(src_set_ratio(r->src.state, (double) r->o_ss.rate / (r->i_ss.rate * r->ratio)) == 0);
+}
+
+static void libsamplerate_update_ratio(pa_resampler *r) {
+    pa_assert(r);
+
+    /* Nothing to do, libsamplerate_resample() picks the new ratio up */
 }
 
 static void libsamplerate_reset(pa_resampler *r) {
@@ -1264,6 +1368,7 @@ static int libsamplerate_init(pa_resampler *r) {
 
     r->impl_free = libsamplerate_free;
     r->impl_update_rates = libsamplerate_update_rates;
+    r->impl_update_ratio = libsamplerate_update_ratio;
     r->impl_resample = libsamplerate_resample;
     r->impl_reset = libsamplerate_reset;
 
@@ -1316,9 +1421,35 @@ static void speex_resample_int(pa_resampler *r, const pa_memchunk *input, unsign
 }
 
 static void speex_update_rates(pa_resampler *r) {
+    uint32_t g, num, den, k;
+    double n;
+
     pa_assert(r);
 
-    pa_assert_se(speex_resampler_set_rate(r->speex.state, r->i_ss.rate, r->o_ss.rate) == 0);
+    g = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+    num = r->i_ss.rate / g;
+    den = r->o_ss.rate / g;
+
+    /* Scale the fraction up as far as speex allows to get a fine
+     * grained ratio. What doesn't fit the grid is carried over to the
+     * next update, so that the ratio is right on average. */
+    k = den < SPEEX_MAX_DEN ? SPEEX_MAX_DEN / den : 1;
+
+    n = (double) num * k * r->ratio + r->speex.error;
+    num = (uint32_t) PA_MAX(lrint(n), 1);
+    den *= k;
+
+    r->speex.error = n - num;
+
+    /* Speex recalculates its filter on every call, even if nothing
+     * changed, so avoid that */
+    if (num == r->speex.num && den == r->speex.den)
+        return;
+
+    pa_assert_se(speex_resampler_set_rate_frac(r->speex.state, num, den, r->i_ss.rate, r->o_ss.rate) == 0);
+
+    r->speex.num = num;
+    r->speex.den = den;
 }
 
 static void speex_reset(pa_resampler *r) {
@@ -1343,6 +1474,7 @@ static int speex_init(pa_resampler *r) {
 
     r->impl_free = speex_free;
     r->impl_update_rates = speex_update_rates;
+    r->impl_update_ratio = speex_update_rates;
     r->impl_reset = speex_reset;
 
     if (r->method >= PA_RESAMPLER_SPEEX_FIXED_BASE && r->method <= PA_RESAMPLER_SPEEX_FIXED_MAX) {
@@ -1362,6 +1494,9 @@ static int speex_init(pa_resampler *r) {
     if (!(r->speex.state = speex_resampler_init(r->o_ss.channels, r->i_ss.rate, r->o_ss.rate, q, &err)))
         return -1;
 
+    r->speex.num = r->speex.den = 0;
+    r->speex.error = 0;
+
     return 0;
 }
 
@@ -1382,11 +1517,10 @@ static void trivial_resample(pa_resampler *r, const pa_memchunk *input, unsigned
     src = (uint8_t*) pa_memblock_acquire(input->memblock) + input->index;
     dst = (uint8_t*) pa_memblock_acquire(output->memblock) + output->index;
 
-    for (o_index = 0;; o_index++, r->trivial.o_counter++) {
+    for (o_index = 0;; o_index++, r->trivial.phase += r->trivial.step) {
         unsigned j;
 
-        j = ((r->trivial.o_counter * r->i_ss.rate) / r->o_ss.rate);
-        j = j > r->trivial.i_counter ? j - r->trivial.i_counter : 0;
+        j = (unsigned) (r->trivial.phase >> 32);
 
         if (j >= in_n_frames)
             break;
@@ -1402,32 +1536,33 @@ static void trivial_resample(pa_resampler *r, const pa_memchunk *input, unsigned
 
     *out_n_frames = o_index;
 
-    r->trivial.i_counter += in_n_frames;
+    /* Make the phase relative to the next block */
+    r->trivial.phase -= (uint64_t) in_n_frames << 32;
+}
 
-    /* Normalize counters */
-    while (r->trivial.i_counter >= r->i_ss.rate) {
-        pa_assert(r->trivial.o_counter >= r->o_ss.rate);
+static void trivial_update_rates(pa_resampler *r) {
+    pa_assert(r);
 
-        r->trivial.i_counter -= r->i_ss.rate;
-        r->trivial.o_counter -= r->o_ss.rate;
-    }
+    /* The phase is kept, so that rate changes don't cause a jump */
+    r->trivial.step = (uint64_t) ceil((double) r->i_ss.rate * r->ratio / r->o_ss.rate * 4294967296.0);
 }
 
-static void trivial_update_rates_or_reset(pa_resampler *r) {
+static void trivial_reset(pa_resampler *r) {
     pa_assert(r);
 
-    r->trivial.i_counter = 0;
-    r->trivial.o_counter = 0;
+    r->trivial.phase = 0;
 }
 
 static int trivial_init(pa_resampler*r) {
     pa_assert(r);
 
-    r->trivial.o_counter = r->trivial.i_counter = 0;
+    r->trivial.phase = 0;
+    trivial_update_rates(r);
 
     r->impl_resample = trivial_resample;
-    r->impl_update_rates = trivial_update_rates_or_reset;
-    r->impl_reset = trivial_update_rates_or_reset;
+    r->impl_update_rates = trivial_update_rates;
+    r->impl_update_ratio = trivial_update_rates;
+    r->impl_reset = trivial_reset;
 
     return 0;
 }
@@ -1550,6 +1685,367 @@ static int peaks_init(pa_resampler*r) {
     return 0;
 }
 
+/*** native polyphase implementation ***/
+
+/* Rational ratios whose reduced output rate is at most this get a
+ * table with one row per output phase, like 44.1 kHz <-> 48 kHz
+ * (147:160). Everything else, including the fine tuning with
+ * pa_resampler_set_rate_ratio(), interpolates between the rows of an
+ * oversampled table. */
+#define POLYPHASE_MAX_PHASES 320
+#define POLYPHASE_OVERSAMPLE 256
+#define POLYPHASE_MAX_TAPS 1024U
+
+static const struct {
+    unsigned taps;
+    double cutoff; /* relative to the Nyquist frequency of the lower rate */
+    double beta;   /* of the Kaiser window */
+} polyphase_quality[] = {
+    {  16, 0.80,  6.0 },
+    {  48, 0.915, 8.6 },
+    { 128, 0.95, 10.5 }
+};
+
+static float dot_c(const float *a, const float *b, unsigned n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+    for (; n >= 4; n -= 4, a += 4, b += 4) {
+        s0 += a[0] * b[0];
+        s1 += a[1] * b[1];
+        s2 += a[2] * b[2];
+        s3 += a[3] * b[3];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+static pa_resampler_dot_func_t dot_func = dot_c;
+
+pa_resampler_dot_func_t pa_get_resampler_dot_func(void) {
+    return dot_func;
+}
+
+void pa_set_resampler_dot_func(pa_resampler_dot_func_t func) {
+    pa_assert(func);
+
+    dot_func = func;
+}
+
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    unsigned k;
+
+    for (k = 1; k < 100 && term > sum * 1e-12; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+/* Fills in one row of taps coefficients for an output that lies frac
+ * input samples after the center tap */
+static void polyphase_fill_row(float *row, unsigned taps, double frac, double cutoff, double beta) {
+    double half = taps / 2, sum = 0;
+    unsigned t;
+
+    for (t = 0; t < taps; t++) {
+        double d = (double) t - (half - 1) - frac, x = d / half, h;
+
+        if (fabs(x) >= 1.0)
+            h = 0;
+        else {
+            h = cutoff * bessel_i0(beta * sqrt(1.0 - x * x)) / bessel_i0(beta);
+
+            if (fabs(d) > 1e-9)
+                h *= sin(M_PI * cutoff * d) / (M_PI * cutoff * d);
+        }
+
+        row[t] = (float) h;
+        sum += h;
+    }
+
+    /* Unity gain at DC for every phase, so that there is no ripple
+     * with the phase */
+    for (t = 0; t < taps; t++)
+        row[t] = (float) (row[t] / sum);
+}
+
+/* Allocates rows*taps floats aligned to 32 bytes */
+static float *polyphase_new_table(unsigned rows, unsigned taps, void **mem) {
+    *mem = pa_xmalloc0(rows * taps * sizeof(float) + 32);
+
+    return (float*) (((uintptr_t) *mem + 31) & ~(uintptr_t) 31);
+}
+
+static void polyphase_free_tables(pa_resampler *r) {
+    pa_xfree(r->polyphase.exact_mem);
+    pa_xfree(r->polyphase.interp_mem);
+
+    r->polyphase.exact_table = r->polyphase.interp_table = NULL;
+    r->polyphase.exact_mem = r->polyphase.interp_mem = NULL;
+}
+
+static void polyphase_clear_history(pa_resampler *r) {
+    unsigned c;
+
+    /* Start with the center tap on the first input sample */
+    r->polyphase.buf_len = r->polyphase.taps / 2 - 1;
+    r->polyphase.pos = 0;
+    r->polyphase.phase = 0;
+    r->polyphase.frac = 0;
+
+    for (c = 0; c < r->o_ss.channels; c++)
+        memset(r->polyphase.buf[c], 0, r->polyphase.buf_len * sizeof(float));
+}
+
+static void polyphase_build_interp_table(pa_resampler *r) {
+    unsigned p;
+
+    if (r->polyphase.interp_table)
+        return;
+
+    /* One row more, so that we can interpolate towards the next input
+     * sample */
+    r->polyphase.interp_table = polyphase_new_table(POLYPHASE_OVERSAMPLE + 1, r->polyphase.taps, &r->polyphase.interp_mem);
+
+    for (p = 0; p <= POLYPHASE_OVERSAMPLE; p++)
+        polyphase_fill_row(r->polyphase.interp_table + p * r->polyphase.taps, r->polyphase.taps,
+                           (double) p / POLYPHASE_OVERSAMPLE, r->polyphase.cutoff, r->polyphase.beta);
+}
+
+/* Switches between stepping through the exact table and
+ * interpolating, without moving the current position */
+static void polyphase_update_ratio(pa_resampler *r) {
+    pa_bool_t exact;
+
+    pa_assert(r);
+
+    exact = r->polyphase.exact_table && r->unity_ratio;
+
+    if (!exact) {
+        polyphase_build_interp_table(r);
+
+        if (r->polyphase.exact)
+            r->polyphase.frac = (uint32_t) (((uint64_t) r->polyphase.phase << 32) / r->polyphase.out_den);
+
+        r->polyphase.step = (uint64_t) ((double) r->i_ss.rate * r->ratio / r->o_ss.rate * 4294967296.0);
+
+    } else if (!r->polyphase.exact) {
+        uint64_t p = ((uint64_t) r->polyphase.frac * r->polyphase.out_den + 0x80000000U) >> 32;
+
+        if (p >= r->polyphase.out_den) {
+            p -= r->polyphase.out_den;
+            r->polyphase.pos++;
+        }
+
+        r->polyphase.phase = (unsigned) p;
+    }
+
+    r->polyphase.exact = exact;
+}
+
+static void polyphase_update_rates(pa_resampler *r) {
+    unsigned q, taps, g, p;
+    double scale;
+
+    pa_assert(r);
+
+    q = (unsigned) (r->method - PA_RESAMPLER_POLYPHASE_BASE);
+    g = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+
+    /* When downsampling the filter has to cut off below the output's
+     * Nyquist frequency and hence needs more taps for the same
+     * transition band */
+    scale = r->o_ss.rate < r->i_ss.rate ? (double) r->o_ss.rate / r->i_ss.rate : 1.0;
+    taps = (unsigned) ceil(polyphase_quality[q].taps / scale);
+    taps = PA_ROUND_UP(taps, 8U);
+    taps = PA_MIN(taps, POLYPHASE_MAX_TAPS);
+
+    polyphase_free_tables(r);
+
+    r->polyphase.cutoff = polyphase_quality[q].cutoff * scale;
+    r->polyphase.beta = polyphase_quality[q].beta;
+    r->polyphase.in_num = r->i_ss.rate / g;
+    r->polyphase.out_den = r->o_ss.rate / g;
+
+    if (r->polyphase.out_den <= POLYPHASE_MAX_PHASES) {
+        r->polyphase.exact_table = polyphase_new_table(r->polyphase.out_den, taps, &r->polyphase.exact_mem);
+
+        for (p = 0; p < r->polyphase.out_den; p++)
+            polyphase_fill_row(r->polyphase.exact_table + p * taps, taps,
+                               (double) p / r->polyphase.out_den, r->polyphase.cutoff, r->polyphase.beta);
+    }
+
+    if (taps != r->polyphase.taps) {
+        r->polyphase.taps = taps;
+        polyphase_clear_history(r);
+    } else
+        r->polyphase.phase = r->polyphase.frac = 0;
+
+    r->polyphase.exact = FALSE;
+    polyphase_update_ratio(r);
+
+    pa_log_info("Polyphase resampler with %u taps, %u phases%s.", taps,
+                r->polyphase.exact ? r->polyphase.out_den : POLYPHASE_OVERSAMPLE,
+                r->polyphase.exact ? "" : ", interpolated");
+}
+
+static void polyphase_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
+    unsigned c, channels, taps, o_index = 0, pos;
+    const float *src;
+    float *dst;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    channels = r->o_ss.channels;
+    taps = r->polyphase.taps;
+
+    if (r->polyphase.buf_len + in_n_frames > r->polyphase.buf_size) {
+        r->polyphase.buf_size = r->polyphase.buf_len + in_n_frames;
+
+        for (c = 0; c < channels; c++)
+            r->polyphase.buf[c] = pa_xrealloc(r->polyphase.buf[c], r->polyphase.buf_size * sizeof(float));
+    }
+
+    /* Append the new input to the planar history */
+    src = (const float*) ((uint8_t*) pa_memblock_acquire(input->memblock) + input->index);
+
+    for (c = 0; c < channels; c++) {
+        float *b = r->polyphase.buf[c] + r->polyphase.buf_len;
+        const float *s = src + c;
+        unsigned i;
+
+        for (i = 0; i < in_n_frames; i++, s += channels)
+            b[i] = *s;
+    }
+
+    pa_memblock_release(input->memblock);
+
+    r->polyphase.buf_len += in_n_frames;
+
+    dst = (float*) ((uint8_t*) pa_memblock_acquire(output->memblock) + output->index);
+    pos = r->polyphase.pos;
+
+    if (r->polyphase.exact) {
+        unsigned phase = r->polyphase.phase;
+        unsigned step = r->polyphase.in_num / r->polyphase.out_den, step_frac = r->polyphase.in_num % r->polyphase.out_den;
+
+        for (; pos + taps <= r->polyphase.buf_len && o_index < *out_n_frames; o_index++) {
+            const float *row = r->polyphase.exact_table + phase * taps;
+
+            for (c = 0; c < channels; c++)
+                *(dst++) = dot_func(row, r->polyphase.buf[c] + pos, taps);
+
+            pos += step;
+            if ((phase += step_frac) >= r->polyphase.out_den) {
+                phase -= r->polyphase.out_den;
+                pos++;
+            }
+        }
+
+        r->polyphase.phase = phase;
+
+    } else {
+        uint64_t frac = r->polyphase.frac;
+
+        for (; pos + taps <= r->polyphase.buf_len && o_index < *out_n_frames; o_index++) {
+            uint64_t f = frac * POLYPHASE_OVERSAMPLE;
+            const float *row = r->polyphase.interp_table + (f >> 32) * taps;
+            float alpha = (float) (f & 0xFFFFFFFFU) * (1.0f / 4294967296.0f);
+
+            for (c = 0; c < channels; c++) {
+                float a, b;
+
+                a = dot_func(row, r->polyphase.buf[c] + pos, taps);
+                b = dot_func(row + taps, r->polyphase.buf[c] + pos, taps);
+
+                *(dst++) = a + alpha * (b - a);
+            }
+
+            frac += r->polyphase.step;
+            pos += (unsigned) (frac >> 32);
+            frac &= 0xFFFFFFFFU;
+        }
+
+        r->polyphase.frac = (uint32_t) frac;
+    }
+
+    pa_memblock_release(output->memblock);
+
+    *out_n_frames = o_index;
+
+    /* Drop what we don't need anymore, but keep the history for the
+     * next outputs. When downsampling we might have stepped beyond
+     * the end already. */
+    r->polyphase.pos = pos - PA_MIN(pos, r->polyphase.buf_len);
+    pos -= r->polyphase.pos;
+
+    if (pos > 0) {
+        r->polyphase.buf_len -= pos;
+
+        for (c = 0; c < channels; c++)
+            memmove(r->polyphase.buf[c], r->polyphase.buf[c] + pos, r->polyphase.buf_len * sizeof(float));
+    }
+}
+
+static void polyphase_reset(pa_resampler *r) {
+    pa_assert(r);
+
+    polyphase_clear_history(r);
+    polyphase_update_ratio(r);
+}
+
+/* The history beyond the center tap of the next output has been
+ * consumed already but not been played yet */
+static unsigned polyphase_get_delay(pa_resampler *r) {
+    unsigned center;
+
+    pa_assert(r);
+
+    center = r->polyphase.pos + r->polyphase.taps / 2 - 1;
+
+    return r->polyphase.buf_len > center ? r->polyphase.buf_len - center : 0;
+}
+
+static void polyphase_free(pa_resampler *r) {
+    unsigned c;
+
+    pa_assert(r);
+
+    polyphase_free_tables(r);
+
+    for (c = 0; c < PA_CHANNELS_MAX; c++)
+        pa_xfree(r->polyphase.buf[c]);
+}
+
+static int polyphase_init(pa_resampler *r) {
+    unsigned c;
+
+    pa_assert(r);
+
+    memset(&r->polyphase, 0, sizeof(r->polyphase));
+
+    r->impl_free = polyphase_free;
+    r->impl_update_rates = polyphase_update_rates;
+    r->impl_update_ratio = polyphase_update_ratio;
+    r->impl_resample = polyphase_resample;
+    r->impl_reset = polyphase_reset;
+    r->impl_get_delay = polyphase_get_delay;
+
+    /* Large enough for the history of any filter */
+    r->polyphase.buf_size = POLYPHASE_MAX_TAPS;
+    for (c = 0; c < r->o_ss.channels; c++)
+        r->polyphase.buf[c] = pa_xnew(float, r->polyphase.buf_size);
+
+    polyphase_update_rates(r);
+
+    return 0;
+}
+
 /*** ffmpeg based implementation ***/
 
 static void ffmpeg_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
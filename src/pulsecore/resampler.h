@@ -45,6 +45,8 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_AUTO, /* automatic select based on sample format */
     PA_RESAMPLER_COPY,
     PA_RESAMPLER_PEAKS,
+    PA_RESAMPLER_POLYPHASE_BASE,
+    PA_RESAMPLER_POLYPHASE_MAX = PA_RESAMPLER_POLYPHASE_BASE + 2,
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
@@ -84,9 +86,22 @@ void pa_resampler_set_input_rate(pa_resampler *r, uint32_t rate);
 /* Change the output rate of the resampler object */
 void pa_resampler_set_output_rate(pa_resampler *r, uint32_t rate);
 
+/* Fine-tune the input rate: the input is resampled as if its rate
+ * was ratio times the input rate. Unlike pa_resampler_set_input_rate()
+ * this is not limited to integral rates and keeps the filter state,
+ * so it may be called continuously to follow a drifting clock.
+ * Ignored by the resamplers that cannot change the rate. */
+void pa_resampler_set_rate_ratio(pa_resampler *r, double ratio);
+double pa_resampler_get_rate_ratio(pa_resampler *r);
+
 /* Reinitialize state of the resampler, possibly due to seeking or other discontinuities */
 void pa_resampler_reset(pa_resampler *r);
 
+/* Returns how much of the input the resampler has consumed but not
+ * returned the output for yet, in bytes of the input. Add this when
+ * rewinding the source of the input before a reset. */
+size_t pa_resampler_get_delay(pa_resampler *r);
+
 /* Return the resampling method of the resampler object */
 pa_resample_method_t pa_resampler_get_method(pa_resampler *r);
 
@@ -99,6 +114,13 @@ const char *pa_resample_method_to_string(pa_resample_method_t m);
 /* Return 1 when the specified resampling method is supported */
 int pa_resample_method_supported(pa_resample_method_t m);
 
+/* Inner loop of the polyphase resampler: the dot product of a and b.
+ * n is a multiple of 8 and a is aligned to 32 bytes. */
+typedef float (*pa_resampler_dot_func_t)(const float *a, const float *b, unsigned n);
+
+pa_resampler_dot_func_t pa_get_resampler_dot_func(void);
+void pa_set_resampler_dot_func(pa_resampler_dot_func_t func);
+
 const pa_channel_map* pa_resampler_input_channel_map(pa_resampler *r);
 const pa_sample_spec* pa_resampler_input_sample_spec(pa_resampler *r);
 const pa_channel_map* pa_resampler_output_channel_map(pa_resampler *r);
@@ -0,0 +1,72 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-arm.h"
+
+#include "resampler.h"
+
+#if defined (__arm__) && defined (__ARM_NEON__)
+
+/* Same as the SSE version: two partial sums in q8/q9, the aligned
+ * coefficients in %[a], the history in %[b] */
+static float dot_neon(const float *a, const float *b, unsigned n) {
+    float r;
+
+    __asm__ __volatile__ (
+        " vmov.i32 q8, #0                 \n\t"
+        " vmov.i32 q9, #0                 \n\t"
+
+        "1:                               \n\t"
+        " vld1.32 {d0-d3}, [%[b]]!        \n\t"
+        " vld1.32 {d4-d7}, [%[a], :128]!  \n\t"
+        " vmla.f32 q8, q0, q2             \n\t"
+        " vmla.f32 q9, q1, q3             \n\t"
+        " subs %[n], %[n], #8             \n\t"
+        " bne 1b                          \n\t"
+
+        " vadd.f32 q8, q8, q9             \n\t"
+        " vadd.f32 d16, d16, d17          \n\t"
+        " vpadd.f32 d16, d16, d16         \n\t"
+        " vst1.32 {d16[0]}, [%[r]]        \n\t"
+
+        : [a] "+r" (a), [b] "+r" (b), [n] "+r" (n)
+        : [r] "r" (&r)
+        : "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7",
+          "d16", "d17", "d18", "d19"
+    );
+
+    return r;
+}
+
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+
+void pa_resampler_func_init_neon(pa_cpu_arm_flag_t flags) {
+#if defined (__arm__) && defined (__ARM_NEON__)
+    pa_log_info("Initialising ARM NEON optimized resampler functions.");
+
+    pa_set_resampler_dot_func(dot_neon);
+#endif /* defined (__arm__) && defined (__ARM_NEON__) */
+}
@@ -0,0 +1,138 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+
+#include "cpu-x86.h"
+
+#include "resampler.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+/* Both versions keep two partial sums to hide the latency of the
+ * additions and only reduce them horizontally at the very end. The
+ * coefficients in %[a] are aligned, the history in %[b] usually
+ * isn't. */
+
+static float dot_sse(const float *a, const float *b, unsigned n) {
+    pa_reg_x86 len = n;
+    float r;
+
+    __asm__ __volatile__ (
+        " xorps %%xmm0, %%xmm0            \n\t"
+        " xorps %%xmm1, %%xmm1            \n\t"
+
+        "1:                               \n\t"
+        " movups (%[b]), %%xmm2           \n\t"
+        " movups 16(%[b]), %%xmm3         \n\t"
+        " mulps (%[a]), %%xmm2            \n\t"
+        " mulps 16(%[a]), %%xmm3          \n\t"
+        " addps %%xmm2, %%xmm0            \n\t"
+        " addps %%xmm3, %%xmm1            \n\t"
+        " add $32, %[a]                   \n\t"
+        " add $32, %[b]                   \n\t"
+        " sub $8, %[n]                    \n\t"
+        " jne 1b                          \n\t"
+
+        " addps %%xmm1, %%xmm0            \n\t"
+        " movhlps %%xmm0, %%xmm1          \n\t"
+        " addps %%xmm1, %%xmm0            \n\t"
+        " movaps %%xmm0, %%xmm1           \n\t"
+        " shufps $0x55, %%xmm1, %%xmm1    \n\t"
+        " addss %%xmm1, %%xmm0            \n\t"
+        " movss %%xmm0, %[r]              \n\t"
+
+        : [a] "+r" (a), [b] "+r" (b), [n] "+r" (len), [r] "=m" (r)
+        :
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3"
+    );
+
+    return r;
+}
+
+static float dot_avx(const float *a, const float *b, unsigned n) {
+    pa_reg_x86 len = n;
+    float r;
+
+    __asm__ __volatile__ (
+        " vxorps %%ymm0, %%ymm0, %%ymm0   \n\t"
+        " vxorps %%ymm1, %%ymm1, %%ymm1   \n\t"
+
+        /* n is a multiple of 8, get rid of the odd 8 first */
+        " test $8, %[n]                   \n\t"
+        " jz 1f                           \n\t"
+        " vmovups (%[b]), %%ymm2          \n\t"
+        " vmulps (%[a]), %%ymm2, %%ymm0   \n\t"
+        " add $32, %[a]                   \n\t"
+        " add $32, %[b]                   \n\t"
+        " sub $8, %[n]                    \n\t"
+        " jz 2f                           \n\t"
+
+        "1:                               \n\t"
+        " vmovups (%[b]), %%ymm2          \n\t"
+        " vmovups 32(%[b]), %%ymm3        \n\t"
+        " vmulps (%[a]), %%ymm2, %%ymm2   \n\t"
+        " vmulps 32(%[a]), %%ymm3, %%ymm3 \n\t"
+        " vaddps %%ymm2, %%ymm0, %%ymm0   \n\t"
+        " vaddps %%ymm3, %%ymm1, %%ymm1   \n\t"
+        " add $64, %[a]                   \n\t"
+        " add $64, %[b]                   \n\t"
+        " sub $16, %[n]                   \n\t"
+        " jne 1b                          \n\t"
+
+        "2:                               \n\t"
+        " vaddps %%ymm1, %%ymm0, %%ymm0   \n\t"
+        " vextractf128 $1, %%ymm0, %%xmm1 \n\t"
+        " vaddps %%xmm1, %%xmm0, %%xmm0   \n\t"
+        " vmovhlps %%xmm0, %%xmm0, %%xmm1 \n\t"
+        " vaddps %%xmm1, %%xmm0, %%xmm0   \n\t"
+        " vshufps $0x55, %%xmm0, %%xmm0, %%xmm1 \n\t"
+        " vaddss %%xmm1, %%xmm0, %%xmm0   \n\t"
+        " vmovss %%xmm0, %[r]             \n\t"
+        " vzeroupper                      \n\t"
+
+        : [a] "+r" (a), [b] "+r" (b), [n] "+r" (len), [r] "=m" (r)
+        :
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3"
+    );
+
+    return r;
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_resampler_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_AVX) {
+        pa_log_info("Initialising AVX optimized resampler functions.");
+
+        pa_set_resampler_dot_func(dot_avx);
+    } else if (flags & PA_CPU_X86_SSE) {
+        pa_log_info("Initialising SSE optimized resampler functions.");
+
+        pa_set_resampler_dot_func(dot_sse);
+    }
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
@@ -0,0 +1,498 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/poll.h>
+
+#include "rtpoll-mainloop.h"
+
+struct pa_io_event {
+    pa_rtpoll_mainloop *mainloop;
+    pa_rtpoll_item *item;
+    int fd;
+
+    pa_io_event_cb_t callback;
+    void *userdata;
+    pa_io_event_destroy_cb_t destroy_callback;
+};
+
+struct pa_time_event {
+    pa_rtpoll_mainloop *mainloop;
+    pa_bool_t dead;
+
+    pa_bool_t enabled;
+    pa_bool_t use_rtclock;
+    pa_usec_t time;
+
+    pa_time_event_cb_t callback;
+    void *userdata;
+    pa_time_event_destroy_cb_t destroy_callback;
+
+    PA_LLIST_FIELDS(pa_time_event);
+};
+
+struct pa_defer_event {
+    pa_rtpoll_mainloop *mainloop;
+    pa_bool_t dead;
+
+    pa_bool_t enabled;
+
+    pa_defer_event_cb_t callback;
+    void *userdata;
+    pa_defer_event_destroy_cb_t destroy_callback;
+
+    PA_LLIST_FIELDS(pa_defer_event);
+};
+
+struct pa_rtpoll_mainloop {
+    pa_mainloop_api api;
+    pa_rtpoll *rtpoll;
+
+    /* Dispatches the time and defer events */
+    pa_rtpoll_item *item;
+
+    PA_LLIST_HEAD(pa_time_event, time_events);
+    PA_LLIST_HEAD(pa_defer_event, defer_events);
+
+    /* Freeing events is delayed while we iterate through the lists */
+    pa_bool_t dispatching, please_scan;
+
+    unsigned n_io_events;
+};
+
+static short map_flags_to_libc(pa_io_event_flags_t flags) {
+    return (short)
+        ((flags & PA_IO_EVENT_INPUT ? POLLIN : 0) |
+         (flags & PA_IO_EVENT_OUTPUT ? POLLOUT : 0) |
+         (flags & PA_IO_EVENT_ERROR ? POLLERR : 0) |
+         (flags & PA_IO_EVENT_HANGUP ? POLLHUP : 0));
+}
+
+static pa_io_event_flags_t map_flags_from_libc(short flags) {
+    return
+        (flags & POLLIN ? PA_IO_EVENT_INPUT : 0) |
+        (flags & POLLOUT ? PA_IO_EVENT_OUTPUT : 0) |
+        (flags & POLLERR ? PA_IO_EVENT_ERROR : 0) |
+        (flags & POLLHUP ? PA_IO_EVENT_HANGUP : 0);
+}
+
+/* IO events */
+static int io_work_cb(pa_rtpoll_item *i) {
+    pa_io_event *e;
+    struct pollfd *p;
+    short revents;
+
+    pa_assert_se(e = pa_rtpoll_item_get_userdata(i));
+
+    p = pa_rtpoll_item_get_pollfd(i, NULL);
+
+    if (!(revents = p->revents))
+        return 0;
+
+    p->revents = 0;
+
+    /* The callback might free e */
+    e->callback(&e->mainloop->api, e, e->fd, map_flags_from_libc(revents), e->userdata);
+
+    return 0;
+}
+
+static pa_io_event* rtpoll_io_new(
+        pa_mainloop_api *a,
+        int fd,
+        pa_io_event_flags_t events,
+        pa_io_event_cb_t callback,
+        void *userdata) {
+
+    pa_rtpoll_mainloop *m;
+    pa_io_event *e;
+    struct pollfd *p;
+
+    pa_assert(a);
+    pa_assert(a->userdata);
+    pa_assert(fd >= 0);
+    pa_assert(callback);
+
+    m = a->userdata;
+    pa_assert(a == &m->api);
+
+    e = pa_xnew0(pa_io_event, 1);
+    e->mainloop = m;
+    e->fd = fd;
+    e->callback = callback;
+    e->userdata = userdata;
+
+    e->item = pa_rtpoll_item_new(m->rtpoll, PA_RTPOLL_NORMAL, 1);
+    p = pa_rtpoll_item_get_pollfd(e->item, NULL);
+    p->fd = fd;
+    p->events = map_flags_to_libc(events);
+    p->revents = 0;
+
+    pa_rtpoll_item_set_work_callback(e->item, io_work_cb);
+    pa_rtpoll_item_set_userdata(e->item, e);
+
+    m->n_io_events++;
+
+    return e;
+}
+
+static void rtpoll_io_enable(pa_io_event *e, pa_io_event_flags_t events) {
+    struct pollfd *p;
+
+    pa_assert(e);
+
+    p = pa_rtpoll_item_get_pollfd(e->item, NULL);
+    p->events = map_flags_to_libc(events);
+}
+
+static void rtpoll_io_free(pa_io_event *e) {
+    pa_assert(e);
+
+    if (e->destroy_callback)
+        e->destroy_callback(&e->mainloop->api, e, e->userdata);
+
+    /* If we are called from within the rtpoll this only marks the
+     * item dead, so it is safe to free e already */
+    pa_rtpoll_item_free(e->item);
+
+    pa_assert(e->mainloop->n_io_events >= 1);
+    e->mainloop->n_io_events--;
+
+    pa_xfree(e);
+}
+
+static void rtpoll_io_set_destroy(pa_io_event *e, pa_io_event_destroy_cb_t callback) {
+    pa_assert(e);
+
+    e->destroy_callback = callback;
+}
+
+/* Time events */
+static pa_usec_t make_rt(const struct timeval *tv, pa_bool_t *use_rtclock) {
+    struct timeval ttv;
+
+    if (!tv) {
+        *use_rtclock = FALSE;
+        return PA_USEC_INVALID;
+    }
+
+    ttv = *tv;
+    *use_rtclock = !!(ttv.tv_usec & PA_TIMEVAL_RTCLOCK);
+
+    if (*use_rtclock)
+        ttv.tv_usec &= ~PA_TIMEVAL_RTCLOCK;
+    else
+        pa_rtclock_from_wallclock(&ttv);
+
+    return pa_timeval_load(&ttv);
+}
+
+static pa_time_event* rtpoll_time_new(
+        pa_mainloop_api *a,
+        const struct timeval *tv,
+        pa_time_event_cb_t callback,
+        void *userdata) {
+
+    pa_rtpoll_mainloop *m;
+    pa_time_event *e;
+
+    pa_assert(a);
+    pa_assert(a->userdata);
+    pa_assert(callback);
+
+    m = a->userdata;
+    pa_assert(a == &m->api);
+
+    e = pa_xnew0(pa_time_event, 1);
+    e->mainloop = m;
+    e->time = make_rt(tv, &e->use_rtclock);
+    e->enabled = e->time != PA_USEC_INVALID;
+    e->callback = callback;
+    e->userdata = userdata;
+
+    PA_LLIST_PREPEND(pa_time_event, m->time_events, e);
+
+    return e;
+}
+
+static void rtpoll_time_restart(pa_time_event *e, const struct timeval *tv) {
+    pa_assert(e);
+    pa_assert(!e->dead);
+
+    e->time = make_rt(tv, &e->use_rtclock);
+    e->enabled = e->time != PA_USEC_INVALID;
+}
+
+static void rtpoll_time_free(pa_time_event *e) {
+    pa_assert(e);
+    pa_assert(!e->dead);
+
+    e->dead = TRUE;
+    e->enabled = FALSE;
+
+    if (e->destroy_callback)
+        e->destroy_callback(&e->mainloop->api, e, e->userdata);
+
+    if (e->mainloop->dispatching)
+        e->mainloop->please_scan = TRUE;
+    else {
+        PA_LLIST_REMOVE(pa_time_event, e->mainloop->time_events, e);
+        pa_xfree(e);
+    }
+}
+
+static void rtpoll_time_set_destroy(pa_time_event *e, pa_time_event_destroy_cb_t callback) {
+    pa_assert(e);
+
+    e->destroy_callback = callback;
+}
+
+/* Defer events */
+static pa_defer_event* rtpoll_defer_new(
+        pa_mainloop_api *a,
+        pa_defer_event_cb_t callback,
+        void *userdata) {
+
+    pa_rtpoll_mainloop *m;
+    pa_defer_event *e;
+
+    pa_assert(a);
+    pa_assert(a->userdata);
+    pa_assert(callback);
+
+    m = a->userdata;
+    pa_assert(a == &m->api);
+
+    e = pa_xnew0(pa_defer_event, 1);
+    e->mainloop = m;
+    e->enabled = TRUE;
+    e->callback = callback;
+    e->userdata = userdata;
+
+    PA_LLIST_PREPEND(pa_defer_event, m->defer_events, e);
+
+    return e;
+}
+
+static void rtpoll_defer_enable(pa_defer_event *e, int b) {
+    pa_assert(e);
+    pa_assert(!e->dead);
+
+    e->enabled = !!b;
+}
+
+static void rtpoll_defer_free(pa_defer_event *e) {
+    pa_assert(e);
+    pa_assert(!e->dead);
+
+    e->dead = TRUE;
+    e->enabled = FALSE;
+
+    if (e->destroy_callback)
+        e->destroy_callback(&e->mainloop->api, e, e->userdata);
+
+    if (e->mainloop->dispatching)
+        e->mainloop->please_scan = TRUE;
+    else {
+        PA_LLIST_REMOVE(pa_defer_event, e->mainloop->defer_events, e);
+        pa_xfree(e);
+    }
+}
+
+static void rtpoll_defer_set_destroy(pa_defer_event *e, pa_defer_event_destroy_cb_t callback) {
+    pa_assert(e);
+
+    e->destroy_callback = callback;
+}
+
+static void rtpoll_quit(pa_mainloop_api *a, int retval) {
+    pa_rtpoll_mainloop *m;
+
+    pa_assert(a);
+    pa_assert(a->userdata);
+
+    m = a->userdata;
+    pa_assert(a == &m->api);
+
+    pa_rtpoll_quit(m->rtpoll);
+}
+
+static const pa_mainloop_api vtable = {
+    .userdata = NULL,
+
+    .io_new = rtpoll_io_new,
+    .io_enable = rtpoll_io_enable,
+    .io_free = rtpoll_io_free,
+    .io_set_destroy = rtpoll_io_set_destroy,
+
+    .time_new = rtpoll_time_new,
+    .time_restart = rtpoll_time_restart,
+    .time_free = rtpoll_time_free,
+    .time_set_destroy = rtpoll_time_set_destroy,
+
+    .defer_new = rtpoll_defer_new,
+    .defer_enable = rtpoll_defer_enable,
+    .defer_free = rtpoll_defer_free,
+    .defer_set_destroy = rtpoll_defer_set_destroy,
+
+    .quit = rtpoll_quit,
+};
+
+static void cleanup_dead(pa_rtpoll_mainloop *m) {
+    pa_time_event *t, *tn;
+    pa_defer_event *d, *dn;
+
+    pa_assert(m);
+
+    m->please_scan = FALSE;
+
+    PA_LLIST_FOREACH_SAFE(t, tn, m->time_events)
+        if (t->dead) {
+            PA_LLIST_REMOVE(pa_time_event, m->time_events, t);
+            pa_xfree(t);
+        }
+
+    PA_LLIST_FOREACH_SAFE(d, dn, m->defer_events)
+        if (d->dead) {
+            PA_LLIST_REMOVE(pa_defer_event, m->defer_events, d);
+            pa_xfree(d);
+        }
+}
+
+static int work_cb(pa_rtpoll_item *i) {
+    pa_rtpoll_mainloop *m;
+    pa_time_event *t;
+    pa_defer_event *d;
+    pa_usec_t now;
+
+    pa_assert_se(m = pa_rtpoll_item_get_userdata(i));
+
+    m->dispatching = TRUE;
+
+    PA_LLIST_FOREACH(d, m->defer_events) {
+        if (d->dead || !d->enabled)
+            continue;
+
+        d->callback(&m->api, d, d->userdata);
+    }
+
+    now = pa_rtclock_now();
+
+    PA_LLIST_FOREACH(t, m->time_events) {
+        struct timeval tv;
+
+        if (t->dead || !t->enabled || t->time > now)
+            continue;
+
+        /* Time events are one-shot unless restarted */
+        t->enabled = FALSE;
+        t->callback(&m->api, t, pa_timeval_rtstore(&tv, t->time, t->use_rtclock), t->userdata);
+    }
+
+    m->dispatching = FALSE;
+
+    if (m->please_scan)
+        cleanup_dead(m);
+
+    return 0;
+}
+
+static int before_cb(pa_rtpoll_item *i) {
+    pa_rtpoll_mainloop *m;
+    pa_time_event *t;
+    pa_defer_event *d;
+    pa_usec_t next = PA_USEC_INVALID;
+
+    pa_assert_se(m = pa_rtpoll_item_get_userdata(i));
+
+    /* Pending defer events mean we shouldn't sleep at all, but we
+     * still want to see what happened on the fds */
+    PA_LLIST_FOREACH(d, m->defer_events)
+        if (!d->dead && d->enabled) {
+            next = 0;
+            break;
+        }
+
+    if (next != 0)
+        PA_LLIST_FOREACH(t, m->time_events)
+            if (!t->dead && t->enabled && (next == PA_USEC_INVALID || t->time < next))
+                next = t->time;
+
+    if (next == PA_USEC_INVALID)
+        pa_rtpoll_set_timer_disabled(m->rtpoll);
+    else
+        pa_rtpoll_set_timer_absolute(m->rtpoll, next);
+
+    return 0;
+}
+
+pa_rtpoll_mainloop *pa_rtpoll_mainloop_new(pa_rtpoll *p) {
+    pa_rtpoll_mainloop *m;
+
+    pa_assert(p);
+
+    m = pa_xnew0(pa_rtpoll_mainloop, 1);
+    m->rtpoll = p;
+
+    m->api = vtable;
+    m->api.userdata = m;
+
+    PA_LLIST_HEAD_INIT(pa_time_event, m->time_events);
+    PA_LLIST_HEAD_INIT(pa_defer_event, m->defer_events);
+
+    /* Run late, so that we see the defer events the others enabled */
+    m->item = pa_rtpoll_item_new(p, PA_RTPOLL_LATE, 0);
+    pa_rtpoll_item_set_work_callback(m->item, work_cb);
+    pa_rtpoll_item_set_before_callback(m->item, before_cb);
+    pa_rtpoll_item_set_userdata(m->item, m);
+
+    return m;
+}
+
+void pa_rtpoll_mainloop_free(pa_rtpoll_mainloop *m) {
+    pa_assert(m);
+    pa_assert(!m->dispatching);
+
+    cleanup_dead(m);
+
+    pa_assert(m->n_io_events == 0);
+    pa_assert(!m->time_events);
+    pa_assert(!m->defer_events);
+
+    pa_rtpoll_item_free(m->item);
+    pa_rtpoll_set_timer_disabled(m->rtpoll);
+
+    pa_xfree(m);
+}
+
+pa_mainloop_api* pa_rtpoll_mainloop_get_api(pa_rtpoll_mainloop *m) {
+    pa_assert(m);
+
+    return &m->api;
+}
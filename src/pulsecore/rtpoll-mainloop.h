@@ -0,0 +1,42 @@
+#ifndef foopulsertpollmainloophfoo
+#define foopulsertpollmainloophfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/mainloop-api.h>
+#include <pulsecore/rtpoll.h>
+
+/* A pa_mainloop_api whose events are dispatched by a pa_rtpoll, so
+ * that objects built on the main loop API, such as pa_iochannel and
+ * pa_pstream, can be driven by an IO thread. Everything, including
+ * the functions of the API itself, must be called from the thread
+ * that runs the rtpoll. Time and defer events are implemented with
+ * the timer of the rtpoll, so nobody else may use it. */
+
+typedef struct pa_rtpoll_mainloop pa_rtpoll_mainloop;
+
+pa_rtpoll_mainloop *pa_rtpoll_mainloop_new(pa_rtpoll *p);
+
+/* All events need to have been freed before */
+void pa_rtpoll_mainloop_free(pa_rtpoll_mainloop *m);
+
+pa_mainloop_api* pa_rtpoll_mainloop_get_api(pa_rtpoll_mainloop *m);
+
+#endif
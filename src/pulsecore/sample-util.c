@@ -37,6 +37,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/g711.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/sconv.h>
 
 #include "sample-util.h"
 #include "endianmacros.h"
@@ -136,7 +137,7 @@ static void calc_linear_float_volume(float linear[], const pa_cvolume *volume) {
 }
 
 static void calc_linear_integer_stream_volumes(pa_mix_info streams[], unsigned nstreams, const pa_cvolume *volume, const pa_sample_spec *spec) {
-    unsigned k, channel;
+    unsigned k, channel, padding;
     float linear[PA_CHANNELS_MAX + VOLUME_PADDING];
 
     pa_assert(streams);
@@ -151,11 +152,14 @@ static void calc_linear_integer_stream_volumes(pa_mix_info streams[], unsigned n
             pa_mix_info *m = streams + k;
             m->linear[channel].i = (int32_t) lrint(pa_sw_volume_to_linear(m->volume.values[channel]) * linear[channel] * 0x10000);
         }
+
+        for (padding = 0; padding < PA_MIX_VOLUME_PADDING; padding++, channel++)
+            streams[k].linear[channel].i = streams[k].linear[padding].i;
     }
 }
 
 static void calc_linear_float_stream_volumes(pa_mix_info streams[], unsigned nstreams, const pa_cvolume *volume, const pa_sample_spec *spec) {
-    unsigned k, channel;
+    unsigned k, channel, padding;
     float linear[PA_CHANNELS_MAX + VOLUME_PADDING];
 
     pa_assert(streams);
@@ -170,528 +174,539 @@ static void calc_linear_float_stream_volumes(pa_mix_info streams[], unsigned nst
             pa_mix_info *m = streams + k;
             m->linear[channel].f = (float) (pa_sw_volume_to_linear(m->volume.values[channel]) * linear[channel]);
         }
+
+        for (padding = 0; padding < PA_MIX_VOLUME_PADDING; padding++, channel++)
+            streams[k].linear[channel].f = streams[k].linear[padding].f;
     }
 }
 
-size_t pa_mix(
-        pa_mix_info streams[],
-        unsigned nstreams,
-        void *data,
-        size_t length,
-        const pa_sample_spec *spec,
-        const pa_cvolume *volume,
-        pa_bool_t mute) {
+static void pa_mix_s16ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-    pa_cvolume full_volume;
-    unsigned k;
-    unsigned z;
-    void *end;
+    while (data < end) {
+        int32_t sum = 0;
+        unsigned i;
 
-    pa_assert(streams);
-    pa_assert(data);
-    pa_assert(length);
-    pa_assert(spec);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, lo, hi, cv = m->linear[channel].i;
 
-    if (!volume)
-        volume = pa_cvolume_reset(&full_volume, spec->channels);
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-    if (mute || pa_cvolume_is_muted(volume) || nstreams <= 0) {
-        pa_silence_memory(data, length, spec);
-        return length;
-    }
+            /* Multiplying the 32bit volume factor with the
+             * 16bit sample might result in an 48bit value. We
+             * want to do without 64 bit integers and hence do
+             * the multiplication independantly for the HI and
+             * LO part of the volume. */
 
-    for (k = 0; k < nstreams; k++)
-        streams[k].ptr = (uint8_t*) pa_memblock_acquire(streams[k].chunk.memblock) + streams[k].chunk.index;
+            hi = cv >> 16;
+            lo = cv & 0xFFFF;
 
-    for (z = 0; z < nstreams; z++)
-        if (length > streams[z].chunk.length)
-            length = streams[z].chunk.length;
-
-    end = (uint8_t*) data + length;
-
-    switch (spec->format) {
-
-        case PA_SAMPLE_S16NE:{
-            unsigned channel = 0;
+            v = *((int16_t*) m->ptr);
+            v = ((v * lo) >> 16) + (v * hi);
+            sum += v;
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
-
-            while (data < end) {
-                int32_t sum = 0;
-                unsigned i;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
+        }
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t v, lo, hi, cv = m->linear[channel].i;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+        *((int16_t*) data) = (int16_t) sum;
 
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+        data = (uint8_t*) data + sizeof(int16_t);
 
-                    /* Multiplying the 32bit volume factor with the
-                     * 16bit sample might result in an 48bit value. We
-                     * want to do without 64 bit integers and hence do
-                     * the multiplication independantly for the HI and
-                     * LO part of the volume. */
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    hi = cv >> 16;
-                    lo = cv & 0xFFFF;
+static void pa_mix_s16re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-                    v = *((int16_t*) m->ptr);
-                    v = ((v * lo) >> 16) + (v * hi);
-                    sum += v;
+    while (data < end) {
+        int32_t sum = 0;
+        unsigned i;
 
-                    m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
-                }
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, lo, hi, cv = m->linear[channel].i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
-                *((int16_t*) data) = (int16_t) sum;
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                data = (uint8_t*) data + sizeof(int16_t);
+            hi = cv >> 16;
+            lo = cv & 0xFFFF;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+            v = PA_INT16_SWAP(*((int16_t*) m->ptr));
+            v = ((v * lo) >> 16) + (v * hi);
+            sum += v;
 
-            break;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
         }
 
-        case PA_SAMPLE_S16RE:{
-            unsigned channel = 0;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+        *((int16_t*) data) = PA_INT16_SWAP((int16_t) sum);
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        data = (uint8_t*) data + sizeof(int16_t);
 
-            while (data < end) {
-                int32_t sum = 0;
-                unsigned i;
-
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t v, lo, hi, cv = m->linear[channel].i;
-
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
-
-                    hi = cv >> 16;
-                    lo = cv & 0xFFFF;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    v = PA_INT16_SWAP(*((int16_t*) m->ptr));
-                    v = ((v * lo) >> 16) + (v * hi);
-                    sum += v;
+static void pa_mix_s32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-                    m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
-                }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
-                *((int16_t*) data) = PA_INT16_SWAP((int16_t) sum);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-                data = (uint8_t*) data + sizeof(int16_t);
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+            v = *((int32_t*) m->ptr);
+            v = (v * cv) >> 16;
+            sum += v;
 
-            break;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
         }
 
-        case PA_SAMPLE_S32NE:{
-            unsigned channel = 0;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        *((int32_t*) data) = (int32_t) sum;
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        data = (uint8_t*) data + sizeof(int32_t);
 
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
-
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
-
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    v = *((int32_t*) m->ptr);
-                    v = (v * cv) >> 16;
-                    sum += v;
+static void pa_mix_s32re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-                    m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
-                }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                *((int32_t*) data) = (int32_t) sum;
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-                data = (uint8_t*) data + sizeof(int32_t);
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+            v = PA_INT32_SWAP(*((int32_t*) m->ptr));
+            v = (v * cv) >> 16;
+            sum += v;
 
-            break;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
         }
 
-        case PA_SAMPLE_S32RE:{
-            unsigned channel = 0;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        *((int32_t*) data) = PA_INT32_SWAP((int32_t) sum);
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        data = (uint8_t*) data + sizeof(int32_t);
 
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
-
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
-
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    v = PA_INT32_SWAP(*((int32_t*) m->ptr));
-                    v = (v * cv) >> 16;
-                    sum += v;
+static void pa_mix_s24ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-                    m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
-                }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                *((int32_t*) data) = PA_INT32_SWAP((int32_t) sum);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-                data = (uint8_t*) data + sizeof(int32_t);
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+            v = (int32_t) (PA_READ24NE(m->ptr) << 8);
+            v = (v * cv) >> 16;
+            sum += v;
 
-            break;
+            m->ptr = (uint8_t*) m->ptr + 3;
         }
 
-        case PA_SAMPLE_S24NE: {
-            unsigned channel = 0;
-
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        PA_WRITE24NE(data, ((uint32_t) sum) >> 8);
 
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
+        data = (uint8_t*) data + 3;
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
-
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    v = (int32_t) (PA_READ24NE(m->ptr) << 8);
-                    v = (v * cv) >> 16;
-                    sum += v;
+static void pa_mix_s24re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-                    m->ptr = (uint8_t*) m->ptr + 3;
-                }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                PA_WRITE24NE(data, ((uint32_t) sum) >> 8);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-                data = (uint8_t*) data + 3;
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+            v = (int32_t) (PA_READ24RE(m->ptr) << 8);
+            v = (v * cv) >> 16;
+            sum += v;
 
-            break;
+            m->ptr = (uint8_t*) m->ptr + 3;
         }
 
-        case PA_SAMPLE_S24RE: {
-            unsigned channel = 0;
-
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        PA_WRITE24RE(data, ((uint32_t) sum) >> 8);
 
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
+        data = (uint8_t*) data + 3;
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
-
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    v = (int32_t) (PA_READ24RE(m->ptr) << 8);
-                    v = (v * cv) >> 16;
-                    sum += v;
+static void pa_mix_s24_32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-                    m->ptr = (uint8_t*) m->ptr + 3;
-                }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                PA_WRITE24RE(data, ((uint32_t) sum) >> 8);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-                data = (uint8_t*) data + 3;
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+            v = (int32_t) (*((uint32_t*)m->ptr) << 8);
+            v = (v * cv) >> 16;
+            sum += v;
 
-            break;
+            m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
         }
 
-        case PA_SAMPLE_S24_32NE: {
-            unsigned channel = 0;
-
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
-
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        *((uint32_t*) data) = ((uint32_t) (int32_t) sum) >> 8;
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
+        data = (uint8_t*) data + sizeof(uint32_t);
 
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    v = (int32_t) (*((uint32_t*)m->ptr) << 8);
-                    v = (v * cv) >> 16;
-                    sum += v;
+static void pa_mix_s24_32re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-                    m->ptr = (uint8_t*) m->ptr + sizeof(int32_t);
-                }
+    while (data < end) {
+        int64_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                *((uint32_t*) data) = ((uint32_t) (int32_t) sum) >> 8;
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t cv = m->linear[channel].i;
+            int64_t v;
 
-                data = (uint8_t*) data + sizeof(uint32_t);
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+            v = (int32_t) (PA_UINT32_SWAP(*((uint32_t*) m->ptr)) << 8);
+            v = (v * cv) >> 16;
+            sum += v;
 
-            break;
+            m->ptr = (uint8_t*) m->ptr + 3;
         }
 
-        case PA_SAMPLE_S24_32RE: {
-            unsigned channel = 0;
-
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
-
-            while (data < end) {
-                int64_t sum = 0;
-                unsigned i;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+        *((uint32_t*) data) = PA_INT32_SWAP(((uint32_t) (int32_t) sum) >> 8);
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t cv = m->linear[channel].i;
-                    int64_t v;
+        data = (uint8_t*) data + sizeof(uint32_t);
 
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    v = (int32_t) (PA_UINT32_SWAP(*((uint32_t*) m->ptr)) << 8);
-                    v = (v * cv) >> 16;
-                    sum += v;
+static void pa_mix_u8_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-                    m->ptr = (uint8_t*) m->ptr + 3;
-                }
+    while (data < end) {
+        int32_t sum = 0;
+        unsigned i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
-                *((uint32_t*) data) = PA_INT32_SWAP(((uint32_t) (int32_t) sum) >> 8);
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, cv = m->linear[channel].i;
 
-                data = (uint8_t*) data + sizeof(uint32_t);
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+            v = (int32_t) *((uint8_t*) m->ptr) - 0x80;
+            v = (v * cv) >> 16;
+            sum += v;
 
-            break;
+            m->ptr = (uint8_t*) m->ptr + 1;
         }
 
-        case PA_SAMPLE_U8: {
-            unsigned channel = 0;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x80, 0x7F);
+        *((uint8_t*) data) = (uint8_t) (sum + 0x80);
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        data = (uint8_t*) data + 1;
 
-            while (data < end) {
-                int32_t sum = 0;
-                unsigned i;
-
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t v, cv = m->linear[channel].i;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+static void pa_mix_ulaw_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-                    v = (int32_t) *((uint8_t*) m->ptr) - 0x80;
-                    v = (v * cv) >> 16;
-                    sum += v;
+    while (data < end) {
+        int32_t sum = 0;
+        unsigned i;
 
-                    m->ptr = (uint8_t*) m->ptr + 1;
-                }
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, hi, lo, cv = m->linear[channel].i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x80, 0x7F);
-                *((uint8_t*) data) = (uint8_t) (sum + 0x80);
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                data = (uint8_t*) data + 1;
+            hi = cv >> 16;
+            lo = cv & 0xFFFF;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+            v = (int32_t) st_ulaw2linear16(*((uint8_t*) m->ptr));
+            v = ((v * lo) >> 16) + (v * hi);
+            sum += v;
 
-            break;
+            m->ptr = (uint8_t*) m->ptr + 1;
         }
 
-        case PA_SAMPLE_ULAW: {
-            unsigned channel = 0;
-
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+        *((uint8_t*) data) = (uint8_t) st_14linear2ulaw((int16_t) sum >> 2);
 
-            while (data < end) {
-                int32_t sum = 0;
-                unsigned i;
+        data = (uint8_t*) data + 1;
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t v, hi, lo, cv = m->linear[channel].i;
-
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                    hi = cv >> 16;
-                    lo = cv & 0xFFFF;
+static void pa_mix_alaw_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-                    v = (int32_t) st_ulaw2linear16(*((uint8_t*) m->ptr));
-                    v = ((v * lo) >> 16) + (v * hi);
-                    sum += v;
+    while (data < end) {
+        int32_t sum = 0;
+        unsigned i;
 
-                    m->ptr = (uint8_t*) m->ptr + 1;
-                }
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            int32_t v, hi, lo, cv = m->linear[channel].i;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
-                *((uint8_t*) data) = (uint8_t) st_14linear2ulaw((int16_t) sum >> 2);
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                data = (uint8_t*) data + 1;
+            hi = cv >> 16;
+            lo = cv & 0xFFFF;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+            v = (int32_t) st_alaw2linear16(*((uint8_t*) m->ptr));
+            v = ((v * lo) >> 16) + (v * hi);
+            sum += v;
 
-            break;
+            m->ptr = (uint8_t*) m->ptr + 1;
         }
 
-        case PA_SAMPLE_ALAW: {
-            unsigned channel = 0;
+        sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+        *((uint8_t*) data) = (uint8_t) st_13linear2alaw((int16_t) sum >> 3);
 
-            calc_linear_integer_stream_volumes(streams, nstreams, volume, spec);
+        data = (uint8_t*) data + 1;
 
-            while (data < end) {
-                int32_t sum = 0;
-                unsigned i;
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    int32_t v, hi, lo, cv = m->linear[channel].i;
+static void pa_mix_float32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+    while (data < end) {
+        float sum = 0;
+        unsigned i;
 
-                    hi = cv >> 16;
-                    lo = cv & 0xFFFF;
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            float v, cv = m->linear[channel].f;
 
-                    v = (int32_t) st_alaw2linear16(*((uint8_t*) m->ptr));
-                    v = ((v * lo) >> 16) + (v * hi);
-                    sum += v;
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                    m->ptr = (uint8_t*) m->ptr + 1;
-                }
+            v = *((float*) m->ptr);
+            v *= cv;
+            sum += v;
 
-                sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
-                *((uint8_t*) data) = (uint8_t) st_13linear2alaw((int16_t) sum >> 3);
+            m->ptr = (uint8_t*) m->ptr + sizeof(float);
+        }
 
-                data = (uint8_t*) data + 1;
+        *((float*) data) = sum;
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+        data = (uint8_t*) data + sizeof(float);
 
-            break;
-        }
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-        case PA_SAMPLE_FLOAT32NE: {
-            unsigned channel = 0;
+static void pa_mix_float32re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length) {
+    unsigned channel = 0;
+    void *end = (uint8_t*) data + length;
 
-            calc_linear_float_stream_volumes(streams, nstreams, volume, spec);
+    while (data < end) {
+        float sum = 0;
+        unsigned i;
 
-            while (data < end) {
-                float sum = 0;
-                unsigned i;
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            float v, cv = m->linear[channel].f;
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    float v, cv = m->linear[channel].f;
+            if (PA_UNLIKELY(cv <= 0))
+                continue;
 
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+            v = PA_FLOAT32_SWAP(*(float*) m->ptr);
+            v *= cv;
+            sum += v;
 
-                    v = *((float*) m->ptr);
-                    v *= cv;
-                    sum += v;
+            m->ptr = (uint8_t*) m->ptr + sizeof(float);
+        }
 
-                    m->ptr = (uint8_t*) m->ptr + sizeof(float);
-                }
+        *((float*) data) = PA_FLOAT32_SWAP(sum);
 
-                *((float*) data) = sum;
+        data = (uint8_t*) data + sizeof(float);
 
-                data = (uint8_t*) data + sizeof(float);
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+static pa_do_mix_func_t do_mix_table[] = {
+    [PA_SAMPLE_U8]        = pa_mix_u8_c,
+    [PA_SAMPLE_ALAW]      = pa_mix_alaw_c,
+    [PA_SAMPLE_ULAW]      = pa_mix_ulaw_c,
+    [PA_SAMPLE_S16NE]     = pa_mix_s16ne_c,
+    [PA_SAMPLE_S16RE]     = pa_mix_s16re_c,
+    [PA_SAMPLE_FLOAT32NE] = pa_mix_float32ne_c,
+    [PA_SAMPLE_FLOAT32RE] = pa_mix_float32re_c,
+    [PA_SAMPLE_S32NE]     = pa_mix_s32ne_c,
+    [PA_SAMPLE_S32RE]     = pa_mix_s32re_c,
+    [PA_SAMPLE_S24NE]     = pa_mix_s24ne_c,
+    [PA_SAMPLE_S24RE]     = pa_mix_s24re_c,
+    [PA_SAMPLE_S24_32NE]  = pa_mix_s24_32ne_c,
+    [PA_SAMPLE_S24_32RE]  = pa_mix_s24_32re_c
+};
 
-            break;
-        }
+pa_do_mix_func_t pa_get_mix_func(pa_sample_format_t f) {
+    pa_assert(f >= 0);
+    pa_assert(f < PA_SAMPLE_MAX);
 
-        case PA_SAMPLE_FLOAT32RE: {
-            unsigned channel = 0;
+    return do_mix_table[f];
+}
 
-            calc_linear_float_stream_volumes(streams, nstreams, volume, spec);
+void pa_set_mix_func(pa_sample_format_t f, pa_do_mix_func_t func) {
+    pa_assert(f >= 0);
+    pa_assert(f < PA_SAMPLE_MAX);
 
-            while (data < end) {
-                float sum = 0;
-                unsigned i;
+    do_mix_table[f] = func;
+}
 
-                for (i = 0; i < nstreams; i++) {
-                    pa_mix_info *m = streams + i;
-                    float v, cv = m->linear[channel].f;
+typedef void (*pa_calc_stream_volumes_func_t) (pa_mix_info streams[], unsigned nstreams, const pa_cvolume *volume, const pa_sample_spec *spec);
+
+static const pa_calc_stream_volumes_func_t calc_stream_volumes_table[] = {
+  [PA_SAMPLE_U8]        = calc_linear_integer_stream_volumes,
+  [PA_SAMPLE_ALAW]      = calc_linear_integer_stream_volumes,
+  [PA_SAMPLE_ULAW]      = calc_linear_integer_stream_volumes,
+  [PA_SAMPLE_S16LE]     = calc_linear_integer_stream_volumes,
+  [PA_SAMPLE_S16BE]     = calc_linear_integer_stream_volumes,
+  [PA_SAMPLE_FLOAT32LE] = calc_linear_float_stream_volumes,
+  [PA_SAMPLE_FLOAT32BE] = calc_linear_float_stream_volumes,
+  [PA_SAMPLE_S32LE]     = calc_linear_integer_stream_volumes,
+  [PA_SAMPLE_S32BE]     = calc_linear_integer_stream_volumes,
+  [PA_SAMPLE_S24LE]     = calc_linear_integer_stream_volumes,
+  [PA_SAMPLE_S24BE]     = calc_linear_integer_stream_volumes,
+  [PA_SAMPLE_S24_32LE]  = calc_linear_integer_stream_volumes,
+  [PA_SAMPLE_S24_32BE]  = calc_linear_integer_stream_volumes
+};
 
-                    if (PA_UNLIKELY(cv <= 0))
-                        continue;
+size_t pa_mix(
+        pa_mix_info streams[],
+        unsigned nstreams,
+        void *data,
+        size_t length,
+        const pa_sample_spec *spec,
+        const pa_cvolume *volume,
+        pa_bool_t mute) {
 
-                    v = PA_FLOAT32_SWAP(*(float*) m->ptr);
-                    v *= cv;
-                    sum += v;
+    pa_cvolume full_volume;
+    pa_do_mix_func_t do_mix;
+    unsigned k;
+    unsigned z;
 
-                    m->ptr = (uint8_t*) m->ptr + sizeof(float);
-                }
+    pa_assert(streams);
+    pa_assert(data);
+    pa_assert(length);
+    pa_assert(spec);
 
-                *((float*) data) = PA_FLOAT32_SWAP(sum);
+    if (!volume)
+        volume = pa_cvolume_reset(&full_volume, spec->channels);
 
-                data = (uint8_t*) data + sizeof(float);
+    if (mute || pa_cvolume_is_muted(volume) || nstreams <= 0) {
+        pa_silence_memory(data, length, spec);
+        return length;
+    }
 
-                if (PA_UNLIKELY(++channel >= spec->channels))
-                    channel = 0;
-            }
+    if (!(do_mix = pa_get_mix_func(spec->format))) {
+        pa_log_error("Unable to mix audio data of format %s.", pa_sample_format_to_string(spec->format));
+        pa_assert_not_reached();
+    }
 
-            break;
-        }
+    for (k = 0; k < nstreams; k++)
+        streams[k].ptr = (uint8_t*) pa_memblock_acquire(streams[k].chunk.memblock) + streams[k].chunk.index;
 
-        default:
-            pa_log_error("Unable to mix audio data of format %s.", pa_sample_format_to_string(spec->format));
-            pa_assert_not_reached();
-    }
+    for (z = 0; z < nstreams; z++)
+        if (length > streams[z].chunk.length)
+            length = streams[z].chunk.length;
+
+    calc_stream_volumes_table[spec->format](streams, nstreams, volume, spec);
+    do_mix(streams, nstreams, spec->channels, data, (unsigned) length);
 
     for (k = 0; k < nstreams; k++)
         pa_memblock_release(streams[k].chunk.memblock);
@@ -1066,3 +1081,57 @@ size_t pa_convert_size(size_t size, const pa_sample_spec *from, const pa_sample_
     usec = pa_bytes_to_usec_round_up(size, from);
     return pa_usec_to_bytes_round_up(usec, to);
 }
+
+/* Converts in place if nobody else holds a reference to the block,
+ * which is fine since no sample format is wider than float32 and all
+ * converters read each sample before writing it. Otherwise *buffer
+ * is used as destination and kept around for the next call. */
+void pa_memchunk_convert_from_float32ne(pa_memchunk *c, pa_mempool *pool, pa_sample_format_t f, pa_memblock **buffer) {
+    pa_convert_func_t convert;
+    unsigned n;
+    size_t l;
+    void *src, *dst;
+
+    pa_assert(c);
+    pa_assert(c->memblock);
+    pa_assert(c->length > 0);
+    pa_assert(pool);
+    pa_assert(buffer);
+
+    if (f == PA_SAMPLE_FLOAT32NE)
+        return;
+
+    pa_assert_se(convert = pa_get_convert_from_float32ne_function(f));
+
+    n = (unsigned) (c->length / sizeof(float));
+    l = n * pa_sample_size_of_format(f);
+
+    if (pa_memblock_ref_is_one(c->memblock) && !pa_memblock_is_read_only(c->memblock)) {
+        src = pa_memblock_acquire(c->memblock);
+        convert(n, (uint8_t*) src + c->index, (uint8_t*) src + c->index);
+        pa_memblock_release(c->memblock);
+
+        c->length = l;
+        return;
+    }
+
+    if (*buffer && (!pa_memblock_ref_is_one(*buffer) || pa_memblock_get_length(*buffer) < l)) {
+        pa_memblock_unref(*buffer);
+        *buffer = NULL;
+    }
+
+    if (!*buffer)
+        *buffer = pa_memblock_new(pool, l);
+
+    src = pa_memblock_acquire(c->memblock);
+    dst = pa_memblock_acquire(*buffer);
+    convert(n, (uint8_t*) src + c->index, dst);
+    pa_memblock_release(*buffer);
+    pa_memblock_release(c->memblock);
+
+    pa_memblock_unref(c->memblock);
+
+    c->memblock = pa_memblock_ref(*buffer);
+    c->index = 0;
+    c->length = l;
+}
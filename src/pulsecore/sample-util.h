@@ -42,6 +42,12 @@ pa_memblock* pa_silence_memblock(pa_memblock *b, const pa_sample_spec *spec);
 
 pa_memchunk* pa_silence_memchunk_get(pa_silence_cache *cache, pa_mempool *pool, pa_memchunk* ret, const pa_sample_spec *spec, size_t length);
 
+/* The per-stream volume arrays are padded with this many entries,
+ * repeating the channel volumes, so that optimized mixers can load
+ * the volumes for several consecutive samples at once without having
+ * to wrap around at the end of a frame. */
+#define PA_MIX_VOLUME_PADDING 16
+
 typedef struct pa_mix_info {
     pa_memchunk chunk;
     pa_cvolume volume;
@@ -53,7 +59,7 @@ typedef struct pa_mix_info {
     union {
         int32_t i;
         float f;
-    } linear[PA_CHANNELS_MAX];
+    } linear[PA_CHANNELS_MAX + PA_MIX_VOLUME_PADDING];
 } pa_mix_info;
 
 size_t pa_mix(
@@ -91,8 +97,15 @@ typedef void (*pa_do_volume_func_t) (void *samples, void *volumes, unsigned chan
 pa_do_volume_func_t pa_get_volume_func(pa_sample_format_t f);
 void pa_set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func);
 
+typedef void (*pa_do_mix_func_t) (pa_mix_info streams[], unsigned nstreams, unsigned channels, void *data, unsigned length);
+
+pa_do_mix_func_t pa_get_mix_func(pa_sample_format_t f);
+void pa_set_mix_func(pa_sample_format_t f, pa_do_mix_func_t func);
+
 size_t pa_convert_size(size_t size, const pa_sample_spec *from, const pa_sample_spec *to);
 
+void pa_memchunk_convert_from_float32ne(pa_memchunk *c, pa_mempool *pool, pa_sample_format_t f, pa_memblock **buffer);
+
 #define PA_CHANNEL_POSITION_MASK_LEFT                                   \
     (PA_CHANNEL_POSITION_MASK(PA_CHANNEL_POSITION_FRONT_LEFT)           \
      | PA_CHANNEL_POSITION_MASK(PA_CHANNEL_POSITION_REAR_LEFT)          \
@@ -26,11 +26,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include <pulsecore/g711.h>
 #include <pulsecore/macro.h>
 
 #include "endianmacros.h"
+#include "sconv-s16le.h"
+#include "sconv-s16be.h"
 
 #include "cpu-x86.h"
 #include "sconv.h"
@@ -164,6 +167,507 @@ static void pa_sconv_s16le_from_f32ne_sse2(unsigned n, const float *a, int16_t *
     );
 }
 
+/* The converters below handle a fixed group of samples per asm block
+ * and leave whatever is left at the end to the C implementation they
+ * replace. Since we build with -ffast-math the C code divides by
+ * multiplying with the reciprocal, and so do we, which makes the
+ * results identical to the reference code. x86 is little endian, so NE
+ * is LE and RE is BE here. */
+
+static const PA_DECLARE_ALIGNED (16, float, s16_rscale[4]) = { 1.0f/0x7FFF, 1.0f/0x7FFF, 1.0f/0x7FFF, 1.0f/0x7FFF };
+static const PA_DECLARE_ALIGNED (16, float, s32_frscale[4]) = { 1.0f/0x7FFFFFFF, 1.0f/0x7FFFFFFF, 1.0f/0x7FFFFFFF, 1.0f/0x7FFFFFFF };
+static const PA_DECLARE_ALIGNED (16, double, s32_dscale[2]) = { 0x7FFFFFFF, 0x7FFFFFFF };
+static const PA_DECLARE_ALIGNED (16, double, s32_drscale[2]) = { 1.0/0x7FFFFFFF, 1.0/0x7FFFFFFF };
+static const PA_DECLARE_ALIGNED (16, float, u8_scale[4]) = { 1.0/128.0, 1.0/128.0, 1.0/128.0, 1.0/128.0 };
+static const PA_DECLARE_ALIGNED (16, float, u8_max[4]) = { 255.0, 255.0, 255.0, 255.0 };
+static const PA_DECLARE_ALIGNED (16, float, u8_min[4]) = { 0.0, 0.0, 0.0, 0.0 };
+static const PA_DECLARE_ALIGNED (16, double, u8_dscale[2]) = { 127.0, 127.0 };
+static const PA_DECLARE_ALIGNED (16, double, u8_doffset[2]) = { 128.0, 128.0 };
+static const PA_DECLARE_ALIGNED (16, int16_t, u8_woffset[8]) = { 128, 128, 128, 128, 128, 128, 128, 128 };
+static const PA_DECLARE_ALIGNED (16, uint8_t, u8_boffset[16]) = {
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 };
+
+/* no-op for the templates below */
+#define NOP(r,t)
+
+/* swaps the bytes of every 16 bit word in r, uses t */
+#define SWAP16(r,t)                                                         \
+      " movdqa "#r", "#t"            \n\t"                                  \
+      " psllw $8, "#r"               \n\t"                                  \
+      " psrlw $8, "#t"               \n\t"                                  \
+      " por "#t", "#r"               \n\t"
+
+/* swaps the bytes of every 32 bit word in r, uses t */
+#define SWAP32(r,t)                                                         \
+      " pshuflw $0xb1, "#r", "#r"    \n\t"                                  \
+      " pshufhw $0xb1, "#r", "#r"    \n\t"                                  \
+      SWAP16(r,t)
+
+/* S24_32 is S32 shifted down by 8 bits */
+#define SHL8(r,t)                                                           \
+      " pslld $8, "#r"               \n\t"
+#define SHR8(r,t)                                                           \
+      " psrld $8, "#r"               \n\t"
+#define SWAP32_SHL8(r,t) SWAP32(r,t) SHL8(r,t)
+#define SHR8_SWAP32(r,t) SHR8(r,t) SWAP32(r,t)
+
+/* s16 -> float, 8 samples at a time */
+#define DEFINE_S16_TO_FLOAT(name, pre, post, tail)                          \
+static void name(unsigned n, const int16_t *a, float *b) {                  \
+    for (; n >= 8; n -= 8, a += 8, b += 8)                                  \
+        __asm__ __volatile__ (                                              \
+            " movdqu (%0), %%xmm0          \n\t"                            \
+            pre(%%xmm0, %%xmm2)                                             \
+            " movdqa %%xmm0, %%xmm1        \n\t"                            \
+            " punpcklwd %%xmm0, %%xmm0     \n\t"                            \
+            " punpckhwd %%xmm1, %%xmm1     \n\t"                            \
+            " psrad $16, %%xmm0            \n\t" /* sign extend */          \
+            " psrad $16, %%xmm1            \n\t"                            \
+            " cvtdq2ps %%xmm0, %%xmm0      \n\t"                            \
+            " cvtdq2ps %%xmm1, %%xmm1      \n\t"                            \
+            " mulps %2, %%xmm0             \n\t" /* /= 0x7fff */            \
+            " mulps %2, %%xmm1             \n\t"                            \
+            post(%%xmm0, %%xmm2)                                            \
+            post(%%xmm1, %%xmm2)                                            \
+            " movups %%xmm0, (%1)          \n\t"                            \
+            " movups %%xmm1, 16(%1)        \n\t"                            \
+            :                                                               \
+            : "r" (a), "r" (b), "m" (*s16_rscale)                           \
+            : "memory", "xmm0", "xmm1", "xmm2"                              \
+        );                                                                  \
+                                                                            \
+    tail(n, (const void *) a, (void *) b);                                  \
+}
+
+/* float -> s16, 8 samples at a time */
+#define DEFINE_FLOAT_TO_S16(name, pre, post, tail)                          \
+static void name(unsigned n, const float *a, int16_t *b) {                  \
+    for (; n >= 8; n -= 8, a += 8, b += 8)                                  \
+        __asm__ __volatile__ (                                              \
+            " movups (%0), %%xmm0          \n\t"                            \
+            " movups 16(%0), %%xmm1        \n\t"                            \
+            pre(%%xmm0, %%xmm2)                                             \
+            pre(%%xmm1, %%xmm2)                                             \
+            " minps %2, %%xmm0             \n\t" /* clamp to 1.0 */         \
+            " minps %2, %%xmm1             \n\t"                            \
+            " maxps %3, %%xmm0             \n\t" /* clamp to -1.0 */        \
+            " maxps %3, %%xmm1             \n\t"                            \
+            " mulps %4, %%xmm0             \n\t" /* *= 0x7fff */            \
+            " mulps %4, %%xmm1             \n\t"                            \
+            " cvtps2dq %%xmm0, %%xmm0      \n\t"                            \
+            " cvtps2dq %%xmm1, %%xmm1      \n\t"                            \
+            " packssdw %%xmm1, %%xmm0      \n\t"                            \
+            post(%%xmm0, %%xmm2)                                            \
+            " movdqu %%xmm0, (%1)          \n\t"                            \
+            :                                                               \
+            : "r" (a), "r" (b), "m" (*one), "m" (*mone), "m" (*scale)       \
+            : "memory", "xmm0", "xmm1", "xmm2"                              \
+        );                                                                  \
+                                                                            \
+    tail(n, (const void *) a, (void *) b);                                  \
+}
+
+/* s32 -> float, 4 samples at a time. The scaling is done in double
+ * precision like in the C version */
+#define DEFINE_S32_TO_FLOAT(name, pre, tail)                                \
+static void name(unsigned n, const int32_t *a, float *b) {                  \
+    for (; n >= 4; n -= 4, a += 4, b += 4)                                  \
+        __asm__ __volatile__ (                                              \
+            " movdqu (%0), %%xmm0          \n\t"                            \
+            pre(%%xmm0, %%xmm2)                                             \
+            " pshufd $0xee, %%xmm0, %%xmm1 \n\t" /* high part to low */     \
+            " cvtdq2pd %%xmm0, %%xmm0      \n\t"                            \
+            " cvtdq2pd %%xmm1, %%xmm1      \n\t"                            \
+            " mulpd %2, %%xmm0             \n\t" /* /= 0x7fffffff */        \
+            " mulpd %2, %%xmm1             \n\t"                            \
+            " cvtpd2ps %%xmm0, %%xmm0      \n\t"                            \
+            " cvtpd2ps %%xmm1, %%xmm1      \n\t"                            \
+            " movlhps %%xmm1, %%xmm0       \n\t"                            \
+            " movups %%xmm0, (%1)          \n\t"                            \
+            :                                                               \
+            : "r" (a), "r" (b), "m" (*s32_drscale)                          \
+            : "memory", "xmm0", "xmm1", "xmm2"                              \
+        );                                                                  \
+                                                                            \
+    tail(n, (const void *) a, (void *) b);                                  \
+}
+
+/* float -> s32 and s24_32, 4 samples at a time, multiplication in
+ * double precision */
+#define FLOAT_TO_S32_BODY                                                   \
+            " movups (%0), %%xmm0          \n\t"                            \
+            " minps %2, %%xmm0             \n\t" /* clamp to 1.0 */         \
+            " maxps %3, %%xmm0             \n\t" /* clamp to -1.0 */        \
+            " movhlps %%xmm0, %%xmm1       \n\t" /* high part to low */     \
+            " cvtps2pd %%xmm0, %%xmm0      \n\t"                            \
+            " cvtps2pd %%xmm1, %%xmm1      \n\t"                            \
+            " mulpd %4, %%xmm0             \n\t" /* *= 0x7fffffff */        \
+            " mulpd %4, %%xmm1             \n\t"                            \
+            " cvtpd2dq %%xmm0, %%xmm0      \n\t"                            \
+            " cvtpd2dq %%xmm1, %%xmm1      \n\t"                            \
+            " punpcklqdq %%xmm1, %%xmm0    \n\t"
+
+#define DEFINE_FLOAT_TO_S32(name, type, post, tail)                         \
+static void name(unsigned n, const float *a, type *b) {                     \
+    for (; n >= 4; n -= 4, a += 4, b += 4)                                  \
+        __asm__ __volatile__ (                                              \
+            FLOAT_TO_S32_BODY                                               \
+            post(%%xmm0, %%xmm2)                                            \
+            " movdqu %%xmm0, (%1)          \n\t"                            \
+            :                                                               \
+            : "r" (a), "r" (b), "m" (*one), "m" (*mone), "m" (*s32_dscale)  \
+            : "memory", "xmm0", "xmm1", "xmm2"                              \
+        );                                                                  \
+                                                                            \
+    tail(n, (const void *) a, (void *) b);                                  \
+}
+
+/* s24_32 -> float, 4 samples at a time */
+#define DEFINE_S24_32_TO_FLOAT(name, pre, tail)                             \
+static void name(unsigned n, const uint32_t *a, float *b) {                 \
+    for (; n >= 4; n -= 4, a += 4, b += 4)                                  \
+        __asm__ __volatile__ (                                              \
+            " movdqu (%0), %%xmm0          \n\t"                            \
+            pre(%%xmm0, %%xmm2)                                             \
+            " pslld $8, %%xmm0             \n\t"                            \
+            " cvtdq2ps %%xmm0, %%xmm0      \n\t"                            \
+            " mulps %2, %%xmm0             \n\t" /* /= 0x7fffffff */        \
+            " movups %%xmm0, (%1)          \n\t"                            \
+            :                                                               \
+            : "r" (a), "r" (b), "m" (*s32_frscale)                          \
+            : "memory", "xmm0", "xmm2"                                      \
+        );                                                                  \
+                                                                            \
+    tail(n, (const void *) a, (void *) b);                                  \
+}
+
+/* s32 and s24_32 -> s16, 8 samples at a time */
+#define DEFINE_S32_TO_S16(name, type, pre, tail)                            \
+static void name(unsigned n, const type *a, int16_t *b) {                   \
+    for (; n >= 8; n -= 8, a += 8, b += 8)                                  \
+        __asm__ __volatile__ (                                              \
+            " movdqu (%0), %%xmm0          \n\t"                            \
+            " movdqu 16(%0), %%xmm1        \n\t"                            \
+            pre(%%xmm0, %%xmm2)                                             \
+            pre(%%xmm1, %%xmm2)                                             \
+            " psrad $16, %%xmm0            \n\t"                            \
+            " psrad $16, %%xmm1            \n\t"                            \
+            " packssdw %%xmm1, %%xmm0      \n\t"                            \
+            " movdqu %%xmm0, (%1)          \n\t"                            \
+            :                                                               \
+            : "r" (a), "r" (b)                                              \
+            : "memory", "xmm0", "xmm1", "xmm2"                              \
+        );                                                                  \
+                                                                            \
+    tail(n, (const void *) a, (void *) b);                                  \
+}
+
+/* s16 -> s32 and s24_32, 8 samples at a time */
+#define DEFINE_S16_TO_S32(name, type, post, tail)                           \
+static void name(unsigned n, const int16_t *a, type *b) {                   \
+    for (; n >= 8; n -= 8, a += 8, b += 8)                                  \
+        __asm__ __volatile__ (                                              \
+            " movdqu (%0), %%xmm0          \n\t"                            \
+            " pxor %%xmm1, %%xmm1          \n\t"                            \
+            " pxor %%xmm2, %%xmm2          \n\t"                            \
+            " punpcklwd %%xmm0, %%xmm1     \n\t" /* s << 16 */              \
+            " punpckhwd %%xmm0, %%xmm2     \n\t"                            \
+            post(%%xmm1, %%xmm3)                                            \
+            post(%%xmm2, %%xmm3)                                            \
+            " movdqu %%xmm1, (%1)          \n\t"                            \
+            " movdqu %%xmm2, 16(%1)        \n\t"                            \
+            :                                                               \
+            : "r" (a), "r" (b)                                              \
+            : "memory", "xmm0", "xmm1", "xmm2", "xmm3"                      \
+        );                                                                  \
+                                                                            \
+    tail(n, (const void *) a, (void *) b);                                  \
+}
+
+DEFINE_S16_TO_FLOAT(s16le_to_float32ne_sse2, NOP, NOP, pa_sconv_s16le_to_float32ne)
+DEFINE_S16_TO_FLOAT(s16be_to_float32ne_sse2, SWAP16, NOP, pa_sconv_s16be_to_float32ne)
+DEFINE_S16_TO_FLOAT(s16le_to_float32re_sse2, NOP, SWAP32, pa_sconv_s16le_to_float32re)
+
+DEFINE_FLOAT_TO_S16(s16be_from_float32ne_sse2, NOP, SWAP16, pa_sconv_s16be_from_float32ne)
+DEFINE_FLOAT_TO_S16(s16le_from_float32re_sse2, SWAP32, NOP, pa_sconv_s16le_from_float32re)
+
+DEFINE_S32_TO_FLOAT(s32le_to_float32ne_sse2, NOP, pa_sconv_s32le_to_float32ne)
+DEFINE_S32_TO_FLOAT(s32be_to_float32ne_sse2, SWAP32, pa_sconv_s32be_to_float32ne)
+
+DEFINE_FLOAT_TO_S32(s32le_from_float32ne_sse2, int32_t, NOP, pa_sconv_s32le_from_float32ne)
+DEFINE_FLOAT_TO_S32(s32be_from_float32ne_sse2, int32_t, SWAP32, pa_sconv_s32be_from_float32ne)
+DEFINE_FLOAT_TO_S32(s24_32le_from_float32ne_sse2, uint32_t, SHR8, pa_sconv_s24_32le_from_float32ne)
+DEFINE_FLOAT_TO_S32(s24_32be_from_float32ne_sse2, uint32_t, SHR8_SWAP32, pa_sconv_s24_32be_from_float32ne)
+
+DEFINE_S24_32_TO_FLOAT(s24_32le_to_float32ne_sse2, NOP, pa_sconv_s24_32le_to_float32ne)
+DEFINE_S24_32_TO_FLOAT(s24_32be_to_float32ne_sse2, SWAP32, pa_sconv_s24_32be_to_float32ne)
+
+DEFINE_S32_TO_S16(s32le_to_s16ne_sse2, int32_t, NOP, pa_sconv_s32le_to_s16ne)
+DEFINE_S32_TO_S16(s32be_to_s16ne_sse2, int32_t, SWAP32, pa_sconv_s32be_to_s16ne)
+DEFINE_S32_TO_S16(s24_32le_to_s16ne_sse2, uint32_t, SHL8, pa_sconv_s24_32le_to_s16ne)
+DEFINE_S32_TO_S16(s24_32be_to_s16ne_sse2, uint32_t, SWAP32_SHL8, pa_sconv_s24_32be_to_s16ne)
+
+DEFINE_S16_TO_S32(s32le_from_s16ne_sse2, int32_t, NOP, pa_sconv_s32le_from_s16ne)
+DEFINE_S16_TO_S32(s32be_from_s16ne_sse2, int32_t, SWAP32, pa_sconv_s32be_from_s16ne)
+DEFINE_S16_TO_S32(s24_32le_from_s16ne_sse2, uint32_t, SHR8, pa_sconv_s24_32le_from_s16ne)
+DEFINE_S16_TO_S32(s24_32be_from_s16ne_sse2, uint32_t, SHR8_SWAP32, pa_sconv_s24_32be_from_s16ne)
+
+/* float32re <-> float32ne, 8 samples at a time */
+static void float32re_to_float32ne_sse2(unsigned n, const uint32_t *a, uint32_t *b) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        __asm__ __volatile__ (
+            " movdqu (%0), %%xmm0          \n\t"
+            " movdqu 16(%0), %%xmm1        \n\t"
+            SWAP32(%%xmm0, %%xmm2)
+            SWAP32(%%xmm1, %%xmm2)
+            " movdqu %%xmm0, (%1)          \n\t"
+            " movdqu %%xmm1, 16(%1)        \n\t"
+            :
+            : "r" (a), "r" (b)
+            : "memory", "xmm0", "xmm1", "xmm2"
+        );
+
+    for (; n > 0; n--, a++, b++)
+        *b = PA_UINT32_SWAP(*a);
+}
+
+/* s16re <-> s16ne, 16 samples at a time */
+static void s16re_to_s16ne_sse2(unsigned n, const int16_t *a, int16_t *b) {
+
+    for (; n >= 16; n -= 16, a += 16, b += 16)
+        __asm__ __volatile__ (
+            " movdqu (%0), %%xmm0          \n\t"
+            " movdqu 16(%0), %%xmm1        \n\t"
+            SWAP16(%%xmm0, %%xmm2)
+            SWAP16(%%xmm1, %%xmm2)
+            " movdqu %%xmm0, (%1)          \n\t"
+            " movdqu %%xmm1, 16(%1)        \n\t"
+            :
+            : "r" (a), "r" (b)
+            : "memory", "xmm0", "xmm1", "xmm2"
+        );
+
+    for (; n > 0; n--, a++, b++)
+        *b = PA_INT16_SWAP(*a);
+}
+
+/* u8 -> float, 8 samples at a time. (x - 128) / 128 is exact in
+ * single precision, so this matches the double precision C code */
+static void u8_to_float32ne_sse2(unsigned n, const uint8_t *a, float *b) {
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        __asm__ __volatile__ (
+            " movq (%0), %%xmm0            \n\t"
+            " pxor %%xmm1, %%xmm1          \n\t"
+            " punpcklbw %%xmm1, %%xmm0     \n\t" /* to 16 bit */
+            " psubw %2, %%xmm0             \n\t" /* -= 128 */
+            " movdqa %%xmm0, %%xmm1        \n\t"
+            " punpcklwd %%xmm0, %%xmm0     \n\t"
+            " punpckhwd %%xmm1, %%xmm1     \n\t"
+            " psrad $16, %%xmm0            \n\t" /* sign extend */
+            " psrad $16, %%xmm1            \n\t"
+            " cvtdq2ps %%xmm0, %%xmm0      \n\t"
+            " cvtdq2ps %%xmm1, %%xmm1      \n\t"
+            " mulps %3, %%xmm0             \n\t" /* /= 128 */
+            " mulps %3, %%xmm1             \n\t"
+            " movups %%xmm0, (%1)          \n\t"
+            " movups %%xmm1, 16(%1)        \n\t"
+            :
+            : "r" (a), "r" (b), "m" (*u8_woffset), "m" (*u8_scale)
+            : "memory", "xmm0", "xmm1"
+        );
+
+    for (; n > 0; n--, a++, b++)
+        *b = (*a * 1.0/128.0) - 1.0;
+}
+
+/* float -> u8, 8 samples at a time, scaled in double precision */
+static void u8_from_float32ne_sse2(unsigned n, const float *a, uint8_t *b) {
+
+#define FLOAT_TO_U8(src, r, t)                                              \
+            " movups "#src", "#r"          \n\t"                            \
+            " movhlps "#r", "#t"           \n\t"                            \
+            " cvtps2pd "#r", "#r"          \n\t"                            \
+            " cvtps2pd "#t", "#t"          \n\t"                            \
+            " mulpd %2, "#r"               \n\t" /* *= 127 */               \
+            " mulpd %2, "#t"               \n\t"                            \
+            " addpd %3, "#r"               \n\t" /* += 128 */               \
+            " addpd %3, "#t"               \n\t"                            \
+            " cvtpd2ps "#r", "#r"          \n\t"                            \
+            " cvtpd2ps "#t", "#t"          \n\t"                            \
+            " movlhps "#t", "#r"           \n\t"                            \
+            " maxps %4, "#r"               \n\t" /* clamp to 0 */           \
+            " minps %5, "#r"               \n\t" /* clamp to 255 */         \
+            " cvtps2dq "#r", "#r"          \n\t"
+
+    for (; n >= 8; n -= 8, a += 8, b += 8)
+        __asm__ __volatile__ (
+            FLOAT_TO_U8((%0), %%xmm0, %%xmm1)
+            FLOAT_TO_U8(16(%0), %%xmm2, %%xmm3)
+            " packssdw %%xmm2, %%xmm0      \n\t"
+            " packuswb %%xmm0, %%xmm0      \n\t"
+            " movq %%xmm0, (%1)            \n\t"
+            :
+            : "r" (a), "r" (b), "m" (*u8_dscale), "m" (*u8_doffset), "m" (*u8_min), "m" (*u8_max)
+            : "memory", "xmm0", "xmm1", "xmm2", "xmm3"
+        );
+
+#undef FLOAT_TO_U8
+
+    for (; n > 0; n--, a++, b++) {
+        float v;
+        v = (*a * 127.0) + 128.0;
+        v = PA_CLAMP_UNLIKELY (v, 0.0, 255.0);
+        *b = rint (v);
+    }
+}
+
+/* u8 -> s16, 16 samples at a time */
+static void u8_to_s16ne_sse2(unsigned n, const uint8_t *a, int16_t *b) {
+
+    for (; n >= 16; n -= 16, a += 16, b += 16)
+        __asm__ __volatile__ (
+            " movdqu (%0), %%xmm0          \n\t"
+            " pxor %%xmm2, %%xmm2          \n\t"
+            " movdqa %%xmm0, %%xmm1        \n\t"
+            " punpcklbw %%xmm2, %%xmm0     \n\t" /* to 16 bit */
+            " punpckhbw %%xmm2, %%xmm1     \n\t"
+            " psubw %2, %%xmm0             \n\t" /* -= 128 */
+            " psubw %2, %%xmm1             \n\t"
+            " psllw $8, %%xmm0             \n\t"
+            " psllw $8, %%xmm1             \n\t"
+            " movdqu %%xmm0, (%1)          \n\t"
+            " movdqu %%xmm1, 16(%1)        \n\t"
+            :
+            : "r" (a), "r" (b), "m" (*u8_woffset)
+            : "memory", "xmm0", "xmm1", "xmm2"
+        );
+
+    for (; n > 0; n--, a++, b++)
+        *b = (((int16_t)*a) - 128) << 8;
+}
+
+/* s16 -> u8, 16 samples at a time */
+static void u8_from_s16ne_sse2(unsigned n, const int16_t *a, uint8_t *b) {
+
+    for (; n >= 16; n -= 16, a += 16, b += 16)
+        __asm__ __volatile__ (
+            " movdqu (%0), %%xmm0          \n\t"
+            " movdqu 16(%0), %%xmm1        \n\t"
+            " psrlw $8, %%xmm0             \n\t"
+            " psrlw $8, %%xmm1             \n\t"
+            " packuswb %%xmm1, %%xmm0      \n\t"
+            " paddb %2, %%xmm0             \n\t" /* += 0x80 */
+            " movdqu %%xmm0, (%1)          \n\t"
+            :
+            : "r" (a), "r" (b), "m" (*u8_boffset)
+            : "memory", "xmm0", "xmm1"
+        );
+
+    for (; n > 0; n--, a++, b++)
+        *b = (uint8_t) ((uint16_t) *a >> 8) + (uint8_t) 0x80U;
+}
+
+/* Packed 24 bit samples need a byte shuffle, so these are SSSE3
+ * only. The loads read 16 bytes for 4 samples, hence the loops stop
+ * early enough to never read past the end of the input. */
+
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24le_to_s32_mask[16]) = {
+    0x80, 0, 1, 2, 0x80, 3, 4, 5, 0x80, 6, 7, 8, 0x80, 9, 10, 11 };
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24be_to_s32_mask[16]) = {
+    0x80, 2, 1, 0, 0x80, 5, 4, 3, 0x80, 8, 7, 6, 0x80, 11, 10, 9 };
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24le_from_s32_mask[16]) = {
+    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 0x80, 0x80, 0x80, 0x80 };
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24be_from_s32_mask[16]) = {
+    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, 0x80, 0x80, 0x80, 0x80 };
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24le_to_s16_mask[16]) = {
+    1, 2, 4, 5, 7, 8, 10, 11, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 };
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24be_to_s16_mask[16]) = {
+    1, 0, 4, 3, 7, 6, 10, 9, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 };
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24le_from_s16_mask[16]) = {
+    0x80, 0, 1, 0x80, 2, 3, 0x80, 4, 5, 0x80, 6, 7, 0x80, 0x80, 0x80, 0x80 };
+static const PA_DECLARE_ALIGNED (16, uint8_t, s24be_from_s16_mask[16]) = {
+    1, 0, 0x80, 3, 2, 0x80, 5, 4, 0x80, 7, 6, 0x80, 0x80, 0x80, 0x80, 0x80 };
+
+/* stores the low 12 bytes of r */
+#define STORE24(r, dst)                                                     \
+            " movq "#r", "#dst"            \n\t"                            \
+            " psrldq $8, "#r"              \n\t"                            \
+            " movd "#r", 8"#dst"           \n\t"
+
+#define DEFINE_S24_TO_FLOAT(name, mask, tail)                               \
+static void name(unsigned n, const uint8_t *a, float *b) {                  \
+    for (; n >= 6; n -= 4, a += 12, b += 4)                                 \
+        __asm__ __volatile__ (                                              \
+            " movdqu (%0), %%xmm0          \n\t"                            \
+            " pshufb %2, %%xmm0            \n\t" /* s << 8 */               \
+            " cvtdq2ps %%xmm0, %%xmm0      \n\t"                            \
+            " mulps %3, %%xmm0             \n\t" /* /= 0x7fffffff */        \
+            " movups %%xmm0, (%1)          \n\t"                            \
+            :                                                               \
+            : "r" (a), "r" (b), "m" (*mask), "m" (*s32_frscale)             \
+            : "memory", "xmm0"                                              \
+        );                                                                  \
+                                                                            \
+    tail(n, (const void *) a, (void *) b);                                  \
+}
+
+#define DEFINE_S24_FROM_FLOAT(name, mask, tail)                             \
+static void name(unsigned n, const float *a, uint8_t *b) {                  \
+    for (; n >= 4; n -= 4, a += 4, b += 12)                                 \
+        __asm__ __volatile__ (                                              \
+            FLOAT_TO_S32_BODY                                               \
+            " psrld $8, %%xmm0             \n\t"                            \
+            " pshufb %5, %%xmm0            \n\t"                            \
+            STORE24(%%xmm0, (%1))                                           \
+            :                                                               \
+            : "r" (a), "r" (b), "m" (*one), "m" (*mone), "m" (*s32_dscale), "m" (*mask) \
+            : "memory", "xmm0", "xmm1"                                      \
+        );                                                                  \
+                                                                            \
+    tail(n, (const void *) a, (void *) b);                                  \
+}
+
+#define DEFINE_S24_TO_S16(name, mask, tail)                                 \
+static void name(unsigned n, const uint8_t *a, int16_t *b) {                \
+    for (; n >= 6; n -= 4, a += 12, b += 4)                                 \
+        __asm__ __volatile__ (                                              \
+            " movdqu (%0), %%xmm0          \n\t"                            \
+            " pshufb %2, %%xmm0            \n\t"                            \
+            " movq %%xmm0, (%1)            \n\t"                            \
+            :                                                               \
+            : "r" (a), "r" (b), "m" (*mask)                                 \
+            : "memory", "xmm0"                                              \
+        );                                                                  \
+                                                                            \
+    tail(n, (const void *) a, (void *) b);                                  \
+}
+
+#define DEFINE_S24_FROM_S16(name, mask, tail)                               \
+static void name(unsigned n, const int16_t *a, uint8_t *b) {                \
+    for (; n >= 4; n -= 4, a += 4, b += 12)                                 \
+        __asm__ __volatile__ (                                              \
+            " movq (%0), %%xmm0            \n\t"                            \
+            " pshufb %2, %%xmm0            \n\t"                            \
+            STORE24(%%xmm0, (%1))                                           \
+            :                                                               \
+            : "r" (a), "r" (b), "m" (*mask)                                 \
+            : "memory", "xmm0"                                              \
+        );                                                                  \
+                                                                            \
+    tail(n, (const void *) a, (void *) b);                                  \
+}
+
+DEFINE_S24_TO_FLOAT(s24le_to_float32ne_ssse3, s24le_to_s32_mask, pa_sconv_s24le_to_float32ne)
+DEFINE_S24_TO_FLOAT(s24be_to_float32ne_ssse3, s24be_to_s32_mask, pa_sconv_s24be_to_float32ne)
+DEFINE_S24_FROM_FLOAT(s24le_from_float32ne_ssse3, s24le_from_s32_mask, pa_sconv_s24le_from_float32ne)
+DEFINE_S24_FROM_FLOAT(s24be_from_float32ne_ssse3, s24be_from_s32_mask, pa_sconv_s24be_from_float32ne)
+DEFINE_S24_TO_S16(s24le_to_s16ne_ssse3, s24le_to_s16_mask, pa_sconv_s24le_to_s16ne)
+DEFINE_S24_TO_S16(s24be_to_s16ne_ssse3, s24be_to_s16_mask, pa_sconv_s24be_to_s16ne)
+DEFINE_S24_FROM_S16(s24le_from_s16ne_ssse3, s24le_from_s16_mask, pa_sconv_s24le_from_s16ne)
+DEFINE_S24_FROM_S16(s24be_from_s16ne_ssse3, s24be_from_s16_mask, pa_sconv_s24be_from_s16ne)
+
 #undef RUN_TEST
 
 #ifdef RUN_TEST
@@ -231,5 +735,54 @@ void pa_convert_func_init_sse (pa_cpu_x86_flag_t flags) {
         pa_set_convert_from_float32ne_function (PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse);
     }
 
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_set_convert_to_float32ne_function (PA_SAMPLE_U8, (pa_convert_func_t) u8_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function (PA_SAMPLE_S16LE, (pa_convert_func_t) s16le_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function (PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function (PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function (PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function (PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function (PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_to_float32ne_sse2);
+        pa_set_convert_to_float32ne_function (PA_SAMPLE_FLOAT32RE, (pa_convert_func_t) float32re_to_float32ne_sse2);
+
+        pa_set_convert_from_float32ne_function (PA_SAMPLE_U8, (pa_convert_func_t) u8_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function (PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function (PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function (PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function (PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function (PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_from_float32ne_sse2);
+        pa_set_convert_from_float32ne_function (PA_SAMPLE_FLOAT32RE, (pa_convert_func_t) float32re_to_float32ne_sse2);
+
+        pa_set_convert_to_s16ne_function (PA_SAMPLE_U8, (pa_convert_func_t) u8_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function (PA_SAMPLE_S16RE, (pa_convert_func_t) s16re_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function (PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse2);
+        pa_set_convert_to_s16ne_function (PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) s16le_from_float32re_sse2);
+        pa_set_convert_to_s16ne_function (PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function (PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function (PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function (PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_to_s16ne_sse2);
+
+        pa_set_convert_from_s16ne_function (PA_SAMPLE_U8, (pa_convert_func_t) u8_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function (PA_SAMPLE_S16RE, (pa_convert_func_t) s16re_to_s16ne_sse2);
+        pa_set_convert_from_s16ne_function (PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) s16le_to_float32ne_sse2);
+        pa_set_convert_from_s16ne_function (PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) s16le_to_float32re_sse2);
+        pa_set_convert_from_s16ne_function (PA_SAMPLE_S32LE, (pa_convert_func_t) s32le_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function (PA_SAMPLE_S32BE, (pa_convert_func_t) s32be_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function (PA_SAMPLE_S24_32LE, (pa_convert_func_t) s24_32le_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function (PA_SAMPLE_S24_32BE, (pa_convert_func_t) s24_32be_from_s16ne_sse2);
+    }
+
+    if (flags & PA_CPU_X86_SSSE3) {
+        pa_log_info("Initialising SSSE3 optimized conversions.");
+        pa_set_convert_to_float32ne_function (PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_to_float32ne_ssse3);
+        pa_set_convert_to_float32ne_function (PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_to_float32ne_ssse3);
+        pa_set_convert_from_float32ne_function (PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_from_float32ne_ssse3);
+        pa_set_convert_from_float32ne_function (PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_from_float32ne_ssse3);
+        pa_set_convert_to_s16ne_function (PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_to_s16ne_ssse3);
+        pa_set_convert_to_s16ne_function (PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_to_s16ne_ssse3);
+        pa_set_convert_from_s16ne_function (PA_SAMPLE_S24LE, (pa_convert_func_t) s24le_from_s16ne_ssse3);
+        pa_set_convert_from_s16ne_function (PA_SAMPLE_S24BE, (pa_convert_func_t) s24be_from_s16ne_ssse3);
+    }
+
 #endif /* defined (__i386__) || defined (__amd64__) */
 }
@@ -35,6 +35,10 @@
 #include <dirent.h>
 #include <signal.h>
 
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+
 #ifdef HAVE_SYS_MMAN_H
 #include <sys/mman.h>
 #endif
@@ -74,6 +78,34 @@
 
 #define SHM_MARKER ((int) 0xbeefcafe)
 
+#if defined(__linux__) && defined(__NR_memfd_create)
+#define HAVE_MEMFD 1
+
+/* Older C libraries don't know about memfd yet */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#endif
+#ifndef F_SEAL_SEAL
+#define F_SEAL_SEAL 0x0001
+#endif
+#ifndef F_SEAL_SHRINK
+#define F_SEAL_SHRINK 0x0002
+#endif
+#ifndef F_SEAL_GROW
+#define F_SEAL_GROW 0x0004
+#endif
+
+static int memfd_create_wrapper(const char *name, unsigned flags) {
+    return (int) syscall(__NR_memfd_create, name, flags);
+}
+#endif
+
 /* We now put this SHM marker at the end of each segment. It's
  * optional, to not require a reboot when upgrading, though. Note that
  * on multiarch systems 32bit and 64bit processes might access this
@@ -111,6 +143,9 @@ int pa_shm_create_rw(pa_shm *m, size_t size, pa_bool_t shared, mode_t mode) {
     /* Round up to make it page aligned */
     size = PA_PAGE_ALIGN(size);
 
+    m->fd = -1;
+    m->memfd = FALSE;
+
     if (!shared) {
         m->id = 0;
         m->size = size;
@@ -206,6 +241,11 @@ void pa_shm_free(pa_shm *m) {
 #else
         pa_xfree(m->ptr);
 #endif
+    } else if (m->memfd) {
+        if (munmap(m->ptr, PA_PAGE_ALIGN(m->size)) < 0)
+            pa_log("munmap() failed: %s", pa_cstrerror(errno));
+
+        pa_assert_se(pa_close(m->fd) == 0);
     } else {
 #ifdef HAVE_SHM_OPEN
         if (munmap(m->ptr, PA_PAGE_ALIGN(m->size)) < 0)
@@ -310,8 +350,10 @@ int pa_shm_attach_ro(pa_shm *m, unsigned id) {
         goto fail;
     }
 
+    m->fd = -1;
     m->do_unlink = FALSE;
     m->shared = TRUE;
+    m->memfd = FALSE;
 
     pa_assert_se(pa_close(fd) == 0);
 
@@ -332,6 +374,121 @@ int pa_shm_attach_ro(pa_shm *m, unsigned id) {
 
 #endif /* HAVE_SHM_OPEN */
 
+pa_bool_t pa_shm_memfd_supported(void) {
+#ifdef HAVE_MEMFD
+    static int supported = -1;
+    int fd;
+
+    if (supported >= 0)
+        return !!supported;
+
+    if ((fd = memfd_create_wrapper("pulseaudio-probe", MFD_CLOEXEC)) < 0)
+        supported = 0;
+    else {
+        pa_close(fd);
+        supported = 1;
+    }
+
+    return !!supported;
+#else
+    return FALSE;
+#endif
+}
+
+#ifdef HAVE_MEMFD
+
+int pa_shm_create_memfd_rw(pa_shm *m, size_t size) {
+    int fd;
+
+    pa_assert(m);
+    pa_assert(size > 0);
+    pa_assert(size <= MAX_SHM_SIZE);
+
+    size = PA_PAGE_ALIGN(size);
+
+    if ((fd = memfd_create_wrapper("pulseaudio", MFD_CLOEXEC|MFD_ALLOW_SEALING)) < 0) {
+        pa_log("memfd_create() failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    if (ftruncate(fd, (off_t) size) < 0) {
+        pa_log("ftruncate() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    /* Make sure the peer can rely on the size it sees when mapping
+     * the segment: nobody may resize it from now on. */
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_SEAL) < 0)
+        pa_log_debug("Failed to seal memfd segment: %s", pa_cstrerror(errno));
+
+    if ((m->ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, (off_t) 0)) == MAP_FAILED) {
+        pa_log("mmap() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    /* memfd segments have no name, the ID is only used to refer to
+     * them in the protocol once the fd has been passed along */
+    pa_random(&m->id, sizeof(m->id));
+    m->size = size;
+    m->fd = fd;
+    m->do_unlink = FALSE;
+    m->shared = TRUE;
+    m->memfd = TRUE;
+
+    return 0;
+
+fail:
+    pa_close(fd);
+    return -1;
+}
+
+int pa_shm_attach_memfd_ro(pa_shm *m, unsigned id, int fd) {
+    struct stat st;
+
+    pa_assert(m);
+    pa_assert(fd >= 0);
+
+    if (fstat(fd, &st) < 0) {
+        pa_log("fstat() failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    if (st.st_size <= 0 ||
+        st.st_size > (off_t) MAX_SHM_SIZE ||
+        PA_ALIGN((size_t) st.st_size) != (size_t) st.st_size) {
+        pa_log("Invalid shared memory segment size");
+        return -1;
+    }
+
+    m->size = (size_t) st.st_size;
+
+    if ((m->ptr = mmap(NULL, PA_PAGE_ALIGN(m->size), PROT_READ, MAP_SHARED, fd, (off_t) 0)) == MAP_FAILED) {
+        pa_log("mmap() failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    /* We take over the fd from the caller */
+    m->id = id;
+    m->fd = fd;
+    m->do_unlink = FALSE;
+    m->shared = TRUE;
+    m->memfd = TRUE;
+
+    return 0;
+}
+
+#else /* HAVE_MEMFD */
+
+int pa_shm_create_memfd_rw(pa_shm *m, size_t size) {
+    return -1;
+}
+
+int pa_shm_attach_memfd_ro(pa_shm *m, unsigned id, int fd) {
+    return -1;
+}
+
+#endif /* HAVE_MEMFD */
+
 int pa_shm_cleanup(void) {
 
 #ifdef HAVE_SHM_OPEN
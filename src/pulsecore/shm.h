@@ -30,13 +30,22 @@ typedef struct pa_shm {
     unsigned id;
     void *ptr;
     size_t size;
+    int fd; /* only valid for memfd segments, -1 otherwise */
     pa_bool_t do_unlink:1;
     pa_bool_t shared:1;
+    pa_bool_t memfd:1;
 } pa_shm;
 
 int pa_shm_create_rw(pa_shm *m, size_t size, pa_bool_t shared, mode_t mode);
 int pa_shm_attach_ro(pa_shm *m, unsigned id);
 
+/* Anonymous, sealed segments that have no name in the file system and
+ * are handed to the peer as a file descriptor instead. The segment
+ * keeps its own reference to the descriptor until pa_shm_free(). */
+pa_bool_t pa_shm_memfd_supported(void);
+int pa_shm_create_memfd_rw(pa_shm *m, size_t size);
+int pa_shm_attach_memfd_ro(pa_shm *m, unsigned id, int fd);
+
 void pa_shm_punch(pa_shm *m, size_t offset, size_t size);
 
 void pa_shm_free(pa_shm *m);
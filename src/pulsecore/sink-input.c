@@ -38,6 +38,7 @@
 #include <pulsecore/play-memblockq.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/resampler-group.h>
 
 #include "sink-input.h"
 
@@ -49,6 +50,61 @@ PA_DEFINE_PUBLIC_CLASS(pa_sink_input, pa_msgobject);
 static void sink_input_free(pa_object *o);
 static void set_real_ratio(pa_sink_input *i, const pa_cvolume *v);
 
+/* The resampler that converts between us and the sink, which might
+ * be the one of our group */
+static pa_resampler *get_resampler(pa_sink_input *i) {
+    return i->thread_info.group ? pa_resampler_group_get_resampler(i->thread_info.group) : i->thread_info.resampler;
+}
+
+/* The sample spec of our render queue */
+static const pa_sample_spec *get_render_spec(pa_sink_input *i) {
+    return i->thread_info.group ? &i->sample_spec : &i->sink->sample_spec;
+}
+
+/* Called from main context */
+static pa_memblockq *render_memblockq_new(pa_sink_input *i) {
+    pa_memblockq *q;
+    pa_memchunk silence;
+
+    if (!i->thread_info.group)
+        return pa_memblockq_new(
+                0,
+                MEMBLOCKQ_MAXLENGTH,
+                0,
+                pa_frame_size(&i->sink->sample_spec),
+                0,
+                1,
+                0,
+                &i->sink->silence);
+
+    pa_silence_memchunk_get(&i->core->silence_cache, i->core->mempool, &silence, &i->sample_spec, 0);
+
+    q = pa_memblockq_new(
+            0,
+            MEMBLOCKQ_MAXLENGTH,
+            0,
+            pa_frame_size(&i->sample_spec),
+            0,
+            1,
+            0,
+            &silence);
+
+    pa_memblock_unref(silence.memblock);
+
+    return q;
+}
+
+/* Called from main context */
+static pa_bool_t may_share_resampler(pa_core *c, pa_sink_input_flags_t flags, const pa_cvolume *volume_factor_sink) {
+
+    /* Streams that change their rate need a resampler of their
+     * own. The sink volume factor can only be applied after
+     * resampling. */
+    return c->shared_resamplers &&
+        !(flags & PA_SINK_INPUT_VARIABLE_RATE) &&
+        pa_cvolume_is_norm(volume_factor_sink);
+}
+
 pa_sink_input_new_data* pa_sink_input_new_data_init(pa_sink_input_new_data *data) {
     pa_assert(data);
 
@@ -150,9 +206,11 @@ int pa_sink_input_new(
 
     pa_sink_input *i;
     pa_resampler *resampler = NULL;
+    pa_resampler_group *group = NULL;
     char st[PA_SAMPLE_SPEC_SNPRINT_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX];
     pa_channel_map original_cm;
     int r;
+    unsigned j;
     char *pt;
 
     pa_assert(_i);
@@ -254,15 +312,25 @@ int pa_sink_input_new(
         !pa_sample_spec_equal(&data->sample_spec, &data->sink->sample_spec) ||
         !pa_channel_map_equal(&data->channel_map, &data->sink->channel_map)) {
 
-        if (!(resampler = pa_resampler_new(
+        pa_resample_flags_t flags =
+            ((data->flags & PA_SINK_INPUT_VARIABLE_RATE) ? PA_RESAMPLER_VARIABLE_RATE : 0) |
+            ((data->flags & PA_SINK_INPUT_NO_REMAP) ? PA_RESAMPLER_NO_REMAP : 0) |
+            (core->disable_remixing || (data->flags & PA_SINK_INPUT_NO_REMIX) ? PA_RESAMPLER_NO_REMIX : 0) |
+            (core->disable_lfe_remixing ? PA_RESAMPLER_NO_LFE : 0);
+
+        if (may_share_resampler(core, data->flags, &data->volume_factor_sink))
+            group = pa_resampler_group_get(
+                    data->sink,
+                    &data->sample_spec, &data->channel_map,
+                    data->resample_method,
+                    flags);
+
+        if (!group && !(resampler = pa_resampler_new(
                       core->mempool,
                       &data->sample_spec, &data->channel_map,
                       &data->sink->sample_spec, &data->sink->channel_map,
                       data->resample_method,
-                      ((data->flags & PA_SINK_INPUT_VARIABLE_RATE) ? PA_RESAMPLER_VARIABLE_RATE : 0) |
-                      ((data->flags & PA_SINK_INPUT_NO_REMAP) ? PA_RESAMPLER_NO_REMAP : 0) |
-                      (core->disable_remixing || (data->flags & PA_SINK_INPUT_NO_REMIX) ? PA_RESAMPLER_NO_REMIX : 0) |
-                      (core->disable_lfe_remixing ? PA_RESAMPLER_NO_LFE : 0)))) {
+                      flags))) {
             pa_log_warn("Unsupported resampling operation.");
             return -PA_ERR_NOTSUPPORTED;
         }
@@ -282,7 +350,9 @@ int pa_sink_input_new(
     i->client = data->client;
 
     i->requested_resample_method = data->resample_method;
-    i->actual_resample_method = resampler ? pa_resampler_get_method(resampler) : PA_RESAMPLER_INVALID;
+    i->actual_resample_method =
+        group ? pa_resampler_get_method(pa_resampler_group_get_resampler(group)) :
+        resampler ? pa_resampler_get_method(resampler) : PA_RESAMPLER_INVALID;
     i->sample_spec = data->sample_spec;
     i->channel_map = data->channel_map;
 
@@ -328,6 +398,8 @@ int pa_sink_input_new(
     pa_atomic_store(&i->thread_info.drained, 1);
     i->thread_info.sample_spec = i->sample_spec;
     i->thread_info.resampler = resampler;
+    i->thread_info.group = group;
+    i->thread_info.direct_resampler = NULL;
     i->thread_info.soft_volume = i->soft_volume;
     i->thread_info.muted = i->muted;
     i->thread_info.requested_sink_latency = (pa_usec_t) -1;
@@ -338,15 +410,10 @@ int pa_sink_input_new(
     i->thread_info.playing_for = 0;
     i->thread_info.direct_outputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
 
-    i->thread_info.render_memblockq = pa_memblockq_new(
-            0,
-            MEMBLOCKQ_MAXLENGTH,
-            0,
-            pa_frame_size(&i->sink->sample_spec),
-            0,
-            1,
-            0,
-            &i->sink->silence);
+    for (j = 0; j < PA_SINK_INPUT_PROBE_MAX; j++)
+        pa_histogram_reset(&i->profile[j]);
+
+    i->thread_info.render_memblockq = render_memblockq_new(i);
 
     pa_assert_se(pa_idxset_put(core->sink_inputs, i, &i->index) == 0);
     pa_assert_se(pa_idxset_put(i->sink->inputs, pa_sink_input_ref(i), NULL) == 0);
@@ -475,6 +542,12 @@ void pa_sink_input_unlink(pa_sink_input *i) {
             pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i->sink), PA_SINK_MESSAGE_REMOVE_INPUT, i, 0, NULL) == 0);
     }
 
+    /* The group must not outlive the sink */
+    if (i->thread_info.group) {
+        pa_resampler_group_unref(i->thread_info.group);
+        i->thread_info.group = NULL;
+    }
+
     reset_callbacks(i);
 
     if (linked) {
@@ -516,6 +589,12 @@ static void sink_input_free(pa_object *o) {
     if (i->thread_info.resampler)
         pa_resampler_free(i->thread_info.resampler);
 
+    if (i->thread_info.group)
+        pa_resampler_group_unref(i->thread_info.group);
+
+    if (i->thread_info.direct_resampler)
+        pa_resampler_free(i->thread_info.direct_resampler);
+
     if (i->proplist)
         pa_proplist_free(i->proplist);
 
@@ -594,16 +673,24 @@ pa_usec_t pa_sink_input_get_latency(pa_sink_input *i, pa_usec_t *sink_latency) {
 }
 
 /* Called from thread context */
-void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, pa_memchunk *chunk, pa_cvolume *volume) {
+void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in render queue frames */, pa_memchunk *chunk, pa_cvolume *volume) {
     pa_bool_t do_volume_adj_here, need_volume_factor_sink;
     pa_bool_t volume_is_norm;
     size_t block_size_max_sink, block_size_max_sink_input;
     size_t ilength;
+    const pa_sample_spec *rss;
+    pa_bool_t profiling;
+    uint64_t t0;
 
     pa_sink_input_assert_ref(i);
     pa_sink_input_assert_io_context(i);
     pa_assert(PA_SINK_INPUT_IS_LINKED(i->thread_info.state));
-    pa_assert(pa_frame_aligned(slength, &i->sink->sample_spec));
+
+    /* If we are in a group, it mixes and resamples us, so we act as
+     * if we played to a sink of our own sample spec */
+    rss = get_render_spec(i);
+
+    pa_assert(pa_frame_aligned(slength, rss));
     pa_assert(chunk);
     pa_assert(volume);
 
@@ -613,15 +700,18 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
               i->thread_info.state == PA_SINK_INPUT_CORKED ||
               i->thread_info.state == PA_SINK_INPUT_DRAINED);
 
+    profiling = pa_atomic_load(&i->core->render_profiling) > 0;
+    t0 = pa_histogram_start(profiling);
+
     block_size_max_sink_input = i->thread_info.resampler ?
         pa_resampler_max_block_size(i->thread_info.resampler) :
         pa_frame_align(pa_mempool_block_size_max(i->core->mempool), &i->sample_spec);
 
-    block_size_max_sink = pa_frame_align(pa_mempool_block_size_max(i->core->mempool), &i->sink->sample_spec);
+    block_size_max_sink = pa_frame_align(pa_mempool_block_size_max(i->core->mempool), rss);
 
     /* Default buffer size */
     if (slength <= 0)
-        slength = pa_frame_align(CONVERT_BUFFER_LENGTH, &i->sink->sample_spec);
+        slength = pa_frame_align(CONVERT_BUFFER_LENGTH, rss);
 
     if (slength > block_size_max_sink)
         slength = block_size_max_sink;
@@ -639,9 +729,10 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
 
     /* If the channel maps of the sink and this stream differ, we need
      * to adjust the volume *before* we resample. Otherwise we can do
-     * it after and leave it for the sink code */
+     * it after and leave it for the sink code. The group mixes us with
+     * others before resampling, so it is always before then. */
 
-    do_volume_adj_here = !pa_channel_map_equal(&i->channel_map, &i->sink->channel_map);
+    do_volume_adj_here = i->thread_info.group || !pa_channel_map_equal(&i->channel_map, &i->sink->channel_map);
     volume_is_norm = pa_cvolume_is_norm(&i->thread_info.soft_volume) && !i->thread_info.muted;
     need_volume_factor_sink = !pa_cvolume_is_norm(&i->volume_factor_sink);
 
@@ -685,6 +776,8 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
 
             /* It might be necessary to adjust the volume here */
             if (do_volume_adj_here && !volume_is_norm) {
+                uint64_t v0 = pa_histogram_start(profiling);
+
                 pa_memchunk_make_writable(&wchunk, 0);
 
                 if (i->thread_info.muted) {
@@ -703,27 +796,40 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
 
                 } else
                     pa_volume_memchunk(&wchunk, &i->thread_info.sample_spec, &i->thread_info.soft_volume);
+
+                pa_histogram_add_since(&i->profile[PA_SINK_INPUT_PROBE_VOLUME], v0);
             }
 
             if (!i->thread_info.resampler) {
 
                 if (nvfs) {
+                    uint64_t v0 = pa_histogram_start(profiling);
+
                     pa_memchunk_make_writable(&wchunk, 0);
-                    pa_volume_memchunk(&wchunk, &i->sink->sample_spec, &i->volume_factor_sink);
+                    pa_volume_memchunk(&wchunk, rss, &i->volume_factor_sink);
+
+                    pa_histogram_add_since(&i->profile[PA_SINK_INPUT_PROBE_VOLUME], v0);
                 }
 
                 pa_memblockq_push_align(i->thread_info.render_memblockq, &wchunk);
             } else {
                 pa_memchunk rchunk;
+                uint64_t r0 = pa_histogram_start(profiling);
+
                 pa_resampler_run(i->thread_info.resampler, &wchunk, &rchunk);
+                pa_histogram_add_since(&i->profile[PA_SINK_INPUT_PROBE_RESAMPLE], r0);
 
 /*                 pa_log_debug("pushing %lu", (unsigned long) rchunk.length); */
 
                 if (rchunk.memblock) {
 
                     if (nvfs) {
+                        uint64_t v0 = pa_histogram_start(profiling);
+
                         pa_memchunk_make_writable(&rchunk, 0);
                         pa_volume_memchunk(&rchunk, &i->sink->sample_spec, &i->volume_factor_sink);
+
+                        pa_histogram_add_since(&i->profile[PA_SINK_INPUT_PROBE_VOLUME], v0);
                     }
 
                     pa_memblockq_push_align(i->thread_info.render_memblockq, &rchunk);
@@ -755,21 +861,23 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
 
     if (do_volume_adj_here)
         /* We had different channel maps, so we already did the adjustment */
-        pa_cvolume_reset(volume, i->sink->sample_spec.channels);
+        pa_cvolume_reset(volume, rss->channels);
     else if (i->thread_info.muted)
         /* We've both the same channel map, so let's have the sink do the adjustment for us*/
         pa_cvolume_mute(volume, i->sink->sample_spec.channels);
     else
         *volume = i->thread_info.soft_volume;
+
+    pa_histogram_add_since(&i->profile[PA_SINK_INPUT_PROBE_PEEK], t0);
 }
 
 /* Called from thread context */
-void pa_sink_input_drop(pa_sink_input *i, size_t nbytes /* in sink sample spec */) {
+void pa_sink_input_drop(pa_sink_input *i, size_t nbytes /* in render queue sample spec */) {
 
     pa_sink_input_assert_ref(i);
     pa_sink_input_assert_io_context(i);
     pa_assert(PA_SINK_INPUT_IS_LINKED(i->thread_info.state));
-    pa_assert(pa_frame_aligned(nbytes, &i->sink->sample_spec));
+    pa_assert(pa_frame_aligned(nbytes, get_render_spec(i)));
     pa_assert(nbytes > 0);
 
 /*     pa_log_debug("dropping %lu", (unsigned long) nbytes); */
@@ -778,20 +886,22 @@ void pa_sink_input_drop(pa_sink_input *i, size_t nbytes /* in sink sample spec *
 }
 
 /* Called from thread context */
-void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sample spec */) {
+void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in render queue sample spec */) {
     size_t lbq;
     pa_bool_t called = FALSE;
 
     pa_sink_input_assert_ref(i);
     pa_sink_input_assert_io_context(i);
     pa_assert(PA_SINK_INPUT_IS_LINKED(i->thread_info.state));
-    pa_assert(pa_frame_aligned(nbytes, &i->sink->sample_spec));
+    pa_assert(pa_frame_aligned(nbytes, get_render_spec(i)));
 
 /*     pa_log_debug("rewind(%lu, %lu)", (unsigned long) nbytes, (unsigned long) i->thread_info.rewrite_nbytes); */
 
     lbq = pa_memblockq_get_length(i->thread_info.render_memblockq);
 
-    if (nbytes > 0 && !i->thread_info.dont_rewind_render) {
+    /* In a group all members need to go back in step, since the group
+     * mixes them again */
+    if (nbytes > 0 && (!i->thread_info.dont_rewind_render || i->thread_info.group)) {
         pa_log_debug("Have to rewind %lu bytes on render memblockq.", (unsigned long) nbytes);
         pa_memblockq_rewind(i->thread_info.render_memblockq, nbytes);
     }
@@ -819,9 +929,10 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
         if (amount > 0) {
             pa_log_debug("Have to rewind %lu bytes on implementor.", (unsigned long) amount);
 
-            /* Tell the implementor */
+            /* Tell the implementor, including what the resampler
+             * has buffered beyond the data we rewrite */
             if (i->process_rewind)
-                i->process_rewind(i, amount);
+                i->process_rewind(i, amount + (i->thread_info.resampler ? pa_resampler_get_delay(i->thread_info.resampler) : 0));
             called = TRUE;
 
             /* Convert back to to sink domain */
@@ -852,45 +963,66 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
 
 /* Called from thread context */
 size_t pa_sink_input_get_max_rewind(pa_sink_input *i) {
+    pa_resampler *r;
+
     pa_sink_input_assert_ref(i);
     pa_sink_input_assert_io_context(i);
 
-    return i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, i->sink->thread_info.max_rewind) : i->sink->thread_info.max_rewind;
+    r = get_resampler(i);
+
+    return r ? pa_resampler_request(r, i->sink->thread_info.max_rewind) : i->sink->thread_info.max_rewind;
 }
 
 /* Called from thread context */
 size_t pa_sink_input_get_max_request(pa_sink_input *i) {
+    pa_resampler *r;
+
     pa_sink_input_assert_ref(i);
     pa_sink_input_assert_io_context(i);
 
     /* We're not verifying the status here, to allow this to be called
      * in the state change handler between _INIT and _RUNNING */
 
-    return i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, i->sink->thread_info.max_request) : i->sink->thread_info.max_request;
+    r = get_resampler(i);
+
+    return r ? pa_resampler_request(r, i->sink->thread_info.max_request) : i->sink->thread_info.max_request;
 }
 
 /* Called from thread context */
 void pa_sink_input_update_max_rewind(pa_sink_input *i, size_t nbytes  /* in the sink's sample spec */) {
+    pa_resampler *r;
+
     pa_sink_input_assert_ref(i);
     pa_sink_input_assert_io_context(i);
     pa_assert(PA_SINK_INPUT_IS_LINKED(i->thread_info.state));
     pa_assert(pa_frame_aligned(nbytes, &i->sink->sample_spec));
 
-    pa_memblockq_set_maxrewind(i->thread_info.render_memblockq, nbytes);
+    r = get_resampler(i);
+
+    if (i->thread_info.group)
+        /* The group may have mixed up to one more block ahead of the
+         * sink that it might have to mix again */
+        pa_memblockq_set_maxrewind(i->thread_info.render_memblockq, pa_resampler_request(r, nbytes) + pa_resampler_max_block_size(r));
+    else
+        pa_memblockq_set_maxrewind(i->thread_info.render_memblockq, nbytes);
 
     if (i->update_max_rewind)
-        i->update_max_rewind(i, i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, nbytes) : nbytes);
+        i->update_max_rewind(i, r ? pa_resampler_request(r, nbytes) : nbytes);
 }
 
 /* Called from thread context */
 void pa_sink_input_update_max_request(pa_sink_input *i, size_t nbytes  /* in the sink's sample spec */) {
+    pa_resampler *r;
+
     pa_sink_input_assert_ref(i);
     pa_sink_input_assert_io_context(i);
     pa_assert(PA_SINK_INPUT_IS_LINKED(i->thread_info.state));
     pa_assert(pa_frame_aligned(nbytes, &i->sink->sample_spec));
 
+    r = get_resampler(i);
+
     if (i->update_max_request)
-        i->update_max_request(i, i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, nbytes) : nbytes);
+        i->update_max_request(i, r ? pa_resampler_request(r, nbytes) : nbytes);
 }
 
 /* Called from thread context */
@@ -1230,6 +1362,22 @@ int pa_sink_input_start_move(pa_sink_input *i) {
 
     pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i->sink), PA_SINK_MESSAGE_START_MOVE, i, 0, NULL) == 0);
 
+    /* The group belongs to the old sink. Our render queue is in our
+     * own sample spec then, so it is replaced when the move is
+     * finished. */
+    if (i->thread_info.group) {
+        pa_resampler_group_unref(i->thread_info.group);
+        i->thread_info.group = NULL;
+
+        pa_memblockq_free(i->thread_info.render_memblockq);
+        i->thread_info.render_memblockq = NULL;
+
+        if (i->thread_info.direct_resampler) {
+            pa_resampler_free(i->thread_info.direct_resampler);
+            i->thread_info.direct_resampler = NULL;
+        }
+    }
+
     pa_sink_update_status(i->sink);
     pa_cvolume_remap(&i->volume_factor_sink, &i->sink->channel_map, &i->channel_map);
     i->sink = NULL;
@@ -1241,7 +1389,8 @@ int pa_sink_input_start_move(pa_sink_input *i) {
 
 /* Called from main context */
 int pa_sink_input_finish_move(pa_sink_input *i, pa_sink *dest, pa_bool_t save) {
-    pa_resampler *new_resampler;
+    pa_resampler *new_resampler = NULL;
+    pa_resampler_group *new_group = NULL;
 
     pa_sink_input_assert_ref(i);
     pa_assert_ctl_context();
@@ -1263,21 +1412,32 @@ int pa_sink_input_finish_move(pa_sink_input *i, pa_sink *dest, pa_bool_t save) {
              !pa_sample_spec_equal(&i->sample_spec, &dest->sample_spec) ||
              !pa_channel_map_equal(&i->channel_map, &dest->channel_map)) {
 
-        /* Okey, we need a new resampler for the new sink */
+        pa_resample_flags_t flags =
+            ((i->flags & PA_SINK_INPUT_VARIABLE_RATE) ? PA_RESAMPLER_VARIABLE_RATE : 0) |
+            ((i->flags & PA_SINK_INPUT_NO_REMAP) ? PA_RESAMPLER_NO_REMAP : 0) |
+            (i->core->disable_remixing || (i->flags & PA_SINK_INPUT_NO_REMIX) ? PA_RESAMPLER_NO_REMIX : 0) |
+            (i->core->disable_lfe_remixing ? PA_RESAMPLER_NO_LFE : 0);
+
+        /* Okey, we need a new resampler for the new sink, maybe we
+         * can share one */
+
+        if (may_share_resampler(i->core, i->flags, &i->volume_factor_sink))
+            new_group = pa_resampler_group_get(
+                    dest,
+                    &i->sample_spec, &i->channel_map,
+                    i->requested_resample_method,
+                    flags);
 
-        if (!(new_resampler = pa_resampler_new(
+        if (!new_group && !(new_resampler = pa_resampler_new(
                       i->core->mempool,
                       &i->sample_spec, &i->channel_map,
                       &dest->sample_spec, &dest->channel_map,
                       i->requested_resample_method,
-                      ((i->flags & PA_SINK_INPUT_VARIABLE_RATE) ? PA_RESAMPLER_VARIABLE_RATE : 0) |
-                      ((i->flags & PA_SINK_INPUT_NO_REMAP) ? PA_RESAMPLER_NO_REMAP : 0) |
-                      (i->core->disable_remixing || (i->flags & PA_SINK_INPUT_NO_REMIX) ? PA_RESAMPLER_NO_REMIX : 0)))) {
+                      flags))) {
             pa_log_warn("Unsupported resampling operation.");
             return -PA_ERR_NOTSUPPORTED;
         }
-    } else
-        new_resampler = NULL;
+    }
 
     if (i->moving)
         i->moving(i, dest);
@@ -1292,24 +1452,22 @@ int pa_sink_input_finish_move(pa_sink_input *i, pa_sink *dest, pa_bool_t save) {
         i->sink->n_corked++;
 
     /* Replace resampler and render queue */
-    if (new_resampler != i->thread_info.resampler) {
+    if (new_resampler != i->thread_info.resampler || new_group || !i->thread_info.render_memblockq) {
 
-        if (i->thread_info.resampler)
+        if (i->thread_info.resampler && i->thread_info.resampler != new_resampler)
             pa_resampler_free(i->thread_info.resampler);
         i->thread_info.resampler = new_resampler;
+        i->thread_info.group = new_group;
 
-        pa_memblockq_free(i->thread_info.render_memblockq);
+        if (i->thread_info.render_memblockq)
+            pa_memblockq_free(i->thread_info.render_memblockq);
 
-        i->thread_info.render_memblockq = pa_memblockq_new(
-                0,
-                MEMBLOCKQ_MAXLENGTH,
-                0,
-                pa_frame_size(&i->sink->sample_spec),
-                0,
-                1,
-                0,
-                &i->sink->silence);
+        i->thread_info.render_memblockq = render_memblockq_new(i);
     }
+
+    i->actual_resample_method =
+        new_group ? pa_resampler_get_method(pa_resampler_group_get_resampler(new_group)) :
+        new_resampler ? pa_resampler_get_method(new_resampler) : PA_RESAMPLER_INVALID;
     pa_sink_update_status(dest);
 
     if (i->sink->flags & PA_SINK_FLAT_VOLUME) {
@@ -1458,7 +1616,10 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
         case PA_SINK_INPUT_MESSAGE_GET_LATENCY: {
             pa_usec_t *r = userdata;
 
-            r[0] += pa_bytes_to_usec(pa_memblockq_get_length(i->thread_info.render_memblockq), &i->sink->sample_spec);
+            r[0] += pa_bytes_to_usec(pa_memblockq_get_length(i->thread_info.render_memblockq), get_render_spec(i));
+
+            if (i->thread_info.group)
+                r[0] += pa_bytes_to_usec(pa_resampler_group_get_length(i->thread_info.group), &i->sink->sample_spec);
             r[1] += pa_sink_get_latency_within_thread(i->sink);
 
             return 0;
@@ -1514,6 +1675,18 @@ pa_sink_input_state_t pa_sink_input_get_state(pa_sink_input *i) {
     return i->state;
 }
 
+const char *pa_sink_input_probe_to_string(pa_sink_input_probe_t p) {
+    static const char * const table[PA_SINK_INPUT_PROBE_MAX] = {
+        [PA_SINK_INPUT_PROBE_PEEK] = "peek",
+        [PA_SINK_INPUT_PROBE_RESAMPLE] = "resample",
+        [PA_SINK_INPUT_PROBE_VOLUME] = "volume"
+    };
+
+    pa_assert(p < PA_SINK_INPUT_PROBE_MAX);
+
+    return table[p];
+}
+
 /* Called from IO context */
 pa_bool_t pa_sink_input_safe_to_remove(pa_sink_input *i) {
     pa_sink_input_assert_ref(i);
@@ -1534,6 +1707,7 @@ void pa_sink_input_request_rewind(
         pa_bool_t dont_rewind_render) {
 
     size_t lbq;
+    pa_resampler *r;
 
     /* If 'rewrite' is TRUE the sink is rewound as far as requested
      * and possible and the exact value of this is passed back the
@@ -1562,11 +1736,17 @@ void pa_sink_input_request_rewind(
 
     /* pa_log_debug("request rewrite %zu", nbytes); */
 
+    r = get_resampler(i);
+
     /* Calculate how much we can rewind locally without having to
-     * touch the sink */
-    if (rewrite)
+     * touch the sink. In a group that includes what the group mixed
+     * already, since it will mix it again. */
+    if (rewrite) {
         lbq = pa_memblockq_get_length(i->thread_info.render_memblockq);
-    else
+
+        if (i->thread_info.group)
+            lbq = pa_resampler_result(r, lbq) + pa_resampler_group_get_length(i->thread_info.group);
+    } else
         lbq = 0;
 
     /* Check if rewinding for the maximum is requested, and if so, fix up */
@@ -1576,8 +1756,8 @@ void pa_sink_input_request_rewind(
         nbytes = i->sink->thread_info.max_rewind + lbq;
 
         /* Transform from sink domain */
-        if (i->thread_info.resampler)
-            nbytes = pa_resampler_request(i->thread_info.resampler, nbytes);
+        if (r)
+            nbytes = pa_resampler_request(r, nbytes);
     }
 
     /* Remember how much we actually want to rewrite */
@@ -1603,8 +1783,8 @@ void pa_sink_input_request_rewind(
     if (nbytes != (size_t) -1) {
 
         /* Transform to sink domain */
-        if (i->thread_info.resampler)
-            nbytes = pa_resampler_result(i->thread_info.resampler, nbytes);
+        if (r)
+            nbytes = pa_resampler_result(r, nbytes);
 
         if (nbytes > lbq)
             pa_sink_request_rewind(i->sink, nbytes - lbq);
@@ -1627,7 +1807,7 @@ pa_memchunk* pa_sink_input_get_silence(pa_sink_input *i, pa_memchunk *ret) {
                 i->core->mempool,
                 ret,
                 &i->sample_spec,
-                i->thread_info.resampler ? pa_resampler_max_block_size(i->thread_info.resampler) : 0);
+                get_resampler(i) ? pa_resampler_max_block_size(get_resampler(i)) : 0);
 
     return ret;
 }
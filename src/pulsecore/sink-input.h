@@ -35,6 +35,7 @@ typedef struct pa_sink_input pa_sink_input;
 #include <pulsecore/client.h>
 #include <pulsecore/sink.h>
 #include <pulsecore/core.h>
+#include <pulsecore/histogram.h>
 
 typedef enum pa_sink_input_state {
     PA_SINK_INPUT_INIT,         /*< The stream is not active yet, because pa_sink_put() has not been called yet */
@@ -63,6 +64,13 @@ typedef enum pa_sink_input_flags {
     PA_SINK_INPUT_KILL_ON_SUSPEND = 1024
 } pa_sink_input_flags_t;
 
+typedef enum pa_sink_input_probe {
+    PA_SINK_INPUT_PROBE_PEEK,       /* one pa_sink_input_peek() call, including the pop() */
+    PA_SINK_INPUT_PROBE_RESAMPLE,   /* pa_resampler_run() */
+    PA_SINK_INPUT_PROBE_VOLUME,     /* pa_volume_memchunk() done by the stream itself */
+    PA_SINK_INPUT_PROBE_MAX
+} pa_sink_input_probe_t;
+
 struct pa_sink_input {
     pa_msgobject parent;
 
@@ -118,7 +126,11 @@ struct pa_sink_input {
      * specified length request_nbytes. This is an optimization
      * only. If less data is available, it's fine to return a smaller
      * block. If more data is already ready, it is better to return
-     * the full block. */
+     * the full block. On sinks with PA_SINK_PARALLEL_RENDER this is
+     * called from a render worker on behalf of the IO thread,
+     * concurrently with the pop() of other inputs, so it may only
+     * touch the state of this stream. Rewind requests are fine, the
+     * sink applies them after the batch. */
     int (*pop) (pa_sink_input *i, size_t request_nbytes, pa_memchunk *chunk); /* may NOT be NULL */
 
     /* Rewind the queue by the specified number of bytes. Called just
@@ -223,7 +235,17 @@ struct pa_sink_input {
 
         pa_resampler *resampler;                     /* may be NULL */
 
-        /* We maintain a history of resampled audio data here. */
+        /* If set we share the resampler of the group instead of
+         * having our own, see resampler-group.h. Only changed from
+         * main context while we are not attached. */
+        pa_resampler_group *group;                   /* may be NULL */
+
+        /* Only used for directly connected outputs while we are in a
+         * group */
+        pa_resampler *direct_resampler;              /* may be NULL */
+
+        /* We maintain a history of resampled audio data here. If we
+         * are in a group the data is not resampled yet. */
         pa_memblockq *render_memblockq;
 
         pa_sink_input *sync_prev, *sync_next;
@@ -234,6 +256,10 @@ struct pa_sink_input {
         pa_hashmap *direct_outputs;
     } thread_info;
 
+    /* Render profile, written from the IO thread, may be read from
+     * everywhere */
+    pa_histogram profile[PA_SINK_INPUT_PROBE_MAX];
+
     void *userdata;
 };
 
@@ -361,13 +387,20 @@ void pa_sink_input_fail_move(pa_sink_input *i);
 
 pa_sink_input_state_t pa_sink_input_get_state(pa_sink_input *i);
 
+const char *pa_sink_input_probe_to_string(pa_sink_input_probe_t p);
+
 pa_usec_t pa_sink_input_get_requested_latency(pa_sink_input *i);
 
 /* To be used exclusively by the sink driver IO thread */
 
+/* The lengths passed to these three are in the sample spec of the
+ * render queue: the sink's, or our own if we are part of a resampler
+ * group. In the latter case the volume has already been applied to
+ * what pa_sink_input_peek() returns. */
 void pa_sink_input_peek(pa_sink_input *i, size_t length, pa_memchunk *chunk, pa_cvolume *volume);
 void pa_sink_input_drop(pa_sink_input *i, size_t length);
-void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in the sink's sample spec */);
+void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes);
+
 void pa_sink_input_update_max_rewind(pa_sink_input *i, size_t nbytes  /* in the sink's sample spec */);
 void pa_sink_input_update_max_request(pa_sink_input *i, size_t nbytes  /* in the sink's sample spec */);
 
@@ -43,6 +43,9 @@
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/play-memblockq.h>
+#include <pulsecore/histogram.h>
+#include <pulsecore/resampler-group.h>
+#include <pulsecore/render-pool.h>
 
 #include "sink.h"
 
@@ -52,6 +55,17 @@
 #define ABSOLUTE_MAX_LATENCY (10*PA_USEC_PER_SEC)
 #define DEFAULT_FIXED_LATENCY (250*PA_USEC_PER_MSEC)
 
+/* Waking up the render workers costs a few microseconds, with fewer
+ * streams than this we peek them ourselves */
+#define PARALLEL_RENDER_MIN_JOBS 4
+
+struct pa_sink_render_job {
+    pa_sink_input *input;       /* either this ... */
+    pa_resampler_group *group;  /* ... or this is set */
+    pa_memchunk chunk;
+    pa_cvolume volume;
+};
+
 PA_DEFINE_PUBLIC_CLASS(pa_sink, pa_msgobject);
 
 static void sink_free(pa_object *s);
@@ -173,6 +187,7 @@ pa_sink* pa_sink_new(
     pa_source_new_data source_data;
     const char *dn;
     char *pt;
+    unsigned i;
 
     pa_assert(core);
     pa_assert(data);
@@ -250,6 +265,7 @@ pa_sink* pa_sink_new(
     s->channel_map = data->channel_map;
 
     s->inputs = pa_idxset_new(NULL, NULL);
+    PA_LLIST_HEAD_INIT(pa_resampler_group, s->resampler_groups);
     s->n_corked = 0;
 
     s->reference_volume = s->real_volume = data->volume;
@@ -297,11 +313,14 @@ pa_sink* pa_sink_new(
 
     s->thread_info.rtpoll = NULL;
     s->thread_info.inputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    s->thread_info.resampler_groups = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
     s->thread_info.soft_volume =  s->soft_volume;
     s->thread_info.soft_muted = s->muted;
     s->thread_info.state = s->state;
     s->thread_info.rewind_nbytes = 0;
     s->thread_info.rewind_requested = FALSE;
+    s->thread_info.defer_rewinds = FALSE;
+    pa_atomic_store(&s->thread_info.deferred_rewind, 0);
     s->thread_info.max_rewind = 0;
     s->thread_info.max_request = 0;
     s->thread_info.requested_latency_valid = FALSE;
@@ -309,6 +328,24 @@ pa_sink* pa_sink_new(
     s->thread_info.min_latency = ABSOLUTE_MIN_LATENCY;
     s->thread_info.max_latency = ABSOLUTE_MAX_LATENCY;
     s->thread_info.fixed_latency = flags & PA_SINK_DYNAMIC_LATENCY ? 0 : DEFAULT_FIXED_LATENCY;
+    s->thread_info.render_jobs = NULL;
+    s->thread_info.n_render_jobs_allocated = 0;
+
+    s->render_pool = NULL;
+
+    if (flags & PA_SINK_PARALLEL_RENDER) {
+        unsigned n;
+
+        n = data->render_threads > 0 ? data->render_threads : pa_ncpus() - 1;
+
+        if (n > 0 && (s->render_pool = pa_render_pool_new(n, core->realtime_scheduling ? core->realtime_priority : 0)))
+            pa_log_info("Rendering on %u additional threads.", n);
+        else
+            s->flags &= ~PA_SINK_PARALLEL_RENDER;
+    }
+
+    for (i = 0; i < PA_SINK_PROBE_MAX; i++)
+        pa_histogram_reset(&s->profile[i]);
 
     /* FIXME: This should probably be moved to pa_sink_put() */
     pa_assert_se(pa_idxset_put(core->sinks, s, &s->index) >= 0);
@@ -539,6 +576,15 @@ static void sink_free(pa_object *o) {
 
     pa_hashmap_free(s->thread_info.inputs, NULL, NULL);
 
+    /* The groups went away with their last member */
+    pa_assert(!s->resampler_groups);
+    pa_hashmap_free(s->thread_info.resampler_groups, NULL, NULL);
+
+    if (s->render_pool)
+        pa_render_pool_free(s->render_pool);
+
+    pa_xfree(s->thread_info.render_jobs);
+
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
 
@@ -703,6 +749,7 @@ void pa_sink_move_all_fail(pa_queue *q) {
 /* Called from IO thread context */
 void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     pa_sink_input *i;
+    pa_resampler_group *g;
     void *state = NULL;
 
     pa_sink_assert_ref(s);
@@ -727,17 +774,158 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
 
     PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
         pa_sink_input_assert_ref(i);
+
+        /* Members of a group are rewound by their group */
+        if (i->thread_info.group)
+            continue;
+
         pa_sink_input_process_rewind(i, nbytes);
     }
 
+    PA_HASHMAP_FOREACH(g, s->thread_info.resampler_groups, state)
+        pa_resampler_group_process_rewind(g, nbytes);
+
     if (nbytes > 0)
         if (s->monitor_source && PA_SOURCE_IS_LINKED(s->monitor_source->thread_info.state))
             pa_source_process_rewind(s->monitor_source, nbytes);
 }
 
+struct render_batch {
+    pa_sink *sink;
+    struct pa_sink_render_job *jobs;
+    size_t length;
+};
+
+/* Called from IO thread context, or from a render worker on its behalf */
+static void render_job_peek(pa_sink *s, struct pa_sink_render_job *j, size_t length) {
+
+    if (j->input)
+        pa_sink_input_peek(j->input, length, &j->chunk, &j->volume);
+    else {
+        pa_resampler_group_peek(j->group, length, &j->chunk);
+        pa_cvolume_reset(&j->volume, s->sample_spec.channels);
+    }
+}
+
+static void render_job_cb(void *userdata, unsigned idx) {
+    struct render_batch *b = userdata;
+    struct pa_sink_render_job *j = b->jobs + idx;
+
+    /* Peeked already by the IO thread itself */
+    if (j->chunk.memblock)
+        return;
+
+    render_job_peek(b->sink, j, b->length);
+}
+
+/* Called from IO thread context */
+static unsigned collect_render_jobs(pa_sink *s) {
+    pa_sink_input *i;
+    pa_resampler_group *g;
+    void *state;
+    unsigned n = 0, max;
+
+    max = pa_hashmap_size(s->thread_info.inputs) + pa_hashmap_size(s->thread_info.resampler_groups);
+
+    if (max > s->thread_info.n_render_jobs_allocated) {
+        s->thread_info.n_render_jobs_allocated = PA_MAX(max, 2 * s->thread_info.n_render_jobs_allocated);
+        s->thread_info.render_jobs = pa_xrealloc(s->thread_info.render_jobs, s->thread_info.n_render_jobs_allocated * sizeof(struct pa_sink_render_job));
+    }
+
+    /* Same order as fill_mix_info() */
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
+        struct pa_sink_render_job *j;
+
+        pa_sink_input_assert_ref(i);
+
+        if (i->thread_info.group)
+            continue;
+
+        j = s->thread_info.render_jobs + n++;
+        j->input = i;
+        j->group = NULL;
+        pa_memchunk_reset(&j->chunk);
+    }
+
+    PA_HASHMAP_FOREACH(g, s->thread_info.resampler_groups, state) {
+        struct pa_sink_render_job *j = s->thread_info.render_jobs + n++;
+
+        j->input = NULL;
+        j->group = g;
+        pa_memchunk_reset(&j->chunk);
+    }
+
+    return n;
+}
+
+/* Called from IO thread context */
+static unsigned fill_mix_info_parallel(pa_sink *s, size_t *length, pa_mix_info *info, unsigned maxinfo, unsigned n_jobs) {
+    struct render_batch b;
+    unsigned k, n = 0;
+    size_t mixlength = *length;
+    int r;
+
+    b.sink = s;
+    b.jobs = s->thread_info.render_jobs;
+    b.length = *length;
+
+    /* The streams convert themselves on their own data, except for
+     * groups feeding peak meters, which touch the monitor source.
+     * These we peek ourselves. */
+    for (k = 0; k < n_jobs; k++)
+        if (b.jobs[k].group && pa_resampler_group_has_direct_outputs(b.jobs[k].group))
+            render_job_peek(s, b.jobs + k, b.length);
+
+    /* The pop() callbacks might ask for a rewind, but the workers
+     * may not touch our state */
+    s->thread_info.defer_rewinds = TRUE;
+    pa_render_pool_run(s->render_pool, n_jobs, render_job_cb, &b);
+    s->thread_info.defer_rewinds = FALSE;
+
+    if ((r = pa_atomic_load(&s->thread_info.deferred_rewind)) > 0) {
+        pa_atomic_store(&s->thread_info.deferred_rewind, 0);
+        pa_sink_request_rewind(s, (size_t) (r - 1));
+    }
+
+    /* Look at the results in the order fill_mix_info() would have, so
+     * that we mix the same no matter which thread was faster */
+    for (k = 0; k < n_jobs; k++) {
+        struct pa_sink_render_job *j = b.jobs + k;
+
+        pa_assert(j->chunk.memblock);
+        pa_assert(j->chunk.length > 0);
+
+        if (n >= maxinfo) {
+            pa_memblock_unref(j->chunk.memblock);
+            continue;
+        }
+
+        if (mixlength == 0 || j->chunk.length < mixlength)
+            mixlength = j->chunk.length;
+
+        if (pa_memblock_is_silence(j->chunk.memblock)) {
+            pa_memblock_unref(j->chunk.memblock);
+            continue;
+        }
+
+        info->chunk = j->chunk;
+        info->volume = j->volume;
+        info->userdata = j->input ? pa_sink_input_ref(j->input) : NULL;
+
+        info++;
+        n++;
+    }
+
+    if (mixlength > 0)
+        *length = mixlength;
+
+    return n;
+}
+
 /* Called from IO thread context */
 static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, unsigned maxinfo) {
     pa_sink_input *i;
+    pa_resampler_group *g;
     unsigned n = 0;
     void *state = NULL;
     size_t mixlength = *length;
@@ -746,9 +934,20 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     pa_sink_assert_io_context(s);
     pa_assert(info);
 
+    if (s->render_pool) {
+        unsigned n_jobs;
+
+        if ((n_jobs = collect_render_jobs(s)) >= PARALLEL_RENDER_MIN_JOBS)
+            return fill_mix_info_parallel(s, length, info, maxinfo, n_jobs);
+    }
+
     while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL)) && maxinfo > 0) {
         pa_sink_input_assert_ref(i);
 
+        /* Members of a group are mixed by their group */
+        if (i->thread_info.group)
+            continue;
+
         pa_sink_input_peek(i, *length, &info->chunk, &info->volume);
 
         if (mixlength == 0 || info->chunk.length < mixlength)
@@ -769,6 +968,30 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
         maxinfo--;
     }
 
+    /* The groups take part like any other stream, their volume has
+     * already been applied by the members. They are told apart from
+     * the inputs by a NULL userdata. */
+    state = NULL;
+    while ((g = pa_hashmap_iterate(s->thread_info.resampler_groups, &state, NULL)) && maxinfo > 0) {
+
+        pa_resampler_group_peek(g, *length, &info->chunk);
+        pa_cvolume_reset(&info->volume, s->sample_spec.channels);
+
+        if (mixlength == 0 || info->chunk.length < mixlength)
+            mixlength = info->chunk.length;
+
+        if (pa_memblock_is_silence(info->chunk.memblock)) {
+            pa_memblock_unref(info->chunk.memblock);
+            continue;
+        }
+
+        info->userdata = NULL;
+
+        info++;
+        n++;
+        maxinfo--;
+    }
+
     if (mixlength > 0)
         *length = mixlength;
 
@@ -778,6 +1001,7 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
 /* Called from IO thread context */
 static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *result) {
     pa_sink_input *i;
+    pa_resampler_group *g;
     void *state;
     unsigned p = 0;
     unsigned n_unreffed = 0;
@@ -796,6 +1020,10 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
 
         pa_sink_input_assert_ref(i);
 
+        /* Members of a group have been dropped when it mixed them */
+        if (i->thread_info.group)
+            continue;
+
         /* Let's try to find the matching entry info the pa_mix_info array */
         for (j = 0; j < n; j ++) {
 
@@ -856,8 +1084,11 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
         }
     }
 
+    PA_HASHMAP_FOREACH(g, s->thread_info.resampler_groups, state)
+        pa_resampler_group_drop(g, result->length);
+
     /* Now drop references to entries that are included in the
-     * pa_mix_info array but don't exist anymore */
+     * pa_mix_info array but don't exist anymore, and to the groups */
 
     if (n_unreffed < n) {
         for (; n > 0; info++, n--) {
@@ -877,6 +1108,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t block_size_max;
+    pa_bool_t profiling;
+    uint64_t t0;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -894,6 +1127,9 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
         return;
     }
 
+    profiling = pa_atomic_load(&s->core->render_profiling) > 0;
+    t0 = pa_histogram_start(profiling);
+
     pa_sink_ref(s);
 
     if (length <= 0)
@@ -934,19 +1170,27 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
                                     &s->sample_spec,
                                     result->length);
         } else if (!pa_cvolume_is_norm(&volume)) {
+            uint64_t v0 = pa_histogram_start(profiling);
+
             pa_memchunk_make_writable(result, 0);
             pa_volume_memchunk(result, &s->sample_spec, &volume);
+
+            pa_histogram_add_since(&s->profile[PA_SINK_PROBE_VOLUME], v0);
         }
     } else {
         void *ptr;
+        uint64_t m0;
+
         result->memblock = pa_memblock_new(s->core->mempool, length);
 
         ptr = pa_memblock_acquire(result->memblock);
+        m0 = pa_histogram_start(profiling);
         result->length = pa_mix(info, n,
                                 ptr, length,
                                 &s->sample_spec,
                                 &s->thread_info.soft_volume,
                                 s->thread_info.soft_muted);
+        pa_histogram_add_since(&s->profile[PA_SINK_PROBE_MIX], m0);
         pa_memblock_release(result->memblock);
 
         result->index = 0;
@@ -954,6 +1198,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     inputs_drop(s, info, n, result);
 
+    pa_histogram_add_since(&s->profile[PA_SINK_PROBE_RENDER], t0);
+
     pa_sink_unref(s);
 }
 
@@ -962,6 +1208,8 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t length, block_size_max;
+    pa_bool_t profiling;
+    uint64_t t0;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -979,6 +1227,9 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
         return;
     }
 
+    profiling = pa_atomic_load(&s->core->render_profiling) > 0;
+    t0 = pa_histogram_start(profiling);
+
     pa_sink_ref(s);
 
     length = target->length;
@@ -1015,8 +1266,12 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
                 vchunk.length = length;
 
             if (!pa_cvolume_is_norm(&volume)) {
+                uint64_t v0 = pa_histogram_start(profiling);
+
                 pa_memchunk_make_writable(&vchunk, 0);
                 pa_volume_memchunk(&vchunk, &s->sample_spec, &volume);
+
+                pa_histogram_add_since(&s->profile[PA_SINK_PROBE_VOLUME], v0);
             }
 
             pa_memchunk_memcpy(target, &vchunk);
@@ -1025,20 +1280,25 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     } else {
         void *ptr;
+        uint64_t m0;
 
         ptr = pa_memblock_acquire(target->memblock);
 
+        m0 = pa_histogram_start(profiling);
         target->length = pa_mix(info, n,
                                 (uint8_t*) ptr + target->index, length,
                                 &s->sample_spec,
                                 &s->thread_info.soft_volume,
                                 s->thread_info.soft_muted);
+        pa_histogram_add_since(&s->profile[PA_SINK_PROBE_MIX], m0);
 
         pa_memblock_release(target->memblock);
     }
 
     inputs_drop(s, info, n, target);
 
+    pa_histogram_add_since(&s->profile[PA_SINK_PROBE_RENDER], t0);
+
     pa_sink_unref(s);
 }
 
@@ -1722,6 +1982,19 @@ unsigned pa_sink_check_suspend(pa_sink *s) {
     return ret;
 }
 
+const char *pa_sink_probe_to_string(pa_sink_probe_t p) {
+    static const char * const table[PA_SINK_PROBE_MAX] = {
+        [PA_SINK_PROBE_RENDER] = "render",
+        [PA_SINK_PROBE_MIX] = "mix",
+        [PA_SINK_PROBE_VOLUME] = "volume",
+        [PA_SINK_PROBE_WRITE] = "write"
+    };
+
+    pa_assert(p < PA_SINK_PROBE_MAX);
+
+    return table[p];
+}
+
 /* Called from the IO thread */
 static void sync_input_volumes_within_thread(pa_sink *s) {
     pa_sink_input *i;
@@ -1774,6 +2047,9 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             pa_assert(!i->thread_info.attached);
             i->thread_info.attached = TRUE;
 
+            if (i->thread_info.group)
+                pa_resampler_group_attach_input(i->thread_info.group, i);
+
             if (i->attach)
                 i->attach(i);
 
@@ -1813,6 +2089,9 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             pa_assert(i->thread_info.attached);
             i->thread_info.attached = FALSE;
 
+            if (i->thread_info.group)
+                pa_resampler_group_detach_input(i->thread_info.group, i);
+
             /* Since the caller sleeps in pa_sink_input_unlink(),
              * we can safely access data outside of thread_info even
              * though it is mutable */
@@ -1857,12 +2136,31 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
                 /* Get the latency of the sink */
                 usec = pa_sink_get_latency_within_thread(s);
                 sink_nbytes = pa_usec_to_bytes(usec, &s->sample_spec);
-                total_nbytes = sink_nbytes + pa_memblockq_get_length(i->thread_info.render_memblockq);
 
-                if (total_nbytes > 0) {
-                    i->thread_info.rewrite_nbytes = i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, total_nbytes) : total_nbytes;
-                    i->thread_info.rewrite_flush = TRUE;
-                    pa_sink_input_process_rewind(i, sink_nbytes);
+                if (i->thread_info.group) {
+                    pa_resampler *r = pa_resampler_group_get_resampler(i->thread_info.group);
+                    size_t input_nbytes;
+
+                    /* Our render queue is in our own sample spec, and
+                     * what the group mixed already is ahead of the
+                     * sink */
+                    input_nbytes = pa_resampler_request(r, sink_nbytes + pa_resampler_group_get_length(i->thread_info.group));
+                    total_nbytes = input_nbytes + pa_memblockq_get_length(i->thread_info.render_memblockq);
+
+                    if (total_nbytes > 0) {
+                        i->thread_info.rewrite_nbytes = total_nbytes;
+                        i->thread_info.rewrite_flush = TRUE;
+                        pa_sink_input_process_rewind(i, input_nbytes);
+                    }
+
+                } else {
+                    total_nbytes = sink_nbytes + pa_memblockq_get_length(i->thread_info.render_memblockq);
+
+                    if (total_nbytes > 0) {
+                        i->thread_info.rewrite_nbytes = i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, total_nbytes) : total_nbytes;
+                        i->thread_info.rewrite_flush = TRUE;
+                        pa_sink_input_process_rewind(i, sink_nbytes);
+                    }
                 }
             }
 
@@ -1872,6 +2170,9 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             pa_assert(i->thread_info.attached);
             i->thread_info.attached = FALSE;
 
+            if (i->thread_info.group)
+                pa_resampler_group_detach_input(i->thread_info.group, i);
+
             /* Let's remove the sink input ...*/
             if (pa_hashmap_remove(s->thread_info.inputs, PA_UINT32_TO_PTR(i->index)))
                 pa_sink_input_unref(i);
@@ -1900,6 +2201,9 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             pa_assert(!i->thread_info.attached);
             i->thread_info.attached = TRUE;
 
+            if (i->thread_info.group)
+                pa_resampler_group_attach_input(i->thread_info.group, i);
+
             if (i->attach)
                 i->attach(i);
 
@@ -1917,8 +2221,13 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
                 usec = pa_sink_get_latency_within_thread(s);
                 nbytes = pa_usec_to_bytes(usec, &s->sample_spec);
 
-                if (nbytes > 0)
-                    pa_sink_input_drop(i, nbytes);
+                if (nbytes > 0) {
+                    if (i->thread_info.group)
+                        /* Members drop in their own sample spec */
+                        pa_sink_input_drop(i, pa_resampler_request(pa_resampler_group_get_resampler(i->thread_info.group), nbytes));
+                    else
+                        pa_sink_input_drop(i, nbytes);
+                }
 
                 pa_log_debug("Requesting rewind due to finished move");
                 pa_sink_request_rewind(s, nbytes);
@@ -2138,7 +2447,7 @@ void pa_sink_attach_within_thread(pa_sink *s) {
         pa_source_attach_within_thread(s->monitor_source);
 }
 
-/* Called from IO thread */
+/* Called from IO thread, or from a render worker on its behalf */
 void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -2152,6 +2461,18 @@ void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
 
     nbytes = PA_MIN(nbytes, s->thread_info.max_rewind);
 
+    if (s->thread_info.defer_rewinds) {
+        int r, v = (int) nbytes + 1;
+
+        /* Called from a render worker, see fill_mix_info_parallel() */
+        do {
+            if ((r = pa_atomic_load(&s->thread_info.deferred_rewind)) >= v)
+                return;
+        } while (!pa_atomic_cmpxchg(&s->thread_info.deferred_rewind, r, v));
+
+        return;
+    }
+
     if (s->thread_info.rewind_requested &&
         nbytes <= s->thread_info.rewind_nbytes)
         return;
@@ -2220,6 +2541,7 @@ pa_usec_t pa_sink_get_requested_latency(pa_sink *s) {
 /* Called from IO as well as the main thread -- the latter only before the IO thread started up */
 void pa_sink_set_max_rewind_within_thread(pa_sink *s, size_t max_rewind) {
     pa_sink_input *i;
+    pa_resampler_group *g;
     void *state = NULL;
 
     pa_sink_assert_ref(s);
@@ -2230,9 +2552,13 @@ void pa_sink_set_max_rewind_within_thread(pa_sink *s, size_t max_rewind) {
 
     s->thread_info.max_rewind = max_rewind;
 
-    if (PA_SINK_IS_LINKED(s->thread_info.state))
+    if (PA_SINK_IS_LINKED(s->thread_info.state)) {
+        PA_HASHMAP_FOREACH(g, s->thread_info.resampler_groups, state)
+            pa_resampler_group_update_max_rewind(g, s->thread_info.max_rewind);
+
         PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state)
             pa_sink_input_update_max_rewind(i, s->thread_info.max_rewind);
+    }
 
     if (s->monitor_source)
         pa_source_set_max_rewind_within_thread(s->monitor_source, s->thread_info.max_rewind);
@@ -25,6 +25,7 @@
 
 typedef struct pa_sink pa_sink;
 typedef struct pa_device_port pa_device_port;
+typedef struct pa_resampler_group pa_resampler_group;
 
 #include <inttypes.h>
 
@@ -43,6 +44,8 @@ typedef struct pa_device_port pa_device_port;
 #include <pulsecore/card.h>
 #include <pulsecore/queue.h>
 #include <pulsecore/thread-mq.h>
+#include <pulsecore/histogram.h>
+#include <pulsecore/render-pool.h>
 
 #define PA_MAX_INPUTS_PER_SINK 32
 
@@ -62,6 +65,14 @@ struct pa_device_port {
 
 #define PA_DEVICE_PORT_DATA(d) ((void*) ((uint8_t*) d + PA_ALIGN(sizeof(pa_device_port))))
 
+typedef enum pa_sink_probe {
+    PA_SINK_PROBE_RENDER,      /* one pa_sink_render() or pa_sink_render_into() call */
+    PA_SINK_PROBE_MIX,         /* pa_mix() of multiple inputs */
+    PA_SINK_PROBE_VOLUME,      /* pa_volume_memchunk() of a single input */
+    PA_SINK_PROBE_WRITE,       /* handing the data to the device, recorded by the driver */
+    PA_SINK_PROBE_MAX
+} pa_sink_probe_t;
+
 struct pa_sink {
     pa_msgobject parent;
 
@@ -84,6 +95,9 @@ struct pa_sink {
 
     pa_idxset *inputs;
     unsigned n_corked;
+
+    /* Shared resamplers of the inputs, see resampler-group.h */
+    PA_LLIST_HEAD(pa_resampler_group, resampler_groups);
     pa_source *monitor_source;
 
     pa_volume_t base_volume; /* shall be constant */
@@ -111,6 +125,9 @@ struct pa_sink {
 
     unsigned priority;
 
+    /* Peeks the inputs in parallel, only with PA_SINK_PARALLEL_RENDER */
+    pa_render_pool *render_pool;
+
     /* Called when the main loop requests a state change. Called from
      * main loop context. If returns -1 the state change will be
      * inhibited */
@@ -156,6 +173,14 @@ struct pa_sink {
         pa_sink_state_t state;
         pa_hashmap *inputs;
 
+        /* The resampler groups that have members attached */
+        pa_hashmap *resampler_groups;
+
+        /* Scratch space for the inputs and groups peeked by the
+         * render pool */
+        struct pa_sink_render_job *render_jobs;
+        unsigned n_render_jobs_allocated;
+
         pa_rtpoll *rtpoll;
 
         pa_cvolume soft_volume;
@@ -179,6 +204,12 @@ struct pa_sink {
         size_t rewind_nbytes;
         pa_bool_t rewind_requested;
 
+        /* While the render pool is busy the rewind requests of the
+         * inputs are only collected here, as the maximum nbytes plus
+         * one, and applied by the IO thread when the batch is done */
+        pa_bool_t defer_rewinds;
+        pa_atomic_t deferred_rewind;
+
         /* Both dynamic and fixed latencies will be clamped to this
          * range. */
         pa_usec_t min_latency; /* we won't go below this latency */
@@ -190,6 +221,10 @@ struct pa_sink {
         pa_usec_t fixed_latency; /* for sinks with PA_SINK_DYNAMIC_LATENCY this is 0 */
     } thread_info;
 
+    /* Render profile, written from the IO thread, may be read from
+     * everywhere */
+    pa_histogram profile[PA_SINK_PROBE_MAX];
+
     void *userdata;
 };
 
@@ -238,6 +273,10 @@ typedef struct pa_sink_new_data {
     pa_cvolume volume;
     pa_bool_t muted :1;
 
+    /* Worker threads for PA_SINK_PARALLEL_RENDER, 0 for one less than
+     * there are CPUs */
+    unsigned render_threads;
+
     pa_bool_t sample_spec_is_set:1;
     pa_bool_t channel_map_is_set:1;
     pa_bool_t volume_is_set:1;
@@ -322,6 +361,8 @@ unsigned pa_sink_used_by(pa_sink *s); /* Number of connected streams which are n
 unsigned pa_sink_check_suspend(pa_sink *s); /* Returns how many streams are active that don't allow suspensions */
 #define pa_sink_get_state(s) ((s)->state)
 
+const char *pa_sink_probe_to_string(pa_sink_probe_t p);
+
 /* Moves all inputs away, and stores them in pa_queue */
 pa_queue *pa_sink_move_all_start(pa_sink *s, pa_queue *q);
 void pa_sink_move_all_finish(pa_sink *s, pa_queue *q, pa_bool_t save);
@@ -37,6 +37,8 @@
 
 #include <pulsecore/winsock.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/flist.h>
+#include <pulsecore/proplist-util.h>
 
 #include "tagstruct.h"
 
@@ -48,28 +50,53 @@ struct pa_tagstruct {
     size_t rindex;
 
     pa_bool_t dynamic;
+
+    /* Tagstructs we build ourselves are written right into the data
+     * of this packet, so that they can be sent without copying */
+    pa_packet *packet;
 };
 
+PA_STATIC_FLIST_DECLARE(tagstructs, 0, pa_xfree);
+
 pa_tagstruct *pa_tagstruct_new(const uint8_t* data, size_t length) {
     pa_tagstruct*t;
 
     pa_assert(!data || (data && length));
 
-    t = pa_xnew(pa_tagstruct, 1);
-    t->data = (uint8_t*) data;
-    t->allocated = t->length = data ? length : 0;
+    if (!(t = pa_flist_pop(PA_STATIC_FLIST_GET(tagstructs))))
+        t = pa_xnew(pa_tagstruct, 1);
+
+    if (data) {
+        t->packet = NULL;
+        t->data = (uint8_t*) data;
+        t->allocated = t->length = length;
+    } else {
+        t->packet = pa_packet_new(PA_PACKET_POOL_SIZE_SMALL);
+        t->data = t->packet->data;
+        t->allocated = t->packet->length;
+        t->length = 0;
+    }
+
     t->rindex = 0;
     t->dynamic = !data;
 
     return t;
 }
 
+static void recycle(pa_tagstruct *t) {
+    pa_assert(t);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(tagstructs), t) < 0)
+        pa_xfree(t);
+}
+
 void pa_tagstruct_free(pa_tagstruct*t) {
     pa_assert(t);
 
-    if (t->dynamic)
-        pa_xfree(t->data);
-    pa_xfree(t);
+    if (t->packet)
+        pa_packet_unref(t->packet);
+
+    recycle(t);
 }
 
 uint8_t* pa_tagstruct_free_data(pa_tagstruct*t, size_t *l) {
@@ -79,20 +106,68 @@ uint8_t* pa_tagstruct_free_data(pa_tagstruct*t, size_t *l) {
     pa_assert(t->dynamic);
     pa_assert(l);
 
-    p = t->data;
+    p = t->length > 0 ? pa_xmemdup(t->data, t->length) : NULL;
     *l = t->length;
-    pa_xfree(t);
+
+    pa_tagstruct_free(t);
+    return p;
+}
+
+pa_packet* pa_tagstruct_free_packet(pa_tagstruct *t) {
+    pa_packet *p;
+
+    pa_assert(t);
+    pa_assert(t->dynamic);
+    pa_assert(t->length > 0);
+
+    p = t->packet;
+
+    /* Don't hold on to a mostly empty 4K block, the packet might sit
+     * in a queue for a while */
+    if (p->type == PA_PACKET_POOLED && t->length <= PA_PACKET_POOL_SIZE/2) {
+        p = pa_packet_new(t->length);
+        memcpy(p->data, t->data, t->length);
+        pa_packet_unref(t->packet);
+    } else
+        p->length = t->length;
+
+    recycle(t);
     return p;
 }
 
 static void extend(pa_tagstruct*t, size_t l) {
+    size_t n;
+
     pa_assert(t);
     pa_assert(t->dynamic);
 
     if (t->length+l <= t->allocated)
         return;
 
-    t->data = pa_xrealloc(t->data, t->allocated = t->length+l+100);
+    n = PA_MAX(t->allocated*2, t->length+l);
+
+    if (t->packet->type == PA_PACKET_DYNAMIC)
+        t->packet->data = pa_xrealloc(t->packet->data, n);
+    else {
+        pa_packet *p;
+
+        if (t->packet->type == PA_PACKET_POOLED_SMALL && n <= PA_PACKET_POOL_SIZE) {
+            /* Move up into the larger size class */
+            n = PA_PACKET_POOL_SIZE;
+            p = pa_packet_new(n);
+        } else
+            /* Too big for the pool, move over into a packet whose
+             * data we can grow on our own */
+            p = pa_packet_new_dynamic(pa_xmalloc(n), n);
+
+        memcpy(p->data, t->data, t->length);
+        pa_packet_unref(t->packet);
+        t->packet = p;
+    }
+
+    t->packet->length = n;
+    t->data = t->packet->data;
+    t->allocated = n;
 }
 
 void pa_tagstruct_puts(pa_tagstruct*t, const char *s) {
@@ -266,29 +341,45 @@ void pa_tagstruct_put_volume(pa_tagstruct *t, pa_volume_t vol) {
 }
 
 void pa_tagstruct_put_proplist(pa_tagstruct *t, pa_proplist *p) {
+    pa_proplist_serialized *s;
+    struct pa_property *prop;
     void *state = NULL;
+    size_t start;
+
     pa_assert(t);
     pa_assert(p);
 
-    extend(t, 1);
+    /* Lists are usually sent many times without being changed in
+     * between, so we keep a copy of what we generated the last time
+     * around with the list contents */
+    if ((s = pa_atomic_ptr_load(&p->data->serialized))) {
+        extend(t, s->length);
+        memcpy(t->data+t->length, PA_PROPLIST_SERIALIZED_DATA(s), s->length);
+        t->length += s->length;
+        return;
+    }
 
-    t->data[t->length++] = PA_TAG_PROPLIST;
+    start = t->length;
 
-    for (;;) {
-        const char *k;
-        const void *d;
-        size_t l;
+    extend(t, 1);
 
-        if (!(k = pa_proplist_iterate(p, &state)))
-            break;
+    t->data[t->length++] = PA_TAG_PROPLIST;
 
-        pa_tagstruct_puts(t, k);
-        pa_assert_se(pa_proplist_get(p, k, &d, &l) >= 0);
-        pa_tagstruct_putu32(t, (uint32_t) l);
-        pa_tagstruct_put_arbitrary(t, d, l);
+    PA_HASHMAP_FOREACH(prop, p->data->properties, state) {
+        pa_tagstruct_puts(t, prop->key);
+        pa_tagstruct_putu32(t, (uint32_t) prop->nbytes);
+        pa_tagstruct_put_arbitrary(t, prop->value, prop->nbytes);
     }
 
     pa_tagstruct_puts(t, NULL);
+
+    s = pa_xmalloc(PA_ALIGN(sizeof(pa_proplist_serialized)) + t->length - start);
+    s->length = t->length - start;
+    memcpy(PA_PROPLIST_SERIALIZED_DATA(s), t->data+start, s->length);
+
+    /* Somebody else might have been quicker with the same list */
+    if (!pa_atomic_ptr_cmpxchg(&p->data->serialized, NULL, s))
+        pa_xfree(s);
 }
 
 int pa_tagstruct_gets(pa_tagstruct*t, const char **s) {
@@ -34,6 +34,7 @@
 #include <pulse/gccmacro.h>
 
 #include <pulsecore/macro.h>
+#include <pulsecore/packet.h>
 
 typedef struct pa_tagstruct pa_tagstruct;
 
@@ -66,6 +67,10 @@ pa_tagstruct *pa_tagstruct_new(const uint8_t* data, size_t length);
 void pa_tagstruct_free(pa_tagstruct*t);
 uint8_t* pa_tagstruct_free_data(pa_tagstruct*t, size_t *l);
 
+/* Frees the tagstruct and returns what has been written to it as a
+ * packet, without copying */
+pa_packet* pa_tagstruct_free_packet(pa_tagstruct *t);
+
 int pa_tagstruct_eof(pa_tagstruct*t);
 const uint8_t* pa_tagstruct_data(pa_tagstruct*t, size_t *l);
 
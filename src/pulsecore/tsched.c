@@ -0,0 +1,455 @@
+/***
+  This file is part of PulseAudio.
+
+  Copyright 2008 Lennart Poettering
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/time-smoother.h>
+
+#include "tsched.h"
+
+/* #define DEBUG_TIMING */
+
+#define TSCHED_WATERMARK_INC_STEP_USEC (10*PA_USEC_PER_MSEC)       /* 10ms  -- On underrun, increase watermark by this */
+#define TSCHED_WATERMARK_DEC_STEP_USEC (5*PA_USEC_PER_MSEC)        /* 5ms   -- When everything's great, decrease watermark by this */
+#define TSCHED_WATERMARK_VERIFY_AFTER_USEC (20*PA_USEC_PER_SEC)    /* 20s   -- How long after a drop out recheck if things are good now */
+#define TSCHED_WATERMARK_INC_THRESHOLD_USEC (0*PA_USEC_PER_MSEC)   /* 0ms   -- If the buffer level ever below this theshold, increase the watermark */
+#define TSCHED_WATERMARK_DEC_THRESHOLD_USEC (100*PA_USEC_PER_MSEC) /* 100ms -- If the buffer level didn't drop below this theshold in the verification time, decrease the watermark */
+
+/* Note that TSCHED_WATERMARK_INC_THRESHOLD_USEC == 0 means tht we
+ * will increase the watermark only if we hit a real underrun. */
+
+#define TSCHED_MIN_SLEEP_USEC (10*PA_USEC_PER_MSEC)                /* 10ms  -- Sleep at least 10ms on each iteration */
+#define TSCHED_MIN_WAKEUP_USEC (4*PA_USEC_PER_MSEC)                /* 4ms   -- Wakeup at least this long before the buffer runs empty*/
+
+#define SMOOTHER_WINDOW_USEC (PA_TSCHED_DEFAULT_BUFFER_USEC*2)     /* 4s    -- smoother adjust and history time */
+#define SMOOTHER_MIN_INTERVAL (2*PA_USEC_PER_MSEC)                 /* 2ms   -- min smoother update interval */
+#define SMOOTHER_MAX_INTERVAL (200*PA_USEC_PER_MSEC)               /* 200ms -- max smoother update inteval */
+
+struct pa_tsched {
+    pa_sink *sink;
+
+    size_t
+        frame_size,
+        hwbuf_size,
+        hwbuf_unused,
+        watermark,
+        min_sleep,
+        min_wakeup,
+        watermark_inc_step,
+        watermark_dec_step,
+        watermark_inc_threshold,
+        watermark_dec_threshold;
+
+    pa_usec_t watermark_dec_not_before;
+
+    pa_bool_t use_tsched;
+
+    pa_smoother *smoother;
+    uint64_t write_count;
+    pa_usec_t smoother_interval;
+    pa_usec_t last_smoother_update;
+};
+
+static void fix_min_sleep_wakeup(pa_tsched *t) {
+    size_t max_use, max_use_2;
+
+    pa_assert(t);
+    pa_assert(t->use_tsched);
+
+    max_use = t->hwbuf_size - t->hwbuf_unused;
+    max_use_2 = pa_frame_align(max_use/2, &t->sink->sample_spec);
+
+    t->min_sleep = pa_usec_to_bytes(TSCHED_MIN_SLEEP_USEC, &t->sink->sample_spec);
+    t->min_sleep = PA_CLAMP(t->min_sleep, t->frame_size, max_use_2);
+
+    t->min_wakeup = pa_usec_to_bytes(TSCHED_MIN_WAKEUP_USEC, &t->sink->sample_spec);
+    t->min_wakeup = PA_CLAMP(t->min_wakeup, t->frame_size, max_use_2);
+}
+
+static void fix_tsched_watermark(pa_tsched *t) {
+    size_t max_use;
+
+    pa_assert(t);
+    pa_assert(t->use_tsched);
+
+    max_use = t->hwbuf_size - t->hwbuf_unused;
+
+    if (t->watermark > max_use - t->min_sleep)
+        t->watermark = max_use - t->min_sleep;
+
+    if (t->watermark < t->min_wakeup)
+        t->watermark = t->min_wakeup;
+}
+
+pa_tsched *pa_tsched_new(pa_sink *s, size_t hwbuf_size, size_t watermark, pa_bool_t use_tsched) {
+    pa_tsched *t;
+
+    pa_sink_assert_ref(s);
+    pa_assert(hwbuf_size > 0);
+
+    t = pa_xnew0(pa_tsched, 1);
+    t->sink = s;
+    t->frame_size = pa_frame_size(&s->sample_spec);
+    t->hwbuf_size = hwbuf_size;
+    t->use_tsched = use_tsched;
+
+    t->smoother = pa_smoother_new(
+            SMOOTHER_WINDOW_USEC,
+            SMOOTHER_WINDOW_USEC,
+            TRUE,
+            TRUE,
+            5,
+            pa_rtclock_now(),
+            TRUE);
+    t->smoother_interval = SMOOTHER_MIN_INTERVAL;
+
+    if (use_tsched) {
+        t->watermark = watermark;
+
+        t->watermark_inc_step = pa_usec_to_bytes(TSCHED_WATERMARK_INC_STEP_USEC, &s->sample_spec);
+        t->watermark_dec_step = pa_usec_to_bytes(TSCHED_WATERMARK_DEC_STEP_USEC, &s->sample_spec);
+
+        t->watermark_inc_threshold = pa_usec_to_bytes_round_up(TSCHED_WATERMARK_INC_THRESHOLD_USEC, &s->sample_spec);
+        t->watermark_dec_threshold = pa_usec_to_bytes_round_up(TSCHED_WATERMARK_DEC_THRESHOLD_USEC, &s->sample_spec);
+
+        fix_min_sleep_wakeup(t);
+        fix_tsched_watermark(t);
+    }
+
+    return t;
+}
+
+void pa_tsched_free(pa_tsched *t) {
+    pa_assert(t);
+
+    pa_smoother_free(t->smoother);
+    pa_xfree(t);
+}
+
+size_t pa_tsched_get_watermark(pa_tsched *t) {
+    pa_assert(t);
+
+    return t->watermark;
+}
+
+size_t pa_tsched_get_unused(pa_tsched *t) {
+    pa_assert(t);
+
+    return t->hwbuf_unused;
+}
+
+pa_bool_t pa_tsched_update_requested_latency(pa_tsched *t) {
+    size_t before;
+
+    pa_assert(t);
+
+    before = t->hwbuf_unused;
+
+    /* Use the full buffer if noone asked us for anything specific */
+    t->hwbuf_unused = 0;
+
+    if (t->use_tsched) {
+        pa_usec_t latency;
+
+        if ((latency = pa_sink_get_requested_latency_within_thread(t->sink)) != (pa_usec_t) -1) {
+            size_t b;
+
+            pa_log_debug("Latency set to %0.2fms", (double) latency / PA_USEC_PER_MSEC);
+
+            b = pa_usec_to_bytes(latency, &t->sink->sample_spec);
+
+            /* We need at least one sample in our buffer */
+
+            if (PA_UNLIKELY(b < t->frame_size))
+                b = t->frame_size;
+
+            t->hwbuf_unused = PA_LIKELY(b < t->hwbuf_size) ? (t->hwbuf_size - b) : 0;
+        }
+
+        fix_min_sleep_wakeup(t);
+        fix_tsched_watermark(t);
+    }
+
+    pa_log_debug("hwbuf_unused=%lu", (unsigned long) t->hwbuf_unused);
+
+    pa_sink_set_max_request_within_thread(t->sink, t->hwbuf_size - t->hwbuf_unused);
+
+    return t->hwbuf_unused > before;
+}
+
+static void increase_watermark(pa_tsched *t) {
+    size_t old_watermark;
+    pa_usec_t old_min_latency, new_min_latency;
+
+    pa_assert(t);
+    pa_assert(t->use_tsched);
+
+    /* First, just try to increase the watermark */
+    old_watermark = t->watermark;
+    t->watermark = PA_MIN(t->watermark * 2, t->watermark + t->watermark_inc_step);
+    fix_tsched_watermark(t);
+
+    if (old_watermark != t->watermark) {
+        pa_log_info("Increasing wakeup watermark to %0.2f ms",
+                    (double) pa_bytes_to_usec(t->watermark, &t->sink->sample_spec) / PA_USEC_PER_MSEC);
+        return;
+    }
+
+    /* Hmm, we cannot increase the watermark any further, hence let's raise the latency */
+    old_min_latency = t->sink->thread_info.min_latency;
+    new_min_latency = PA_MIN(old_min_latency * 2, old_min_latency + TSCHED_WATERMARK_INC_STEP_USEC);
+    new_min_latency = PA_MIN(new_min_latency, t->sink->thread_info.max_latency);
+
+    if (old_min_latency != new_min_latency) {
+        pa_log_info("Increasing minimal latency to %0.2f ms",
+                    (double) new_min_latency / PA_USEC_PER_MSEC);
+
+        pa_sink_set_latency_range_within_thread(t->sink, new_min_latency, t->sink->thread_info.max_latency);
+    }
+
+    /* When we reach this we're officialy fucked! */
+}
+
+static void decrease_watermark(pa_tsched *t) {
+    size_t old_watermark;
+    pa_usec_t now;
+
+    pa_assert(t);
+    pa_assert(t->use_tsched);
+
+    now = pa_rtclock_now();
+
+    if (t->watermark_dec_not_before <= 0)
+        goto restart;
+
+    if (t->watermark_dec_not_before > now)
+        return;
+
+    old_watermark = t->watermark;
+
+    if (t->watermark < t->watermark_dec_step)
+        t->watermark = t->watermark / 2;
+    else
+        t->watermark = PA_MAX(t->watermark / 2, t->watermark - t->watermark_dec_step);
+
+    fix_tsched_watermark(t);
+
+    if (old_watermark != t->watermark)
+        pa_log_info("Decreasing wakeup watermark to %0.2f ms",
+                    (double) pa_bytes_to_usec(t->watermark, &t->sink->sample_spec) / PA_USEC_PER_MSEC);
+
+    /* We don't change the latency range*/
+
+restart:
+    t->watermark_dec_not_before = now + TSCHED_WATERMARK_VERIFY_AFTER_USEC;
+}
+
+size_t pa_tsched_check_left_to_play(pa_tsched *t, size_t n_bytes, pa_bool_t on_timeout, pa_bool_t settled) {
+    size_t left_to_play;
+    pa_bool_t underrun = FALSE;
+
+    pa_assert(t);
+
+    /* We use <= instead of < for this check here because an underrun
+     * only happens after the last sample was processed, not already when
+     * it is removed from the buffer. This is particularly important
+     * when block transfer is used. */
+
+    if (n_bytes <= t->hwbuf_size)
+        left_to_play = t->hwbuf_size - n_bytes;
+    else {
+
+        /* We got a dropout. What a mess! */
+        left_to_play = 0;
+        underrun = TRUE;
+
+#ifdef DEBUG_TIMING
+        PA_DEBUG_TRAP;
+#endif
+
+        if (settled)
+            if (pa_log_ratelimit())
+                pa_log_info("Underrun!");
+    }
+
+#ifdef DEBUG_TIMING
+    pa_log_debug("%0.2f ms left to play; inc threshold = %0.2f ms; dec threshold = %0.2f ms",
+                 (double) pa_bytes_to_usec(left_to_play, &t->sink->sample_spec) / PA_USEC_PER_MSEC,
+                 (double) pa_bytes_to_usec(t->watermark_inc_threshold, &t->sink->sample_spec) / PA_USEC_PER_MSEC,
+                 (double) pa_bytes_to_usec(t->watermark_dec_threshold, &t->sink->sample_spec) / PA_USEC_PER_MSEC);
+#endif
+
+    if (t->use_tsched) {
+        pa_bool_t reset_not_before = TRUE;
+
+        if (settled) {
+            if (underrun || left_to_play < t->watermark_inc_threshold)
+                increase_watermark(t);
+            else if (left_to_play > t->watermark_dec_threshold) {
+                reset_not_before = FALSE;
+
+                /* We decrease the watermark only if have actually
+                 * been woken up by a timeout. If something else woke
+                 * us up it's too easy to fulfill the deadlines... */
+
+                if (on_timeout)
+                    decrease_watermark(t);
+            }
+        }
+
+        if (reset_not_before)
+            t->watermark_dec_not_before = 0;
+    }
+
+    return left_to_play;
+}
+
+void pa_tsched_sleep_time(pa_tsched *t, pa_usec_t *sleep_usec, pa_usec_t *process_usec) {
+    pa_usec_t usec, wm;
+
+    pa_assert(sleep_usec);
+    pa_assert(process_usec);
+
+    pa_assert(t);
+    pa_assert(t->use_tsched);
+
+    usec = pa_sink_get_requested_latency_within_thread(t->sink);
+
+    if (usec == (pa_usec_t) -1)
+        usec = pa_bytes_to_usec(t->hwbuf_size, &t->sink->sample_spec);
+
+    wm = pa_bytes_to_usec(t->watermark, &t->sink->sample_spec);
+
+    if (wm > usec)
+        wm = usec/2;
+
+    *sleep_usec = usec - wm;
+    *process_usec = wm;
+
+#ifdef DEBUG_TIMING
+    pa_log_debug("Buffer time: %lu ms; Sleep time: %lu ms; Process time: %lu ms",
+                 (unsigned long) (usec / PA_USEC_PER_MSEC),
+                 (unsigned long) (*sleep_usec / PA_USEC_PER_MSEC),
+                 (unsigned long) (*process_usec / PA_USEC_PER_MSEC));
+#endif
+}
+
+size_t pa_tsched_rewind_limit(pa_tsched *t, size_t left_to_play) {
+    pa_assert(t);
+
+    /* Never rewind into what is going to be played before we can
+     * possibly write again */
+    if (left_to_play > t->watermark)
+        return left_to_play - t->watermark;
+
+    return 0;
+}
+
+void pa_tsched_set_timer(pa_tsched *t, pa_rtpoll *rtpoll, pa_usec_t sleep_usec) {
+    pa_usec_t cusec;
+
+    pa_assert(t);
+    pa_assert(rtpoll);
+
+    /* Convert from the sound card time domain to the
+     * system time domain */
+    cusec = pa_smoother_translate(t->smoother, pa_rtclock_now(), sleep_usec);
+
+#ifdef DEBUG_TIMING
+    pa_log_debug("Waking up in %0.2fms (sound card clock), %0.2fms (system clock).",
+                 (double) sleep_usec / PA_USEC_PER_MSEC, (double) cusec / PA_USEC_PER_MSEC);
+#endif
+
+    /* We don't trust the conversion, so we wake up whatever comes first */
+    pa_rtpoll_set_timer_relative(rtpoll, PA_MIN(sleep_usec, cusec));
+}
+
+void pa_tsched_written(pa_tsched *t, size_t nbytes) {
+    pa_assert(t);
+
+    t->write_count += nbytes;
+}
+
+void pa_tsched_rewound(pa_tsched *t, size_t nbytes) {
+    pa_assert(t);
+
+    t->write_count -= nbytes;
+}
+
+void pa_tsched_update_smoother(pa_tsched *t, pa_usec_t now, size_t delay) {
+    int64_t position;
+
+    pa_assert(t);
+
+    /* check if the time since the last update is bigger than the interval */
+    if (t->last_smoother_update > 0)
+        if (t->last_smoother_update + t->smoother_interval > now)
+            return;
+
+    position = (int64_t) t->write_count - (int64_t) delay;
+
+    if (PA_UNLIKELY(position < 0))
+        position = 0;
+
+    pa_smoother_put(t->smoother, now, pa_bytes_to_usec((uint64_t) position, &t->sink->sample_spec));
+
+    t->last_smoother_update = now;
+    /* exponentially increase the update interval up to the MAX limit */
+    t->smoother_interval = PA_MIN (t->smoother_interval * 2, SMOOTHER_MAX_INTERVAL);
+}
+
+pa_usec_t pa_tsched_get_latency(pa_tsched *t, pa_usec_t now) {
+    int64_t delay;
+
+    pa_assert(t);
+
+    delay = (int64_t) pa_bytes_to_usec(t->write_count, &t->sink->sample_spec) - (int64_t) pa_smoother_get(t->smoother, now);
+
+    return delay >= 0 ? (pa_usec_t) delay : 0;
+}
+
+void pa_tsched_start(pa_tsched *t, pa_usec_t now) {
+    pa_assert(t);
+
+    pa_smoother_resume(t->smoother, now, TRUE);
+}
+
+void pa_tsched_pause(pa_tsched *t, pa_usec_t now) {
+    pa_assert(t);
+
+    pa_smoother_pause(t->smoother, now);
+}
+
+void pa_tsched_reset(pa_tsched *t, pa_usec_t now) {
+    pa_assert(t);
+
+    t->write_count = 0;
+    pa_smoother_reset(t->smoother, now, TRUE);
+    t->smoother_interval = SMOOTHER_MIN_INTERVAL;
+    t->last_smoother_update = 0;
+}
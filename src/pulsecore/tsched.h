@@ -0,0 +1,90 @@
+#ifndef foopulsetschedhfoo
+#define foopulsetschedhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  Copyright 2008 Lennart Poettering
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <pulse/sample.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/rtpoll.h>
+
+/* Timer based scheduling for sinks that can tell how much space is
+ * left in their playback buffer. Instead of waking up once per
+ * fragment the IO thread fills the buffer up completely and sleeps
+ * until only the wakeup watermark is left to play. The watermark is
+ * adjusted dynamically: raised on underruns, lowered again when
+ * things have been fine for a while. A time smoother translates the
+ * sleep time from the device clock into the system clock.
+ *
+ * All sizes are in bytes of the sink sample spec. Except for
+ * pa_tsched_new() and pa_tsched_free() everything has to be called
+ * from the IO thread. */
+
+#define PA_TSCHED_DEFAULT_BUFFER_USEC (2*PA_USEC_PER_SEC)      /* 2s    -- Overall buffer size */
+#define PA_TSCHED_DEFAULT_WATERMARK_USEC (20*PA_USEC_PER_MSEC) /* 20ms  -- Fill up when only this much is left in the buffer */
+
+typedef struct pa_tsched pa_tsched;
+
+/* If use_tsched is FALSE only the latency estimation is done and the
+ * whole buffer is used, like for classic interrupt driven playback */
+pa_tsched *pa_tsched_new(pa_sink *s, size_t hwbuf_size, size_t watermark, pa_bool_t use_tsched);
+void pa_tsched_free(pa_tsched *t);
+
+size_t pa_tsched_get_watermark(pa_tsched *t);
+
+/* The part of the buffer we leave empty to fulfill the requested latency */
+size_t pa_tsched_get_unused(pa_tsched *t);
+
+/* Recalculates how much of the buffer is used after the requested
+ * latency changed and updates max_request accordingly. Returns TRUE
+ * if we now use less of the buffer than before, in which case the
+ * caller should ask for a full rewind. */
+pa_bool_t pa_tsched_update_requested_latency(pa_tsched *t);
+
+/* Takes the number of bytes that are currently free in the buffer
+ * and returns how many are left to play. Adapts the watermark unless
+ * the buffer was just (re)started or rewound, i.e. settled is FALSE. */
+size_t pa_tsched_check_left_to_play(pa_tsched *t, size_t n_bytes, pa_bool_t on_timeout, pa_bool_t settled);
+
+/* Splits the current latency into the time we may sleep and the time
+ * we need to process data before the buffer runs empty */
+void pa_tsched_sleep_time(pa_tsched *t, pa_usec_t *sleep_usec, pa_usec_t *process_usec);
+
+/* How much may be rewound if left_to_play bytes are still queued */
+size_t pa_tsched_rewind_limit(pa_tsched *t, size_t left_to_play);
+
+/* Programs the rtpoll timer to wake up after sleep_usec of device time */
+void pa_tsched_set_timer(pa_tsched *t, pa_rtpoll *rtpoll, pa_usec_t sleep_usec);
+
+/* Latency bookkeeping */
+void pa_tsched_written(pa_tsched *t, size_t nbytes);
+void pa_tsched_rewound(pa_tsched *t, size_t nbytes);
+void pa_tsched_update_smoother(pa_tsched *t, pa_usec_t now, size_t delay);
+pa_usec_t pa_tsched_get_latency(pa_tsched *t, pa_usec_t now);
+
+void pa_tsched_start(pa_tsched *t, pa_usec_t now);
+void pa_tsched_pause(pa_tsched *t, pa_usec_t now);
+void pa_tsched_reset(pa_tsched *t, pa_usec_t now);
+
+#endif
@@ -0,0 +1,209 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/asyncmsgq.h>
+#include <pulsecore/chunkring.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/atomic.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Simulates a client streaming small blocks to a sink whose IO thread
+ * renders every PERIOD_MS. With pa_asyncmsgq every block wakes up the
+ * IO thread, with pa_chunkring the IO thread only wakes up for
+ * rendering and picks up whatever accumulated in the meantime. */
+
+#define N_CHUNKS 1000
+#define CHUNK_USEC 200
+#define PERIOD_MS 10
+
+struct context {
+    pa_memblock *block;
+    pa_asyncmsgq *q;
+    pa_chunkring *r;
+    pa_atomic_t done;
+};
+
+static void producer(void *userdata) {
+    struct context *c = userdata;
+    pa_memchunk chunk;
+    unsigned i;
+
+    chunk.memblock = c->block;
+    chunk.length = 1;
+
+    for (i = 0; i < N_CHUNKS; i++) {
+        chunk.index = i;
+
+        if (c->r) {
+            /* A full ring would fall back to the message queue in
+             * the real thing, here we just wait for the reader */
+            while (pa_chunkring_push(c->r, &chunk) < 0)
+                usleep(CHUNK_USEC);
+        } else
+            pa_asyncmsgq_post(c->q, NULL, 0, NULL, 0, &chunk, NULL);
+
+        usleep(CHUNK_USEC);
+    }
+
+    pa_atomic_store(&c->done, 1);
+    pa_asyncmsgq_post(c->q, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL, NULL);
+}
+
+static void run(struct context *c, const char *name) {
+    pa_thread *t;
+    pa_usec_t start;
+    unsigned wakeups = 0, renders = 0, received = 0;
+    pa_bool_t quit = FALSE;
+
+    pa_atomic_store(&c->done, 0);
+    start = pa_rtclock_now();
+
+    pa_assert_se(t = pa_thread_new(producer, c));
+
+    while (!quit) {
+        struct pollfd pfd;
+        pa_msgobject *object;
+        int code, k;
+        void *data;
+        int64_t offset;
+        pa_memchunk chunk;
+
+        if (c->r)
+            while (pa_chunkring_pop(c->r, &chunk) >= 0) {
+                pa_assert_se(chunk.index == received++);
+                pa_memblock_unref(chunk.memblock);
+            }
+
+        while (pa_asyncmsgq_get(c->q, &object, &code, &data, &offset, &chunk, FALSE) == 0) {
+
+            if (code == PA_MESSAGE_SHUTDOWN)
+                quit = TRUE;
+            else
+                pa_assert_se(chunk.index == received++);
+
+            pa_asyncmsgq_done(c->q, 0);
+        }
+
+        if (quit)
+            break;
+
+        if (pa_asyncmsgq_read_before_poll(c->q) < 0)
+            continue;
+
+        pfd.fd = pa_asyncmsgq_read_fd(c->q);
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        pa_assert_se((k = poll(&pfd, 1, PERIOD_MS)) >= 0);
+
+        if (k > 0)
+            wakeups++;
+        else
+            renders++;
+
+        pa_asyncmsgq_read_after_poll(c->q);
+    }
+
+    pa_thread_free(t);
+
+    pa_assert_se(received == N_CHUNKS);
+
+    printf("%-10s %u chunks, %u message wakeups, %u render wakeups, %0.1f ms\n",
+           name, received, wakeups, renders, (double) (pa_rtclock_now() - start) / PA_USEC_PER_MSEC);
+}
+
+static void test_ring(pa_memblock *block) {
+    pa_chunkring *r;
+    pa_memchunk chunk;
+    unsigned i;
+
+    pa_assert_se(r = pa_chunkring_new(4));
+
+    chunk.memblock = block;
+    chunk.length = 1;
+
+    for (i = 0; i < 4; i++) {
+        chunk.index = i;
+        pa_assert_se(pa_chunkring_push(r, &chunk) == 0);
+    }
+
+    pa_assert_se(pa_chunkring_push(r, &chunk) < 0);
+
+    for (i = 0; i < 2; i++) {
+        pa_assert_se(pa_chunkring_pop(r, &chunk) == 0);
+        pa_assert_se(chunk.index == i);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    /* Wrap around and leave some entries for pa_chunkring_free() */
+    chunk.memblock = block;
+    chunk.index = 4;
+    pa_assert_se(pa_chunkring_push(r, &chunk) == 0);
+
+    pa_assert_se(pa_chunkring_pop(r, &chunk) == 0);
+    pa_assert_se(chunk.index == 2);
+    pa_memblock_unref(chunk.memblock);
+
+    pa_chunkring_free(r);
+
+    r = pa_chunkring_new(0);
+    pa_assert_se(pa_chunkring_pop(r, &chunk) < 0);
+    pa_chunkring_free(r);
+}
+
+int main(int argc, char *argv[]) {
+    pa_mempool *pool;
+    struct context c;
+
+    pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+    pa_assert_se(c.block = pa_memblock_new(pool, N_CHUNKS));
+
+    test_ring(c.block);
+
+    pa_assert_se(c.q = pa_asyncmsgq_new(0));
+
+    c.r = NULL;
+    run(&c, "asyncmsgq:");
+
+    pa_assert_se(c.r = pa_chunkring_new(0));
+    run(&c, "chunkring:");
+    pa_chunkring_free(c.r);
+
+    pa_asyncmsgq_unref(c.q);
+
+    pa_memblock_unref(c.block);
+    pa_mempool_free(pool);
+
+    return 0;
+}
@@ -0,0 +1,257 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/codec.h>
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+
+#define FRAMES 48000
+
+static pa_mempool *pool;
+
+static void generate(const pa_sample_spec *ss, void *data, unsigned frames) {
+    unsigned i, ch;
+
+    for (i = 0; i < frames; i++)
+        for (ch = 0; ch < ss->channels; ch++) {
+            double v;
+
+            /* Two tones and a bit of noise */
+            v = 0.4 * sin(2 * M_PI * 440 * i / ss->rate + ch) +
+                0.2 * sin(2 * M_PI * 3000 * i / ss->rate) +
+                0.01 * ((double) rand() / RAND_MAX - 0.5);
+
+            switch (ss->format) {
+                case PA_SAMPLE_S16LE:
+                    ((int16_t*) data)[i * ss->channels + ch] = PA_INT16_TO_LE((int16_t) (v * 0x7FFF));
+                    break;
+                case PA_SAMPLE_S16BE:
+                    ((int16_t*) data)[i * ss->channels + ch] = PA_INT16_TO_BE((int16_t) (v * 0x7FFF));
+                    break;
+                case PA_SAMPLE_FLOAT32NE:
+                    ((float*) data)[i * ss->channels + ch] = (float) v;
+                    break;
+                default:
+                    pa_assert_not_reached();
+            }
+        }
+}
+
+static double snr(const pa_sample_spec *ss, const void *a, const void *b, unsigned frames) {
+    double signal = 0, noise = 0, x, y;
+    unsigned i;
+
+    for (i = 0; i < frames * ss->channels; i++) {
+        if (ss->format == PA_SAMPLE_FLOAT32NE) {
+            x = ((const float*) a)[i];
+            y = ((const float*) b)[i];
+        } else {
+            x = ((const int16_t*) a)[i];
+            y = ((const int16_t*) b)[i];
+        }
+
+        signal += x * x;
+        noise += (x - y) * (x - y);
+    }
+
+    return noise > 0 ? 10 * log10(signal / noise) : INFINITY;
+}
+
+static void run(pa_codec_type_t type, pa_sample_format_t format, unsigned channels) {
+    pa_sample_spec ss;
+    pa_codec *enc, *dec;
+    pa_memchunk pcm, out;
+    size_t length, encoded = 0, decoded = 0, packets = 0;
+    uint8_t *input, *output, *p;
+    double s;
+
+    ss.format = format;
+    ss.rate = 48000;
+    ss.channels = (uint8_t) channels;
+
+    pa_assert_se(pa_codec_supported(type, &ss));
+
+    length = FRAMES * pa_frame_size(&ss);
+    input = pa_xmalloc(length);
+    output = pa_xmalloc(length);
+    generate(&ss, input, FRAMES);
+
+    enc = pa_codec_new(type, &ss, pa_codec_packet_size(&ss, pa_usec_to_bytes(25 * PA_USEC_PER_MSEC, &ss)), pool);
+    dec = pa_codec_new(type, &ss, 0, pool);
+
+    pcm.memblock = pa_memblock_new_fixed(pool, input, length, TRUE);
+    pcm.index = 0;
+    pcm.length = length;
+
+    while (pcm.length > 0) {
+        pa_memchunk packet;
+        size_t l;
+
+        l = pa_codec_encode(enc, &pcm, &packet);
+        pa_assert_se(l > 0 && l <= pcm.length);
+        pcm.index += l;
+        pcm.length -= l;
+
+        encoded += packet.length;
+        packets++;
+
+        /* Hand the packet to the decoder in random pieces, like a
+         * pa_pstream would */
+        while (packet.length > 0) {
+            pa_memchunk piece = packet;
+
+            piece.length = PA_MIN(packet.length, (size_t) (rand() % 3000) + 1);
+            packet.index += piece.length;
+            packet.length -= piece.length;
+
+            pa_assert_se(pa_codec_decode(dec, &piece, &out) == 0);
+
+            if (out.memblock) {
+                pa_assert_se(decoded + out.length <= length);
+
+                p = pa_memblock_acquire(out.memblock);
+                memcpy(output + decoded, p + out.index, out.length);
+                pa_memblock_release(out.memblock);
+                pa_memblock_unref(out.memblock);
+
+                decoded += out.length;
+            }
+        }
+
+        pa_memblock_unref(packet.memblock);
+    }
+
+    pa_memblock_unref_fixed(pcm.memblock);
+
+    pa_assert_se(decoded == length);
+
+    s = snr(&ss, input, output, FRAMES);
+
+    printf("%-8s %-10s %u ch: %lu packets, %0.1f%% of the PCM size, SNR %0.1f dB\n",
+           pa_codec_type_to_string(type), pa_sample_format_to_string(format), channels,
+           (unsigned long) packets, 100.0 * encoded / length, s);
+
+    if (type == PA_CODEC_LOSSLESS) {
+        pa_assert_se(memcmp(input, output, length) == 0);
+        pa_assert_se(encoded < length);
+    } else {
+        pa_assert_se(s > 20);
+        pa_assert_se(encoded < length / 3);
+    }
+
+    pa_codec_free(enc);
+    pa_codec_free(dec);
+    pa_xfree(input);
+    pa_xfree(output);
+}
+
+static void corrupt(void) {
+    pa_sample_spec ss;
+    pa_codec *c;
+    pa_memchunk chunk, out;
+    uint8_t *d;
+    unsigned i;
+
+    ss.format = PA_SAMPLE_S16LE;
+    ss.rate = 44100;
+    ss.channels = 2;
+
+    c = pa_codec_new(PA_CODEC_LOSSLESS, &ss, 4096, pool);
+
+    /* A header with the wrong channel count */
+    chunk.memblock = pa_memblock_new(pool, 8);
+    chunk.index = 0;
+    chunk.length = 8;
+    d = pa_memblock_acquire(chunk.memblock);
+    memcpy(d, "\x01\x01\x10\x00\x10\x00\x00\x00", 8);
+    pa_memblock_release(chunk.memblock);
+
+    pa_assert_se(pa_codec_decode(c, &chunk, &out) < 0);
+    pa_assert_se(!out.memblock);
+
+    pa_memblock_unref(chunk.memblock);
+    pa_codec_free(c);
+
+    c = pa_codec_new(PA_CODEC_LOSSLESS, &ss, 4096, pool);
+
+    /* A Rice quotient that would wrap around to a zero residual when
+     * shifted by the Rice parameter. 512 frames, the first channel
+     * with order 1, k = 20 and 4096 zero bits before the first stop
+     * bit, the second one with order 0, k = 0 and all residuals 0. */
+    chunk.memblock = pa_memblock_new(pool, 8 + 1858 + 66);
+    chunk.index = 0;
+    chunk.length = 8 + 1858 + 66;
+    d = pa_memblock_acquire(chunk.memblock);
+    memset(d, 0, chunk.length);
+    memcpy(d, "\x01\x02\x00\x02\x84\x07\x00\x00\x01\xff\x7f\x14", 12);
+
+    for (i = 0; i < 511; i++) {
+        unsigned bit = 4096 + 21 * i;
+        d[12 + bit / 8] |= 0x80 >> (bit % 8);
+    }
+
+    memset(d + 8 + 1858 + 2, 0xFF, 64);
+    pa_memblock_release(chunk.memblock);
+
+    pa_assert_se(pa_codec_decode(c, &chunk, &out) < 0);
+    pa_assert_se(!out.memblock);
+
+    pa_memblock_unref(chunk.memblock);
+    pa_codec_free(c);
+}
+
+int main(int argc, char *argv[]) {
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+
+    srand(4711);
+
+    pa_assert_se(pa_codec_type_from_string("lossless") == PA_CODEC_LOSSLESS);
+    pa_assert_se(pa_codec_type_from_string("foo") == PA_CODEC_MAX);
+
+    /* Big units are split evenly */
+    {
+        pa_sample_spec ss = { PA_SAMPLE_S16LE, 48000, 2 };
+        pa_assert_se(pa_codec_packet_size(&ss, 1200 * 4) == 1200 * 4);
+        pa_assert_se(pa_codec_packet_size(&ss, 6000 * 4) == 3000 * 4);
+    }
+
+    run(PA_CODEC_LOSSLESS, PA_SAMPLE_S16LE, 2);
+    run(PA_CODEC_LOSSLESS, PA_SAMPLE_S16BE, 1);
+    run(PA_CODEC_ADPCM, PA_SAMPLE_S16LE, 2);
+    run(PA_CODEC_ADPCM, PA_SAMPLE_FLOAT32NE, 6);
+
+    corrupt();
+
+    pa_mempool_free(pool);
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <pulse/timeval.h>
+
+#include <pulsecore/drift.h>
+#include <pulsecore/macro.h>
+
+/* Simulates a source whose clock runs 100 ppm fast feeding a sink in
+ * fragments of jittery size, and checks that the drift engine finds
+ * the right rate and keeps the queue at the target length. */
+
+#define RATE 48000
+#define DRIFT 100e-6
+#define FRAGMENT (10*PA_USEC_PER_MSEC)
+#define TARGET (50*PA_USEC_PER_MSEC)
+#define BLOCK 336
+
+static double run(pa_usec_t time_constant, pa_usec_t start_latency, double *rate_error) {
+    pa_drift *d;
+    pa_usec_t now = 0;
+    double queue, pending = 0, rate = RATE, sum = 0, rate_sum = 0;
+    unsigned i, n = 0;
+
+    d = pa_drift_new(RATE, time_constant);
+    pa_drift_set_target(d, TARGET);
+
+    /* in frames of the source */
+    queue = (double) start_latency * RATE / PA_USEC_PER_SEC;
+
+    for (i = 0; i < 60000; i++) {
+        pa_usec_t latency, dt;
+
+        /* Our fragments are a bit late now and then */
+        dt = FRAGMENT + (pa_usec_t) (rand() % 500);
+        now += dt;
+
+        /* The source writes in blocks that don't line up with our
+         * fragments */
+        pending += RATE * (1.0 + DRIFT) * dt / PA_USEC_PER_SEC;
+        while (pending >= BLOCK) {
+            queue += BLOCK;
+            pending -= BLOCK;
+        }
+
+        queue -= rate * dt / PA_USEC_PER_SEC;
+        pa_assert(queue > 0);
+
+        latency = (pa_usec_t) (queue * PA_USEC_PER_SEC / RATE);
+        rate = pa_drift_update(d, now, latency);
+
+        pa_assert(rate >= RATE * (1.0 - PA_DRIFT_MAX_DEVIATION) - 0.001);
+        pa_assert(rate <= RATE * (1.0 + PA_DRIFT_MAX_DEVIATION) + 0.001);
+
+        /* Only look at the last quarter, when things should be
+         * settled. The single measurements jump around by a block. */
+        if (i >= 45000) {
+            sum += (double) latency;
+            rate_sum += rate;
+            n++;
+        }
+    }
+
+    *rate_error = fabs(rate_sum / n / RATE - 1.0 - DRIFT);
+
+    pa_drift_free(d);
+
+    return fabs(sum / n - (double) TARGET);
+}
+
+int main(int argc, char *argv[]) {
+    static const pa_usec_t time_constants[] = { 2 * PA_USEC_PER_SEC, 10 * PA_USEC_PER_SEC };
+    static const pa_usec_t start_latencies[] = { TARGET, 20 * PA_USEC_PER_MSEC, 200 * PA_USEC_PER_MSEC };
+    unsigned i, j;
+
+    srand(0);
+
+    for (i = 0; i < PA_ELEMENTSOF(time_constants); i++)
+        for (j = 0; j < PA_ELEMENTSOF(start_latencies); j++) {
+            double latency_error, rate_error;
+
+            latency_error = run(time_constants[i], start_latencies[j], &rate_error);
+
+            printf("time constant %llu ms, start %llu ms: latency error %0.1f usec, rate error %0.2f ppm\n",
+                   (unsigned long long) (time_constants[i] / PA_USEC_PER_MSEC),
+                   (unsigned long long) (start_latencies[j] / PA_USEC_PER_MSEC),
+                   latency_error, rate_error * 1e6);
+
+            /* Sub-millisecond latency error, and the drift estimate
+             * within 10 ppm of the real one */
+            pa_assert(latency_error < PA_USEC_PER_MSEC);
+            pa_assert(rate_error < 10e-6);
+        }
+
+    return 0;
+}
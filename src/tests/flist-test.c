@@ -25,17 +25,28 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <stdio.h>
+
 #include <pulse/util.h>
 #include <pulse/xmalloc.h>
+#include <pulse/rtclock.h>
 #include <pulsecore/flist.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/log.h>
+#include <pulsecore/atomic.h>
+#include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
 
 #define THREADS_MAX 20
 
+/* For the benchmark: every thread takes BATCH entries from the list
+ * and puts them back, ITERATIONS times */
+#define BATCH 4
+#define ITERATIONS 200000
+
 static pa_flist *flist;
 static int quit = 0;
+static pa_atomic_t go = PA_ATOMIC_INIT(0);
 
 static void spin(void) {
     int k;
@@ -80,11 +91,12 @@ static void thread_func(void *data) {
         pa_xfree(s);
 }
 
-int main(int argc, char* argv[]) {
+static void stress(pa_flist *l) {
     pa_thread *threads[THREADS_MAX];
     int i;
 
-    flist = pa_flist_new(0);
+    flist = l;
+    quit = 0;
 
     for (i = 0; i < THREADS_MAX; i++) {
         threads[i] = pa_thread_new(thread_func, pa_sprintf_malloc("Thread #%i", i+1));
@@ -98,6 +110,120 @@ int main(int argc, char* argv[]) {
         pa_thread_free(threads[i]);
 
     pa_flist_free(flist, pa_xfree);
+}
+
+/* Every thread leaves a few entries in its magazine and waits until
+ * the list has been freed */
+#define LEFT_BEHIND 8
+
+static pa_atomic_t n_ready = PA_ATOMIC_INIT(0);
+static pa_atomic_t n_freed = PA_ATOMIC_INIT(0);
+
+static void count_free(void *p) {
+    pa_atomic_inc(&n_freed);
+    pa_xfree(p);
+}
+
+static void left_behind_thread_func(void *data) {
+    unsigned i;
+
+    for (i = 0; i < LEFT_BEHIND; i++)
+        pa_assert_se(pa_flist_push(flist, pa_xnew(int, 1)) == 0);
+
+    pa_atomic_inc(&n_ready);
+
+    while (!pa_atomic_load(&go))
+        pa_thread_yield();
+}
+
+static void left_behind(void) {
+    pa_thread *threads[THREADS_MAX];
+    unsigned i;
+
+    flist = pa_flist_new_with_magazines(0, count_free);
+    pa_atomic_store(&go, 0);
+
+    for (i = 0; i < THREADS_MAX; i++)
+        pa_assert_se(threads[i] = pa_thread_new(left_behind_thread_func, NULL));
+
+    while (pa_atomic_load(&n_ready) < THREADS_MAX)
+        pa_thread_yield();
+
+    /* All entries are still in the magazines of running threads */
+    pa_flist_free(flist, count_free);
+    pa_assert_se(pa_atomic_load(&n_freed) == THREADS_MAX * LEFT_BEHIND);
+
+    pa_atomic_store(&go, 1);
+
+    for (i = 0; i < THREADS_MAX; i++)
+        pa_thread_free(threads[i]);
+
+    pa_assert_se(pa_atomic_load(&n_freed) == THREADS_MAX * LEFT_BEHIND);
+}
+
+static void benchmark_thread_func(void *data) {
+    void *items[BATCH];
+    unsigned i, j;
+
+    while (!pa_atomic_load(&go))
+        pa_thread_yield();
+
+    for (i = 0; i < ITERATIONS; i++) {
+
+        for (j = 0; j < BATCH; j++)
+            if (!(items[j] = pa_flist_pop(flist)))
+                items[j] = pa_xnew(int, 1);
+
+        for (j = 0; j < BATCH; j++)
+            if (pa_flist_push(flist, items[j]) < 0)
+                pa_xfree(items[j]);
+    }
+}
+
+static void benchmark(pa_bool_t magazines) {
+    pa_thread *threads[THREADS_MAX];
+    unsigned n, i;
+
+    for (n = 1; n <= THREADS_MAX; n = n < 16 ? n * 2 : n + 4) {
+        pa_usec_t start, stop;
+
+        flist = magazines ? pa_flist_new_with_magazines(0, pa_xfree) : pa_flist_new(0);
+        pa_atomic_store(&go, 0);
+
+        for (i = 0; i < n; i++)
+            pa_assert_se(threads[i] = pa_thread_new(benchmark_thread_func, NULL));
+
+        start = pa_rtclock_now();
+        pa_atomic_store(&go, 1);
+
+        for (i = 0; i < n; i++)
+            pa_thread_free(threads[i]);
+
+        stop = pa_rtclock_now();
+
+        printf("%-9s %2u threads: %8.2f ns/op\n",
+               magazines ? "magazines" : "shared", n,
+               (double) (stop - start) * 1000.0 / ((double) n * ITERATIONS * BATCH * 2));
+
+        pa_flist_free(flist, pa_xfree);
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    /* With -b we measure the throughput when the list is used from
+     * several threads at the same time, with and without per-thread
+     * caches */
+    if (argc > 1 && pa_streq(argv[1], "-b")) {
+        benchmark(FALSE);
+        benchmark(TRUE);
+        return 0;
+    }
+
+    left_behind();
+
+    stress(pa_flist_new(0));
+    stress(pa_flist_new_with_magazines(0, pa_xfree));
 
     return 0;
 }
@@ -0,0 +1,209 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/macro.h>
+
+/* Times put/get/iterate/remove on a pa_hashmap with string keys and
+ * a pa_idxset with pointers, at various sizes, and checks the results
+ * along the way. */
+
+/* Roughly how many operations of each kind to time per size */
+#define OPERATIONS 1000000
+
+static const unsigned sizes[] = { 10, 100, 1000, 10000, 100000 };
+
+static pa_usec_t start;
+
+static void begin(void) {
+    start = pa_rtclock_now();
+}
+
+static double end(unsigned operations) {
+    return (double) (pa_rtclock_now() - start) * 1000.0 / operations;
+}
+
+static void shuffle(unsigned *order, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        order[i] = i;
+
+    for (i = n - 1; i > 0; i--) {
+        unsigned j = (unsigned) rand() % (i + 1), t;
+
+        t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+}
+
+static void bench_hashmap(unsigned n, unsigned rounds, char **keys, unsigned *order) {
+    double put = 0, get = 0, iterate = 0, remove = 0;
+    unsigned r, i;
+
+    for (r = 0; r < rounds; r++) {
+        pa_hashmap *h;
+        void *state;
+        const void *key;
+        char *v;
+
+        h = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+
+        begin();
+        for (i = 0; i < n; i++)
+            pa_assert_se(pa_hashmap_put(h, keys[i], keys[i]) == 0);
+        put += end(n * rounds);
+
+        pa_assert_se(pa_hashmap_size(h) == n);
+        pa_assert_se(pa_hashmap_put(h, keys[0], NULL) < 0);
+
+        begin();
+        for (i = 0; i < n; i++)
+            pa_assert_se(pa_hashmap_get(h, keys[order[i]]) == keys[order[i]]);
+        get += end(n * rounds);
+
+        pa_assert_se(!pa_hashmap_get(h, "missing"));
+
+        /* Iteration follows the insertion order */
+        i = 0;
+        begin();
+        for (state = NULL; (v = pa_hashmap_iterate(h, &state, &key)); i++)
+            pa_assert_se(v == keys[i] && key == keys[i]);
+        iterate += end(n * rounds);
+
+        pa_assert_se(i == n);
+
+        begin();
+        for (i = 0; i < n; i++)
+            pa_assert_se(pa_hashmap_remove(h, keys[order[i]]) == keys[order[i]]);
+        remove += end(n * rounds);
+
+        pa_assert_se(pa_hashmap_isempty(h));
+
+        pa_hashmap_free(h, NULL, NULL);
+    }
+
+    printf("hashmap %6u: put %6.1f  get %6.1f  iterate %6.1f  remove %6.1f ns\n", n, put, get, iterate, remove);
+}
+
+static void bench_idxset(unsigned n, unsigned rounds, char **keys, unsigned *order) {
+    double put = 0, get_index = 0, get_data = 0, iterate = 0, remove = 0;
+    unsigned r, i;
+
+    for (r = 0; r < rounds; r++) {
+        pa_idxset *s;
+        uint32_t idx, *indexes;
+        char *v;
+
+        s = pa_idxset_new(NULL, NULL);
+        indexes = pa_xnew(uint32_t, n);
+
+        begin();
+        for (i = 0; i < n; i++)
+            pa_assert_se(pa_idxset_put(s, keys[i], &indexes[i]) == 0);
+        put += end(n * rounds);
+
+        pa_assert_se(pa_idxset_size(s) == n);
+
+        begin();
+        for (i = 0; i < n; i++)
+            pa_assert_se(pa_idxset_get_by_index(s, indexes[order[i]]) == keys[order[i]]);
+        get_index += end(n * rounds);
+
+        begin();
+        for (i = 0; i < n; i++)
+            pa_assert_se(pa_idxset_get_by_data(s, keys[order[i]], &idx) == keys[order[i]]);
+        get_data += end(n * rounds);
+
+        /* Iteration follows the insertion order */
+        i = 0;
+        begin();
+        PA_IDXSET_FOREACH(v, s, idx) {
+            pa_assert_se(v == keys[i] && idx == indexes[i]);
+            i++;
+        }
+        iterate += end(n * rounds);
+
+        pa_assert_se(i == n);
+
+        /* Remove every other entry by index, the rest by data */
+        begin();
+        for (i = 0; i < n; i++)
+            if (i % 2)
+                pa_assert_se(pa_idxset_remove_by_index(s, indexes[order[i]]) == keys[order[i]]);
+            else
+                pa_assert_se(pa_idxset_remove_by_data(s, keys[order[i]], NULL) == keys[order[i]]);
+        remove += end(n * rounds);
+
+        pa_assert_se(pa_idxset_isempty(s));
+
+        pa_idxset_free(s, NULL, NULL);
+        pa_xfree(indexes);
+    }
+
+    printf("idxset  %6u: put %6.1f  get %6.1f/%6.1f  iterate %6.1f  remove %6.1f ns\n", n, put, get_index, get_data, iterate, remove);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned k, i, max_n = 0;
+    char **keys;
+    unsigned *order;
+
+    srand(4711);
+
+    for (k = 0; k < PA_ELEMENTSOF(sizes); k++)
+        max_n = PA_MAX(max_n, sizes[k]);
+
+    keys = pa_xnew(char*, max_n);
+    for (i = 0; i < max_n; i++)
+        keys[i] = pa_sprintf_malloc("key-%u", i);
+
+    order = pa_xnew(unsigned, max_n);
+
+    for (k = 0; k < PA_ELEMENTSOF(sizes); k++) {
+        unsigned n = sizes[k], rounds = PA_MAX(OPERATIONS / n, 1U);
+
+        shuffle(order, n);
+
+        bench_hashmap(n, rounds, keys, order);
+        bench_idxset(n, rounds, keys, order);
+    }
+
+    for (i = 0; i < max_n; i++)
+        pa_xfree(keys[i]);
+
+    pa_xfree(keys);
+    pa_xfree(order);
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+
+#include <pulse/timeval.h>
+
+#include <pulsecore/histogram.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+int main(int argc, char *argv[]) {
+    pa_histogram h;
+    uint64_t a, b;
+    unsigned i, total = 0;
+
+    pa_histogram_reset(&h);
+
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS; i++)
+        pa_assert_se(pa_histogram_get(&h, i) == 0);
+
+    pa_histogram_add(&h, 0);
+    pa_histogram_add(&h, 1);
+    pa_assert_se(pa_histogram_get(&h, 0) == 2);
+
+    pa_histogram_add(&h, 2);
+    pa_histogram_add(&h, 3);
+    pa_assert_se(pa_histogram_get(&h, 1) == 2);
+
+    pa_histogram_add(&h, 1023);
+    pa_histogram_add(&h, 1024);
+    pa_assert_se(pa_histogram_get(&h, 9) == 1);
+    pa_assert_se(pa_histogram_get(&h, 10) == 1);
+
+    /* Everything too long ends up in the last bucket */
+    pa_histogram_add(&h, 60 * PA_NSEC_PER_SEC);
+    pa_histogram_add(&h, (uint64_t) -1);
+    pa_assert_se(pa_histogram_get(&h, PA_HISTOGRAM_BUCKETS-1) == 2);
+
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS; i++)
+        total += pa_histogram_get(&h, i);
+    pa_assert_se(total == 8);
+
+    a = pa_histogram_now();
+    b = pa_histogram_now();
+    pa_assert_se(b >= a);
+
+    pa_histogram_add_since(&h, a);
+
+    total = 0;
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS; i++)
+        total += pa_histogram_get(&h, i);
+    pa_assert_se(total == 9);
+
+    /* Probes that were not started are not accounted */
+    pa_assert_se(pa_histogram_start(FALSE) == 0);
+    pa_histogram_add_since(&h, pa_histogram_start(FALSE));
+    pa_histogram_add_since(&h, pa_histogram_start(TRUE));
+
+    total = 0;
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS; i++)
+        total += pa_histogram_get(&h, i);
+    pa_assert_se(total == 10);
+
+    pa_histogram_reset(&h);
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS; i++)
+        pa_assert_se(pa_histogram_get(&h, i) == 0);
+
+    return 0;
+}
@@ -22,6 +22,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <pulsecore/memblock.h>
@@ -65,7 +66,7 @@ static void print_stats(pa_mempool *p, const char *text) {
 }
 
 int main(int argc, char *argv[]) {
-    pa_mempool *pool_a, *pool_b, *pool_c;
+    pa_mempool *pool_a, *pool_b, *pool_c, *pool_m;
     unsigned id_a, id_b, id_c;
     pa_memexport *export_a, *export_b;
     pa_memimport *import_b, *import_c;
@@ -158,6 +159,56 @@ int main(int argc, char *argv[]) {
         pa_memexport_free(export_a);
     }
 
+    /* memfd segments are only reachable through the fd we pass
+     * along, and B must not hand the block on to anybody else */
+    if ((pool_m = pa_mempool_new_memfd(0))) {
+        unsigned id_m;
+
+        printf("memfd memory block\n");
+
+        pa_assert(pa_mempool_is_memfd_backed(pool_m));
+        pa_assert_se(pa_mempool_get_shm_id(pool_m, &id_m) >= 0);
+
+        mb_a = pa_memblock_new_pool(pool_m, sizeof(txt));
+        x = pa_memblock_acquire(mb_a);
+        snprintf(x, pa_memblock_get_length(mb_a), "%s", txt);
+        pa_memblock_release(mb_a);
+
+        export_a = pa_memexport_new(pool_m, revoke_cb, (void*) "M");
+        export_b = pa_memexport_new(pool_b, revoke_cb, (void*) "B");
+        import_b = pa_memimport_new(pool_b, release_cb, (void*) "B");
+
+        r = pa_memexport_put(export_a, mb_a, &id, &shm_id, &offset, &size);
+        pa_assert(r >= 0);
+        pa_assert(shm_id == id_m);
+
+        /* Without the fd the segment cannot be found */
+        pa_assert(!pa_memimport_get(import_b, id, shm_id, offset, size));
+
+        r = pa_memimport_attach_memfd(import_b, id_m, dup(pa_mempool_get_memfd_fd(pool_m)));
+        pa_assert(r >= 0);
+
+        mb_b = pa_memimport_get(import_b, id, shm_id, offset, size);
+        pa_assert(mb_b);
+        x = pa_memblock_acquire(mb_b);
+        printf("3 data=%s\n", x);
+        pa_assert(strcmp(x, txt) == 0);
+        pa_memblock_release(mb_b);
+
+        r = pa_memexport_put(export_b, mb_b, &id, &shm_id, &offset, &size);
+        pa_assert(r >= 0);
+        pa_assert(shm_id == id_b);
+        pa_memblock_unref(mb_b);
+
+        pa_memexport_free(export_b);
+        pa_memimport_free(import_b);
+        pa_memblock_unref(mb_a);
+        pa_memexport_free(export_a);
+
+        pa_mempool_free(pool_m);
+    } else
+        printf("memfd not supported, skipping.\n");
+
     printf("vaccuuming...\n");
 
     pa_mempool_vacuum(pool_a);
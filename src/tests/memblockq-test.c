@@ -25,9 +25,17 @@
 #include <assert.h>
 #include <stdio.h>
 #include <signal.h>
+#include <string.h>
+
+#include <pulse/rtclock.h>
 
 #include <pulsecore/memblockq.h>
 #include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define N_BLOCKS 10000
+#define BLOCK_SIZE 8
+#define N_WRITES 10000
 
 static void dump(pa_memblockq *bq) {
     printf(">");
@@ -53,6 +61,170 @@ static void dump(pa_memblockq *bq) {
     printf("<\n");
 }
 
+/* Fills a queue with many small blocks and then overwrites random ones
+ * of them, which needs the queue to look up blocks far away from the
+ * last write position */
+static void benchmark(pa_mempool *p) {
+    pa_memblockq *bq;
+    pa_memblock *data;
+    pa_memchunk chunk;
+    uint8_t *d, expected[N_BLOCKS];
+    pa_usec_t start, stop;
+    unsigned i;
+    int ret;
+
+    /* Every second block is left empty, so that neighbouring chunks are
+     * never contiguous and don't get merged */
+    data = pa_memblock_new(p, N_BLOCKS * 2 * BLOCK_SIZE);
+    d = pa_memblock_acquire(data);
+    for (i = 0; i < N_BLOCKS * 2 * BLOCK_SIZE; i++)
+        d[i] = (uint8_t) (i / BLOCK_SIZE);
+    pa_memblock_release(data);
+
+    bq = pa_memblockq_new(0, N_BLOCKS * BLOCK_SIZE, 0, BLOCK_SIZE, 0, BLOCK_SIZE, N_BLOCKS * BLOCK_SIZE, NULL);
+    assert(bq);
+
+    chunk.memblock = data;
+    chunk.length = BLOCK_SIZE;
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < N_BLOCKS; i++) {
+        chunk.index = 2 * i * BLOCK_SIZE;
+        ret = pa_memblockq_push(bq, &chunk);
+        assert(ret == 0);
+        expected[i] = (uint8_t) (2 * i);
+    }
+
+    stop = pa_rtclock_now();
+    assert(pa_memblockq_get_nblocks(bq) == N_BLOCKS);
+    printf("%u appends: %llu usec\n", N_BLOCKS, (unsigned long long) (stop - start));
+
+    srand(0);
+    start = pa_rtclock_now();
+
+    for (i = 0; i < N_WRITES; i++) {
+        unsigned j, k;
+
+        j = (unsigned) rand() % N_BLOCKS;
+        k = (unsigned) rand() % N_BLOCKS;
+
+        pa_memblockq_seek(bq, (int64_t) (j * BLOCK_SIZE), PA_SEEK_ABSOLUTE, TRUE);
+        chunk.index = (2 * k + 1) * BLOCK_SIZE;
+        ret = pa_memblockq_push(bq, &chunk);
+        assert(ret == 0);
+        expected[j] = (uint8_t) (2 * k + 1);
+    }
+
+    stop = pa_rtclock_now();
+    printf("%u random writes into %u blocks: %llu usec\n", N_WRITES, pa_memblockq_get_nblocks(bq), (unsigned long long) (stop - start));
+
+    pa_memblockq_seek(bq, 0, PA_SEEK_RELATIVE_END, TRUE);
+
+    /* Read everything, then jump back and forth within the rewind
+     * buffer */
+    for (i = 0; i < 2; i++) {
+        int64_t idx = 0;
+
+        start = pa_rtclock_now();
+
+        while (idx < N_BLOCKS * BLOCK_SIZE) {
+            pa_memchunk out;
+
+            ret = pa_memblockq_peek(bq, &out);
+            assert(ret == 0);
+            assert(out.memblock);
+
+            d = pa_memblock_acquire(out.memblock);
+            assert(d[out.index] == expected[idx / BLOCK_SIZE]);
+            pa_memblock_release(out.memblock);
+            pa_memblock_unref(out.memblock);
+
+            pa_memblockq_drop(bq, BLOCK_SIZE);
+            idx += BLOCK_SIZE;
+
+            if (i == 1 && idx < N_BLOCKS * BLOCK_SIZE) {
+                /* Go back to the front, look at the block there and
+                 * come back */
+                pa_memblockq_rewind(bq, (size_t) idx);
+
+                ret = pa_memblockq_peek(bq, &out);
+                assert(ret == 0);
+                d = pa_memblock_acquire(out.memblock);
+                assert(d[out.index] == expected[0]);
+                pa_memblock_release(out.memblock);
+                pa_memblock_unref(out.memblock);
+
+                pa_memblockq_drop(bq, (size_t) idx);
+            }
+        }
+
+        stop = pa_rtclock_now();
+        printf("%s read of %u blocks: %llu usec\n", i == 0 ? "sequential" : "seeking", N_BLOCKS, (unsigned long long) (stop - start));
+
+        pa_memblockq_rewind(bq, N_BLOCKS * BLOCK_SIZE);
+    }
+
+    pa_memblockq_free(bq);
+    pa_memblock_unref(data);
+}
+
+/* Small writes from many different blocks should end up in a few
+ * entries when write combining is enabled */
+static void write_combining(pa_mempool *p) {
+    pa_memblockq *bq;
+    pa_memchunk chunk, out;
+    uint8_t *d;
+    pa_usec_t start, stop;
+    unsigned i, n;
+    int ret;
+
+    bq = pa_memblockq_new(0, N_BLOCKS * BLOCK_SIZE, 0, BLOCK_SIZE, 0, BLOCK_SIZE, 0, NULL);
+    assert(bq);
+
+    pa_memblockq_set_write_combining(bq, p, 4 * BLOCK_SIZE);
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < N_BLOCKS; i++) {
+        chunk.memblock = pa_memblock_new(p, BLOCK_SIZE);
+        chunk.index = 0;
+        chunk.length = BLOCK_SIZE;
+
+        d = pa_memblock_acquire(chunk.memblock);
+        memset(d, (uint8_t) i, BLOCK_SIZE);
+        pa_memblock_release(chunk.memblock);
+
+        ret = pa_memblockq_push(bq, &chunk);
+        assert(ret == 0);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    stop = pa_rtclock_now();
+
+    n = pa_memblockq_get_nblocks(bq);
+    printf("%u combined writes: %u blocks, %llu usec\n", N_BLOCKS, n, (unsigned long long) (stop - start));
+    assert(n <= N_BLOCKS * BLOCK_SIZE / (pa_mempool_block_size_max(p) / 2));
+
+    for (i = 0; i < N_BLOCKS; i++) {
+        ret = pa_memblockq_peek(bq, &out);
+        assert(ret == 0);
+        assert(out.length >= BLOCK_SIZE);
+
+        d = pa_memblock_acquire(out.memblock);
+        assert(d[out.index] == (uint8_t) i);
+        assert(d[out.index + BLOCK_SIZE - 1] == (uint8_t) i);
+        pa_memblock_release(out.memblock);
+        pa_memblock_unref(out.memblock);
+
+        pa_memblockq_drop(bq, BLOCK_SIZE);
+    }
+
+    assert(pa_memblockq_get_length(bq) == 0);
+
+    pa_memblockq_free(bq);
+}
+
 int main(int argc, char *argv[]) {
     int ret;
 
@@ -158,6 +330,9 @@ int main(int argc, char *argv[]) {
     pa_memblock_unref(chunk3.memblock);
     pa_memblock_unref(chunk4.memblock);
 
+    benchmark(p);
+    write_combining(p);
+
     pa_mempool_free(p);
 
     return 0;
@@ -22,15 +22,33 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <pulse/sample.h>
 #include <pulse/volume.h>
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
 
 #include <pulsecore/resampler.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/endianmacros.h>
 #include <pulsecore/memblock.h>
 #include <pulsecore/sample-util.h>
+#include <pulsecore/random.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/cpu-arm.h>
+
+#define MAX_STREAMS 32
+#define FRAMES 1021
+#define TIMES 1000
+
+static const pa_sample_format_t optimized_formats[] = {
+    PA_SAMPLE_S16NE,
+    PA_SAMPLE_S32NE,
+    PA_SAMPLE_FLOAT32NE
+};
 
 static float swap_float(float a) {
     uint32_t *b = (uint32_t*) &a;
@@ -204,15 +222,202 @@ static pa_memblock* generate_block(pa_mempool *pool, const pa_sample_spec *ss) {
     return r;
 }
 
+static pa_memblock* generate_random_block(pa_mempool *pool, const pa_sample_spec *ss, unsigned frames) {
+    pa_memblock *r;
+    void *d;
+    unsigned i, n;
+
+    n = frames * ss->channels;
+    pa_assert_se(r = pa_memblock_new(pool, pa_frame_size(ss) * frames));
+    d = pa_memblock_acquire(r);
+
+    pa_random(d, pa_memblock_get_length(r));
+
+    /* Random bits make lousy floats, keep them in the usual range */
+    if (ss->format == PA_SAMPLE_FLOAT32NE)
+        for (i = 0; i < n; i++)
+            ((float*) d)[i] = (float) ((int16_t*) d)[i*2] / 0x8000;
+
+    pa_memblock_release(r);
+
+    return r;
+}
+
+static void setup_streams(pa_mempool *pool, const pa_sample_spec *ss, pa_mix_info m[], unsigned nstreams, unsigned frames) {
+    unsigned i, c;
+
+    for (i = 0; i < nstreams; i++) {
+        m[i].chunk.memblock = generate_random_block(pool, ss, frames);
+        m[i].chunk.length = pa_memblock_get_length(m[i].chunk.memblock);
+        m[i].chunk.index = 0;
+        m[i].volume.channels = ss->channels;
+        m[i].userdata = NULL;
+
+        for (c = 0; c < ss->channels; c++)
+            m[i].volume.values[c] = pa_sw_volume_from_linear(0.05 + 1.5 * (double) ((i * 7 + c * 3) % 17) / 17);
+    }
+}
+
+static void free_streams(pa_mix_info m[], unsigned nstreams) {
+    unsigned i;
+
+    for (i = 0; i < nstreams; i++)
+        pa_memblock_unref(m[i].chunk.memblock);
+}
+
+static pa_bool_t samples_equal(const pa_sample_spec *ss, const void *a, const void *b, unsigned n, unsigned nstreams) {
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        switch (ss->format) {
+            case PA_SAMPLE_S16NE:
+                if (((const int16_t*) a)[i] != ((const int16_t*) b)[i]) {
+                    printf("%u: %d != %d\n", i, ((const int16_t*) a)[i], ((const int16_t*) b)[i]);
+                    return FALSE;
+                }
+                break;
+
+            case PA_SAMPLE_S32NE: {
+                /* The optimized version may round only once instead
+                 * of once per stream */
+                int64_t d = (int64_t) ((const int32_t*) a)[i] - (int64_t) ((const int32_t*) b)[i];
+
+                if (d > (int64_t) nstreams || d < -(int64_t) nstreams) {
+                    printf("%u: %d != %d\n", i, ((const int32_t*) a)[i], ((const int32_t*) b)[i]);
+                    return FALSE;
+                }
+                break;
+            }
+
+            case PA_SAMPLE_FLOAT32NE:
+                if (memcmp((const float*) a + i, (const float*) b + i, sizeof(float)) != 0) {
+                    printf("%u: %f != %f\n", i, ((const float*) a)[i], ((const float*) b)[i]);
+                    return FALSE;
+                }
+                break;
+
+            default:
+                pa_assert_not_reached();
+        }
+    }
+
+    return TRUE;
+}
+
+static void compare_mix_funcs(pa_mempool *pool, pa_sample_format_t f, pa_do_mix_func_t ref, pa_do_mix_func_t opt) {
+    pa_sample_spec ss;
+    pa_mix_info m[MAX_STREAMS];
+    unsigned nstreams;
+    void *a, *b;
+
+    ss.format = f;
+    ss.rate = 44100;
+
+    for (ss.channels = 1; ss.channels <= 8; ss.channels++) {
+        for (nstreams = 2; nstreams <= MAX_STREAMS; nstreams *= 2) {
+            size_t length;
+
+            setup_streams(pool, &ss, m, nstreams, FRAMES);
+            length = m[0].chunk.length;
+
+            a = pa_xmalloc(length);
+            b = pa_xmalloc(length);
+
+            pa_set_mix_func(f, ref);
+            pa_assert_se(pa_mix(m, nstreams, a, length, &ss, NULL, FALSE) == length);
+            pa_set_mix_func(f, opt);
+            pa_assert_se(pa_mix(m, nstreams, b, length, &ss, NULL, FALSE) == length);
+
+            if (!samples_equal(&ss, a, b, FRAMES * ss.channels, nstreams)) {
+                printf("optimized %s mixer differs for %u channels, %u streams\n",
+                       pa_sample_format_to_string(f), ss.channels, nstreams);
+                pa_assert_not_reached();
+            }
+
+            pa_xfree(a);
+            pa_xfree(b);
+            free_streams(m, nstreams);
+        }
+    }
+
+    printf("=== optimized mixer for %s matches\n", pa_sample_format_to_string(f));
+}
+
+static void benchmark_mix_func(pa_mempool *pool, pa_sample_format_t f, pa_do_mix_func_t func, const char *name) {
+    pa_sample_spec ss;
+    pa_mix_info m[MAX_STREAMS];
+    unsigned nstreams, j;
+    pa_usec_t start, stop;
+    size_t length;
+    void *d;
+
+    ss.format = f;
+    ss.rate = 44100;
+    ss.channels = 2;
+
+    pa_set_mix_func(f, func);
+
+    for (nstreams = 1; nstreams <= MAX_STREAMS; nstreams *= 2) {
+        setup_streams(pool, &ss, m, nstreams, FRAMES);
+        length = m[0].chunk.length;
+        d = pa_xmalloc(length);
+
+        start = pa_rtclock_now();
+        for (j = 0; j < TIMES; j++)
+            pa_mix(m, nstreams, d, length, &ss, NULL, FALSE);
+        stop = pa_rtclock_now();
+
+        printf("%-10s %-5s %2u streams: %8.2f ns/frame\n",
+               pa_sample_format_to_string(f), name, nstreams,
+               (double) (stop - start) * 1000.0 / ((double) TIMES * FRAMES));
+
+        pa_xfree(d);
+        free_streams(m, nstreams);
+    }
+}
+
 int main(int argc, char *argv[]) {
     pa_mempool *pool;
     pa_sample_spec a;
     pa_cvolume v;
 
-    pa_log_set_level(PA_LOG_DEBUG);
+    pa_do_mix_func_t ref[PA_ELEMENTSOF(optimized_formats)];
+    unsigned f;
+    pa_bool_t benchmark;
+
+    benchmark = argc > 1 && pa_streq(argv[1], "-b");
+
+    pa_log_set_level(benchmark ? PA_LOG_WARN : PA_LOG_DEBUG);
 
     pa_assert_se(pool = pa_mempool_new(FALSE, 0));
 
+    for (f = 0; f < PA_ELEMENTSOF(optimized_formats); f++)
+        ref[f] = pa_get_mix_func(optimized_formats[f]);
+
+    pa_cpu_init_x86();
+    pa_cpu_init_arm();
+
+    if (benchmark) {
+        for (f = 0; f < PA_ELEMENTSOF(optimized_formats); f++) {
+            pa_do_mix_func_t opt = pa_get_mix_func(optimized_formats[f]);
+
+            benchmark_mix_func(pool, optimized_formats[f], ref[f], "C");
+
+            if (opt != ref[f])
+                benchmark_mix_func(pool, optimized_formats[f], opt, "SIMD");
+        }
+
+        pa_mempool_free(pool);
+        return 0;
+    }
+
+    for (f = 0; f < PA_ELEMENTSOF(optimized_formats); f++) {
+        pa_do_mix_func_t opt = pa_get_mix_func(optimized_formats[f]);
+
+        if (opt != ref[f])
+            compare_mix_funcs(pool, optimized_formats[f], ref[f], opt);
+    }
+
     a.channels = 1;
     a.rate = 44100;
 
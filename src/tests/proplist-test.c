@@ -22,12 +22,88 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 
 #include <pulse/proplist.h>
 #include <pulse/xmalloc.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/modargs.h>
+#include <pulsecore/tagstruct.h>
+
+/* Serializes p twice, the second time from the cache, and checks
+ * that both times the same comes out and that it can be read back */
+static void check_serialize(pa_proplist *p) {
+    pa_tagstruct *t;
+    const uint8_t *d;
+    size_t l1, l2;
+    pa_proplist *q;
+    char *s, *u;
+
+    t = pa_tagstruct_new(NULL, 0);
+    pa_tagstruct_put_proplist(t, p);
+    pa_tagstruct_data(t, &l1);
+    pa_tagstruct_put_proplist(t, p);
+    d = pa_tagstruct_data(t, &l2);
+    pa_assert_se(l2 == 2 * l1);
+    pa_assert_se(memcmp(d, d + l1, l1) == 0);
+
+    q = pa_proplist_new();
+    pa_assert_se(pa_tagstruct_get_proplist(t, q) == 0);
+    s = pa_proplist_to_string(p);
+    u = pa_proplist_to_string(q);
+    pa_assert_se(pa_streq(s, u));
+
+    pa_xfree(s);
+    pa_xfree(u);
+    pa_proplist_free(q);
+    pa_tagstruct_free(t);
+}
+
+static void copy_on_write(void) {
+    pa_proplist *a, *b, *c;
+    void *state = NULL;
+    const char *v;
+
+    a = pa_proplist_new();
+    pa_assert_se(pa_proplist_sets(a, PA_PROP_MEDIA_NAME, "Eins") == 0);
+    pa_assert_se(pa_proplist_sets(a, "foo.bar", "Zwei") == 0);
+    check_serialize(a);
+
+    /* Copies share everything until one of them is changed */
+    b = pa_proplist_copy(a);
+    v = pa_proplist_gets(a, PA_PROP_MEDIA_NAME);
+    pa_assert_se(pa_proplist_gets(b, PA_PROP_MEDIA_NAME) == v);
+
+    pa_assert_se(pa_proplist_sets(b, PA_PROP_MEDIA_NAME, "Drei") == 0);
+    pa_assert_se(pa_streq(pa_proplist_gets(a, PA_PROP_MEDIA_NAME), "Eins"));
+    pa_assert_se(pa_streq(pa_proplist_gets(b, PA_PROP_MEDIA_NAME), "Drei"));
+    pa_assert_se(pa_proplist_size(b) == 2);
+    check_serialize(a);
+    check_serialize(b);
+
+    /* Replacing a value keeps the order */
+    pa_assert_se(pa_streq(pa_proplist_iterate(b, &state), PA_PROP_MEDIA_NAME));
+
+    c = pa_proplist_new();
+    pa_proplist_update(c, PA_UPDATE_REPLACE, a);
+    pa_assert_se(pa_proplist_unset(c, "foo.bar") == 0);
+    pa_assert_se(pa_proplist_contains(a, "foo.bar") == 1);
+    pa_assert_se(pa_proplist_unset(c, "foo.bar") == -2);
+
+    pa_proplist_update(c, PA_UPDATE_MERGE, b);
+    pa_assert_se(pa_streq(pa_proplist_gets(c, PA_PROP_MEDIA_NAME), "Eins"));
+    pa_assert_se(pa_streq(pa_proplist_gets(c, "foo.bar"), "Zwei"));
+    check_serialize(c);
+
+    pa_proplist_clear(a);
+    pa_assert_se(pa_proplist_isempty(a));
+    pa_assert_se(pa_proplist_size(c) == 2);
+
+    pa_proplist_free(a);
+    pa_proplist_free(b);
+    pa_proplist_free(c);
+}
 
 int main(int argc, char*argv[]) {
     pa_modargs *ma;
@@ -92,5 +168,7 @@ int main(int argc, char*argv[]) {
     pa_proplist_free(a);
     pa_modargs_free(ma);
 
+    copy_on_write();
+
     return 0;
 }
@@ -0,0 +1,363 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/iochannel.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/pstream.h>
+
+enum {
+    FRAME_PACKET,
+    FRAME_MEMBLOCK,
+    FRAME_RELEASE,
+    FRAME_REVOKE
+};
+
+struct frame {
+    int type;
+    uint32_t channel;
+    int64_t offset;
+    pa_seek_mode_t seek;
+    size_t size; /* the block id for release and revoke frames */
+};
+
+/* Release and revoke frames have no payload, the big ones don't fit
+ * into the read-ahead buffer of the receiving side. The block ids
+ * don't refer to anything, which the receiver has to ignore. */
+static const struct frame frames[] = {
+    { FRAME_PACKET,   0, 0,     PA_SEEK_RELATIVE,      10 },
+    { FRAME_MEMBLOCK, 1, 0,     PA_SEEK_RELATIVE,      100 },
+    { FRAME_RELEASE,  0, 0,     PA_SEEK_RELATIVE,      4711 },
+    { FRAME_MEMBLOCK, 2, -4096, PA_SEEK_RELATIVE,      1 },
+    { FRAME_PACKET,   0, 0,     PA_SEEK_RELATIVE,      10000 },
+    { FRAME_REVOKE,   0, 0,     PA_SEEK_RELATIVE,      42 },
+    { FRAME_MEMBLOCK, 1, 12345, PA_SEEK_ABSOLUTE,      10000 },
+    { FRAME_PACKET,   0, 0,     PA_SEEK_RELATIVE,      1 },
+    { FRAME_RELEASE,  0, 0,     PA_SEEK_RELATIVE,      0 },
+    { FRAME_REVOKE,   0, 0,     PA_SEEK_RELATIVE,      1 },
+    { FRAME_MEMBLOCK, 3, 1,     PA_SEEK_RELATIVE_ON_READ, 3 },
+    { FRAME_MEMBLOCK, 3, 2,     PA_SEEK_RELATIVE_END,  4096 },
+    { FRAME_PACKET,   0, 0,     PA_SEEK_RELATIVE,      4097 },
+    { FRAME_PACKET,   0, 0,     PA_SEEK_RELATIVE,      20 },
+};
+
+#define N_FRAMES PA_ELEMENTSOF(frames)
+
+static unsigned current;
+static size_t received;
+
+static uint8_t content(unsigned k, size_t j) {
+    return (uint8_t) (k * 37 + j);
+}
+
+/* Release and revoke frames don't show up on the receiving side */
+static const struct frame *next_frame(void) {
+
+    while (current < N_FRAMES &&
+           (frames[current].type == FRAME_RELEASE || frames[current].type == FRAME_REVOKE))
+        current++;
+
+    pa_assert_se(current < N_FRAMES);
+
+    return frames + current;
+}
+
+static void packet_cb(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
+    const struct frame *f;
+    size_t j;
+
+    f = next_frame();
+
+    pa_assert_se(f->type == FRAME_PACKET);
+    pa_assert_se(packet->length == f->size);
+
+    for (j = 0; j < packet->length; j++)
+        pa_assert_se(packet->data[j] == content(current, j));
+
+    current++;
+}
+
+static void memblock_cb(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    const struct frame *f;
+    const uint8_t *d;
+    size_t j;
+
+    f = next_frame();
+
+    pa_assert_se(f->type == FRAME_MEMBLOCK);
+    pa_assert_se(channel == f->channel);
+    pa_assert_se(chunk->length > 0);
+    pa_assert_se(received + chunk->length <= f->size);
+
+    /* Only the first part of a frame carries the seek information */
+    if (received == 0)
+        pa_assert_se(offset == f->offset && seek == f->seek);
+    else
+        pa_assert_se(offset == 0 && seek == PA_SEEK_RELATIVE);
+
+    d = (const uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index;
+
+    for (j = 0; j < chunk->length; j++)
+        pa_assert_se(d[j] == content(current, received + j));
+
+    pa_memblock_release(chunk->memblock);
+
+    received += chunk->length;
+
+    if (received >= f->size) {
+        received = 0;
+        current++;
+    }
+}
+
+static void die_cb(pa_pstream *p, void *userdata) {
+    pa_assert_not_reached();
+}
+
+static void send_frames(pa_pstream *p, pa_mempool *pool) {
+    unsigned k;
+
+    for (k = 0; k < N_FRAMES; k++) {
+        const struct frame *f = frames + k;
+        uint8_t *d;
+        size_t j;
+
+        switch (f->type) {
+
+            case FRAME_PACKET: {
+                pa_packet *packet;
+
+                packet = pa_packet_new(f->size);
+
+                for (j = 0; j < f->size; j++)
+                    packet->data[j] = content(k, j);
+
+                pa_pstream_send_packet(p, packet, NULL);
+                pa_packet_unref(packet);
+                break;
+            }
+
+            case FRAME_MEMBLOCK: {
+                pa_memchunk chunk;
+
+                /* Send from the middle of a block */
+                chunk.memblock = pa_memblock_new(pool, f->size + 16);
+                chunk.index = 16;
+                chunk.length = f->size;
+
+                d = (uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index;
+                for (j = 0; j < f->size; j++)
+                    d[j] = content(k, j);
+                pa_memblock_release(chunk.memblock);
+
+                pa_pstream_send_memblock(p, f->channel, f->offset, f->seek, &chunk);
+                pa_memblock_unref(chunk.memblock);
+                break;
+            }
+
+            case FRAME_RELEASE:
+                pa_pstream_send_release(p, (uint32_t) f->size);
+                break;
+
+            case FRAME_REVOKE:
+                pa_pstream_send_revoke(p, (uint32_t) f->size);
+                break;
+        }
+    }
+}
+
+static pa_pstream *receiver_new(pa_mainloop_api *a, int fd, pa_mempool *pool) {
+    pa_pstream *p;
+
+    p = pa_pstream_new(a, pa_iochannel_new(a, fd, fd), pool);
+    pa_pstream_set_recieve_packet_callback(p, packet_cb, NULL);
+    pa_pstream_set_recieve_memblock_callback(p, memblock_cb, NULL);
+    pa_pstream_set_die_callback(p, die_cb, NULL);
+
+    /* Release frames are refused otherwise */
+    pa_pstream_enable_shm(p, TRUE);
+
+    return p;
+}
+
+static void receive_all(pa_mainloop *m) {
+
+    current = 0;
+    received = 0;
+
+    while (current < N_FRAMES)
+        pa_assert_se(pa_mainloop_iterate(m, 1, NULL) >= 0);
+}
+
+/* Straight from one pstream to the other */
+static void direct(pa_mainloop *m, pa_mempool *pool, pa_mempool *shared_pool) {
+    pa_mainloop_api *a;
+    pa_pstream *sender, *receiver;
+    int fds[2];
+
+    a = pa_mainloop_get_api(m);
+    pa_assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    sender = pa_pstream_new(a, pa_iochannel_new(a, fds[0], fds[0]), pool);
+    pa_pstream_set_die_callback(sender, die_cb, NULL);
+    receiver = receiver_new(a, fds[1], shared_pool);
+
+    send_frames(sender, pool);
+    receive_all(m);
+
+    pa_assert_se(!pa_pstream_is_pending(sender));
+
+    pa_pstream_unlink(sender);
+    pa_pstream_unref(sender);
+    pa_pstream_unlink(receiver);
+    pa_pstream_unref(receiver);
+
+    fprintf(stderr, "direct: ok\n");
+}
+
+/* Returns the raw byte stream a pstream writes for our frames */
+static uint8_t *capture(pa_mainloop *m, pa_mempool *pool, size_t *length) {
+    pa_mainloop_api *a;
+    pa_pstream *sender;
+    int fds[2];
+    uint8_t *buf = NULL;
+    size_t allocated = 0;
+
+    a = pa_mainloop_get_api(m);
+    pa_assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    pa_make_fd_nonblock(fds[1]);
+
+    sender = pa_pstream_new(a, pa_iochannel_new(a, fds[0], fds[0]), pool);
+    pa_pstream_set_die_callback(sender, die_cb, NULL);
+
+    send_frames(sender, pool);
+
+    *length = 0;
+
+    for (;;) {
+        ssize_t r;
+
+        if (allocated - *length < 4096)
+            buf = pa_xrealloc(buf, allocated += 65536);
+
+        if ((r = read(fds[1], buf + *length, allocated - *length)) > 0) {
+            *length += (size_t) r;
+            continue;
+        }
+
+        pa_assert_se(r < 0 && errno == EAGAIN);
+
+        if (!pa_pstream_is_pending(sender))
+            break;
+
+        pa_assert_se(pa_mainloop_iterate(m, 0, NULL) >= 0);
+    }
+
+    pa_pstream_unlink(sender);
+    pa_pstream_unref(sender);
+    pa_close(fds[1]);
+
+    return buf;
+}
+
+/* Feeds the captured stream to a pstream piece by piece, so that reads
+ * end at every possible position within the frames */
+static void replay(pa_mainloop *m, pa_mempool *pool, const uint8_t *buf, size_t length, size_t piece) {
+    pa_mainloop_api *a;
+    pa_pstream *receiver;
+    int fds[2];
+    size_t idx, l;
+
+    a = pa_mainloop_get_api(m);
+    pa_assert_se(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    receiver = receiver_new(a, fds[1], pool);
+
+    current = 0;
+    received = 0;
+
+    for (idx = 0; idx < length; idx += l) {
+        l = PA_MIN(piece, length - idx);
+
+        pa_assert_se(pa_loop_write(fds[0], buf + idx, l, NULL) == (ssize_t) l);
+
+        while (pa_mainloop_iterate(m, 0, NULL) > 0)
+            ;
+    }
+
+    while (current < N_FRAMES)
+        pa_assert_se(pa_mainloop_iterate(m, 1, NULL) >= 0);
+
+    pa_pstream_unlink(receiver);
+    pa_pstream_unref(receiver);
+    pa_close(fds[0]);
+
+    fprintf(stderr, "%lu byte pieces: ok\n", (unsigned long) piece);
+}
+
+int main(int argc, char *argv[]) {
+    static const size_t pieces[] = { 1, 3, 7, 20, 64, 4096 + 13, 0 };
+    pa_mainloop *m;
+    pa_mempool *pool, *shared_pool;
+    uint8_t *buf;
+    size_t length;
+    unsigned i;
+
+    pa_assert_se(m = pa_mainloop_new());
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+
+    if (!(shared_pool = pa_mempool_new(TRUE, 0))) {
+        fprintf(stderr, "No shared memory, skipping.\n");
+        pa_mempool_free(pool);
+        pa_mainloop_free(m);
+        return 0;
+    }
+
+    direct(m, pool, shared_pool);
+
+    buf = capture(m, pool, &length);
+    fprintf(stderr, "captured %lu bytes\n", (unsigned long) length);
+
+    /* The last one hands over everything at once */
+    for (i = 0; i < PA_ELEMENTSOF(pieces); i++)
+        replay(m, shared_pool, buf, length, pieces[i] > 0 ? pieces[i] : length);
+
+    pa_xfree(buf);
+
+    pa_mempool_free(shared_pool);
+    pa_mempool_free(pool);
+    pa_mainloop_free(m);
+
+    return 0;
+}
@@ -0,0 +1,299 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <pulse/mainloop.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/core.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/render-pool.h>
+
+/* Runs batches of all sizes and checks that every job is done exactly
+ * once, and that everything is done when pa_render_pool_run()
+ * returns. */
+
+#define MAX_JOBS 300
+
+struct batch {
+    pa_atomic_t calls[MAX_JOBS];
+    double result[MAX_JOBS];
+    pa_thread *thread[MAX_JOBS];
+};
+
+static void job_cb(void *userdata, unsigned idx) {
+    struct batch *b = userdata;
+    double x = 0;
+    unsigned k;
+
+    pa_assert(idx < MAX_JOBS);
+
+    pa_atomic_inc(&b->calls[idx]);
+
+    /* Some work of different length */
+    for (k = 0; k < 1000 * (idx % 7 + 1); k++)
+        x += sin((double) k * idx);
+
+    b->result[idx] = x + idx;
+    b->thread[idx] = pa_thread_self();
+}
+
+static unsigned run(pa_render_pool *p, unsigned n) {
+    static struct batch b;
+    unsigned k, j, n_threads = 0;
+
+    for (k = 0; k < MAX_JOBS; k++) {
+        pa_atomic_store(&b.calls[k], 0);
+        b.result[k] = 0;
+        b.thread[k] = NULL;
+    }
+
+    pa_render_pool_run(p, n, job_cb, &b);
+
+    for (k = 0; k < MAX_JOBS; k++) {
+        pa_assert(pa_atomic_load(&b.calls[k]) == (k < n ? 1 : 0));
+
+        if (k >= n)
+            continue;
+
+        /* Written last by the job */
+        pa_assert(b.thread[k]);
+
+        for (j = 0; j < k; j++)
+            if (b.thread[j] == b.thread[k])
+                break;
+
+        if (j == k)
+            n_threads++;
+    }
+
+    return n_threads;
+}
+
+/* A sink with the pool attached, whose inputs ask for a rewind from
+ * pop(), as a client that just ended an underrun does. The workers
+ * may not touch the sink, so the requests have to show up in the sink
+ * only after the batch, merged into the largest one. */
+
+#define N_INPUTS 8
+#define REWIND_STEP 256
+#define RENDER_BYTES 4096
+
+enum {
+    TEST_SINK_MESSAGE_RENDER = PA_SINK_MESSAGE_MAX
+};
+
+static pa_atomic_t n_pops;
+
+static int test_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    void *p;
+
+    /* Nobody may have touched the sink before us in this batch */
+    pa_assert(!i->sink->thread_info.rewind_requested);
+
+    pa_sink_input_request_rewind(i, (size_t) PA_PTR_TO_UINT(i->userdata), FALSE, TRUE, FALSE);
+
+    chunk->memblock = pa_memblock_new(i->core->mempool, nbytes);
+    chunk->index = 0;
+    chunk->length = nbytes;
+
+    p = pa_memblock_acquire(chunk->memblock);
+    memset(p, 1, nbytes);
+    pa_memblock_release(chunk->memblock);
+
+    pa_atomic_inc(&n_pops);
+    return 0;
+}
+
+static void test_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+}
+
+static void test_kill_cb(pa_sink_input *i) {
+    pa_assert_not_reached();
+}
+
+static int test_sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_sink *s = PA_SINK(o);
+
+    if (code == TEST_SINK_MESSAGE_RENDER) {
+        pa_memchunk result;
+
+        pa_sink_render_full(s, RENDER_BYTES, &result);
+        pa_memblock_unref(result.memblock);
+
+        pa_assert(pa_atomic_load(&s->thread_info.deferred_rewind) == 0);
+        pa_assert(s->thread_info.rewind_requested);
+        *(size_t*) data = s->thread_info.rewind_nbytes;
+
+        pa_sink_process_rewind(s, 0);
+        return 0;
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+struct io_thread {
+    pa_thread_mq mq;
+    pa_rtpoll *rtpoll;
+};
+
+static void io_thread_func(void *userdata) {
+    struct io_thread *io = userdata;
+
+    pa_thread_mq_install(&io->mq);
+
+    for (;;) {
+        int ret;
+
+        if ((ret = pa_rtpoll_run(io->rtpoll, TRUE)) < 0)
+            pa_assert_not_reached();
+
+        if (ret == 0)
+            break;
+    }
+}
+
+static void rewind_from_pop(void) {
+    static const pa_sample_spec ss = { PA_SAMPLE_S16NE, 44100, 2 };
+    pa_mainloop *m;
+    pa_core *c;
+    struct io_thread io;
+    pa_thread *thread;
+    pa_sink_new_data data;
+    pa_sink *s;
+    pa_sink_input *inputs[N_INPUTS];
+    unsigned k, round;
+
+    pa_assert_se(m = pa_mainloop_new());
+    pa_assert_se(c = pa_core_new(pa_mainloop_get_api(m), FALSE, 0));
+
+    io.rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&io.mq, pa_mainloop_get_api(m), io.rtpoll);
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, "test_sink");
+    pa_sink_new_data_set_sample_spec(&data, &ss);
+    data.render_threads = 2;
+    pa_assert_se(s = pa_sink_new(c, &data, PA_SINK_LATENCY|PA_SINK_PARALLEL_RENDER));
+    pa_sink_new_data_done(&data);
+
+    pa_assert(s->render_pool);
+
+    s->parent.process_msg = test_sink_process_msg;
+    pa_sink_set_asyncmsgq(s, io.mq.inq);
+    pa_sink_set_rtpoll(s, io.rtpoll);
+    pa_sink_set_max_rewind(s, RENDER_BYTES);
+
+    pa_assert_se(thread = pa_thread_new(io_thread_func, &io));
+    pa_sink_put(s);
+
+    for (k = 0; k < N_INPUTS; k++) {
+        pa_sink_input_new_data idata;
+
+        pa_sink_input_new_data_init(&idata);
+        idata.driver = __FILE__;
+        idata.sink = s;
+        pa_sink_input_new_data_set_sample_spec(&idata, &ss);
+        pa_assert_se(pa_sink_input_new(&inputs[k], c, &idata) >= 0);
+        pa_sink_input_new_data_done(&idata);
+
+        inputs[k]->pop = test_pop_cb;
+        inputs[k]->process_rewind = test_process_rewind_cb;
+        inputs[k]->kill = test_kill_cb;
+        inputs[k]->userdata = PA_UINT_TO_PTR((k + 1) * REWIND_STEP);
+
+        pa_sink_input_put(inputs[k]);
+    }
+
+    for (round = 0; round < 10; round++) {
+        size_t nbytes = 0;
+
+        pa_atomic_store(&n_pops, 0);
+        pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), TEST_SINK_MESSAGE_RENDER, &nbytes, 0, NULL) == 0);
+
+        /* The rewind flushed what they rendered, so all of them were
+         * asked again */
+        pa_assert(pa_atomic_load(&n_pops) == N_INPUTS);
+        pa_assert(nbytes == N_INPUTS * REWIND_STEP);
+    }
+
+    printf("rewinds requested from pop(): ok\n");
+
+    for (k = 0; k < N_INPUTS; k++) {
+        pa_sink_input_unlink(inputs[k]);
+        pa_sink_input_unref(inputs[k]);
+    }
+
+    pa_sink_unlink(s);
+
+    pa_asyncmsgq_send(io.mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(thread);
+
+    /* Dispatch whatever the IO thread still sent us */
+    while (pa_mainloop_iterate(m, FALSE, NULL) > 0)
+        ;
+
+    pa_thread_mq_done(&io.mq);
+    pa_sink_unref(s);
+    pa_rtpoll_free(io.rtpoll);
+
+    pa_core_unref(c);
+    pa_mainloop_free(m);
+}
+
+int main(int argc, char *argv[]) {
+    static const unsigned n_workers[] = { 1, 3, 8 };
+    unsigned i, n;
+
+    for (i = 0; i < PA_ELEMENTSOF(n_workers); i++) {
+        pa_render_pool *p;
+        unsigned max_threads = 0;
+
+        pa_assert_se(p = pa_render_pool_new(n_workers[i], 0));
+        pa_assert(pa_render_pool_get_n_threads(p) == n_workers[i]);
+
+        for (n = 0; n <= MAX_JOBS; n += (n < 20 ? 1 : 37)) {
+            unsigned t = run(p, n);
+
+            pa_assert(t <= n_workers[i] + 1);
+            max_threads = PA_MAX(max_threads, t);
+        }
+
+        printf("%u workers: up to %u threads per batch\n", n_workers[i], max_threads);
+
+        pa_render_pool_free(p);
+    }
+
+    rewind_from_pop();
+
+    return 0;
+}
@@ -0,0 +1,357 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <pulse/mainloop.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/core.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+
+/* Plays the same streams through a sink once with a resampler of
+ * their own each, and once with a shared one, and checks that the
+ * sink renders exactly the same. The streams only differ from the
+ * sink in the byte order, or in the rate with the trivial resampler,
+ * and all their samples are small multiples of a power of two, so
+ * mixing before or after the conversion gives the same result, bit by
+ * bit. */
+
+#define N_STREAMS 4
+#define BLOCK_FRAMES 1024
+#define MAX_BLOCKS 64
+
+enum {
+    TEST_SINK_MESSAGE_RENDER = PA_SINK_MESSAGE_MAX,
+    TEST_SINK_MESSAGE_REWIND,
+    TEST_SINK_MESSAGE_REWRITE
+};
+
+struct stream {
+    pa_sink_input *input;
+    unsigned id;
+    uint64_t pos; /* in frames, only touched from the IO thread */
+};
+
+struct io_thread {
+    pa_thread_mq mq;
+    pa_rtpoll *rtpoll;
+};
+
+static const pa_sample_spec sink_spec = { PA_SAMPLE_FLOAT32NE, 44100, 2 };
+
+/* What the sink rendered, by position. Written from the IO thread
+ * only while the main thread waits for it. */
+static float output[MAX_BLOCKS * BLOCK_FRAMES * 2];
+static size_t output_index;
+
+static float sample(unsigned id, uint64_t pos, unsigned c) {
+    /* Small enough that nothing clips when mixed */
+    return (float) ((int) ((pos * (id + 3) * 7 + c * 311 + id * 1009) % 2001) - 1000) / 4096.0f;
+}
+
+static int pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    struct stream *s = i->userdata;
+    size_t fs = pa_frame_size(&i->sample_spec), n, k;
+    float *d;
+
+    n = PA_MAX(nbytes / fs, (size_t) 1);
+
+    chunk->memblock = pa_memblock_new(i->core->mempool, n * fs);
+    chunk->index = 0;
+    chunk->length = n * fs;
+
+    d = pa_memblock_acquire(chunk->memblock);
+
+    for (k = 0; k < n; k++, s->pos++) {
+        *(d++) = PA_FLOAT32_SWAP(sample(s->id, s->pos, 0));
+        *(d++) = PA_FLOAT32_SWAP(sample(s->id, s->pos, 1));
+    }
+
+    pa_memblock_release(chunk->memblock);
+
+    return 0;
+}
+
+static void process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+    struct stream *s = i->userdata;
+
+    nbytes /= pa_frame_size(&i->sample_spec);
+
+    pa_assert(nbytes <= s->pos);
+    s->pos -= nbytes;
+}
+
+static void kill_cb(pa_sink_input *i) {
+    pa_assert_not_reached();
+}
+
+/* Like a driver whose whole history can still be rewritten */
+static void process_pending_rewind(pa_sink *s) {
+    size_t nbytes;
+
+    if (!s->thread_info.rewind_requested)
+        return;
+
+    nbytes = PA_MIN(s->thread_info.rewind_nbytes, output_index);
+
+    pa_sink_process_rewind(s, nbytes);
+    output_index -= nbytes;
+}
+
+static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_sink *s = PA_SINK(o);
+
+    switch (code) {
+
+        case TEST_SINK_MESSAGE_RENDER: {
+            pa_memchunk result;
+            void *p;
+
+            process_pending_rewind(s);
+
+            pa_assert(output_index + (size_t) offset <= sizeof(output));
+
+            pa_sink_render_full(s, (size_t) offset, &result);
+
+            p = pa_memblock_acquire(result.memblock);
+            memcpy((uint8_t*) output + output_index, (uint8_t*) p + result.index, result.length);
+            pa_memblock_release(result.memblock);
+            pa_memblock_unref(result.memblock);
+
+            output_index += (size_t) offset;
+            return 0;
+        }
+
+        case TEST_SINK_MESSAGE_REWIND:
+            process_pending_rewind(s);
+
+            pa_assert((size_t) offset <= output_index);
+
+            pa_sink_process_rewind(s, (size_t) offset);
+            output_index -= (size_t) offset;
+            return 0;
+
+        case TEST_SINK_MESSAGE_REWRITE:
+            process_pending_rewind(s);
+
+            pa_sink_input_request_rewind(PA_SINK_INPUT(data), 0, TRUE, FALSE, FALSE);
+            pa_assert(s->thread_info.rewind_requested);
+
+            process_pending_rewind(s);
+            return 0;
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+static void io_thread_func(void *userdata) {
+    struct io_thread *io = userdata;
+
+    pa_thread_mq_install(&io->mq);
+
+    for (;;) {
+        int ret;
+
+        if ((ret = pa_rtpoll_run(io->rtpoll, TRUE)) < 0)
+            pa_assert_not_reached();
+
+        if (ret == 0)
+            break;
+    }
+}
+
+static void add_stream(pa_core *c, pa_sink *sink, struct stream *s, unsigned id, const pa_sample_spec *ss) {
+    pa_sink_input_new_data data;
+
+    pa_sink_input_new_data_init(&data);
+    data.driver = __FILE__;
+    data.sink = sink;
+    data.resample_method = PA_RESAMPLER_TRIVIAL;
+    pa_sink_input_new_data_set_sample_spec(&data, ss);
+    pa_assert_se(pa_sink_input_new(&s->input, c, &data) >= 0);
+    pa_sink_input_new_data_done(&data);
+
+    s->id = id;
+    s->pos = 0;
+
+    s->input->pop = pop_cb;
+    s->input->process_rewind = process_rewind_cb;
+    s->input->kill = kill_cb;
+    s->input->userdata = s;
+
+    pa_sink_input_put(s->input);
+}
+
+static void remove_stream(struct stream *s) {
+    pa_sink_input_unlink(s->input);
+    pa_sink_input_unref(s->input);
+    s->input = NULL;
+}
+
+static void render(pa_sink *sink, unsigned n_blocks) {
+    for (; n_blocks > 0; n_blocks--)
+        pa_assert_se(pa_asyncmsgq_send(sink->asyncmsgq, PA_MSGOBJECT(sink), TEST_SINK_MESSAGE_RENDER, NULL, BLOCK_FRAMES * pa_frame_size(&sink_spec), NULL) == 0);
+}
+
+static void rewind_frames(pa_sink *sink, unsigned n_frames) {
+    pa_assert_se(pa_asyncmsgq_send(sink->asyncmsgq, PA_MSGOBJECT(sink), TEST_SINK_MESSAGE_REWIND, NULL, n_frames * pa_frame_size(&sink_spec), NULL) == 0);
+}
+
+static void rewrite(pa_sink *sink, struct stream *s) {
+    pa_assert_se(pa_asyncmsgq_send(sink->asyncmsgq, PA_MSGOBJECT(sink), TEST_SINK_MESSAGE_REWRITE, s->input, 0, NULL) == 0);
+}
+
+/* Plays the streams, with members coming and going if change_members
+ * is set, and returns how much the sink rendered in the end */
+static size_t run(const pa_sample_spec *ss, pa_bool_t shared, pa_bool_t change_members) {
+    pa_mainloop *m;
+    pa_core *c;
+    struct io_thread io;
+    pa_thread *thread;
+    pa_sink_new_data data;
+    pa_sink *sink;
+    struct stream streams[N_STREAMS];
+    unsigned k;
+
+    memset(output, 0, sizeof(output));
+    output_index = 0;
+
+    pa_assert_se(m = pa_mainloop_new());
+    pa_assert_se(c = pa_core_new(pa_mainloop_get_api(m), FALSE, 0));
+    c->shared_resamplers = shared;
+
+    io.rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&io.mq, pa_mainloop_get_api(m), io.rtpoll);
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, "test_sink");
+    pa_sink_new_data_set_sample_spec(&data, &sink_spec);
+    pa_assert_se(sink = pa_sink_new(c, &data, PA_SINK_LATENCY));
+    pa_sink_new_data_done(&data);
+
+    sink->parent.process_msg = sink_process_msg;
+    pa_sink_set_asyncmsgq(sink, io.mq.inq);
+    pa_sink_set_rtpoll(sink, io.rtpoll);
+    pa_sink_set_max_rewind(sink, 4 * BLOCK_FRAMES * pa_frame_size(&sink_spec));
+
+    pa_assert_se(thread = pa_thread_new(io_thread_func, &io));
+    pa_sink_put(sink);
+
+    for (k = 0; k < N_STREAMS - 1; k++)
+        add_stream(c, sink, streams + k, k, ss);
+
+    /* All of them have to end up in the same group */
+    for (k = 0; k < N_STREAMS - 1; k++)
+        pa_assert(shared ?
+                  streams[k].input->thread_info.group && streams[k].input->thread_info.group == streams[0].input->thread_info.group :
+                  !streams[k].input->thread_info.group);
+
+    render(sink, 6);
+
+    /* The sink plays again what it rendered already */
+    rewind_frames(sink, 3 * BLOCK_FRAMES / 2);
+    render(sink, 4);
+
+    if (change_members) {
+        /* A stream wants to change what it played already, the group
+         * has to mix everything again for that */
+        rewrite(sink, streams + 1);
+        render(sink, 4);
+
+        add_stream(c, sink, streams + N_STREAMS - 1, N_STREAMS - 1, ss);
+        render(sink, 4);
+
+        /* Since a member came, the group mixes again, too */
+        rewind_frames(sink, BLOCK_FRAMES);
+        render(sink, 3);
+
+        remove_stream(streams);
+        render(sink, 3);
+
+        rewind_frames(sink, BLOCK_FRAMES / 2);
+        render(sink, 2);
+    }
+
+    for (k = 0; k < N_STREAMS; k++)
+        if (streams[k].input && (change_members || k < N_STREAMS - 1))
+            remove_stream(streams + k);
+
+    pa_sink_unlink(sink);
+
+    pa_asyncmsgq_send(io.mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(thread);
+
+    /* Dispatch whatever the IO thread still sent us */
+    while (pa_mainloop_iterate(m, FALSE, NULL) > 0)
+        ;
+
+    pa_thread_mq_done(&io.mq);
+    pa_sink_unref(sink);
+    pa_rtpoll_free(io.rtpoll);
+
+    pa_core_unref(c);
+    pa_mainloop_free(m);
+
+    return output_index;
+}
+
+static void compare(const pa_sample_spec *ss, pa_bool_t change_members) {
+    static float reference[PA_ELEMENTSOF(output)];
+    size_t length, i;
+    char t[PA_SAMPLE_SPEC_SNPRINT_MAX];
+
+    length = run(ss, FALSE, change_members);
+    memcpy(reference, output, length);
+
+    pa_assert_se(run(ss, TRUE, change_members) == length);
+
+    for (i = 0; i < length / sizeof(float); i++)
+        if (memcmp(reference + i, output + i, sizeof(float)) != 0) {
+            fprintf(stderr, "%s: sample %lu differs: %f vs. %f\n", pa_sample_spec_snprint(t, sizeof(t), ss), (unsigned long) i, reference[i], output[i]);
+            pa_assert_not_reached();
+        }
+
+    printf("%s: %lu bytes identical\n", pa_sample_spec_snprint(t, sizeof(t), ss), (unsigned long) length);
+}
+
+int main(int argc, char *argv[]) {
+    static const pa_sample_spec same_rate = { PA_SAMPLE_FLOAT32RE, 44100, 2 };
+    static const pa_sample_spec other_rate = { PA_SAMPLE_FLOAT32RE, 22050, 2 };
+
+    compare(&same_rate, TRUE);
+
+    /* The resampler is reset when something is mixed again, and a
+     * new stream starts with a fresh one, so members can't change
+     * here without the phase of the resampling changing, too */
+    compare(&other_rate, FALSE);
+
+    return 0;
+}
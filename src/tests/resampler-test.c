@@ -22,15 +22,22 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
 
 #include <pulse/sample.h>
 #include <pulse/volume.h>
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
 
 #include <pulsecore/resampler.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/endianmacros.h>
 #include <pulsecore/memblock.h>
 #include <pulsecore/sample-util.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/cpu-arm.h>
 
 static void dump_block(const pa_sample_spec *ss, const pa_memchunk *chunk) {
     void *d;
@@ -241,15 +248,277 @@ static pa_memblock* generate_block(pa_mempool *pool, const pa_sample_spec *ss) {
     return r;
 }
 
+/* Follows a slowly changing fractional ratio, the way the drift
+ * compensation does it, and checks that the resampler neither loses
+ * track of the ratio nor glitches when it is changed */
+static void test_rate_ratio(pa_mempool *pool, pa_resample_method_t method) {
+    pa_sample_spec ss;
+    pa_resampler *r;
+    double phase = 0, expected = 0, max_step = 0;
+    float last = 0;
+    unsigned n, out_frames = 0;
+
+    if (!pa_resample_method_supported(method))
+        return;
+
+    ss.format = PA_SAMPLE_FLOAT32NE;
+    ss.channels = 1;
+    ss.rate = 48000;
+
+    pa_assert_se(r = pa_resampler_new(pool, &ss, NULL, &ss, NULL, method, PA_RESAMPLER_VARIABLE_RATE));
+
+    for (n = 0; n < 1000; n++) {
+        pa_memchunk i, j;
+        double ratio;
+        float *d;
+        unsigned k;
+
+        ratio = 1.0 + 100e-6 + 50e-6 * sin(n / 50.0);
+        pa_resampler_set_rate_ratio(r, ratio);
+        expected += 480 / ratio;
+
+        i.memblock = pa_memblock_new(pool, 480 * sizeof(float));
+        i.index = 0;
+        i.length = pa_memblock_get_length(i.memblock);
+
+        d = pa_memblock_acquire(i.memblock);
+        for (k = 0; k < 480; k++, phase += 2 * M_PI * 440 / 48000)
+            d[k] = (float) (0.5 * sin(phase));
+        pa_memblock_release(i.memblock);
+
+        pa_resampler_run(r, &i, &j);
+        pa_memblock_unref(i.memblock);
+
+        if (!j.memblock)
+            continue;
+
+        d = (float*) ((uint8_t*) pa_memblock_acquire(j.memblock) + j.index);
+        for (k = 0; k < j.length / sizeof(float); k++, out_frames++) {
+
+            /* Skip the filter delay at the beginning */
+            if (out_frames > 1000)
+                max_step = PA_MAX(max_step, fabs(d[k] - last));
+
+            last = d[k];
+        }
+        pa_memblock_release(j.memblock);
+        pa_memblock_unref(j.memblock);
+    }
+
+    printf("=== ratio %s: %u frames, expected %0.1f, max step %0.4f\n",
+           pa_resample_method_to_string(method), out_frames, expected, max_step);
+
+    /* Everything but the filter delay is accounted for, and the
+     * largest step between two samples is not much bigger than what
+     * the sine itself has (0.029), even for the trivial resampler
+     * which drops or repeats single samples */
+    pa_assert(fabs(out_frames - expected) < 256);
+    pa_assert(max_step < 0.07);
+
+    pa_resampler_free(r);
+}
+
+/* Resamples a 1 kHz sine and returns the THD+N of the result in dB,
+ * i.e. the power of everything that is not the sine relative to the
+ * sine. Optionally returns the time it took. */
+static double measure_thd_n(pa_mempool *pool, pa_resample_method_t method, uint32_t in_rate, uint32_t out_rate, pa_usec_t *usec) {
+    pa_sample_spec a, b;
+    pa_resampler *r;
+    float *out;
+    unsigned n, k, out_frames = 0, max_frames;
+    double w, ss = 0, sc = 0, cc = 0, xs = 0, xc = 0, amp_s, amp_c, det, signal = 0, noise = 0;
+    pa_usec_t start;
+
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = 1;
+    a.rate = in_rate;
+    b.rate = out_rate;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, method, 0));
+
+    max_frames = out_rate * 2 + 4096;
+    out = pa_xnew(float, max_frames);
+
+    start = pa_rtclock_now();
+
+    /* Two seconds of input in blocks of 1024 frames */
+    for (n = 0; n < in_rate * 2; n += 1024) {
+        pa_memchunk i, j;
+        float *d;
+
+        i.memblock = pa_memblock_new(pool, 1024 * sizeof(float));
+        i.index = 0;
+        i.length = pa_memblock_get_length(i.memblock);
+
+        d = pa_memblock_acquire(i.memblock);
+        for (k = 0; k < 1024; k++)
+            d[k] = (float) (0.9 * sin(2 * M_PI * 1000.0 * (n + k) / in_rate));
+        pa_memblock_release(i.memblock);
+
+        pa_resampler_run(r, &i, &j);
+        pa_memblock_unref(i.memblock);
+
+        if (!j.memblock)
+            continue;
+
+        k = (unsigned) PA_MIN(j.length / sizeof(float), max_frames - out_frames);
+        memcpy(out + out_frames, (uint8_t*) pa_memblock_acquire(j.memblock) + j.index, k * sizeof(float));
+        pa_memblock_release(j.memblock);
+        pa_memblock_unref(j.memblock);
+
+        out_frames += k;
+    }
+
+    if (usec)
+        *usec = pa_rtclock_now() - start;
+
+    pa_resampler_free(r);
+
+    /* Least squares fit of a 1 kHz sine of any phase to the output,
+     * skipping the start-up of the filter */
+    w = 2 * M_PI * 1000.0 / out_rate;
+
+    for (n = out_rate / 10; n < out_frames; n++) {
+        double s = sin(w * n), c = cos(w * n);
+
+        ss += s * s;
+        sc += s * c;
+        cc += c * c;
+        xs += out[n] * s;
+        xc += out[n] * c;
+    }
+
+    det = ss * cc - sc * sc;
+    amp_s = (xs * cc - xc * sc) / det;
+    amp_c = (xc * ss - xs * sc) / det;
+
+    for (n = out_rate / 10; n < out_frames; n++) {
+        double fit = amp_s * sin(w * n) + amp_c * cos(w * n);
+
+        signal += fit * fit;
+        noise += (out[n] - fit) * (out[n] - fit);
+    }
+
+    pa_xfree(out);
+
+    return 10.0 * log10(PA_MAX(noise, 1e-30) / signal);
+}
+
+static const struct {
+    uint32_t in, out;
+} rate_pairs[] = {
+    { 44100, 48000 },
+    { 48000, 44100 },
+    { 8000, 48000 },
+    { 48000, 16000 },
+    { 44100, 47999 } /* has no exact table */
+};
+
+/* The built-in resampler has no external dependencies, so we can
+ * always check that it is as good as it is supposed to be */
+static void test_polyphase_quality(pa_mempool *pool) {
+    static const double limits[] = { -60, -90, -110 };
+    unsigned q, p;
+
+    for (q = 0; q < PA_ELEMENTSOF(limits); q++)
+        for (p = 0; p < PA_ELEMENTSOF(rate_pairs); p++) {
+            double thd_n;
+
+            thd_n = measure_thd_n(pool, PA_RESAMPLER_POLYPHASE_BASE + q, rate_pairs[p].in, rate_pairs[p].out, NULL);
+
+            printf("=== %s %u -> %u: THD+N %0.1f dB\n", pa_resample_method_to_string(PA_RESAMPLER_POLYPHASE_BASE + q),
+                   rate_pairs[p].in, rate_pairs[p].out, thd_n);
+
+            pa_assert(thd_n < limits[q]);
+        }
+}
+
+/* The optimized inner products may only differ from the C version by
+ * rounding */
+static void compare_dot_funcs(pa_resampler_dot_func_t ref, pa_resampler_dot_func_t opt) {
+    float *a, *b;
+    void *mem;
+    unsigned n, i;
+
+    mem = pa_xmalloc(1024 * sizeof(float) + 32);
+    a = (float*) (((uintptr_t) mem + 31) & ~(uintptr_t) 31);
+    b = pa_xnew(float, 1024 + 1);
+
+    for (i = 0; i < 1024; i++) {
+        a[i] = (float) (rand() / (RAND_MAX + 1.0) - 0.5);
+        b[i] = (float) (rand() / (RAND_MAX + 1.0) - 0.5);
+    }
+
+    for (n = 8; n <= 1024; n += 8) {
+        /* The history is usually not aligned */
+        float x = ref(a, b + 1, n), y = opt(a, b + 1, n);
+
+        if (fabs(x - y) > 1e-5 * sqrt(n)) {
+            printf("optimized dot product differs for %u: %g != %g\n", n, y, x);
+            pa_assert_not_reached();
+        }
+    }
+
+    printf("=== optimized dot product matches\n");
+
+    pa_xfree(mem);
+    pa_xfree(b);
+}
+
+static void benchmark_methods(pa_mempool *pool) {
+    pa_resample_method_t m;
+    unsigned p;
+
+    for (m = 0; m < PA_RESAMPLER_MAX; m++) {
+
+        if (m == PA_RESAMPLER_AUTO || m == PA_RESAMPLER_COPY || m == PA_RESAMPLER_PEAKS || m == PA_RESAMPLER_FFMPEG)
+            continue;
+
+        if (!pa_resample_method_supported(m))
+            continue;
+
+        for (p = 0; p < 2; p++) {
+            pa_usec_t usec;
+            double thd_n;
+
+            thd_n = measure_thd_n(pool, m, rate_pairs[p].in, rate_pairs[p].out, &usec);
+
+            printf("%-24s %5u -> %5u %8.1f Msamples/s THD+N %6.1f dB\n",
+                   pa_resample_method_to_string(m), rate_pairs[p].in, rate_pairs[p].out,
+                   (double) rate_pairs[p].in * 2 / (double) PA_MAX(usec, (pa_usec_t) 1), thd_n);
+        }
+    }
+}
+
 int main(int argc, char *argv[]) {
     pa_mempool *pool;
     pa_sample_spec a, b;
     pa_cvolume v;
+    pa_resampler_dot_func_t dot;
+    pa_bool_t benchmark;
+
+    /* Call with -b for a throughput and quality comparison of all
+     * resamplers */
+    benchmark = argc > 1 && pa_streq(argv[1], "-b");
 
-    pa_log_set_level(PA_LOG_DEBUG);
+    pa_log_set_level(benchmark ? PA_LOG_WARN : PA_LOG_DEBUG);
 
     pa_assert_se(pool = pa_mempool_new(FALSE, 0));
 
+    dot = pa_get_resampler_dot_func();
+
+    pa_cpu_init_x86();
+    pa_cpu_init_arm();
+
+    if (benchmark) {
+        benchmark_methods(pool);
+        pa_mempool_free(pool);
+        return 0;
+    }
+
+    if (pa_get_resampler_dot_func() != dot)
+        compare_dot_funcs(dot, pa_get_resampler_dot_func());
+
     a.channels = b.channels = 1;
     a.rate = b.rate = 44100;
 
@@ -296,6 +565,14 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    test_rate_ratio(pool, PA_RESAMPLER_TRIVIAL);
+    test_rate_ratio(pool, PA_RESAMPLER_SPEEX_FLOAT_BASE + 3);
+    test_rate_ratio(pool, PA_RESAMPLER_SPEEX_FIXED_BASE + 3);
+    test_rate_ratio(pool, PA_RESAMPLER_SRC_SINC_FASTEST);
+    test_rate_ratio(pool, PA_RESAMPLER_POLYPHASE_BASE + 1);
+
+    test_polyphase_quality(pool);
+
     pa_mempool_free(pool);
 
     return 0;
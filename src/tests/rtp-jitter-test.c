@@ -0,0 +1,118 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+
+#include "../modules/rtp/jitter.h"
+
+#define FRAMES 160
+
+static pa_mempool *pool;
+
+static void put(pa_rtp_jitter *j, uint16_t sequence, pa_bool_t expect) {
+    pa_rtp_packet p;
+
+    p.chunk.memblock = pa_memblock_new(pool, FRAMES * 2);
+    p.chunk.index = 0;
+    p.chunk.length = FRAMES * 2;
+    p.sequence = sequence;
+    p.timestamp = (uint32_t) sequence * FRAMES;
+    p.ssrc = 4711;
+    p.payload = 10;
+
+    pa_assert_se(pa_rtp_jitter_put(j, &p, (pa_usec_t) sequence * 20000) == expect);
+}
+
+static void get(pa_rtp_jitter *j, pa_bool_t force, int sequence, unsigned lost) {
+    pa_rtp_packet p;
+    unsigned l;
+
+    if (sequence < 0) {
+        pa_assert_se(!pa_rtp_jitter_get(j, &p, force, &l));
+        return;
+    }
+
+    pa_assert_se(pa_rtp_jitter_get(j, &p, force, &l));
+    pa_assert_se(p.sequence == (uint16_t) sequence);
+    pa_assert_se(l == lost);
+
+    pa_memblock_unref(p.chunk.memblock);
+}
+
+int main(int argc, char *argv[]) {
+    pa_rtp_jitter *j;
+    pa_rtp_jitter_stats stats;
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+    pa_assert_se(j = pa_rtp_jitter_new(8000));
+
+    /* In order, across the wrap around */
+    put(j, 65534, TRUE);
+    put(j, 65535, TRUE);
+    put(j, 0, TRUE);
+    get(j, FALSE, 65534, 0);
+    get(j, FALSE, 65535, 0);
+    get(j, FALSE, 0, 0);
+    get(j, TRUE, -1, 0);
+
+    /* Reordered */
+    put(j, 2, TRUE);
+    put(j, 1, TRUE);
+    get(j, FALSE, 1, 0);
+    get(j, FALSE, 2, 0);
+
+    /* A gap: we wait until told otherwise */
+    put(j, 5, TRUE);
+    get(j, FALSE, -1, 0);
+    get(j, TRUE, 5, 2);
+
+    /* The missing ones show up late, duplicates are dropped */
+    put(j, 3, FALSE);
+    put(j, 6, TRUE);
+    put(j, 6, FALSE);
+    get(j, FALSE, 6, 0);
+
+    /* A big jump resynchronizes */
+    put(j, 1000, TRUE);
+    put(j, 1001, TRUE);
+    get(j, FALSE, 1000, 0);
+
+    pa_rtp_jitter_get_stats(j, &stats);
+
+    printf("received=%u lost=%u reordered=%u duplicates=%u late=%u jitter=%lu\n",
+           stats.received, stats.lost, stats.reordered, stats.duplicates, stats.late, (unsigned long) stats.jitter);
+
+    pa_assert_se(stats.received == 9);
+    pa_assert_se(stats.lost == 2 + 993);
+    pa_assert_se(stats.reordered == 1);
+    pa_assert_se(stats.duplicates == 1);
+    pa_assert_se(stats.late == 1);
+
+    pa_rtp_jitter_free(j);
+    pa_mempool_free(pool);
+
+    return 0;
+}
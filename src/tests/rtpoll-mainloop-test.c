@@ -0,0 +1,215 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/rtpoll-mainloop.h>
+
+static int fds[2];
+
+static pa_io_event *ioe, *ioe_once;
+static pa_defer_event *de, *de_once, *de_victim;
+static pa_time_event *te, *te_disabled, *te_quit;
+
+static unsigned n_io, n_io_once, n_defer, n_defer_once, n_time, n_destroy;
+
+static void destroy_cb(pa_mainloop_api *a, void *e, void *userdata) {
+    n_destroy++;
+}
+
+static void iocb(pa_mainloop_api *a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    unsigned char c;
+
+    pa_assert_se(e == ioe);
+    pa_assert_se(f & PA_IO_EVENT_INPUT);
+    pa_assert_se(read(fd, &c, sizeof(c)) == 1);
+
+    fprintf(stderr, "IO EVENT: %c\n", c < 32 ? '.' : c);
+    n_io++;
+
+    /* Each byte read kicks the defer event once more */
+    a->defer_enable(de, 1);
+}
+
+/* Writes the first byte and frees itself right away */
+static void iocb_once(pa_mainloop_api *a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    pa_assert_se(e == ioe_once);
+    pa_assert_se(f & PA_IO_EVENT_OUTPUT);
+    pa_assert_se(write(fd, "a", 1) == 1);
+
+    fprintf(stderr, "IO EVENT (once)\n");
+    n_io_once++;
+
+    a->io_free(e);
+    ioe_once = NULL;
+}
+
+static void dcb(pa_mainloop_api *a, pa_defer_event *e, void *userdata) {
+    fprintf(stderr, "DEFER EVENT\n");
+    n_defer++;
+
+    a->defer_enable(e, 0);
+}
+
+/* Frees another defer event, which hasn't been dispatched yet, and then
+ * itself */
+static void dcb_once(pa_mainloop_api *a, pa_defer_event *e, void *userdata) {
+    fprintf(stderr, "DEFER EVENT (once)\n");
+    n_defer_once++;
+
+    a->defer_free(de_victim);
+    de_victim = NULL;
+
+    a->defer_free(e);
+    de_once = NULL;
+}
+
+static void dcb_victim(pa_mainloop_api *a, pa_defer_event *e, void *userdata) {
+    pa_assert_not_reached();
+}
+
+static void tcb_disabled(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    pa_assert_not_reached();
+}
+
+static void tcb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    struct timeval now;
+
+    pa_assert_se(e == te);
+
+    /* We asked for the monotonic clock */
+    pa_assert_se(tv->tv_usec & PA_TIMEVAL_RTCLOCK);
+
+    fprintf(stderr, "TIME EVENT %u\n", n_time);
+    n_time++;
+
+    if (n_time == 1) {
+        pa_assert_se(write(fds[1], "b", 1) == 1);
+
+        /* One-shot unless restarted */
+        a->time_restart(e, pa_timeval_rtstore(&now, pa_rtclock_now() + 10 * PA_USEC_PER_MSEC, TRUE));
+
+        /* Enabling and disabling again must leave it silent */
+        a->time_restart(te_disabled, pa_timeval_rtstore(&now, pa_rtclock_now() + PA_USEC_PER_SEC, TRUE));
+        a->time_restart(te_disabled, NULL);
+        return;
+    }
+
+    /* Freeing from within the dispatch loop, followed by the quit event */
+    a->time_free(e);
+    te = NULL;
+
+    a->time_restart(te_quit, pa_timeval_rtstore(&now, pa_rtclock_now(), TRUE));
+}
+
+static void tcb_quit(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    fprintf(stderr, "TIME EVENT (quit)\n");
+
+    a->time_free(e);
+    te_quit = NULL;
+
+    a->quit(a, 0);
+}
+
+int main(int argc, char *argv[]) {
+    pa_rtpoll *p;
+    pa_rtpoll_mainloop *m;
+    pa_mainloop_api *a;
+    struct timeval tv;
+    int r;
+
+    pa_assert_se(pipe(fds) == 0);
+
+    p = pa_rtpoll_new();
+    m = pa_rtpoll_mainloop_new(p);
+    a = pa_rtpoll_mainloop_get_api(m);
+
+    ioe = a->io_new(a, fds[0], PA_IO_EVENT_INPUT, iocb, NULL);
+    a->io_set_destroy(ioe, (pa_io_event_destroy_cb_t) destroy_cb);
+
+    ioe_once = a->io_new(a, fds[1], PA_IO_EVENT_OUTPUT, iocb_once, NULL);
+    a->io_set_destroy(ioe_once, (pa_io_event_destroy_cb_t) destroy_cb);
+
+    /* Defer events start out enabled */
+    de = a->defer_new(a, dcb, NULL);
+    a->defer_enable(de, 0);
+
+    /* Lists are prepended to, hence the victim is dispatched after
+     * the event that frees it */
+    de_victim = a->defer_new(a, dcb_victim, NULL);
+    a->defer_set_destroy(de_victim, (pa_defer_event_destroy_cb_t) destroy_cb);
+
+    de_once = a->defer_new(a, dcb_once, NULL);
+    a->defer_set_destroy(de_once, (pa_defer_event_destroy_cb_t) destroy_cb);
+
+    te = a->time_new(a, pa_timeval_rtstore(&tv, pa_rtclock_now() + 10 * PA_USEC_PER_MSEC, TRUE), tcb, NULL);
+    a->time_set_destroy(te, (pa_time_event_destroy_cb_t) destroy_cb);
+
+    /* Disabled by restarting with no time */
+    te_disabled = a->time_new(a, pa_timeval_rtstore(&tv, pa_rtclock_now(), TRUE), tcb_disabled, NULL);
+    a->time_restart(te_disabled, NULL);
+
+    /* Created disabled, enabled by tcb() */
+    te_quit = a->time_new(a, NULL, tcb_quit, NULL);
+
+    while ((r = pa_rtpoll_run(p, TRUE)) > 0)
+        ;
+
+    pa_assert_se(r == 0);
+
+    fprintf(stderr, "io=%u io_once=%u defer=%u defer_once=%u time=%u destroy=%u\n",
+            n_io, n_io_once, n_defer, n_defer_once, n_time, n_destroy);
+
+    pa_assert_se(n_io == 2);
+    pa_assert_se(n_io_once == 1);
+    pa_assert_se(n_defer == 2);
+    pa_assert_se(n_defer_once == 1);
+    pa_assert_se(n_time == 2);
+
+    /* ioe_once, de_victim, de_once and te */
+    pa_assert_se(n_destroy == 4);
+
+    pa_assert_se(!ioe_once && !de_once && !de_victim && !te && !te_quit);
+
+    a->time_free(te_disabled);
+    a->defer_free(de);
+    a->io_free(ioe);
+
+    pa_assert_se(n_destroy == 5);
+
+    pa_rtpoll_mainloop_free(m);
+    pa_rtpoll_free(p);
+
+    pa_close(fds[0]);
+    pa_close(fds[1]);
+
+    return 0;
+}
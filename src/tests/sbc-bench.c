@@ -0,0 +1,192 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sndfile.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/macro.h>
+
+#include "../modules/bluetooth/sbc.h"
+
+/* Encodes the WAV files given on the command line with the SBC
+ * settings A2DP devices commonly use, and prints the throughput. */
+
+#define PASSES 5
+
+struct file {
+    const char *name;
+    int16_t *pcm;
+    size_t length;  /* bytes */
+    unsigned channels;
+    uint8_t frequency;
+    double duration;
+};
+
+static const struct config {
+    const char *name;
+    uint8_t subbands;
+    uint8_t mode;   /* for stereo input */
+    uint8_t bitpool;
+} configs[] = {
+    { "8 subbands, joint stereo", SBC_SB_8, SBC_MODE_JOINT_STEREO, 53 },
+    { "8 subbands, stereo", SBC_SB_8, SBC_MODE_STEREO, 53 },
+    { "4 subbands, joint stereo", SBC_SB_4, SBC_MODE_JOINT_STEREO, 35 },
+    { "4 subbands, stereo", SBC_SB_4, SBC_MODE_STEREO, 35 },
+};
+
+static pa_bool_t load(struct file *f, const char *name) {
+    SNDFILE *sf;
+    SF_INFO info;
+    sf_count_t n;
+
+    memset(&info, 0, sizeof(info));
+
+    if (!(sf = sf_open(name, SFM_READ, &info))) {
+        fprintf(stderr, "Failed to open %s: %s\n", name, sf_strerror(NULL));
+        return FALSE;
+    }
+
+    switch (info.samplerate) {
+        case 16000: f->frequency = SBC_FREQ_16000; break;
+        case 32000: f->frequency = SBC_FREQ_32000; break;
+        case 44100: f->frequency = SBC_FREQ_44100; break;
+        case 48000: f->frequency = SBC_FREQ_48000; break;
+        default:
+            fprintf(stderr, "%s: sample rate %i not supported by SBC, skipping.\n", name, info.samplerate);
+            sf_close(sf);
+            return FALSE;
+    }
+
+    if (info.channels < 1 || info.channels > 2) {
+        fprintf(stderr, "%s: %i channels not supported by SBC, skipping.\n", name, info.channels);
+        sf_close(sf);
+        return FALSE;
+    }
+
+    f->name = name;
+    f->channels = (unsigned) info.channels;
+    f->pcm = pa_xnew(int16_t, (size_t) info.frames * f->channels);
+    n = sf_readf_short(sf, f->pcm, info.frames);
+    f->length = (size_t) n * f->channels * sizeof(int16_t);
+    f->duration = (double) n / info.samplerate;
+
+    sf_close(sf);
+    return TRUE;
+}
+
+static size_t encode(const struct file *f, const struct config *c, uint8_t *out, size_t out_size, const char **implementation) {
+    sbc_t sbc;
+    size_t offset = 0, total = 0;
+
+    pa_assert_se(sbc_init(&sbc, 0) == 0);
+
+    sbc.frequency = f->frequency;
+    sbc.blocks = SBC_BLK_16;
+    sbc.subbands = c->subbands;
+    sbc.mode = f->channels == 1 ? SBC_MODE_MONO : c->mode;
+    sbc.allocation = SBC_AM_LOUDNESS;
+    sbc.bitpool = f->channels == 1 ? c->bitpool / 2 : c->bitpool;
+#ifdef WORDS_BIGENDIAN
+    sbc.endian = SBC_BE;
+#else
+    sbc.endian = SBC_LE;
+#endif
+
+    for (;;) {
+        size_t written;
+        ssize_t r;
+
+        r = sbc_encode(&sbc, (const uint8_t*) f->pcm + offset, f->length - offset, out, out_size, &written);
+
+        if (r <= 0)
+            break;
+
+        offset += (size_t) r;
+        total += written;
+    }
+
+    *implementation = sbc_get_implementation_info(&sbc);
+    sbc_finish(&sbc);
+
+    return total;
+}
+
+int main(int argc, char *argv[]) {
+    struct file *files;
+    unsigned n_files = 0, i, j, k;
+    double duration = 0;
+    size_t length = 0;
+    uint8_t out[1024];
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s FILE.wav ...\n", argv[0]);
+        return 1;
+    }
+
+    files = pa_xnew0(struct file, (unsigned) argc - 1);
+
+    for (i = 1; i < (unsigned) argc; i++)
+        if (load(&files[n_files], argv[i])) {
+            duration += files[n_files].duration;
+            length += files[n_files].length;
+            n_files++;
+        }
+
+    if (n_files <= 0)
+        return 1;
+
+    printf("%u files, %0.1f s of audio\n", n_files, duration);
+
+    for (i = 0; i < PA_ELEMENTSOF(configs); i++) {
+        const char *implementation = NULL;
+        pa_usec_t start, elapsed;
+        size_t encoded = 0;
+
+        start = pa_rtclock_now();
+
+        for (k = 0; k < PASSES; k++)
+            for (j = 0; j < n_files; j++)
+                encoded += encode(&files[j], &configs[i], out, sizeof(out), &implementation);
+
+        elapsed = pa_rtclock_now() - start;
+
+        printf("%s (%s): %0.1f MB/s, %0.0fx realtime, %0.1f kbit/s\n",
+               configs[i].name, implementation,
+               (double) length * PASSES / elapsed,
+               duration * PASSES * PA_USEC_PER_SEC / elapsed,
+               (double) encoded * 8 / PASSES / duration / 1000);
+    }
+
+    for (j = 0; j < n_files; j++)
+        pa_xfree(files[j].pcm);
+    pa_xfree(files);
+
+    return 0;
+}
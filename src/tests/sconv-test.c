@@ -0,0 +1,222 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/sample.h>
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/sconv.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/log.h>
+#include <pulsecore/random.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/cpu-arm.h>
+
+/* Compares the optimized sample format converters with the generic C
+ * versions. Call with -b to get a benchmark instead. */
+
+#define SAMPLES 1019
+#define TIMES 1000
+#define GUARD 64
+
+typedef enum direction {
+    TO_FLOAT32NE,
+    FROM_FLOAT32NE,
+    TO_S16NE,
+    FROM_S16NE,
+    DIRECTION_MAX
+} direction_t;
+
+static const char * const direction_names[DIRECTION_MAX] = {
+    [TO_FLOAT32NE] = "-> float32ne",
+    [FROM_FLOAT32NE] = "<- float32ne",
+    [TO_S16NE] = "-> s16ne",
+    [FROM_S16NE] = "<- s16ne"
+};
+
+static pa_convert_func_t get_func(direction_t d, pa_sample_format_t f) {
+    switch (d) {
+        case TO_FLOAT32NE: return pa_get_convert_to_float32ne_function(f);
+        case FROM_FLOAT32NE: return pa_get_convert_from_float32ne_function(f);
+        case TO_S16NE: return pa_get_convert_to_s16ne_function(f);
+        case FROM_S16NE: return pa_get_convert_from_s16ne_function(f);
+        default: pa_assert_not_reached();
+    }
+}
+
+static size_t in_size(direction_t d, pa_sample_format_t f) {
+    if (d == FROM_FLOAT32NE)
+        return sizeof(float);
+    if (d == FROM_S16NE)
+        return sizeof(int16_t);
+    return pa_sample_size_of_format(f);
+}
+
+static size_t out_size(direction_t d, pa_sample_format_t f) {
+    if (d == TO_FLOAT32NE)
+        return sizeof(float);
+    if (d == TO_S16NE)
+        return sizeof(int16_t);
+    return pa_sample_size_of_format(f);
+}
+
+/* Generates valid input for the converter: float data slightly beyond
+ * [-1.0, 1.0] to exercise the clamping, converted into f with the
+ * reference converter where necessary, so that there are no NaNs */
+static void *generate_input(direction_t d, pa_sample_format_t f, pa_convert_func_t from_float_ref, unsigned n) {
+    float *floats;
+    void *in;
+    unsigned i;
+
+    in = pa_xmalloc(n * in_size(d, f) + GUARD);
+
+    if (d == FROM_S16NE) {
+        pa_random(in, n * sizeof(int16_t));
+        return in;
+    }
+
+    floats = pa_xnew(float, n);
+    for (i = 0; i < n; i++)
+        floats[i] = (float) ((rand() / (RAND_MAX+1.0)) * 2.4 - 1.2);
+
+    /* hit the edges too */
+    if (n > 4) {
+        floats[0] = 1.0f;
+        floats[1] = -1.0f;
+        floats[2] = 0.0f;
+        floats[3] = 0.5f;
+    }
+
+    if (d == FROM_FLOAT32NE) {
+        pa_xfree(in);
+        return floats;
+    }
+
+    from_float_ref(n, floats, in);
+    pa_xfree(floats);
+
+    return in;
+}
+
+static void compare_convert_funcs(direction_t d, pa_sample_format_t f, pa_convert_func_t ref, pa_convert_func_t opt, pa_convert_func_t from_float_ref) {
+    unsigned n;
+
+    for (n = 1; n <= SAMPLES; n = n < 64 ? n + 1 : n * 2 + 1) {
+        uint8_t *a, *b;
+        void *in;
+        size_t len = n * out_size(d, f);
+
+        in = generate_input(d, f, from_float_ref, n);
+        a = pa_xmalloc(len + GUARD);
+        b = pa_xmalloc(len + GUARD);
+        memset(a, 0xAA, len + GUARD);
+        memset(b, 0xAA, len + GUARD);
+
+        ref(n, in, a);
+        opt(n, in, b);
+
+        if (memcmp(a, b, len + GUARD) != 0) {
+            size_t i;
+
+            for (i = 0; i < len + GUARD; i++)
+                if (a[i] != b[i])
+                    break;
+
+            printf("optimized %s %s differs for %u samples at byte %u: %02x != %02x\n",
+                   pa_sample_format_to_string(f), direction_names[d], n, (unsigned) i, b[i], a[i]);
+            pa_assert_not_reached();
+        }
+
+        pa_xfree(in);
+        pa_xfree(a);
+        pa_xfree(b);
+    }
+
+    printf("=== optimized %s %s matches\n", pa_sample_format_to_string(f), direction_names[d]);
+}
+
+static void benchmark_convert_func(direction_t d, pa_sample_format_t f, pa_convert_func_t func, pa_convert_func_t from_float_ref, const char *name) {
+    pa_usec_t start, stop;
+    unsigned j;
+    void *in, *out;
+
+    in = generate_input(d, f, from_float_ref, SAMPLES);
+    out = pa_xmalloc(SAMPLES * out_size(d, f));
+
+    start = pa_rtclock_now();
+    for (j = 0; j < TIMES; j++)
+        func(SAMPLES, in, out);
+    stop = pa_rtclock_now();
+
+    printf("%-10s %-13s %-5s %8.2f ns/sample %8.1f Msamples/s\n",
+           pa_sample_format_to_string(f), direction_names[d], name,
+           (double) (stop - start) * 1000.0 / ((double) TIMES * SAMPLES),
+           (double) TIMES * SAMPLES / (double) PA_MAX(stop - start, (pa_usec_t) 1));
+
+    pa_xfree(in);
+    pa_xfree(out);
+}
+
+int main(int argc, char *argv[]) {
+    pa_convert_func_t ref[DIRECTION_MAX][PA_SAMPLE_MAX];
+    pa_bool_t benchmark;
+    direction_t d;
+    int f;
+
+    benchmark = argc > 1 && pa_streq(argv[1], "-b");
+
+    pa_log_set_level(benchmark ? PA_LOG_WARN : PA_LOG_DEBUG);
+
+    srand(0);
+
+    for (d = 0; d < DIRECTION_MAX; d++)
+        for (f = 0; f < PA_SAMPLE_MAX; f++)
+            ref[d][f] = get_func(d, f);
+
+    pa_cpu_init_x86();
+    pa_cpu_init_arm();
+
+    for (d = 0; d < DIRECTION_MAX; d++)
+        for (f = 0; f < PA_SAMPLE_MAX; f++) {
+            pa_convert_func_t opt = get_func(d, f);
+
+            if (!ref[d][f])
+                continue;
+
+            if (benchmark) {
+                benchmark_convert_func(d, f, ref[d][f], ref[FROM_FLOAT32NE][f], "C");
+
+                if (opt != ref[d][f])
+                    benchmark_convert_func(d, f, opt, ref[FROM_FLOAT32NE][f], "SIMD");
+
+            } else if (opt != ref[d][f])
+                compare_convert_funcs(d, f, ref[d][f], opt, ref[FROM_FLOAT32NE][f]);
+        }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/tagstruct.h>
+
+#define ROUNDS 1000000
+
+/* The kind of packet we expect a tagstruct of this size to end up in */
+static int packet_type(size_t length) {
+
+    if (length <= PA_PACKET_POOL_SIZE_SMALL)
+        return PA_PACKET_POOLED_SMALL;
+
+    if (length <= PA_PACKET_POOL_SIZE/2)
+        return PA_PACKET_APPENDED;
+
+    if (length <= PA_PACKET_POOL_SIZE)
+        return PA_PACKET_POOLED;
+
+    return PA_PACKET_DYNAMIC;
+}
+
+/* Writes n entries into a tagstruct, turns it into a packet, and
+ * reads them back from that */
+static void round_trip(unsigned n) {
+    pa_tagstruct *t;
+    pa_packet *packet;
+    pa_sample_spec ss = { PA_SAMPLE_S16LE, 44100, 2 }, ss2;
+    pa_proplist *p, *q;
+    unsigned i;
+
+    p = pa_proplist_new();
+    pa_assert_se(pa_proplist_sets(p, PA_PROP_MEDIA_NAME, "Test") == 0);
+
+    t = pa_tagstruct_new(NULL, 0);
+
+    for (i = 0; i < n; i++) {
+        pa_tagstruct_putu32(t, i);
+        pa_tagstruct_puts(t, "Hallo Welt");
+        pa_tagstruct_put_sample_spec(t, &ss);
+        pa_tagstruct_put_proplist(t, p);
+    }
+
+    pa_assert_se(packet = pa_tagstruct_free_packet(t));
+    pa_assert_se((int) packet->type == packet_type(packet->length));
+
+    t = pa_tagstruct_new(packet->data, packet->length);
+    q = pa_proplist_new();
+
+    for (i = 0; i < n; i++) {
+        uint32_t u;
+        const char *s;
+
+        pa_assert_se(pa_tagstruct_getu32(t, &u) == 0 && u == i);
+        pa_assert_se(pa_tagstruct_gets(t, &s) == 0 && pa_streq(s, "Hallo Welt"));
+        pa_assert_se(pa_tagstruct_get_sample_spec(t, &ss2) == 0 && pa_sample_spec_equal(&ss, &ss2));
+        pa_assert_se(pa_tagstruct_get_proplist(t, q) == 0);
+        pa_assert_se(pa_streq(pa_proplist_gets(q, PA_PROP_MEDIA_NAME), "Test"));
+    }
+
+    pa_assert_se(pa_tagstruct_eof(t));
+
+    printf("%u entries: %lu bytes\n", n, (unsigned long) packet->length);
+
+    pa_tagstruct_free(t);
+    pa_packet_unref(packet);
+    pa_proplist_free(p);
+    pa_proplist_free(q);
+}
+
+int main(int argc, char *argv[]) {
+    pa_usec_t start;
+    unsigned i;
+
+    round_trip(1);
+    round_trip(10);
+    round_trip(50);
+    round_trip(100);
+    round_trip(10000);
+
+    /* What a simple ack costs, mostly recycled memory */
+    start = pa_rtclock_now();
+
+    for (i = 0; i < ROUNDS; i++) {
+        pa_tagstruct *t;
+
+        t = pa_tagstruct_new(NULL, 0);
+        pa_tagstruct_putu32(t, 2);
+        pa_tagstruct_putu32(t, i);
+        pa_packet_unref(pa_tagstruct_free_packet(t));
+    }
+
+    printf("new+put+free: %0.1f ns\n", (double) (pa_rtclock_now() - start) * 1000.0 / ROUNDS);
+
+    return 0;
+}
@@ -78,6 +78,7 @@ static size_t sample_length = 0;
 static int actions = 1;
 
 static pa_bool_t nl = FALSE;
+static pa_bool_t profile = FALSE;
 
 static enum {
     NONE,
@@ -149,6 +150,66 @@ static void stat_callback(pa_context *c, const pa_stat_info *i, void *userdata)
     complete_action();
 }
 
+/* Returns the upper bound of the bucket the given fraction of all calls fell in, in usec */
+static double histogram_percentile(const pa_render_histogram_info *h, uint64_t total, double fraction) {
+    uint64_t sum = 0;
+    uint32_t b;
+
+    for (b = 0; b < h->n_buckets; b++) {
+        sum += h->buckets[b];
+
+        if ((double) sum >= fraction * (double) total)
+            break;
+    }
+
+    return (double) (1ULL << PA_MIN(b+1, 63U)) / PA_NSEC_PER_USEC;
+}
+
+static void get_render_profile_info_callback(pa_context *c, const pa_render_profile_info *i, int is_last, void *userdata) {
+    uint32_t j;
+
+    if (is_last < 0) {
+        pa_log(_("Failed to get render profile: %s"), pa_strerror(pa_context_errno(c)));
+        quit(1);
+        return;
+    }
+
+    if (is_last) {
+        complete_action();
+        return;
+    }
+
+    pa_assert(i);
+
+    printf("\n");
+
+    if (i->facility == PA_SUBSCRIPTION_EVENT_SINK)
+        printf(_("Render profile of sink #%u (%s):\n"), i->index, i->name);
+    else
+        printf(_("Render profile of sink input #%u on sink #%u (%s):\n"), i->index, i->sink, i->name);
+
+    for (j = 0; j < i->n_histograms; j++) {
+        const pa_render_histogram_info *h = &i->histograms[j];
+        uint64_t total = 0;
+        uint32_t b;
+
+        for (b = 0; b < h->n_buckets; b++)
+            total += h->buckets[b];
+
+        if (total <= 0) {
+            printf(_("\t%s: no calls\n"), h->name);
+            continue;
+        }
+
+        printf(_("\t%s: %llu calls, 50%% < %0.1f usec, 99%% < %0.1f usec, max < %0.1f usec\n"),
+               h->name,
+               (unsigned long long) total,
+               histogram_percentile(h, total, 0.5),
+               histogram_percentile(h, total, 0.99),
+               histogram_percentile(h, total, 1.0));
+    }
+}
+
 static void get_server_info_callback(pa_context *c, const pa_server_info *i, void *useerdata) {
     char ss[PA_SAMPLE_SPEC_SNPRINT_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX];
 
@@ -730,6 +791,19 @@ static void context_state_callback(pa_context *c, void *userdata) {
                     actions = 2;
                     pa_operation_unref(pa_context_stat(c, stat_callback, NULL));
                     pa_operation_unref(pa_context_get_server_info(c, get_server_info_callback, NULL));
+
+                    if (profile) {
+                        pa_operation *o;
+
+                        if (!(o = pa_context_get_render_profile_info_list(c, get_render_profile_info_callback, NULL))) {
+                            pa_log(_("Failed to get render profile: %s"), pa_strerror(pa_context_errno(c)));
+                            quit(1);
+                            break;
+                        }
+
+                        actions++;
+                        pa_operation_unref(o);
+                    }
                     break;
 
                 case PLAY_SAMPLE:
@@ -866,7 +940,7 @@ static void exit_signal_callback(pa_mainloop_api *m, pa_signal_event *e, int sig
 
 static void help(const char *argv0) {
 
-    printf(_("%s [options] stat\n"
+    printf(_("%s [options] stat [--profile]\n"
              "%s [options] list\n"
              "%s [options] exit\n"
              "%s [options] upload-sample FILENAME [NAME]\n"
@@ -890,7 +964,8 @@ static void help(const char *argv0) {
              "  -h, --help                            Show this help\n"
              "      --version                         Show version\n\n"
              "  -s, --server=SERVER                   The name of the server to connect to\n"
-             "  -n, --client-name=NAME                How to call this client on the server\n"),
+             "  -n, --client-name=NAME                How to call this client on the server\n"
+             "      --profile                         Show render latency histograms with stat\n"),
            argv0, argv0, argv0, argv0, argv0,
            argv0, argv0, argv0, argv0, argv0,
            argv0, argv0, argv0, argv0, argv0,
@@ -899,7 +974,8 @@ static void help(const char *argv0) {
 }
 
 enum {
-    ARG_VERSION = 256
+    ARG_VERSION = 256,
+    ARG_PROFILE
 };
 
 int main(int argc, char *argv[]) {
@@ -911,6 +987,7 @@ int main(int argc, char *argv[]) {
         {"server",      1, NULL, 's'},
         {"client-name", 1, NULL, 'n'},
         {"version",     0, NULL, ARG_VERSION},
+        {"profile",     0, NULL, ARG_PROFILE},
         {"help",        0, NULL, 'h'},
         {NULL,          0, NULL, 0}
     };
@@ -944,6 +1021,10 @@ int main(int argc, char *argv[]) {
                 server = pa_xstrdup(optarg);
                 break;
 
+            case ARG_PROFILE:
+                profile = TRUE;
+                break;
+
             case 'n': {
                 char *t;
 